@@ -0,0 +1,135 @@
+/*
+ * cache.c -- optional on-disk cache of GET results for the rfs client
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "cache.h"
+#include "local.h"
+#include "protocol.h"
+
+#define CACHE_MAGIC    "RFSCACH1"
+#define CACHE_HDR_LEN  28           /* magic, checksum, size, key_len */
+
+/**
+ * @brief Look up the cache entry for a key.
+ */
+int cache_lookup(const char *key, cache_entry_t *e)
+{
+    e->fd = -1;
+
+    const char *dir = getenv(CACHE_DIR_ENV);
+    if (!dir || !dir[0])
+        return -1;
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST)
+        return -1;
+
+    size_t key_len = strlen(key);
+    uint64_t h = rfs_fnv64(RFS_FNV64_INIT, key, key_len);
+    if (snprintf(e->path, sizeof(e->path), "%s/%016llx", dir,
+                 (unsigned long long)h) >= (int)sizeof(e->path))
+        return -1;
+
+    int fd = open(e->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+
+    /* the key is stored too, so a hash collision is just a miss */
+    uint8_t hdr[CACHE_HDR_LEN];
+    char stored[RFS_MAX_PATH + 64];
+    struct stat st;
+    uint32_t stored_len = 0;
+    int ok = pread(fd, hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+             memcmp(hdr, CACHE_MAGIC, 8) == 0;
+    if (ok)
+    {
+        memcpy(&stored_len, hdr + 24, 4);
+        stored_len = ntohl(stored_len);
+        ok = stored_len == key_len && key_len <= sizeof(stored) &&
+             pread(fd, stored, key_len, CACHE_HDR_LEN) == (ssize_t)key_len &&
+             memcmp(stored, key, key_len) == 0;
+    }
+
+    e->checksum = rfs_get_u64(hdr + 8);
+    e->size = rfs_get_u64(hdr + 16);
+    e->data_off = CACHE_HDR_LEN + key_len;
+    if (!ok || fstat(fd, &st) < 0 ||
+        (uint64_t)st.st_size != e->data_off + e->size)
+    {
+        close(fd);
+        return 0;
+    }
+
+    e->fd = fd;
+    return 1;
+}
+
+/**
+ * @brief Copy a hit's contents to a descriptor.
+ */
+int cache_copy_out(const cache_entry_t *e, int dst_fd)
+{
+    return copy_fd_at(e->fd, e->data_off, dst_fd, e->size);
+}
+
+/**
+ * @brief Replace an entry with the first @p size bytes of a file.
+ */
+int cache_store(cache_entry_t *e, const char *key, int src_fd, uint64_t size,
+                uint64_t checksum)
+{
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.XXXXXX", e->path);
+    int fd = mkstemp(tmp);
+    if (fd < 0)
+        return -1;
+
+    uint32_t key_len = (uint32_t)strlen(key);
+    uint32_t key_len_net = htonl(key_len);
+    uint8_t hdr[CACHE_HDR_LEN];
+    memcpy(hdr, CACHE_MAGIC, 8);
+    rfs_put_u64(hdr + 8, checksum);
+    rfs_put_u64(hdr + 16, size);
+    memcpy(hdr + 24, &key_len_net, 4);
+
+    int ok = write(fd, hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+             write(fd, key, key_len) == (ssize_t)key_len &&
+             copy_fd(src_fd, fd, size) == 0;
+    if (close(fd) < 0)
+        ok = 0;
+    if (!ok || rename(tmp, e->path) < 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Delete an entry.
+ */
+void cache_drop(cache_entry_t *e)
+{
+    cache_close(e);
+    unlink(e->path);
+}
+
+/**
+ * @brief Close an entry opened by cache_lookup().
+ */
+void cache_close(cache_entry_t *e)
+{
+    if (e->fd >= 0)
+        close(e->fd);
+    e->fd = -1;
+}
@@ -0,0 +1,86 @@
+/*
+ * cache.h -- optional on-disk cache of GET results for the rfs client
+ *
+ * Set RFS_CACHE_DIR to a directory to enable it. Every remote file the
+ * client downloads is kept there as one entry, named by the FNV-1a-64
+ * of its key ("server:port/remote/path") in hex:
+ *
+ *    0  magic "RFSCACH1"
+ *    8  uint64 FNV-1a-64 checksum of the contents
+ *   16  uint64 size of the contents
+ *   24  uint32 key_len, then the key, then the contents
+ *
+ * A GET of a cached file sends the entry's checksum as a conditional
+ * GET (RFS_F_IF_NONE_MATCH). If the server's copy still has it, the
+ * server answers RFS_NOT_MODIFIED without a body and the file is copied
+ * out of the cache: one round trip, no payload. An entry is only ever
+ * served after the server has confirmed it, so entries never go stale
+ * in a way that matters and are not expired.
+ *
+ * Entries are written to a temp file and renamed into place, so a
+ * concurrent reader sees a whole entry or none.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+
+#define CACHE_DIR_ENV "RFS_CACHE_DIR"
+
+/* One cache entry, as found by cache_lookup(). */
+typedef struct
+{
+    int fd;                 /* entry open for reading, or -1          */
+    uint64_t checksum;      /* contents checksum (valid on a hit)     */
+    uint64_t size;          /* contents size (valid on a hit)         */
+    uint64_t data_off;      /* offset of the contents in the entry    */
+    char path[1024];        /* entry file                             */
+} cache_entry_t;
+
+/**
+ * @brief Look up the cache entry for a key.
+ *
+ * @param key Cache key ("server:port/remote/path").
+ * @param e Receives the entry; e->path is set on a hit or a miss, so
+ *          a miss can be filled with cache_store().
+ *
+ * @return 1 on a hit (e->fd open), 0 on a miss, or -1 if the cache is
+ *         disabled or unusable.
+ */
+int cache_lookup(const char *key, cache_entry_t *e);
+
+/**
+ * @brief Copy a hit's contents to a descriptor (at its current offset).
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int cache_copy_out(const cache_entry_t *e, int dst_fd);
+
+/**
+ * @brief Replace an entry with the first @p size bytes of a file.
+ *
+ * @param e Entry from cache_lookup() (hit or miss).
+ * @param key Cache key, as passed to cache_lookup().
+ * @param src_fd File holding the contents, read from offset 0.
+ * @param size Contents size.
+ * @param checksum FNV-1a-64 of the contents.
+ *
+ * @return 0 on success, or -1 on error (the old entry is left as is).
+ */
+int cache_store(cache_entry_t *e, const char *key, int src_fd, uint64_t size,
+                uint64_t checksum);
+
+/**
+ * @brief Delete an entry (the remote file no longer exists).
+ */
+void cache_drop(cache_entry_t *e);
+
+/**
+ * @brief Close an entry opened by cache_lookup().
+ */
+void cache_close(cache_entry_t *e);
+
+#endif /* CACHE_H */
@@ -0,0 +1,367 @@
+/*
+ * delta.c -- rsync-style delta transfer shared by the RFS client and server
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "delta.h"
+#include "protocol.h"
+
+/**
+ * @brief Block size used for a base file of @p size bytes.
+ */
+uint32_t delta_block_size(uint64_t size)
+{
+    uint64_t bs = DELTA_MIN_BLOCK;
+    while (bs * bs < size)
+        bs *= 2;
+    while ((size + bs - 1) / bs > DELTA_MAX_BLOCKS)
+        bs *= 2;
+    return (uint32_t)bs;
+}
+
+/**
+ * @brief Weak (rolling) checksum of a block.
+ */
+uint32_t delta_weak_sum(const uint8_t *p, size_t len)
+{
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        a += p[i];
+        b += (uint32_t)(len - i) * p[i];
+    }
+    return (a & 0xffff) | (b << 16);
+}
+
+/*------------------------------------------------------------*/
+/*                      Delta generation                      */
+/*------------------------------------------------------------*/
+
+/* Buffered writer for the ops, plus the pending run of block copies. */
+typedef struct
+{
+    int fd;
+    int failed;
+    size_t len;
+    uint8_t buf[RFS_IO_CHUNK];
+    uint32_t run_first;         /* first block of the pending copy run */
+    uint32_t run_count;         /* 0 if no run is pending              */
+} delta_out_t;
+
+/* Lookup of block signatures by weak checksum (chained hash table). */
+typedef struct
+{
+    const delta_sigs_t *base;
+    uint32_t mask;
+    int32_t *head;              /* first block per bucket, or -1       */
+    int32_t *next;              /* next block in the same bucket       */
+} sig_table_t;
+
+/**
+ * @brief Write exactly @p len bytes to a file descriptor.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            perror("write delta");
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Append bytes to the op stream.
+ */
+static void out_put(delta_out_t *o, const void *p, size_t n)
+{
+    if (o->failed)
+        return;
+    if (o->len + n > sizeof(o->buf))
+    {
+        if (write_all(o->fd, o->buf, o->len) < 0)
+        {
+            o->failed = 1;
+            return;
+        }
+        o->len = 0;
+        if (n >= sizeof(o->buf))
+        {
+            if (write_all(o->fd, p, n) < 0)
+                o->failed = 1;
+            return;
+        }
+    }
+    memcpy(o->buf + o->len, p, n);
+    o->len += n;
+}
+
+/**
+ * @brief Emit the pending run of block copies, if any.
+ */
+static void out_copy_run(delta_out_t *o)
+{
+    if (o->run_count == 0)
+        return;
+    uint8_t op[9];
+    uint32_t first = htonl(o->run_first);
+    uint32_t count = htonl(o->run_count);
+    op[0] = DELTA_OP_COPY;
+    memcpy(op + 1, &first, 4);
+    memcpy(op + 5, &count, 4);
+    out_put(o, op, sizeof(op));
+    o->run_count = 0;
+}
+
+/**
+ * @brief Emit literal data (after the pending copy run, to keep order).
+ */
+static void out_literal(delta_out_t *o, const uint8_t *p, size_t len,
+                        delta_result_t *res)
+{
+    if (len == 0)
+        return;
+    out_copy_run(o);
+    uint8_t op[5];
+    uint32_t len_net = htonl((uint32_t)len);
+    op[0] = DELTA_OP_LITERAL;
+    memcpy(op + 1, &len_net, 4);
+    out_put(o, op, sizeof(op));
+    out_put(o, p, len);
+    res->literal_bytes += len;
+}
+
+/**
+ * @brief Add one matched block, extending the pending run if it follows.
+ */
+static void out_block(delta_out_t *o, uint32_t block)
+{
+    if (o->run_count > 0 && o->run_first + o->run_count == block)
+    {
+        o->run_count++;
+        return;
+    }
+    out_copy_run(o);
+    o->run_first = block;
+    o->run_count = 1;
+}
+
+/** @brief Bucket of a weak checksum. */
+static uint32_t sig_bucket(const sig_table_t *t, uint32_t weak)
+{
+    return (uint32_t)(((uint64_t)weak * 0x9E3779B97F4A7C15ull) >> 32) & t->mask;
+}
+
+/**
+ * @brief Build the weak-checksum table for a set of signatures.
+ *
+ * @return 0 on success, or -1 if memory could not be allocated.
+ */
+static int sig_table_init(sig_table_t *t, const delta_sigs_t *base)
+{
+    uint32_t size = 1;
+    while (size < 2 * base->nblocks)
+        size *= 2;
+
+    t->base = base;
+    t->mask = size - 1;
+    t->head = (int32_t *)malloc(size * sizeof(int32_t));
+    t->next = (int32_t *)malloc((base->nblocks + 1) * sizeof(int32_t));
+    if (!t->head || !t->next)
+    {
+        free(t->head);
+        free(t->next);
+        return -1;
+    }
+    memset(t->head, 0xff, size * sizeof(int32_t));
+
+    /* inserted from the end, so each chain lists blocks in file order */
+    for (uint32_t j = base->nblocks; j-- > 0;)
+    {
+        uint32_t slot = sig_bucket(t, base->sigs[j].weak);
+        t->next[j] = t->head[slot];
+        t->head[slot] = (int32_t)j;
+    }
+    return 0;
+}
+
+/**
+ * @brief Find a base block identical to a window of the local file.
+ *
+ * @return The block number, or -1 if none matches.
+ */
+static int32_t sig_table_find(const sig_table_t *t, uint32_t weak,
+                              const uint8_t *p, size_t len)
+{
+    const delta_sigs_t *base = t->base;
+    uint64_t last_len = base->size - (uint64_t)(base->nblocks - 1) * base->block_size;
+    uint64_t strong = 0;
+    int have_strong = 0;
+
+    for (int32_t j = t->head[sig_bucket(t, weak)]; j >= 0; j = t->next[j])
+    {
+        uint64_t block_len = (uint32_t)j == base->nblocks - 1
+                                 ? last_len : base->block_size;
+        if (base->sigs[j].weak != weak || block_len != len)
+            continue;
+        if (!have_strong)
+        {
+            strong = rfs_fnv64(RFS_FNV64_INIT, p, len);
+            have_strong = 1;
+        }
+        if (base->sigs[j].strong == strong)
+            return j;
+    }
+    return -1;
+}
+
+/**
+ * @brief Write the delta ops that turn the base into a local file.
+ *
+ * The buffer holds the window being matched (buf[w..w+n)) and the
+ * literal bytes before it that have not been emitted yet
+ * (buf[lit..w)). When the window reaches the end of the buffer, the
+ * literal is emitted, the window moves to the front, and the buffer is
+ * refilled from the file.
+ */
+int delta_generate(int fd, uint64_t size, const delta_sigs_t *base,
+                   int out_fd, delta_result_t *res)
+{
+    size_t bs = base->block_size;
+    size_t cap = 4 * bs > 4 * RFS_IO_CHUNK ? 4 * bs : 4 * RFS_IO_CHUNK;
+    uint8_t *buf = (uint8_t *)malloc(cap);
+    delta_out_t *o = (delta_out_t *)calloc(1, sizeof(*o));
+    sig_table_t table;
+    if (!buf || !o || sig_table_init(&table, base) < 0)
+    {
+        fprintf(stderr, "SYNC: out of memory\n");
+        free(buf);
+        free(o);
+        return -1;
+    }
+    o->fd = out_fd;
+    memset(res, 0, sizeof(*res));
+
+    uint64_t h = RFS_FNV64_INIT;
+    uint64_t read_off = 0;
+    size_t fill = 0;
+    size_t w = 0;
+    size_t lit = 0;
+    int rc = 0;
+
+    for (;;)
+    {
+        size_t n = 0;
+        uint32_t a = 0;
+        uint32_t b = 0;
+
+        for (;;)
+        {
+            /* keep a whole window in the buffer while the file lasts */
+            int short_window = n ? w + n >= fill : w + bs > fill;
+            if (short_window && read_off < size)
+            {
+                out_literal(o, buf + lit, w - lit, res);
+                memmove(buf, buf + w, fill - w);
+                fill -= w;
+                lit = w = 0;
+                while (fill < cap && read_off < size)
+                {
+                    size_t want = cap - fill;
+                    if (size - read_off < want)
+                        want = (size_t)(size - read_off);
+                    ssize_t got = read(fd, buf + fill, want);
+                    if (got < 0 && errno == EINTR)
+                        continue;
+                    if (got <= 0)
+                    {
+                        fprintf(stderr, "SYNC: local file changed while reading\n");
+                        rc = -1;
+                        goto done;
+                    }
+                    h = rfs_fnv64(h, buf + fill, (size_t)got);
+                    fill += (size_t)got;
+                    read_off += (uint64_t)got;
+                }
+            }
+
+            if (n == 0)
+            {
+                /* start a new window */
+                n = fill - w < bs ? fill - w : bs;
+                if (n == 0)
+                    goto done;
+                uint32_t weak = delta_weak_sum(buf + w, n);
+                a = weak & 0xffff;
+                b = weak >> 16;
+            }
+
+            int32_t j = sig_table_find(&table, (a & 0xffff) | (b << 16), buf + w, n);
+            if (j >= 0)
+            {
+                out_literal(o, buf + lit, w - lit, res);
+                out_block(o, (uint32_t)j);
+                res->copied_bytes += n;
+                w += n;
+                lit = w;
+                break;
+            }
+
+            /* no match: slide one byte, or shrink the window at EOF */
+            uint8_t out = buf[w];
+            if (w + n < fill)
+            {
+                a += (uint32_t)buf[w + n] - out;
+                b += a - (uint32_t)n * out;
+            }
+            else
+            {
+                a -= out;
+                b -= (uint32_t)n * out;
+                n--;
+            }
+            w++;
+            if (n == 0)
+                break;
+        }
+    }
+
+done:
+    if (rc == 0)
+    {
+        out_literal(o, buf + lit, fill - lit, res);
+        out_copy_run(o);
+        if (!o->failed && o->len > 0 && write_all(o->fd, o->buf, o->len) < 0)
+            o->failed = 1;
+        if (o->failed)
+            rc = -1;
+        res->checksum = h;
+    }
+
+    free(table.head);
+    free(table.next);
+    free(buf);
+    free(o);
+    return rc;
+}
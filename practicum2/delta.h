@@ -0,0 +1,111 @@
+/*
+ * delta.h -- rsync-style delta transfer shared by the RFS client and server
+ *
+ * SYNC re-uploads a modified file by sending only what changed:
+ *
+ *  1. SIGS: the server splits the current version into blocks of
+ *     delta_block_size() bytes (the last one may be shorter) and replies
+ *     with a weak rolling checksum and a strong FNV-1a-64 per block.
+ *  2. The client slides a window over its file one byte at a time. The
+ *     weak checksum rolls in O(1) per byte; a weak hit is confirmed with
+ *     the strong checksum. Matched blocks become block references and
+ *     everything in between becomes literal data (delta_generate()).
+ *  3. DELTA: the server rebuilds the new version from the current one
+ *     and the literals, checks it against the client's whole-file
+ *     checksum, and commits it like a WRITE.
+ *
+ * SIGS reply payload:
+ *    0  uint32 block_size, uint32 block count, uint64 file size
+ *   16  per block: uint32 weak checksum, uint64 strong checksum
+ *  end  uint64 FNV-1a-64 of the whole file (identifies the base)
+ *
+ * DELTA request payload (followed by the RFS_F_DATA_SUM trailer):
+ *    0  uint64 base checksum, uint64 new size, uint64 new checksum,
+ *       uint32 block_size
+ *   28  ops until the end of the payload:
+ *       DELTA_OP_COPY    uint32 first block, uint32 block count
+ *       DELTA_OP_LITERAL uint32 length, then that many bytes
+ *
+ * Multi-byte fields are in network byte order.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DELTA_MIN_BLOCK  1024           /* smallest block size             */
+#define DELTA_MAX_BLOCKS (1u << 20)     /* most blocks (signatures) a file has */
+
+#define DELTA_SIGS_HDR   16     /* block size, block count, file size     */
+#define DELTA_SIG_LEN    12     /* weak + strong checksum of one block    */
+#define DELTA_HDR_LEN    28     /* DELTA payload header                   */
+
+#define DELTA_OP_COPY    'C'
+#define DELTA_OP_LITERAL 'L'
+
+/* Signature of one block of the base file. */
+typedef struct
+{
+    uint32_t weak;
+    uint64_t strong;
+} delta_sig_t;
+
+/* Signatures of a base file, as received from SIGS. */
+typedef struct
+{
+    uint32_t block_size;
+    uint32_t nblocks;
+    uint64_t size;              /* base file size                      */
+    uint64_t checksum;          /* FNV-1a-64 of the whole base file    */
+    delta_sig_t *sigs;
+} delta_sigs_t;
+
+/* What delta_generate() produced. */
+typedef struct
+{
+    uint64_t literal_bytes;     /* file bytes sent as literals         */
+    uint64_t copied_bytes;      /* file bytes sent as block references */
+    uint64_t checksum;          /* FNV-1a-64 of the new file           */
+} delta_result_t;
+
+/**
+ * @brief Block size used for a base file of @p size bytes.
+ *
+ * About the square root of the size (as rsync does), at least
+ * DELTA_MIN_BLOCK and large enough that the file has at most
+ * DELTA_MAX_BLOCKS blocks.
+ */
+uint32_t delta_block_size(uint64_t size);
+
+/**
+ * @brief Weak (rolling) checksum of a block.
+ *
+ * rsync's checksum: with a = sum of the bytes and b = sum of
+ * (len - i) * byte[i], both mod 2^16, the result is a | b << 16.
+ */
+uint32_t delta_weak_sum(const uint8_t *p, size_t len);
+
+/**
+ * @brief Write the delta ops that turn the base into a local file.
+ *
+ * The file is read once, sequentially, through a buffer of a few
+ * blocks, so memory does not depend on its size. Only the ops are
+ * written (no DELTA header).
+ *
+ * @param fd Local file, read from offset 0.
+ * @param size Its size.
+ * @param base Signatures of the server's current version.
+ * @param out_fd Where the ops are written (at its current offset).
+ * @param res Receives literal / copied byte counts and the checksum.
+ *
+ * @return 0 on success, or -1 on error (including a file that changed
+ *         size while being read).
+ */
+int delta_generate(int fd, uint64_t size, const delta_sigs_t *base,
+                   int out_fd, delta_result_t *res);
+
+#endif /* DELTA_H */
@@ -0,0 +1,1294 @@
+/*
+ * index.c -- memory-mapped metadata index: hash table, rebuild, queries
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#define _GNU_SOURCE     /* fdopendir/openat helpers, st_mtim */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index.h"
+#include "protocol.h"
+#include "server.h"
+#include "snapshot.h"
+#include "tier.h"
+
+#define INDEX_MAGIC     "RFSIDX1"
+#define INDEX_LAYOUT    2
+#define INDEX_MIN_SLOTS 1024
+#define INDEX_MIN_HEAP  (64 * 1024)
+
+/* Slot hash values with special meaning; real hashes are >= 2. */
+#define SLOT_EMPTY 0
+#define SLOT_DEAD  1
+
+typedef struct
+{
+    char     magic[8];
+    uint32_t layout;
+    uint32_t clean;         /* 1 only while no server has it open */
+    uint64_t nslots;        /* power of two */
+    uint64_t live;          /* slots holding an entry */
+    uint64_t dead;          /* tombstones */
+    uint64_t heap_cap;
+    uint64_t heap_used;
+    uint64_t heap_garbage;  /* bytes of paths no longer referenced */
+} index_hdr_t;
+
+/*
+ * A directory record (INDEX_F_DIR) reuses the fields: checksum is its
+ * digest, size the number of files below it and version how many of
+ * those have no checksum yet. The root directory's path is "".
+ */
+typedef struct
+{
+    uint64_t hash;          /* SLOT_EMPTY, SLOT_DEAD, or path hash */
+    uint64_t path_off;      /* into the heap */
+    uint32_t path_len;
+    uint32_t version;
+    uint64_t size;
+    int64_t  mtime_ns;
+    uint64_t checksum;
+    uint32_t flags;
+    uint32_t reserved;
+} index_slot_t;
+
+static pthread_rwlock_t index_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static char index_dir[1024];    /* server root */
+static int index_fd = -1;
+static uint8_t *index_map = NULL;
+static size_t index_map_len = 0;
+
+static index_hdr_t *hdr(void) { return (index_hdr_t *)index_map; }
+
+static index_slot_t *slots(void)
+{
+    return (index_slot_t *)(index_map + sizeof(index_hdr_t));
+}
+
+static char *heap(void)
+{
+    return (char *)(index_map + sizeof(index_hdr_t) +
+                    hdr()->nslots * sizeof(index_slot_t));
+}
+
+/*------------------------------------------------------------*/
+/*                       Path helpers                         */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Normalize a remote path: no leading "/" or "./", no empty or
+ *        "." components. A trailing "/" (prefix queries) is kept.
+ *
+ * @return 0 on success, or -1 if the result does not fit.
+ */
+static int normalize(const char *in, char *out, size_t size)
+{
+    size_t n = 0;
+    const char *p = in;
+
+    while (*p)
+    {
+        if (*p == '/')
+        {
+            p++;
+            continue;
+        }
+        if (p[0] == '.' && (p[1] == '/' || p[1] == '\0'))
+        {
+            p++;
+            continue;
+        }
+
+        const char *end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (n + len + 2 > size)
+            return -1;
+        if (n > 0)
+            out[n++] = '/';
+        memcpy(out + n, p, len);
+        n += len;
+        p += len;
+    }
+
+    /* keep the trailing slash of "dir/" so it only matches inside dir */
+    size_t in_len = strlen(in);
+    if (n > 0 && in_len > 0 && in[in_len - 1] == '/')
+        out[n++] = '/';
+
+    out[n] = '\0';
+    return 0;
+}
+
+static uint64_t path_hash(const char *path, size_t len)
+{
+    uint64_t h = rfs_fnv64(RFS_FNV64_INIT, path, len);
+    return h < 2 ? h + 2 : h;
+}
+
+/**
+ * @brief Report whether a remote path names the index file itself.
+ */
+int index_reserved(const char *remote_path)
+{
+    char norm[RFS_MAX_PATH];
+    if (normalize(remote_path, norm, sizeof(norm)) < 0)
+        return 0;
+    size_t n = strlen(INDEX_FILE);
+    return strncmp(norm, INDEX_FILE, n) == 0 && (norm[n] == '\0' || norm[n] == '.');
+}
+
+/**
+ * @brief Report whether a file name is a saved version ("name.vN").
+ */
+int index_is_version_name(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    if (!dot || dot[1] != 'v' || dot[2] == '\0')
+        return 0;
+    for (const char *p = dot + 2; *p; p++)
+    {
+        if (!isdigit((unsigned char)*p))
+            return 0;
+    }
+    return 1;
+}
+
+/*------------------------------------------------------------*/
+/*                    Mapping and hash table                  */
+/*------------------------------------------------------------*/
+
+static size_t map_size(uint64_t nslots, uint64_t heap_cap)
+{
+    return sizeof(index_hdr_t) + nslots * sizeof(index_slot_t) + heap_cap;
+}
+
+/**
+ * @brief Create and map an empty index file.
+ *
+ * @param path File to create (truncated if it exists).
+ * @param nslots Slot count (power of two).
+ * @param heap_cap Heap size in bytes.
+ * @param fd_out Receives the open descriptor.
+ * @param len_out Receives the mapping length.
+ *
+ * @return The mapping, or NULL on error.
+ */
+static uint8_t *create_map(const char *path, uint64_t nslots, uint64_t heap_cap,
+                           int *fd_out, size_t *len_out)
+{
+    size_t len = map_size(nslots, heap_cap);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        perror("open(index)");
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)len) < 0)
+    {
+        perror("ftruncate(index)");
+        close(fd);
+        return NULL;
+    }
+
+    uint8_t *map = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap(index)");
+        close(fd);
+        return NULL;
+    }
+
+    index_hdr_t *h = (index_hdr_t *)map;
+    memcpy(h->magic, INDEX_MAGIC, sizeof(h->magic));
+    h->layout   = INDEX_LAYOUT;
+    h->clean    = 0;
+    h->nslots   = nslots;
+    h->heap_cap = heap_cap;
+
+    *fd_out = fd;
+    *len_out = len;
+    return map;
+}
+
+/**
+ * @brief Find the slot for @p path, or the slot to insert it into.
+ *
+ * @return The matching slot, else the first reusable slot on the
+ *         probe sequence. *found says which.
+ */
+static index_slot_t *probe(const char *path, size_t len, uint64_t h, int *found)
+{
+    uint64_t mask = hdr()->nslots - 1;
+    index_slot_t *tab = slots();
+    index_slot_t *reuse = NULL;
+
+    for (uint64_t i = h & mask;; i = (i + 1) & mask)
+    {
+        index_slot_t *s = &tab[i];
+        if (s->hash == SLOT_EMPTY)
+        {
+            *found = 0;
+            return reuse ? reuse : s;
+        }
+        if (s->hash == SLOT_DEAD)
+        {
+            if (!reuse)
+                reuse = s;
+            continue;
+        }
+        if (s->hash == h && s->path_len == len &&
+            memcmp(heap() + s->path_off, path, len) == 0)
+        {
+            *found = 1;
+            return s;
+        }
+    }
+}
+
+/**
+ * @brief Insert or overwrite an entry. The table must have room.
+ */
+static void put_slot(const char *path, size_t len, const index_slot_t *val)
+{
+    uint64_t h = path_hash(path, len);
+    int found;
+    index_slot_t *s = probe(path, len, h, &found);
+
+    if (!found)
+    {
+        if (s->hash == SLOT_DEAD)
+            hdr()->dead--;
+        hdr()->live++;
+
+        s->path_off = hdr()->heap_used;
+        s->path_len = (uint32_t)len;
+        memcpy(heap() + s->path_off, path, len);
+        heap()[s->path_off + len] = '\0';
+        hdr()->heap_used += len + 1;
+        s->hash = h;
+    }
+
+    s->version  = val->version;
+    s->size     = val->size;
+    s->mtime_ns = val->mtime_ns;
+    s->checksum = val->checksum;
+    s->flags    = val->flags;
+}
+
+/**
+ * @brief Rebuild the table with room for @p need_live entries and
+ *        @p need_heap more path bytes, dropping tombstones and garbage.
+ *
+ * The new table is written to INDEX_FILE ".tmp" and renamed over the
+ * old one. Must be called with the write lock held.
+ *
+ * @return 0 on success, or -1 on error (the old table stays in use).
+ */
+static int grow(uint64_t need_live, uint64_t need_heap)
+{
+    uint64_t nslots = INDEX_MIN_SLOTS;
+    while (need_live * 10 > nslots * 7)
+        nslots *= 2;
+
+    uint64_t heap_need = hdr()->heap_used - hdr()->heap_garbage + need_heap;
+    uint64_t heap_cap = INDEX_MIN_HEAP;
+    while (heap_cap < heap_need * 2)
+        heap_cap *= 2;
+
+    char path[1100], tmp[1100];
+    snprintf(path, sizeof(path), "%s/%s", index_dir, INDEX_FILE);
+    snprintf(tmp, sizeof(tmp), "%s/%s.tmp", index_dir, INDEX_FILE);
+
+    int fd;
+    size_t len;
+    uint8_t *map = create_map(tmp, nslots, heap_cap, &fd, &len);
+    if (!map)
+        return -1;
+
+    uint8_t *old_map = index_map;
+    size_t old_len = index_map_len;
+    int old_fd = index_fd;
+    index_hdr_t *old_hdr = (index_hdr_t *)old_map;
+    index_slot_t *old_slots = (index_slot_t *)(old_map + sizeof(index_hdr_t));
+    const char *old_heap = (const char *)(old_slots + old_hdr->nslots);
+    uint64_t old_n = old_hdr->nslots;
+
+    index_map = map;
+    index_map_len = len;
+    index_fd = fd;
+
+    for (uint64_t i = 0; i < old_n; i++)
+    {
+        const index_slot_t *s = &old_slots[i];
+        if (s->hash >= 2)
+            put_slot(old_heap + s->path_off, s->path_len, s);
+    }
+
+    if (rename(tmp, path) < 0)
+    {
+        perror("rename(index)");
+        munmap(map, len);
+        close(fd);
+        unlink(tmp);
+        index_map = old_map;
+        index_map_len = old_len;
+        index_fd = old_fd;
+        return -1;
+    }
+
+    munmap(old_map, old_len);
+    close(old_fd);
+    return 0;
+}
+
+/**
+ * @brief Make room for an entry and every directory above it.
+ *
+ * Must be called with the write lock held; slot pointers taken before
+ * are invalid afterwards.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int reserve(const char *path, size_t len)
+{
+    uint64_t dirs = 1;
+    for (size_t i = 0; i < len; i++)
+        dirs += path[i] == '/';
+
+    uint64_t need_slots = 1 + dirs;
+    uint64_t need_heap = (len + 1) * (dirs + 1);
+    if ((hdr()->live + hdr()->dead + need_slots) * 10 > hdr()->nslots * 7 ||
+        hdr()->heap_used + need_heap > hdr()->heap_cap)
+        return grow(hdr()->live + need_slots, need_heap);
+    return 0;
+}
+
+/** @brief Tombstone an occupied slot. */
+static void kill_slot(index_slot_t *s)
+{
+    s->hash = SLOT_DEAD;
+    hdr()->live--;
+    hdr()->dead++;
+    hdr()->heap_garbage += s->path_len + 1;
+}
+
+/**
+ * @brief Contribution of a file record to its directory's digest.
+ *
+ * @return The leaf hash, or 0 while the checksum is not known.
+ */
+static uint64_t file_leaf(const char *path, size_t len, const index_slot_t *s)
+{
+    if (!(s->flags & INDEX_F_CHECKSUM))
+        return 0;
+    const char *slash = memrchr(path, '/', len);
+    const char *name = slash ? slash + 1 : path;
+    return rfs_tree_leaf(name, len - (size_t)(name - path), 0, s->checksum);
+}
+
+/**
+ * @brief Carry a change of one entry up through its ancestors' digests.
+ *
+ * Each parent's digest moves by the change in the child's leaf; that
+ * changes the parent's own leaf in its parent, and so on up to the
+ * root. A directory whose file count drops to zero is dropped. Must be
+ * called with the write lock held, after reserve() if a file was added.
+ *
+ * @param path Normalized path of the entry that changed.
+ * @param len Length of @p path.
+ * @param old_leaf Its contribution to its parent before the change.
+ * @param new_leaf Its contribution after the change.
+ * @param d_files Change in the number of files (-1, 0 or +1).
+ * @param d_unknown Change in the number of files without a checksum.
+ */
+static void update_dirs(const char *path, size_t len, uint64_t old_leaf,
+                        uint64_t new_leaf, int64_t d_files, int64_t d_unknown)
+{
+    size_t end = len;
+    while (end > 0 && (old_leaf != new_leaf || d_files != 0 || d_unknown != 0))
+    {
+        const char *slash = memrchr(path, '/', end);
+        size_t dir_len = slash ? (size_t)(slash - path) : 0;
+
+        int found;
+        uint64_t h = path_hash(path, dir_len);
+        index_slot_t *s = probe(path, dir_len, h, &found);
+        if (!found)
+        {
+            if (d_files <= 0)
+                return;     /* nothing recorded to update */
+            index_slot_t val;
+            memset(&val, 0, sizeof(val));
+            val.flags = INDEX_F_DIR;
+            put_slot(path, dir_len, &val);
+            s = probe(path, dir_len, h, &found);
+        }
+
+        uint64_t old_digest = s->checksum;
+        uint64_t old_files = s->size;
+        s->checksum += new_leaf - old_leaf;
+        s->size += (uint64_t)d_files;
+        s->version += (uint32_t)d_unknown;
+
+        const char *pslash = memrchr(path, '/', dir_len);
+        const char *name = pslash ? pslash + 1 : path;
+        size_t name_len = dir_len - (size_t)(name - path);
+        old_leaf = old_files ? rfs_tree_leaf(name, name_len, 1, old_digest) : 0;
+        new_leaf = s->size ? rfs_tree_leaf(name, name_len, 1, s->checksum) : 0;
+        if (s->size == 0)
+            kill_slot(s);
+        end = dir_len;
+    }
+}
+
+/*------------------------------------------------------------*/
+/*                          Rebuild                           */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Count the stored versions of a file by probing its .vN files.
+ */
+uint32_t index_count_versions(int dir, const char *name, const char *remote_path)
+{
+    /* the current version follows the saved .vN files, hot or cold */
+    uint32_t version = 1;
+    char vname[300];
+    char cold[RFS_MAX_PATH + 16];
+    struct stat vst;
+    while (snprintf(vname, sizeof(vname), "%s.v%u", name, version) <
+               (int)sizeof(vname) &&
+           (fstatat(dir, vname, &vst, 0) == 0 ||
+            (snprintf(cold, sizeof(cold), "%s.v%u", remote_path, version) <
+                 (int)sizeof(cold) &&
+             tier_stat(cold, &vst) == 0)))
+        version++;
+    return version;
+}
+
+/**
+ * @brief Copy a slot into an entry whose path lives in @p path.
+ */
+static void fill_entry(index_entry_t *e, const index_slot_t *s, const char *path)
+{
+    e->path     = path;
+    e->version  = s->version;
+    e->flags    = s->flags;
+    e->size     = s->size;
+    e->mtime_ns = s->mtime_ns;
+    e->checksum = s->checksum;
+}
+
+/*
+ * Recovery scan. A rebuild walks the tree with several threads sharing
+ * a stack of directories still to read; each thread reads one directory
+ * at a time, queues its subdirectories and inserts its files in batches.
+ * The server serves requests meanwhile (see index_get()).
+ */
+#define SCAN_THREADS_PER_CPU 4  /* stat() waits on the disk, not the CPU  */
+#define SCAN_MAX_THREADS     32
+#define SCAN_BATCH           256 /* files inserted per write-lock hold    */
+
+/* A file found by the scan, waiting to be inserted. */
+typedef struct
+{
+    char name[256];
+    ino_t ino;
+    index_slot_t val;
+} scan_file_t;
+
+static pthread_mutex_t scan_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_cond = PTHREAD_COND_INITIALIZER;
+static char **scan_dirs = NULL;         /* directories not read yet (LIFO) */
+static size_t scan_ndirs = 0;
+static size_t scan_cap = 0;
+static size_t scan_busy = 0;            /* threads reading a directory     */
+static int scan_running = 0;            /* scan in progress                */
+static int scan_stop = 0;               /* index_close() ends the scan     */
+static int scan_failed = 0;             /* a directory could not be queued */
+static int scan_nthreads = 0;
+static int scan_live = 0;               /* threads not yet exited          */
+static pthread_t scan_threads[SCAN_MAX_THREADS];
+static int scan_root = -1;              /* open descriptor of index_dir    */
+static time_t scan_started;             /* older temp files are orphans    */
+static double scan_t0;
+static uint64_t scan_files = 0;
+static uint64_t scan_nread = 0;         /* directories read                */
+static uint64_t scan_orphans = 0;
+
+/** @brief Monotonic clock in seconds. */
+static double scan_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Report whether a directory entry can hold indexed files.
+ *
+ * @param name Entry name.
+ * @param at_root Whether the entry is directly under the server root.
+ *
+ * @return 0 for ".", "..", saved versions, upload temp files, and (at
+ *         the root) the snapshot area and the index, else 1.
+ */
+static int scan_wanted(const char *name, int at_root)
+{
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return 0;
+    if (at_root && (strcmp(name, SNAPSHOT_DIR) == 0 ||
+                    strncmp(name, INDEX_FILE, strlen(INDEX_FILE)) == 0))
+        return 0;
+    return strstr(name, RFS_TMP_MARKER) == NULL && !index_is_version_name(name);
+}
+
+/**
+ * @brief Queue a directory for the scan threads.
+ *
+ * @return 0 on success, or -1 if memory could not be allocated.
+ */
+static int scan_push(const char *rel)
+{
+    char *copy = strdup(rel);
+    pthread_mutex_lock(&scan_lock);
+    if (copy && scan_ndirs == scan_cap)
+    {
+        size_t ncap = scan_cap ? scan_cap * 2 : 64;
+        char **d = (char **)realloc(scan_dirs, ncap * sizeof(*d));
+        if (d)
+        {
+            scan_dirs = d;
+            scan_cap = ncap;
+        }
+        else
+        {
+            free(copy);
+            copy = NULL;
+        }
+    }
+    if (copy)
+    {
+        scan_dirs[scan_ndirs++] = copy;
+        pthread_cond_signal(&scan_cond);
+    }
+    else
+        scan_failed = 1;
+    pthread_mutex_unlock(&scan_lock);
+    return copy ? 0 : -1;
+}
+
+/**
+ * @brief Insert a batch of files found in one directory.
+ *
+ * A file is only added if the index does not have it yet: a commit or
+ * an on-demand lookup that got there first knows better. It is also
+ * stat'ed again under the lock and skipped if it was removed or
+ * replaced since it was read; a replacing commit indexes it itself.
+ *
+ * @param dir Open directory holding the files.
+ * @param rel Remote path of @p dir.
+ * @param batch Files to insert.
+ * @param n Number of files in @p batch.
+ */
+static void scan_flush(int dir, const char *rel, const scan_file_t *batch, size_t n)
+{
+    uint64_t added = 0;
+    pthread_rwlock_wrlock(&index_lock);
+    for (size_t i = 0; i < n && index_map; i++)
+    {
+        char child[RFS_MAX_PATH];
+        if (snprintf(child, sizeof(child), "%s%s%s", rel, rel[0] ? "/" : "",
+                     batch[i].name) >= (int)sizeof(child))
+            continue;
+        size_t len = strlen(child);
+        if (reserve(child, len) < 0)
+        {
+            pthread_mutex_lock(&scan_lock);
+            scan_failed = 1;
+            pthread_mutex_unlock(&scan_lock);
+            break;
+        }
+
+        int found;
+        struct stat st;
+        probe(child, len, path_hash(child, len), &found);
+        if (found || fstatat(dir, batch[i].name, &st, AT_SYMLINK_NOFOLLOW) < 0 ||
+            st.st_ino != batch[i].ino)
+            continue;
+
+        put_slot(child, len, &batch[i].val);
+        update_dirs(child, len, 0, 0, 1, 1);
+        added++;
+    }
+    pthread_rwlock_unlock(&index_lock);
+
+    pthread_mutex_lock(&scan_lock);
+    scan_files += added;
+    pthread_mutex_unlock(&scan_lock);
+}
+
+/**
+ * @brief Read one directory: queue its subdirectories, index its
+ *        files, and delete upload temp files left by a previous run.
+ *
+ * A temp file is an orphan if it was last written before the scan
+ * began; uploads in progress since then keep theirs.
+ *
+ * @param rel Remote path of the directory ("" for the root).
+ * @param batch Buffer of SCAN_BATCH files.
+ */
+static void scan_read_dir(const char *rel, scan_file_t *batch)
+{
+    int fd = openat(scan_root, rel[0] ? rel : ".", O_RDONLY | O_DIRECTORY);
+    DIR *d = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!d)
+    {
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+
+    size_t n = 0;
+    uint64_t orphans = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL)
+    {
+        const char *name = de->d_name;
+        struct stat st;
+        if (strstr(name, RFS_TMP_MARKER) != NULL)
+        {
+            if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+                S_ISREG(st.st_mode) && st.st_mtime < scan_started &&
+                unlinkat(dirfd(d), name, 0) == 0)
+                orphans++;
+            continue;
+        }
+        if (!scan_wanted(name, rel[0] == '\0'))
+            continue;
+
+        char child[RFS_MAX_PATH];
+        if (snprintf(child, sizeof(child), "%s%s%s", rel, rel[0] ? "/" : "",
+                     name) >= (int)sizeof(child))
+            continue;
+
+        if (de->d_type == DT_DIR)
+        {
+            scan_push(child);
+            continue;
+        }
+        if ((de->d_type != DT_REG && de->d_type != DT_UNKNOWN) ||
+            fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+        {
+            scan_push(child);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode) || strlen(name) >= sizeof(batch[n].name))
+            continue;
+
+        scan_file_t *f = &batch[n++];
+        memcpy(f->name, name, strlen(name) + 1);
+        f->ino = st.st_ino;
+        memset(&f->val, 0, sizeof(f->val));
+        f->val.version  = index_count_versions(dirfd(d), name, child);
+        f->val.size     = (uint64_t)st.st_size;
+        f->val.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL +
+                          st.st_mtim.tv_nsec;
+        if (n == SCAN_BATCH)
+        {
+            scan_flush(dirfd(d), rel, batch, n);
+            n = 0;
+        }
+    }
+    if (n > 0)
+        scan_flush(dirfd(d), rel, batch, n);
+    closedir(d);
+
+    pthread_mutex_lock(&scan_lock);
+    scan_nread++;
+    scan_orphans += orphans;
+    pthread_mutex_unlock(&scan_lock);
+}
+
+/**
+ * @brief Scan thread: read queued directories until none are left and
+ *        no other thread can queue more.
+ *
+ * The last thread to finish reports the result and wakes everyone
+ * waiting in scan_wait().
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *scan_main(void *arg)
+{
+    (void)arg;
+    scan_file_t *batch = (scan_file_t *)malloc(SCAN_BATCH * sizeof(*batch));
+
+    pthread_mutex_lock(&scan_lock);
+    while (batch && !scan_stop)
+    {
+        if (scan_ndirs > 0)
+        {
+            char *rel = scan_dirs[--scan_ndirs];
+            scan_busy++;
+            pthread_mutex_unlock(&scan_lock);
+
+            scan_read_dir(rel, batch);
+            free(rel);
+
+            pthread_mutex_lock(&scan_lock);
+            scan_busy--;
+            if (scan_ndirs == 0 && scan_busy == 0)
+                pthread_cond_broadcast(&scan_cond);
+            continue;
+        }
+        if (scan_busy == 0)
+            break;
+        pthread_cond_wait(&scan_cond, &scan_lock);
+    }
+    if (!batch)
+        scan_failed = 1;
+
+    if (--scan_live == 0)
+    {
+        if (!scan_stop)
+            printf("Index rebuilt from disk: %llu files in %llu directories, "
+                   "%llu orphaned temp files removed, %.2f s (%d threads)%s\n",
+                   (unsigned long long)scan_files, (unsigned long long)scan_nread,
+                   (unsigned long long)scan_orphans, scan_now() - scan_t0,
+                   scan_nthreads, scan_failed ? " [incomplete]" : "");
+        for (size_t i = 0; i < scan_ndirs; i++)
+            free(scan_dirs[i]);
+        free(scan_dirs);
+        scan_dirs = NULL;
+        scan_ndirs = scan_cap = 0;
+        scan_running = 0;
+        pthread_cond_broadcast(&scan_cond);
+    }
+    pthread_mutex_unlock(&scan_lock);
+    free(batch);
+    return NULL;
+}
+
+/**
+ * @brief Wait until a running recovery scan has finished.
+ *
+ * Whole-tree queries (LIST, directory digests) call this; lookups of
+ * single files do not need to.
+ */
+static void scan_wait(void)
+{
+    pthread_mutex_lock(&scan_lock);
+    while (scan_running)
+        pthread_cond_wait(&scan_cond, &scan_lock);
+    pthread_mutex_unlock(&scan_lock);
+}
+
+/** @brief Whether a recovery scan is in progress. */
+static int scan_active(void)
+{
+    pthread_mutex_lock(&scan_lock);
+    int running = scan_running;
+    pthread_mutex_unlock(&scan_lock);
+    return running;
+}
+
+/**
+ * @brief Index one file ahead of the recovery scan.
+ *
+ * Called on an index miss while the scan runs, so a file that exists
+ * is found whether or not the scan has reached it.
+ *
+ * @param path Normalized remote path.
+ * @param len Length of @p path.
+ * @param out Receives the entry (its path is @p path).
+ *
+ * @return 1 if the file exists and is now indexed, else 0.
+ */
+static int scan_lookup(const char *path, size_t len, index_entry_t *out)
+{
+    if (len == 0 || path[len - 1] == '/')
+        return 0;
+
+    /* the scan skips these at any depth */
+    char comp[RFS_MAX_PATH];
+    const char *p = path;
+    while (*p)
+    {
+        const char *slash = strchr(p, '/');
+        size_t n = slash ? (size_t)(slash - p) : strlen(p);
+        memcpy(comp, p, n);
+        comp[n] = '\0';
+        if (!scan_wanted(comp, p == path))
+            return 0;
+        p += n + (slash ? 1 : 0);
+    }
+
+    struct stat st;
+    if (fstatat(scan_root, path, &st, AT_SYMLINK_NOFOLLOW) < 0 || !S_ISREG(st.st_mode))
+        return 0;
+
+    index_slot_t val;
+    memset(&val, 0, sizeof(val));
+    val.version  = index_count_versions(scan_root, path, path);
+    val.size     = (uint64_t)st.st_size;
+    val.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+    int rc = 0;
+    pthread_rwlock_wrlock(&index_lock);
+    if (index_map && reserve(path, len) == 0)
+    {
+        int found;
+        index_slot_t *s = probe(path, len, path_hash(path, len), &found);
+        if (!found)
+        {
+            put_slot(path, len, &val);
+            update_dirs(path, len, 0, 0, 1, 1);
+            s = probe(path, len, path_hash(path, len), &found);
+        }
+        rc = !(s->flags & INDEX_F_DIR);
+        if (rc)
+            fill_entry(out, s, path);
+    }
+    pthread_rwlock_unlock(&index_lock);
+    return rc;
+}
+
+/**
+ * @brief Start building a fresh index in the background.
+ *
+ * Creates an empty index and starts the scan threads; they fill it in
+ * while the server runs. Must be called with the write lock held.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int rebuild(void)
+{
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/%s", index_dir, INDEX_FILE);
+
+    index_map = create_map(path, INDEX_MIN_SLOTS, INDEX_MIN_HEAP,
+                           &index_fd, &index_map_len);
+    if (!index_map)
+        return -1;
+
+    scan_root = open(index_dir, O_RDONLY | O_DIRECTORY);
+    if (scan_root < 0 || scan_push("") < 0)
+        return -1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int want = (int)(cpus > 0 ? cpus : 1) * SCAN_THREADS_PER_CPU;
+    if (want > SCAN_MAX_THREADS)
+        want = SCAN_MAX_THREADS;
+
+    scan_started = time(NULL);
+    scan_t0 = scan_now();
+    pthread_mutex_lock(&scan_lock);
+    scan_running = 1;
+    for (int i = 0; i < want; i++)
+    {
+        if (pthread_create(&scan_threads[scan_nthreads], NULL, scan_main, NULL) != 0)
+            break;
+        scan_nthreads++;
+        scan_live++;
+    }
+    if (scan_nthreads == 0)
+        scan_running = 0;
+    pthread_mutex_unlock(&scan_lock);
+
+    if (scan_nthreads == 0)
+    {
+        perror("pthread_create(index scan)");
+        return -1;
+    }
+    printf("Index rebuild started (%d threads); serving requests meanwhile\n",
+           scan_nthreads);
+    return 0;
+}
+
+/**
+ * @brief Map an existing index if it is intact and was closed cleanly.
+ *
+ * @return 0 on success, or -1 if it must be rebuilt.
+ */
+static int map_existing(void)
+{
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/%s", index_dir, INDEX_FILE);
+
+    int fd = open(path, O_RDWR);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    index_hdr_t h;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(h) ||
+        pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+        memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) != 0 ||
+        h.layout != INDEX_LAYOUT || !h.clean ||
+        h.nslots == 0 || (h.nslots & (h.nslots - 1)) != 0 ||
+        (uint64_t)st.st_size != map_size(h.nslots, h.heap_cap) ||
+        h.heap_used > h.heap_cap)
+    {
+        close(fd);
+        return -1;
+    }
+
+    uint8_t *map = (uint8_t *)mmap(NULL, (size_t)st.st_size,
+                                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+
+    index_fd = fd;
+    index_map = map;
+    index_map_len = (size_t)st.st_size;
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+/*                        Public API                          */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Open (or rebuild) the index under @p root.
+ */
+int index_open(const char *root)
+{
+    snprintf(index_dir, sizeof(index_dir), "%s", root);
+
+    pthread_rwlock_wrlock(&index_lock);
+    int rc = 0;
+    if (map_existing() == 0)
+    {
+        /* the root directory record counts every file */
+        int found;
+        index_slot_t *root_dir = probe("", 0, path_hash("", 0), &found);
+        printf("Index opened: %llu files\n",
+               (unsigned long long)(found ? root_dir->size : 0));
+    }
+    else
+        rc = rebuild();
+
+    if (rc == 0)
+    {
+        /* from here on a crash leaves the index marked unclean */
+        hdr()->clean = 0;
+        msync(index_map, sizeof(index_hdr_t), MS_SYNC);
+    }
+    else
+    {
+        if (index_map)
+        {
+            munmap(index_map, index_map_len);
+            close(index_fd);
+            index_map = NULL;
+            index_fd = -1;
+        }
+        if (scan_root >= 0)
+        {
+            close(scan_root);
+            scan_root = -1;
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+    return rc;
+}
+
+/**
+ * @brief Flush the index and mark it clean.
+ */
+void index_close(void)
+{
+    /* an unfinished scan leaves the index unclean, to be rebuilt */
+    pthread_mutex_lock(&scan_lock);
+    int complete = !scan_running && !scan_failed;
+    scan_stop = 1;
+    pthread_cond_broadcast(&scan_cond);
+    pthread_mutex_unlock(&scan_lock);
+    for (int i = 0; i < scan_nthreads; i++)
+        pthread_join(scan_threads[i], NULL);
+    scan_nthreads = 0;
+    if (scan_root >= 0)
+    {
+        close(scan_root);
+        scan_root = -1;
+    }
+
+    pthread_rwlock_wrlock(&index_lock);
+    if (index_map)
+    {
+        msync(index_map, index_map_len, MS_SYNC);
+        hdr()->clean = complete;
+        msync(index_map, sizeof(index_hdr_t), MS_SYNC);
+        munmap(index_map, index_map_len);
+        close(index_fd);
+        index_map = NULL;
+        index_fd = -1;
+    }
+    pthread_rwlock_unlock(&index_lock);
+}
+
+/**
+ * @brief Record a newly committed version of a file.
+ */
+int index_put(const char *remote_path, uint32_t version, uint64_t size,
+              int64_t mtime_ns, const uint64_t *checksum)
+{
+    char norm[RFS_MAX_PATH];
+    if (normalize(remote_path, norm, sizeof(norm)) < 0 || norm[0] == '\0')
+        return -1;
+    size_t len = strlen(norm);
+
+    index_slot_t val;
+    memset(&val, 0, sizeof(val));
+    val.version  = version;
+    val.size     = size;
+    val.mtime_ns = mtime_ns;
+    if (checksum)
+    {
+        val.checksum = *checksum;
+        val.flags    = INDEX_F_CHECKSUM;
+    }
+
+    pthread_rwlock_wrlock(&index_lock);
+    int rc = -1;
+    if (index_map && reserve(norm, len) == 0)
+    {
+        int found;
+        index_slot_t *s = probe(norm, len, path_hash(norm, len), &found);
+        if (!found || !(s->flags & INDEX_F_DIR))
+        {
+            uint64_t old_leaf = found ? file_leaf(norm, len, s) : 0;
+            int64_t d_unknown = !checksum;
+            if (found)
+                d_unknown -= !(s->flags & INDEX_F_CHECKSUM);
+
+            put_slot(norm, len, &val);
+            update_dirs(norm, len, old_leaf, file_leaf(norm, len, &val),
+                        found ? 0 : 1, d_unknown);
+            rc = 0;
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+    return rc;
+}
+
+/**
+ * @brief Forget a removed file.
+ */
+void index_remove(const char *remote_path)
+{
+    char norm[RFS_MAX_PATH];
+    if (normalize(remote_path, norm, sizeof(norm)) < 0)
+        return;
+    size_t len = strlen(norm);
+
+    pthread_rwlock_wrlock(&index_lock);
+    if (index_map)
+    {
+        int found;
+        index_slot_t *s = probe(norm, len, path_hash(norm, len), &found);
+        if (found && !(s->flags & INDEX_F_DIR))
+        {
+            uint64_t old_leaf = file_leaf(norm, len, s);
+            int64_t d_unknown = (s->flags & INDEX_F_CHECKSUM) ? 0 : -1;
+            kill_slot(s);
+            update_dirs(norm, len, old_leaf, 0, -1, d_unknown);
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+}
+
+/**
+ * @brief Look up one file.
+ */
+int index_get(const char *remote_path, index_entry_t *out,
+              char *path_buf, size_t path_size)
+{
+    if (normalize(remote_path, path_buf, path_size) < 0)
+        return 0;
+    size_t len = strlen(path_buf);
+
+    pthread_rwlock_rdlock(&index_lock);
+    int rc = -1;
+    if (index_map)
+    {
+        int found;
+        index_slot_t *s = probe(path_buf, len, path_hash(path_buf, len), &found);
+        found = found && !(s->flags & INDEX_F_DIR);
+        if (found)
+            fill_entry(out, s, path_buf);
+        rc = found;
+    }
+    pthread_rwlock_unlock(&index_lock);
+
+    if (rc == 0 && scan_active())
+        rc = scan_lookup(path_buf, len, out);
+    return rc;
+}
+
+/**
+ * @brief Store a checksum computed after the fact.
+ */
+void index_set_checksum(const char *remote_path, uint32_t version,
+                        uint64_t size, uint64_t checksum)
+{
+    char norm[RFS_MAX_PATH];
+    if (normalize(remote_path, norm, sizeof(norm)) < 0)
+        return;
+    size_t len = strlen(norm);
+
+    pthread_rwlock_wrlock(&index_lock);
+    if (index_map)
+    {
+        int found;
+        index_slot_t *s = probe(norm, len, path_hash(norm, len), &found);
+        if (found && s->version == version && s->size == size &&
+            !(s->flags & INDEX_F_DIR))
+        {
+            uint64_t old_leaf = file_leaf(norm, len, s);
+            int64_t d_unknown = (s->flags & INDEX_F_CHECKSUM) ? 0 : -1;
+            s->checksum = checksum;
+            s->flags |= INDEX_F_CHECKSUM;
+            update_dirs(norm, len, old_leaf, file_leaf(norm, len, s), 0, d_unknown);
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+}
+
+/**
+ * @brief Look up the Merkle digest of a directory.
+ */
+int index_get_dir(const char *remote_path, uint64_t *digest, uint64_t *files,
+                  uint64_t *unknown)
+{
+    char norm[RFS_MAX_PATH];
+    if (normalize(remote_path, norm, sizeof(norm)) < 0)
+        return 0;
+    size_t len = strlen(norm);
+    if (len > 0 && norm[len - 1] == '/')
+        norm[--len] = '\0';
+
+    scan_wait();
+    pthread_rwlock_rdlock(&index_lock);
+    int rc = -1;
+    if (index_map)
+    {
+        int found;
+        index_slot_t *s = probe(norm, len, path_hash(norm, len), &found);
+        rc = found && (s->flags & INDEX_F_DIR);
+        if (rc)
+        {
+            *digest = s->checksum;
+            *files = s->size;
+            *unknown = s->version;
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+    return rc;
+}
+
+static int cmp_entry(const void *a, const void *b)
+{
+    return strcmp(((const index_entry_t *)a)->path,
+                  ((const index_entry_t *)b)->path);
+}
+
+/**
+ * @brief List every indexed file whose path starts with @p prefix.
+ *
+ * One pass over the slot array in memory; the matches are copied out
+ * under the read lock and sorted after it is released.
+ */
+int index_list(const char *prefix, index_list_t *out)
+{
+    char norm[RFS_MAX_PATH];
+    memset(out, 0, sizeof(*out));
+    if (normalize(prefix, norm, sizeof(norm)) < 0)
+        return -1;
+    size_t plen = strlen(norm);
+
+    scan_wait();
+    pthread_rwlock_rdlock(&index_lock);
+    if (!index_map)
+    {
+        pthread_rwlock_unlock(&index_lock);
+        return -1;
+    }
+
+    const index_slot_t *tab = slots();
+    const char *h = heap();
+    uint64_t n = hdr()->nslots;
+
+    size_t count = 0, bytes = 0;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        if (tab[i].hash >= 2 && !(tab[i].flags & INDEX_F_DIR) &&
+            tab[i].path_len >= plen &&
+            memcmp(h + tab[i].path_off, norm, plen) == 0)
+        {
+            count++;
+            bytes += tab[i].path_len + 1;
+        }
+    }
+
+    out->entries = (index_entry_t *)malloc((count ? count : 1) * sizeof(index_entry_t));
+    out->paths = (char *)malloc(bytes ? bytes : 1);
+    if (!out->entries || !out->paths)
+    {
+        pthread_rwlock_unlock(&index_lock);
+        index_list_free(out);
+        return -1;
+    }
+
+    char *p = out->paths;
+    for (uint64_t i = 0; i < n && out->count < count; i++)
+    {
+        const index_slot_t *s = &tab[i];
+        if (s->hash >= 2 && !(s->flags & INDEX_F_DIR) && s->path_len >= plen &&
+            memcmp(h + s->path_off, norm, plen) == 0)
+        {
+            memcpy(p, h + s->path_off, s->path_len + 1);
+            fill_entry(&out->entries[out->count++], s, p);
+            p += s->path_len + 1;
+        }
+    }
+    pthread_rwlock_unlock(&index_lock);
+
+    qsort(out->entries, out->count, sizeof(index_entry_t), cmp_entry);
+    return 0;
+}
+
+/**
+ * @brief Free a result of index_list().
+ */
+void index_list_free(index_list_t *list)
+{
+    free(list->entries);
+    free(list->paths);
+    list->entries = NULL;
+    list->paths = NULL;
+    list->count = 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * index.h -- persistent, memory-mapped metadata index
+ *
+ * SERVER_ROOT/.index records, for the current version of every stored
+ * file, its remote path, version number, size, modification time and
+ * (once known) FNV-1a-64 checksum. WRITE and RM update it as they
+ * commit, so LIST and STAT are answered from memory without touching
+ * the tree.
+ *
+ * File layout (host byte order; the index is local to the server):
+ *
+ *   header   64 bytes, see index_hdr_t in index.c
+ *   slots    nslots x 56-byte records, open addressing on the path hash
+ *   heap     path bytes (NUL-terminated), appended as entries are added
+ *
+ * The header carries a "clean" flag that is cleared while the server
+ * runs and set again by index_close(). Reopening a clean index is a
+ * single mmap; a missing, corrupt or unclean index (the server was
+ * killed) is rebuilt by walking the tree. Checksums are not known after
+ * a rebuild and are filled in on first STAT.
+ *
+ * The rebuild runs on several threads while the server serves requests,
+ * and deletes upload temp files left by the killed run. Until it ends,
+ * index_get() looks up files it has not reached on disk, and
+ * index_list() and index_get_dir() wait for it.
+ *
+ * Each directory holding files also has a record with its Merkle
+ * digest: the sum of rfs_tree_leaf() over its files and non-empty
+ * subdirectories (protocol.h). A commit, removal or newly computed
+ * checksum updates the digests of the file's ancestors in place, one
+ * record per level. Files whose checksum is not known yet are counted
+ * instead of hashed in; a directory's digest is complete once that
+ * count is zero.
+ *
+ * Paths are normalized ("./a//b" and "/a/b" are both "a/b"). Version
+ * files (.vN), upload temp files, the snapshot area and the index
+ * itself are never indexed.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INDEX_FILE ".index"     /* relative to SERVER_ROOT */
+
+#define INDEX_F_CHECKSUM 0x1    /* checksum field is valid */
+#define INDEX_F_DIR      0x2    /* directory record (internal; see index_get_dir()) */
+
+/* One indexed file, as returned by index_get() and index_list(). */
+typedef struct
+{
+    const char *path;       /* normalized remote path */
+    uint32_t version;       /* current version number (1 = first WRITE) */
+    uint32_t flags;         /* INDEX_F_* bits */
+    uint64_t size;
+    int64_t  mtime_ns;      /* modification time, ns since the epoch */
+    uint64_t checksum;      /* FNV-1a-64 of the contents if INDEX_F_CHECKSUM */
+} index_entry_t;
+
+/* Result of index_list(): entries sorted by path. */
+typedef struct
+{
+    index_entry_t *entries;
+    size_t count;
+    char *paths;            /* storage behind entries[i].path */
+} index_list_t;
+
+/**
+ * @brief Open (or rebuild) the index under @p root.
+ *
+ * @param root Server root directory.
+ *
+ * @return 0 on success, or -1 on error (the server then runs without
+ *         an index and LIST / STAT report an I/O error).
+ */
+int index_open(const char *root);
+
+/**
+ * @brief Flush the index and mark it clean for a fast reopen.
+ */
+void index_close(void);
+
+/**
+ * @brief Report whether a remote path names the index file itself.
+ *
+ * @param remote_path Client-supplied remote path.
+ *
+ * @return 1 if clients must not WRITE or RM @p remote_path, else 0.
+ */
+int index_reserved(const char *remote_path);
+
+/**
+ * @brief Report whether a file name is a saved version ("name.vN").
+ *
+ * @param name Single path component.
+ *
+ * @return 1 if @p name ends in ".v<digits>", else 0.
+ */
+int index_is_version_name(const char *name);
+
+/**
+ * @brief Count the stored versions of a file by probing its .vN files.
+ *
+ * Used when a file is not in the index (a rebuild, or a snapshot).
+ * Versions moved to the cold tier count too.
+ *
+ * @param dir Open descriptor of the directory holding the file.
+ * @param name File name within @p dir.
+ * @param remote_path Remote path of the file, for the cold tier lookup.
+ *
+ * @return The current version number (1 if no .vN files exist).
+ */
+uint32_t index_count_versions(int dir, const char *name, const char *remote_path);
+
+/**
+ * @brief Record a newly committed version of a file.
+ *
+ * Callers hold the server's commit lock, so updates are ordered.
+ *
+ * @param remote_path Remote path as sent by the client.
+ * @param version Version number now current.
+ * @param size File size in bytes.
+ * @param mtime_ns Modification time in ns since the epoch.
+ * @param checksum FNV-1a-64 of the contents, or NULL if not known.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int index_put(const char *remote_path, uint32_t version, uint64_t size,
+              int64_t mtime_ns, const uint64_t *checksum);
+
+/**
+ * @brief Forget a removed file.
+ *
+ * @param remote_path Remote path as sent by the client.
+ */
+void index_remove(const char *remote_path);
+
+/**
+ * @brief Look up one file.
+ *
+ * @param remote_path Remote path as sent by the client.
+ * @param out Receives the entry; @c out->path points into @p path_buf.
+ * @param path_buf Buffer for the normalized path.
+ * @param path_size Size of @p path_buf (RFS_MAX_PATH is enough).
+ *
+ * @return 1 if found, 0 if not, or -1 if the index is unavailable.
+ */
+int index_get(const char *remote_path, index_entry_t *out,
+              char *path_buf, size_t path_size);
+
+/**
+ * @brief Store a checksum computed after the fact.
+ *
+ * Ignored if the file has moved on to another version, or grown by an
+ * APPEND, meanwhile.
+ *
+ * @param remote_path Remote path.
+ * @param version Version the checksum was computed for.
+ * @param size Size the checksum was computed over.
+ * @param checksum FNV-1a-64 of that version's contents.
+ */
+void index_set_checksum(const char *remote_path, uint32_t version,
+                        uint64_t size, uint64_t checksum);
+
+/**
+ * @brief Look up the Merkle digest of a directory.
+ *
+ * @param remote_path Directory ("" for the root).
+ * @param digest Receives the digest of the files whose checksum is known.
+ * @param files Receives the number of files below the directory.
+ * @param unknown Receives how many of those have no checksum yet; the
+ *                digest is complete only when this is 0.
+ *
+ * @return 1 if found, 0 if the directory holds no files, or -1 if the
+ *         index is unavailable.
+ */
+int index_get_dir(const char *remote_path, uint64_t *digest, uint64_t *files,
+                  uint64_t *unknown);
+
+/**
+ * @brief List every indexed file whose path starts with @p prefix.
+ *
+ * @param prefix Path prefix ("" for everything); normalized like paths.
+ * @param out Receives the sorted entries (free with index_list_free()).
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int index_list(const char *prefix, index_list_t *out);
+
+/**
+ * @brief Free a result of index_list().
+ */
+void index_list_free(index_list_t *list);
+
+#endif /* INDEX_H */
@@ -0,0 +1,882 @@
+/*
+ * librfs.c -- embeddable RFS client library: connection pool and calls
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "librfs.h"
+#include "librfs_internal.h"
+#include "protocol.h"
+
+/* Pooled connections idle at least this long are probed before reuse. */
+#define PROBE_IDLE_MS 1000
+
+/*------------------------------------------------------------*/
+/*                      Socket helpers                        */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Send exactly @p len bytes over a socket.
+ *
+ * Never raises SIGPIPE: a closed peer is reported as an error, which
+ * matters in a library whose caller owns the signal handlers.
+ *
+ * @param sockfd Connected socket.
+ * @param buf Bytes to send.
+ * @param len Number of bytes.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int send_all(int sockfd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    size_t total = 0;
+    while (total < len)
+    {
+        ssize_t n = send(sockfd, p + total, len - total, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        total += (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receive exactly @p len bytes from a socket.
+ *
+ * @param sockfd Connected socket.
+ * @param buf Destination buffer.
+ * @param len Number of bytes.
+ *
+ * @return 0 on success, or -1 on error or connection close.
+ */
+int recv_all(int sockfd, void *buf, size_t len)
+{
+    char *p = (char *)buf;
+    size_t total = 0;
+    while (total < len)
+    {
+        ssize_t n = recv(sockfd, p + total, len - total, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        total += (size_t)n;
+    }
+    return 0;
+}
+
+/** @brief Write all of @p len bytes to a file descriptor. */
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Open a new v2 session to the client's server.
+ *
+ * @return A connected socket after a successful HELLO, or -1.
+ */
+static int connect_session(const rfs_client_t *cl)
+{
+    int sockfd;
+
+    if (cl->host[0] == '/')
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", cl->host);
+
+        sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sockfd < 0)
+            return -1;
+        if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(sockfd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)cl->port);
+        if (inet_pton(AF_INET, cl->host, &addr.sin_addr) != 1)
+            return -1;
+
+        sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sockfd < 0)
+            return -1;
+        if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(sockfd);
+            return -1;
+        }
+
+        /* requests are small writes followed by a read; don't batch them */
+        int one = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    if (rfs_client_hello(sockfd) < 0)
+    {
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+/** @brief CLOCK_MONOTONIC in milliseconds. */
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Check that a pooled connection is still usable.
+ *
+ * An idle session should have nothing to read. End-of-file means the
+ * server closed it (it restarted, say); stray bytes mean it is out of
+ * step. Either way it is discarded rather than failing the next call.
+ */
+static int conn_alive(int sockfd)
+{
+    char b;
+    ssize_t n = recv(sockfd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/*------------------------------------------------------------*/
+/*                     Connection pool                        */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Borrow a connection from the pool.
+ *
+ * The most recently returned idle connection is reused first. One that
+ * sat idle for PROBE_IDLE_MS or more is probed with conn_alive() before
+ * reuse; a busy pool skips that extra system call. If none is idle, a
+ * new one is opened while fewer than max_connections exist; otherwise
+ * the caller waits for one to be returned.
+ *
+ * @param cl Client handle.
+ * @param sockfd Receives the connection.
+ *
+ * @return RFS_E_OK or RFS_E_CONNECT.
+ */
+int librfs_acquire(rfs_client_t *cl, int *sockfd)
+{
+    pthread_mutex_lock(&cl->lock);
+    while (1)
+    {
+        if (cl->nidle > 0)
+        {
+            idle_conn_t *ic = &cl->idle[--cl->nidle];
+            int s = ic->sockfd;
+            if (now_ms() - ic->idle_since_ms < PROBE_IDLE_MS || conn_alive(s))
+            {
+                pthread_mutex_unlock(&cl->lock);
+                *sockfd = s;
+                return RFS_E_OK;
+            }
+            close(s);
+            cl->open--;
+            continue;
+        }
+
+        if (cl->open < cl->max_connections)
+        {
+            cl->open++;
+            pthread_mutex_unlock(&cl->lock);
+
+            int s = connect_session(cl);
+            if (s >= 0)
+            {
+                *sockfd = s;
+                return RFS_E_OK;
+            }
+
+            pthread_mutex_lock(&cl->lock);
+            cl->open--;
+            pthread_cond_signal(&cl->available);
+            pthread_mutex_unlock(&cl->lock);
+            return RFS_E_CONNECT;
+        }
+
+        pthread_cond_wait(&cl->available, &cl->lock);
+    }
+}
+
+/**
+ * @brief Return a borrowed connection.
+ *
+ * @param cl Client handle.
+ * @param sockfd Connection from librfs_acquire().
+ * @param reusable 0 if the connection failed or is out of step with the
+ *                 server; it is then closed instead of pooled.
+ */
+void librfs_release(rfs_client_t *cl, int sockfd, int reusable)
+{
+    pthread_mutex_lock(&cl->lock);
+    if (reusable)
+    {
+        cl->idle[cl->nidle].sockfd = sockfd;
+        cl->idle[cl->nidle].idle_since_ms = now_ms();
+        cl->nidle++;
+    }
+    else
+    {
+        close(sockfd);
+        cl->open--;
+    }
+    pthread_cond_signal(&cl->available);
+    pthread_mutex_unlock(&cl->lock);
+}
+
+/*------------------------------------------------------------*/
+/*                     Request helpers                        */
+/*------------------------------------------------------------*/
+
+/** @brief Map a v2 status to an RFS_E_* code. */
+int librfs_status_error(uint32_t status)
+{
+    if (status == RFS_OK)
+        return RFS_E_OK;
+    return status < 100 ? -(int)status : RFS_E_PROTOCOL;
+}
+
+/**
+ * @brief Send one request header and path.
+ *
+ * @return 0 on success, or -1 if the connection failed.
+ */
+static int send_header(int sockfd, const char *cmd, uint16_t flags,
+                       const char *path, uint64_t payload_len, uint64_t arg)
+{
+    rfs_req_t req;
+    memcpy(req.cmd, cmd, 5);
+    req.flags = flags;
+    req.payload_len = payload_len;
+    req.arg = arg;
+    return rfs_send_request(sockfd, &req, path);
+}
+
+/**
+ * @brief Receive a response payload (and its checksum, if flagged).
+ *
+ * The bytes go to @p dst if non-NULL, else to @p fd if it is not
+ * negative, else nowhere. A failed write to @p fd does not stop the
+ * transfer, so the connection stays in step.
+ *
+ * @param sockfd Connection.
+ * @param resp Response header.
+ * @param dst Destination buffer of at least resp->payload_len bytes.
+ * @param fd Destination descriptor.
+ *
+ * @return RFS_E_OK, RFS_E_CHECKSUM, RFS_E_LOCAL_IO (payload fully
+ *         received either way), or RFS_E_NETWORK.
+ */
+static int recv_payload(int sockfd, const rfs_resp_t *resp, uint8_t *dst, int fd)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    uint64_t sum = RFS_FNV64_INIT;
+    uint64_t left = resp->payload_len;
+    int want_sum = (resp->flags & RFS_F_DATA_SUM) != 0;
+    int rc = RFS_E_OK;
+
+    while (left > 0)
+    {
+        size_t chunk = left < sizeof(buf) ? (size_t)left : sizeof(buf);
+        uint8_t *p = dst ? dst : buf;
+        if (recv_all(sockfd, p, chunk) < 0)
+            return RFS_E_NETWORK;
+        if (want_sum)
+            sum = rfs_fnv64(sum, p, chunk);
+        if (!dst && fd >= 0 && rc == RFS_E_OK && write_all(fd, p, chunk) < 0)
+            rc = RFS_E_LOCAL_IO;
+        if (dst)
+            dst += chunk;
+        left -= chunk;
+    }
+
+    if (want_sum)
+    {
+        uint8_t trailer[8];
+        if (recv_all(sockfd, trailer, 8) < 0)
+            return RFS_E_NETWORK;
+        if (rc == RFS_E_OK && rfs_get_u64(trailer) != sum)
+            rc = RFS_E_CHECKSUM;
+    }
+    return rc;
+}
+
+/**
+ * @brief Send a request with no payload and read the response header.
+ *
+ * On a connection failure the connection is released as unusable and
+ * RFS_E_NETWORK returned; otherwise the caller still holds it.
+ */
+static int simple_request(rfs_client_t *cl, int sockfd, const char *cmd,
+                          const char *path, uint16_t flags, rfs_resp_t *resp)
+{
+    if (send_header(sockfd, cmd, flags, path, 0, 0) < 0 ||
+        rfs_recv_response(sockfd, resp) < 0)
+    {
+        librfs_release(cl, sockfd, 0);
+        return RFS_E_NETWORK;
+    }
+    return RFS_E_OK;
+}
+
+/*------------------------------------------------------------*/
+/*                        Handles                             */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Create a client handle.
+ */
+rfs_client_t *rfs_client_open(const rfs_options_t *opts)
+{
+    rfs_options_t defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    if (!opts)
+        opts = &defaults;
+    if (opts->max_connections < 0 || opts->port < 0 || opts->port > 65535)
+        return NULL;
+
+    rfs_client_t *cl = calloc(1, sizeof(*cl));
+    if (!cl)
+        return NULL;
+
+    cl->host = strdup(opts->host ? opts->host : LIBRFS_DEFAULT_HOST);
+    cl->port = opts->port ? opts->port : LIBRFS_DEFAULT_PORT;
+    cl->max_connections = opts->max_connections ? opts->max_connections
+                                                : LIBRFS_DEFAULT_POOL;
+    cl->checksums = !opts->no_checksums;
+    cl->idle = calloc((size_t)cl->max_connections, sizeof(idle_conn_t));
+    if (!cl->host || !cl->idle)
+    {
+        free(cl->host);
+        free(cl->idle);
+        free(cl);
+        return NULL;
+    }
+
+    pthread_mutex_init(&cl->lock, NULL);
+    pthread_cond_init(&cl->available, NULL);
+    return cl;
+}
+
+/**
+ * @brief Close every pooled connection and free the handle.
+ */
+void rfs_client_close(rfs_client_t *client)
+{
+    if (!client)
+        return;
+    for (int i = 0; i < client->nidle; i++)
+        close(client->idle[i].sockfd);
+    pthread_mutex_destroy(&client->lock);
+    pthread_cond_destroy(&client->available);
+    free(client->idle);
+    free(client->host);
+    free(client);
+}
+
+/*------------------------------------------------------------*/
+/*                        Operations                          */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Common body of rfs_write() and rfs_write_fd().
+ *
+ * Exactly one of @p buf and @p fd >= 0 supplies the data.
+ */
+static int write_common(rfs_client_t *cl, const char *remote_path,
+                        const void *buf, int fd, uint64_t len)
+{
+    int sockfd;
+    int rc = librfs_acquire(cl, &sockfd);
+    if (rc != RFS_E_OK)
+        return rc;
+
+    uint16_t flags = cl->checksums ? RFS_F_DATA_SUM : 0;
+    if (send_header(sockfd, "WRITE", flags, remote_path, len, 0) < 0)
+    {
+        librfs_release(cl, sockfd, 0);
+        return RFS_E_NETWORK;
+    }
+
+    uint64_t sum = RFS_FNV64_INIT;
+    if (buf)
+    {
+        if (cl->checksums)
+            sum = rfs_fnv64(sum, buf, (size_t)len);
+        if (send_all(sockfd, buf, (size_t)len) < 0)
+        {
+            librfs_release(cl, sockfd, 0);
+            return RFS_E_NETWORK;
+        }
+    }
+    else
+    {
+        uint8_t chunk[RFS_IO_CHUNK];
+        uint64_t done = 0;
+        while (done < len)
+        {
+            size_t want = len - done < sizeof(chunk) ? (size_t)(len - done)
+                                                     : sizeof(chunk);
+            ssize_t n = pread(fd, chunk, want, (off_t)done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                /* the header promised len bytes; the session is lost */
+                librfs_release(cl, sockfd, 0);
+                return RFS_E_LOCAL_IO;
+            }
+            if (cl->checksums)
+                sum = rfs_fnv64(sum, chunk, (size_t)n);
+            if (send_all(sockfd, chunk, (size_t)n) < 0)
+            {
+                librfs_release(cl, sockfd, 0);
+                return RFS_E_NETWORK;
+            }
+            done += (uint64_t)n;
+        }
+    }
+
+    if (cl->checksums)
+    {
+        uint8_t trailer[8];
+        rfs_put_u64(trailer, sum);
+        if (send_all(sockfd, trailer, 8) < 0)
+        {
+            librfs_release(cl, sockfd, 0);
+            return RFS_E_NETWORK;
+        }
+    }
+
+    rfs_resp_t resp;
+    if (rfs_recv_response(sockfd, &resp) < 0 ||
+        recv_payload(sockfd, &resp, NULL, -1) == RFS_E_NETWORK)
+    {
+        librfs_release(cl, sockfd, 0);
+        return RFS_E_NETWORK;
+    }
+    librfs_release(cl, sockfd, 1);
+    return librfs_status_error(resp.status);
+}
+
+/**
+ * @brief Store a buffer as the newest version of a remote file.
+ */
+int rfs_write(rfs_client_t *client, const char *remote_path,
+              const void *buf, size_t len)
+{
+    if (!client || !remote_path || (!buf && len > 0))
+        return RFS_E_INVALID;
+    return write_common(client, remote_path, buf ? buf : "", -1, len);
+}
+
+/**
+ * @brief Store the contents of an open file as the newest version.
+ */
+int rfs_write_fd(rfs_client_t *client, const char *remote_path, int fd)
+{
+    struct stat st;
+    if (!client || !remote_path)
+        return RFS_E_INVALID;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+        return RFS_E_LOCAL_IO;
+    return write_common(client, remote_path, NULL, fd, (uint64_t)st.st_size);
+}
+
+/**
+ * @brief Common body of the rfs_read*() calls.
+ *
+ * Sends GET, then either hands the file size to @p sized (which picks
+ * the destination) or, with @p fd >= 0, streams into @p fd.
+ *
+ * @param cl Client handle.
+ * @param remote_path Remote path.
+ * @param fd Destination descriptor, or -1 to use @p sized.
+ * @param sized Called with the file size; returns a buffer to receive
+ *              it, or NULL with *err set to refuse it.
+ * @param ctx Passed to @p sized.
+ * @param len Receives the file size.
+ */
+static int read_common(rfs_client_t *cl, const char *remote_path, int fd,
+                       uint8_t *(*sized)(void *ctx, uint64_t size, int *err),
+                       void *ctx, uint64_t *len)
+{
+    int sockfd;
+    int rc = librfs_acquire(cl, &sockfd);
+    if (rc != RFS_E_OK)
+        return rc;
+
+    rfs_resp_t resp;
+    rc = simple_request(cl, sockfd, "GET  ", remote_path,
+                        cl->checksums ? RFS_F_DATA_SUM : 0, &resp);
+    if (rc != RFS_E_OK)
+        return rc;
+
+    if (resp.status != RFS_OK)
+    {
+        rc = recv_payload(sockfd, &resp, NULL, -1);
+        librfs_release(cl, sockfd, rc != RFS_E_NETWORK);
+        return rc == RFS_E_NETWORK ? rc : librfs_status_error(resp.status);
+    }
+
+    *len = resp.payload_len;
+    uint8_t *dst = NULL;
+    int refused = RFS_E_OK;
+    if (fd < 0)
+        dst = sized(ctx, resp.payload_len, &refused);
+
+    /* a refused payload is still drained to keep the session */
+    rc = recv_payload(sockfd, &resp, dst, fd);
+    librfs_release(cl, sockfd, rc != RFS_E_NETWORK);
+    if (rc == RFS_E_OK && refused != RFS_E_OK)
+        rc = refused;
+    return rc;
+}
+
+/* Destination of rfs_read(): the caller's buffer, if it is big enough. */
+typedef struct
+{
+    void *buf;
+    size_t cap;
+} fixed_dst_t;
+
+static uint8_t *fixed_sized(void *ctx, uint64_t size, int *err)
+{
+    fixed_dst_t *d = (fixed_dst_t *)ctx;
+    if (size > d->cap)
+    {
+        *err = RFS_E_TOO_LARGE;
+        return NULL;
+    }
+    return (uint8_t *)d->buf;
+}
+
+static uint8_t *alloc_sized(void *ctx, uint64_t size, int *err)
+{
+    void **out = (void **)ctx;
+    *out = size <= SIZE_MAX - 1 ? malloc((size_t)size + 1) : NULL;
+    if (!*out)
+        *err = RFS_E_NOMEM;
+    return (uint8_t *)*out;
+}
+
+/**
+ * @brief Read a remote file into a caller-supplied buffer.
+ */
+int rfs_read(rfs_client_t *client, const char *remote_path,
+             void *buf, size_t cap, size_t *len)
+{
+    if (!client || !remote_path || !len || (!buf && cap > 0))
+        return RFS_E_INVALID;
+
+    fixed_dst_t d = { buf, cap };
+    uint64_t size = 0;
+    int rc = read_common(client, remote_path, -1, fixed_sized, &d, &size);
+    *len = (size_t)size;
+    return rc;
+}
+
+/**
+ * @brief Read a remote file into a newly allocated buffer.
+ */
+int rfs_read_alloc(rfs_client_t *client, const char *remote_path,
+                   void **buf, size_t *len)
+{
+    if (!client || !remote_path || !buf || !len)
+        return RFS_E_INVALID;
+
+    *buf = NULL;
+    uint64_t size = 0;
+    int rc = read_common(client, remote_path, -1, alloc_sized, buf, &size);
+    if (rc != RFS_E_OK)
+    {
+        free(*buf);
+        *buf = NULL;
+        *len = 0;
+        return rc;
+    }
+    *len = (size_t)size;
+    return RFS_E_OK;
+}
+
+/**
+ * @brief Stream a remote file into an open descriptor.
+ */
+int rfs_read_fd(rfs_client_t *client, const char *remote_path, int fd,
+                uint64_t *len)
+{
+    if (!client || !remote_path || fd < 0)
+        return RFS_E_INVALID;
+
+    uint64_t size = 0;
+    int rc = read_common(client, remote_path, fd, NULL, NULL, &size);
+    if (len)
+        *len = rc == RFS_E_OK ? size : 0;
+    return rc;
+}
+
+/**
+ * @brief Remove a file and all of its versions, or an empty directory.
+ */
+int rfs_remove(rfs_client_t *client, const char *remote_path)
+{
+    if (!client || !remote_path)
+        return RFS_E_INVALID;
+
+    int sockfd;
+    int rc = librfs_acquire(client, &sockfd);
+    if (rc != RFS_E_OK)
+        return rc;
+
+    rfs_resp_t resp;
+    if ((rc = simple_request(client, sockfd, "RM   ", remote_path, 0, &resp)) != RFS_E_OK)
+        return rc;
+    rc = recv_payload(sockfd, &resp, NULL, -1);
+    librfs_release(client, sockfd, rc != RFS_E_NETWORK);
+    return rc == RFS_E_NETWORK ? rc : librfs_status_error(resp.status);
+}
+
+/**
+ * @brief Decode a STAT reply (one entry) into an rfs_stat_t.
+ *
+ * @return RFS_E_OK or RFS_E_PROTOCOL.
+ */
+int librfs_parse_stat(const uint8_t *p, uint64_t len, rfs_stat_t *st)
+{
+    uint32_t path_len = 0;
+    if (len >= 4)
+    {
+        memcpy(&path_len, p, 4);
+        path_len = ntohl(path_len);
+    }
+    if (len != 4 + (uint64_t)path_len + RFS_ENTRY_FIXED)
+        return RFS_E_PROTOCOL;
+
+    const uint8_t *f = p + 4 + path_len;
+    uint32_t v;
+    memcpy(&v, f, 4);
+    st->version = ntohl(v);
+    memcpy(&v, f + 4, 4);
+    st->has_checksum = (ntohl(v) & RFS_ENTRY_CHECKSUM) != 0;
+    st->size = rfs_get_u64(f + 8);
+    st->mtime_ns = (int64_t)rfs_get_u64(f + 16);
+    st->checksum = rfs_get_u64(f + 24);
+    return RFS_E_OK;
+}
+
+/**
+ * @brief Look up a file's metadata in the server's index (STAT).
+ */
+int rfs_stat(rfs_client_t *client, const char *remote_path, rfs_stat_t *st)
+{
+    if (!client || !remote_path || !st)
+        return RFS_E_INVALID;
+
+    int sockfd;
+    int rc = librfs_acquire(client, &sockfd);
+    if (rc != RFS_E_OK)
+        return rc;
+
+    rfs_resp_t resp;
+    if ((rc = simple_request(client, sockfd, "STAT ", remote_path, 0, &resp)) != RFS_E_OK)
+        return rc;
+
+    uint8_t *entry = NULL;
+    if (resp.payload_len > 0 && resp.payload_len <= 4 + RFS_MAX_PATH + RFS_ENTRY_FIXED)
+        entry = malloc((size_t)resp.payload_len);
+    if (resp.payload_len > 0 && !entry)
+    {
+        /* oversized or out of memory: drain and report */
+        rc = recv_payload(sockfd, &resp, NULL, -1);
+        librfs_release(client, sockfd, rc != RFS_E_NETWORK);
+        return rc == RFS_E_NETWORK ? rc : RFS_E_PROTOCOL;
+    }
+
+    rc = recv_payload(sockfd, &resp, entry, -1);
+    librfs_release(client, sockfd, rc != RFS_E_NETWORK);
+    if (rc == RFS_E_OK && resp.status != RFS_OK)
+        rc = librfs_status_error(resp.status);
+
+    if (rc == RFS_E_OK)
+        rc = librfs_parse_stat(entry, resp.payload_len, st);
+    free(entry);
+    return rc;
+}
+
+/**
+ * @brief Decode an LS reply into rfs_version_t entries.
+ *
+ * @return RFS_E_OK, RFS_E_NOMEM or RFS_E_PROTOCOL.
+ */
+int librfs_parse_versions(const uint8_t *p, uint64_t len,
+                          rfs_version_t **versions, size_t *count)
+{
+    uint32_t n;
+    if (len < 4)
+        return RFS_E_PROTOCOL;
+    memcpy(&n, p, 4);
+    n = ntohl(n);
+    p += 4;
+    len -= 4;
+
+    if (n > len / 8)
+        return RFS_E_PROTOCOL;
+    rfs_version_t *v = n ? calloc(n, sizeof(*v)) : NULL;
+    if (n && !v)
+        return RFS_E_NOMEM;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t name_len, ts_len;
+        if (len < 8)
+            goto bad;
+        memcpy(&name_len, p, 4);
+        memcpy(&ts_len, p + 4, 4);
+        name_len = ntohl(name_len);
+        ts_len = ntohl(ts_len);
+        p += 8;
+        len -= 8;
+        if ((uint64_t)name_len + ts_len > len)
+            goto bad;
+
+        v[i].name = strndup((const char *)p, name_len);
+        v[i].modified = strndup((const char *)p + name_len, ts_len);
+        if (!v[i].name || !v[i].modified)
+        {
+            rfs_versions_free(v, n);
+            return RFS_E_NOMEM;
+        }
+        p += name_len + ts_len;
+        len -= (uint64_t)name_len + ts_len;
+    }
+
+    *versions = v;
+    *count = n;
+    return RFS_E_OK;
+
+bad:
+    rfs_versions_free(v, n);
+    return RFS_E_PROTOCOL;
+}
+
+/**
+ * @brief List the stored versions of a file (LS).
+ */
+int rfs_versions(rfs_client_t *client, const char *remote_path,
+                 rfs_version_t **versions, size_t *count)
+{
+    if (!client || !remote_path || !versions || !count)
+        return RFS_E_INVALID;
+    *versions = NULL;
+    *count = 0;
+
+    int sockfd;
+    int rc = librfs_acquire(client, &sockfd);
+    if (rc != RFS_E_OK)
+        return rc;
+
+    rfs_resp_t resp;
+    if ((rc = simple_request(client, sockfd, "LS   ", remote_path, 0, &resp)) != RFS_E_OK)
+        return rc;
+
+    uint8_t *body = NULL;
+    if (resp.payload_len > 0 && resp.payload_len <= SIZE_MAX)
+        body = malloc((size_t)resp.payload_len);
+    int refused = resp.payload_len > 0 && !body;
+
+    rc = recv_payload(sockfd, &resp, body, -1);
+    librfs_release(client, sockfd, rc != RFS_E_NETWORK);
+    if (rc == RFS_E_OK && resp.status != RFS_OK)
+        rc = librfs_status_error(resp.status);
+    if (rc == RFS_E_OK && refused)
+        rc = RFS_E_NOMEM;
+    if (rc == RFS_E_OK)
+        rc = librfs_parse_versions(body, resp.payload_len, versions, count);
+    free(body);
+    return rc;
+}
+
+/**
+ * @brief Free a result of rfs_versions().
+ */
+void rfs_versions_free(rfs_version_t *versions, size_t count)
+{
+    if (!versions)
+        return;
+    for (size_t i = 0; i < count; i++)
+    {
+        free(versions[i].name);
+        free(versions[i].modified);
+    }
+    free(versions);
+}
+
+/**
+ * @brief Describe an error code.
+ */
+const char *rfs_strerror(int err)
+{
+    switch (err)
+    {
+    case RFS_E_OK:          return "success";
+    case RFS_E_NOT_FOUND:   return "no such file or version";
+    case RFS_E_NOT_EMPTY:   return "directory not empty";
+    case RFS_E_TOO_LARGE:   return "file too large";
+    case RFS_E_SERVER_IO:   return "server I/O error";
+    case RFS_E_BAD_REQUEST: return "bad request";
+    case RFS_E_CHECKSUM:    return "checksum mismatch";
+    case RFS_E_UNSUPPORTED: return "not supported by the server";
+    case RFS_E_EXISTS:      return "already exists";
+    case RFS_E_READ_ONLY:   return "read-only path";
+    case RFS_E_BUSY:        return "server busy";
+    case RFS_E_INCOMPLETE:  return "upload incomplete";
+    case RFS_E_CONNECT:     return "cannot connect to server";
+    case RFS_E_NETWORK:     return "connection failed";
+    case RFS_E_PROTOCOL:    return "malformed reply";
+    case RFS_E_NOMEM:       return "out of memory";
+    case RFS_E_LOCAL_IO:    return "local I/O error";
+    case RFS_E_INVALID:     return "invalid argument";
+    default:                return "unknown error";
+    }
+}
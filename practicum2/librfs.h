@@ -0,0 +1,352 @@
+/*
+ * librfs.h -- embeddable RFS client library
+ *
+ * The same operations as the rfs command-line client, as function
+ * calls that return error codes instead of printing. A client handle
+ * keeps a pool of persistent protocol v2 connections: each call borrows
+ * one, runs one request on it and hands it back, so a busy caller pays
+ * for the TCP and HELLO handshakes once per connection rather than once
+ * per operation. A handle may be shared by any number of threads; at
+ * most max_connections requests are in flight at once and further
+ * callers wait for a connection to come back.
+ *
+ * The rfs_async_*() calls are the asynchronous form: a caller submits
+ * any number of operations without waiting and collects each result
+ * through a callback or a completion queue. One event-loop thread per
+ * async handle pipelines the requests over a few of the pool's
+ * connections, so a single submitting thread can keep hundreds of
+ * requests in flight.
+ *
+ * Every call returns 0 (RFS_E_OK) or a negative RFS_E_* code. Codes
+ * -1 .. -99 are the server's v2 status codes (protocol.h) negated;
+ * the others describe local and connection failures.
+ *
+ * Build: link with librfs.a and -pthread.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef LIBRFS_H
+#define LIBRFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LIBRFS_DEFAULT_HOST "127.0.0.1"
+#define LIBRFS_DEFAULT_PORT 2000
+#define LIBRFS_DEFAULT_POOL 8
+#define LIBRFS_ASYNC_CONNECTIONS 4      /* async connections (capped by pool) */
+#define LIBRFS_ASYNC_DEPTH       1024   /* operations in flight per handle    */
+
+/* Error codes */
+#define RFS_E_OK            0
+#define RFS_E_NOT_FOUND     (-1)    /* no such file or version          */
+#define RFS_E_NOT_EMPTY     (-2)    /* RM of a non-empty directory      */
+#define RFS_E_TOO_LARGE     (-3)    /* file does not fit (see rfs_read) */
+#define RFS_E_SERVER_IO     (-4)    /* the server failed to store/read  */
+#define RFS_E_BAD_REQUEST   (-5)
+#define RFS_E_CHECKSUM      (-6)    /* data corrupted in transit        */
+#define RFS_E_UNSUPPORTED   (-7)    /* server too old for this call     */
+#define RFS_E_EXISTS        (-8)
+#define RFS_E_READ_ONLY     (-9)    /* snapshot or reserved path        */
+#define RFS_E_BUSY          (-10)   /* server limit reached; retry      */
+#define RFS_E_INCOMPLETE    (-11)
+#define RFS_E_CONNECT       (-100)  /* could not reach the server       */
+#define RFS_E_NETWORK       (-101)  /* connection failed mid-request    */
+#define RFS_E_PROTOCOL      (-102)  /* malformed reply                  */
+#define RFS_E_NOMEM         (-103)
+#define RFS_E_LOCAL_IO      (-104)  /* reading / writing the caller's fd */
+#define RFS_E_INVALID       (-105)  /* bad argument                     */
+
+/* Options for rfs_client_open(); zero fields take the defaults. */
+typedef struct
+{
+    const char *host;       /* IPv4 address, or a Unix socket path
+                               starting with '/' (LIBRFS_DEFAULT_HOST) */
+    int port;               /* TCP port (LIBRFS_DEFAULT_PORT)          */
+    int max_connections;    /* pool size (LIBRFS_DEFAULT_POOL)         */
+    int no_checksums;       /* skip the FNV-1a-64 data checksums       */
+} rfs_options_t;
+
+/* Metadata of one stored file, from rfs_stat(). */
+typedef struct
+{
+    uint32_t version;       /* current version number                  */
+    uint64_t size;
+    int64_t  mtime_ns;
+    int      has_checksum;
+    uint64_t checksum;      /* FNV-1a-64 of the contents               */
+} rfs_stat_t;
+
+/* One stored version, from rfs_versions(). */
+typedef struct
+{
+    char *name;             /* "path" (current) or "path.vN"           */
+    char *modified;         /* "YYYY-MM-DD HH:MM:SS", server local time */
+} rfs_version_t;
+
+typedef struct rfs_client rfs_client_t;
+
+/**
+ * @brief Create a client handle.
+ *
+ * No connection is made until the first call needs one.
+ *
+ * @param opts Options, or NULL for all defaults.
+ *
+ * @return A handle to free with rfs_client_close(), or NULL if out of
+ *         memory or @p opts is invalid.
+ */
+rfs_client_t *rfs_client_open(const rfs_options_t *opts);
+
+/**
+ * @brief Close every pooled connection and free the handle.
+ *
+ * No call may be in progress on @p client.
+ */
+void rfs_client_close(rfs_client_t *client);
+
+/**
+ * @brief Store a buffer as the newest version of a remote file.
+ *
+ * @param client Client handle.
+ * @param remote_path Remote path.
+ * @param buf File contents.
+ * @param len Number of bytes.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_write(rfs_client_t *client, const char *remote_path,
+              const void *buf, size_t len);
+
+/**
+ * @brief Store the contents of an open file as the newest version.
+ *
+ * The file is read with pread() from offset 0 to its current size and
+ * streamed through a fixed-size buffer; the descriptor's position is
+ * not used or changed.
+ *
+ * @param client Client handle.
+ * @param remote_path Remote path.
+ * @param fd Open regular file.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_write_fd(rfs_client_t *client, const char *remote_path, int fd);
+
+/**
+ * @brief Read a remote file into a caller-supplied buffer.
+ *
+ * Append ".vN" to @p remote_path to read an older version.
+ *
+ * @param client Client handle.
+ * @param remote_path Remote path.
+ * @param buf Destination buffer.
+ * @param cap Size of @p buf.
+ * @param len Receives the file size. If it exceeds @p cap nothing is
+ *            copied and RFS_E_TOO_LARGE is returned.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_read(rfs_client_t *client, const char *remote_path,
+             void *buf, size_t cap, size_t *len);
+
+/**
+ * @brief Read a remote file into a newly allocated buffer.
+ *
+ * @param client Client handle.
+ * @param remote_path Remote path (".vN" for an older version).
+ * @param buf Receives a malloc()ed buffer the caller frees.
+ * @param len Receives the file size.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_read_alloc(rfs_client_t *client, const char *remote_path,
+                   void **buf, size_t *len);
+
+/**
+ * @brief Stream a remote file into an open descriptor.
+ *
+ * The data is written at @p fd's current position through a
+ * fixed-size buffer, so files of any size use constant memory.
+ *
+ * @param client Client handle.
+ * @param remote_path Remote path (".vN" for an older version).
+ * @param fd Descriptor to write to (file, pipe or socket).
+ * @param len If non-NULL, receives the number of bytes written.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_read_fd(rfs_client_t *client, const char *remote_path, int fd,
+                uint64_t *len);
+
+/**
+ * @brief Remove a file and all of its versions, or an empty directory.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_remove(rfs_client_t *client, const char *remote_path);
+
+/**
+ * @brief Look up a file's metadata in the server's index (STAT).
+ *
+ * @param client Client handle.
+ * @param remote_path Remote path.
+ * @param st Receives the metadata.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_stat(rfs_client_t *client, const char *remote_path, rfs_stat_t *st);
+
+/**
+ * @brief List the stored versions of a file (LS).
+ *
+ * @param client Client handle.
+ * @param remote_path Remote path.
+ * @param versions Receives an array to free with rfs_versions_free()
+ *                 (NULL when @p count is 0).
+ * @param count Receives the number of versions.
+ *
+ * @return RFS_E_OK or a negative RFS_E_* code.
+ */
+int rfs_versions(rfs_client_t *client, const char *remote_path,
+                 rfs_version_t **versions, size_t *count);
+
+/**
+ * @brief Free a result of rfs_versions().
+ */
+void rfs_versions_free(rfs_version_t *versions, size_t count);
+
+/*------------------------------------------------------------*/
+/*                  Asynchronous interface                    */
+/*------------------------------------------------------------*/
+
+/* Operation types in rfs_completion_t */
+#define RFS_OP_WRITE    1
+#define RFS_OP_READ     2
+#define RFS_OP_REMOVE   3
+#define RFS_OP_STAT     4
+#define RFS_OP_VERSIONS 5
+
+/* Result of one asynchronous operation. */
+typedef struct
+{
+    int op;                     /* RFS_OP_*                                */
+    int result;                 /* RFS_E_OK or a negative RFS_E_* code     */
+    const char *path;           /* remote path; valid in the callback only,
+                                   NULL from rfs_async_poll()              */
+    void *user;                 /* as passed at submission                 */
+
+    /* RFS_OP_WRITE: the submitted buffer. RFS_OP_READ: the contents,
+       malloc()ed and owned by the caller (NULL unless result is OK).      */
+    void *data;
+    size_t len;
+
+    rfs_stat_t stat;            /* RFS_OP_STAT                             */
+    rfs_version_t *versions;    /* RFS_OP_VERSIONS; caller frees with      */
+    size_t count;               /* rfs_versions_free()                     */
+} rfs_completion_t;
+
+/*
+ * Completion callback. Runs on the handle's event-loop thread and should
+ * return quickly; it may submit further operations on the same handle.
+ */
+typedef void (*rfs_callback_t)(rfs_completion_t *c);
+
+typedef struct rfs_async rfs_async_t;
+
+/**
+ * @brief Create an asynchronous handle on top of a client.
+ *
+ * Starts the event-loop thread. Connections are borrowed from
+ * @p client's pool as they are first needed and held until
+ * rfs_async_close(). Operations are spread over them by path, each
+ * connection carrying a pipeline of requests answered in order: two
+ * operations on the same path run in submission order, operations on
+ * different paths in no particular order.
+ *
+ * @param client Client handle; must outlive the async handle.
+ * @param connections Connections to use (LIBRFS_ASYNC_CONNECTIONS if 0,
+ *                    at most the client's max_connections).
+ * @param max_in_flight Submitted operations not yet completed before a
+ *                      submit blocks (LIBRFS_ASYNC_DEPTH if 0).
+ *
+ * @return A handle, or NULL on error.
+ */
+rfs_async_t *rfs_async_open(rfs_client_t *client, int connections,
+                            int max_in_flight);
+
+/**
+ * @brief Wait for every submitted operation, then free the handle.
+ *
+ * Completions not yet taken with rfs_async_poll() are discarded along
+ * with their data. The borrowed connections go back to the pool.
+ */
+void rfs_async_close(rfs_async_t *as);
+
+/*
+ * Submission calls. Each queues one operation and returns at once with
+ * RFS_E_OK, or with an error (nothing queued, no completion). They block
+ * only while max_in_flight operations are outstanding, and never when
+ * called from a callback. The operation's result goes to @p cb if it is
+ * non-NULL, else to the completion queue read by rfs_async_poll().
+ */
+
+/**
+ * @brief Queue a WRITE of @p len bytes from @p buf.
+ *
+ * @p buf is sent in place: it must stay valid and unchanged until the
+ * operation completes (the completion's data points back to it).
+ */
+int rfs_async_write(rfs_async_t *as, const char *remote_path,
+                    const void *buf, size_t len,
+                    rfs_callback_t cb, void *user);
+
+/** @brief Queue a read of a whole file (".vN" for an older version). */
+int rfs_async_read(rfs_async_t *as, const char *remote_path,
+                   rfs_callback_t cb, void *user);
+
+/** @brief Queue a remove of a file and its versions. */
+int rfs_async_remove(rfs_async_t *as, const char *remote_path,
+                     rfs_callback_t cb, void *user);
+
+/** @brief Queue a STAT. */
+int rfs_async_stat(rfs_async_t *as, const char *remote_path,
+                   rfs_callback_t cb, void *user);
+
+/** @brief Queue a listing of a file's versions. */
+int rfs_async_versions(rfs_async_t *as, const char *remote_path,
+                       rfs_callback_t cb, void *user);
+
+/**
+ * @brief Take completions of operations submitted without a callback.
+ *
+ * @param as Async handle.
+ * @param out Receives up to @p max completions.
+ * @param max Size of @p out.
+ * @param timeout_ms Longest wait for the first completion; 0 does not
+ *                   wait, -1 waits as long as operations are pending.
+ *
+ * @return The number of completions stored (0 on timeout, or when
+ *         nothing is pending at all), or RFS_E_INVALID.
+ */
+int rfs_async_poll(rfs_async_t *as, rfs_completion_t *out, int max,
+                   int timeout_ms);
+
+/**
+ * @brief Wait until every submitted operation has completed.
+ *
+ * Callbacks have all returned by then; queued completions stay queued.
+ * Must not be called from a callback.
+ */
+void rfs_async_drain(rfs_async_t *as);
+
+/**
+ * @brief Describe an error code.
+ *
+ * @return A static string; never NULL.
+ */
+const char *rfs_strerror(int err);
+
+#endif /* LIBRFS_H */
@@ -0,0 +1,978 @@
+/*
+ * librfs_async.c -- asynchronous librfs calls: one event loop
+ * pipelining many requests over a few pooled connections
+ *
+ * A v2 session answers its requests strictly in order, so a client does
+ * not have to wait for one reply before sending the next request: it
+ * can stream requests down a connection and match each reply to the
+ * oldest request still waiting. Each async handle runs one thread that
+ * does exactly that with non-blocking sockets and epoll:
+ *
+ *   - rfs_async_*() build the request header in memory and put the
+ *     operation on a submission queue; the first submission into an
+ *     empty queue wakes the loop through an eventfd.
+ *   - The loop hands each operation to the connection with the fewest
+ *     operations outstanding, unless an earlier operation on the same
+ *     path is still in flight: then it follows that one, so operations
+ *     on one path run in the order they were submitted. Every unsent
+ *     request of a connection goes out with one sendmsg() (header, path, payload and checksum
+ *     trailer of many requests as one iovec array).
+ *   - Replies are read in 64 KB gulps and parsed by a small state
+ *     machine (header, payload, trailer); a large GET payload is
+ *     received straight into its final buffer.
+ *   - Each finished operation goes to its callback, or to the completion
+ *     queue for rfs_async_poll().
+ *
+ * A connection that fails completes everything queued on it with
+ * RFS_E_NETWORK and is reopened for the next operation that needs it.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "librfs.h"
+#include "librfs_internal.h"
+#include "protocol.h"
+
+#define ASYNC_IOV_MAX    64             /* iovecs per sendmsg()          */
+#define ASYNC_MAX_EVENTS 64             /* events per epoll_wait()       */
+#define ASYNC_WAKE_ID    UINT32_MAX     /* epoll data of the eventfd     */
+#define ASYNC_PATH_SLOTS 4096           /* path-hash buckets for ordering */
+
+/* One submitted operation. */
+typedef struct async_op
+{
+    struct async_op *next;      /* submission queue, connection or done list */
+    rfs_completion_t comp;
+    rfs_callback_t cb;
+
+    /* request bytes: head (header + path), payload, checksum trailer */
+    uint8_t *head;
+    size_t head_len;
+    const uint8_t *payload;
+    uint64_t payload_len;
+    uint8_t trailer[8];
+    size_t trailer_len;
+    uint64_t sent;              /* bytes of the three sent so far */
+    uint32_t path_hash;         /* bucket in rfs_async.paths */
+
+    uint8_t *body;              /* reply payload being received */
+    char path[];                /* NUL-terminated; head follows it */
+} async_op_t;
+
+/* Reply parser states */
+enum { RX_HEADER, RX_PAYLOAD, RX_TRAILER };
+
+/* One pipelined connection. */
+typedef struct
+{
+    int sockfd;                 /* -1 until first used, or after a failure */
+    async_op_t *head;           /* oldest operation awaiting its reply     */
+    async_op_t *unsent;         /* first operation not fully sent          */
+    async_op_t *tail;
+    size_t depth;               /* operations on this connection           */
+    int want_out;               /* EPOLLOUT registered                     */
+
+    uint8_t *rx;                /* received bytes not yet parsed           */
+    size_t rx_pos;
+    size_t rx_len;
+
+    int stage;                  /* RX_* */
+    uint8_t hdr[RFS_RESP_HDR_LEN];
+    size_t hdr_got;
+    uint8_t trailer[8];
+    size_t trailer_got;
+    rfs_resp_t resp;
+    uint64_t got;               /* payload bytes received */
+    uint64_t sum;
+    int refused;                /* RFS_E_* for a payload we could not keep */
+} async_conn_t;
+
+struct rfs_async
+{
+    rfs_client_t *client;
+    pthread_t thread;
+    int epfd;
+    int wakefd;                 /* eventfd: submissions are waiting */
+    async_conn_t *conns;
+    int nconns;
+
+    /* Paths with operations in flight, by hash: which connection they
+       are on. A collision only pins two paths together. Loop thread. */
+    struct
+    {
+        uint32_t inflight;
+        int conn;
+    } paths[ASYNC_PATH_SLOTS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;     /* room, a completion, or all done */
+    async_op_t *sub_head;       /* submitted, not yet on a connection */
+    async_op_t *sub_tail;
+    async_op_t *done_head;      /* completions for rfs_async_poll() */
+    async_op_t *done_tail;
+    size_t outstanding;         /* submitted and not yet completed */
+    size_t max_in_flight;
+    int stopping;
+};
+
+/*------------------------------------------------------------*/
+/*                        Completion                          */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Deliver an operation's result and forget the operation.
+ *
+ * Runs on the loop thread. A callback is invoked without the lock held,
+ * so it may submit more work.
+ */
+static void finish_op(rfs_async_t *as, async_op_t *op, int result)
+{
+    free(op->body);
+    op->body = NULL;
+    op->next = NULL;
+    op->comp.result = result;
+
+    if (op->cb)
+    {
+        op->comp.path = op->path;
+        op->cb(&op->comp);
+        free(op);
+        pthread_mutex_lock(&as->lock);
+    }
+    else
+    {
+        op->comp.path = NULL;
+        pthread_mutex_lock(&as->lock);
+        if (as->done_tail)
+            as->done_tail->next = op;
+        else
+            as->done_head = op;
+        as->done_tail = op;
+    }
+    as->outstanding--;
+    pthread_cond_broadcast(&as->changed);
+    pthread_mutex_unlock(&as->lock);
+}
+
+/** @brief An operation has left its connection. */
+static void detach_op(rfs_async_t *as, async_conn_t *c, const async_op_t *op)
+{
+    as->paths[op->path_hash % ASYNC_PATH_SLOTS].inflight--;
+    c->depth--;
+}
+
+/**
+ * @brief Close a failed connection and fail everything queued on it.
+ */
+static void fail_conn(rfs_async_t *as, async_conn_t *c)
+{
+    epoll_ctl(as->epfd, EPOLL_CTL_DEL, c->sockfd, NULL);
+    librfs_release(as->client, c->sockfd, 0);
+    c->sockfd = -1;
+
+    async_op_t *op = c->head;
+    c->head = c->unsent = c->tail = NULL;
+    c->want_out = 0;
+    c->rx_pos = c->rx_len = 0;
+    c->stage = RX_HEADER;
+    c->hdr_got = c->trailer_got = 0;
+
+    while (op)
+    {
+        async_op_t *next = op->next;
+        detach_op(as, c, op);
+        finish_op(as, op, RFS_E_NETWORK);
+        op = next;
+    }
+}
+
+/*------------------------------------------------------------*/
+/*                         Replies                            */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief The reply to the connection's oldest operation is complete.
+ *
+ * @param sum_ok 0 if the payload failed its checksum.
+ */
+static void reply_done(rfs_async_t *as, async_conn_t *c, int sum_ok)
+{
+    async_op_t *op = c->head;
+    c->head = op->next;
+    if (!c->head)
+        c->tail = NULL;
+    detach_op(as, c, op);
+    c->stage = RX_HEADER;
+
+    int rc;
+    if (!sum_ok)
+        rc = RFS_E_CHECKSUM;
+    else if (c->resp.status != RFS_OK)
+        rc = librfs_status_error(c->resp.status);
+    else
+        rc = c->refused;
+
+    if (rc == RFS_E_OK)
+    {
+        switch (op->comp.op)
+        {
+        case RFS_OP_READ:
+            op->comp.data = op->body;
+            op->comp.len = (size_t)c->resp.payload_len;
+            op->body = NULL;
+            break;
+        case RFS_OP_STAT:
+            rc = librfs_parse_stat(op->body, c->resp.payload_len, &op->comp.stat);
+            break;
+        case RFS_OP_VERSIONS:
+            rc = librfs_parse_versions(op->body, c->resp.payload_len,
+                                       &op->comp.versions, &op->comp.count);
+            break;
+        default:
+            break;
+        }
+    }
+    finish_op(as, op, rc);
+}
+
+/** @brief The payload is in: expect the trailer or finish the reply. */
+static void payload_done(rfs_async_t *as, async_conn_t *c)
+{
+    if (c->resp.flags & RFS_F_DATA_SUM)
+    {
+        c->stage = RX_TRAILER;
+        c->trailer_got = 0;
+    }
+    else
+    {
+        reply_done(as, c, 1);
+    }
+}
+
+/**
+ * @brief A reply header has arrived: decide where its payload goes.
+ *
+ * Only successful READ, STAT and VERSIONS replies keep their payload;
+ * anything else is received and dropped so the connection stays in step.
+ */
+static void begin_payload(rfs_async_t *as, async_conn_t *c, async_op_t *op)
+{
+    uint64_t len = c->resp.payload_len;
+    int keep = c->resp.status == RFS_OK &&
+               (op->comp.op == RFS_OP_READ || op->comp.op == RFS_OP_STAT ||
+                op->comp.op == RFS_OP_VERSIONS);
+
+    c->got = 0;
+    c->sum = RFS_FNV64_INIT;
+    c->refused = RFS_E_OK;
+
+    if (keep)
+    {
+        if (op->comp.op == RFS_OP_STAT &&
+            len > 4 + RFS_MAX_PATH + RFS_ENTRY_FIXED)
+            c->refused = RFS_E_PROTOCOL;
+        else if (len > SIZE_MAX - 1 || !(op->body = malloc((size_t)len + 1)))
+            c->refused = RFS_E_NOMEM;
+    }
+
+    if (len > 0)
+        c->stage = RX_PAYLOAD;
+    else
+        payload_done(as, c);
+}
+
+/**
+ * @brief Consume everything in the connection's receive buffer.
+ *
+ * @return 0, or -1 if the server sent something that is not a valid
+ *         reply to the oldest operation.
+ */
+static int parse_replies(rfs_async_t *as, async_conn_t *c)
+{
+    while (c->rx_pos < c->rx_len)
+    {
+        const uint8_t *p = c->rx + c->rx_pos;
+        size_t avail = c->rx_len - c->rx_pos;
+        async_op_t *op = c->head;
+
+        /* the server answers only after reading a whole request */
+        if (!op || op == c->unsent)
+            return -1;
+
+        size_t n;
+        switch (c->stage)
+        {
+        case RX_HEADER:
+            n = sizeof(c->hdr) - c->hdr_got;
+            if (n > avail)
+                n = avail;
+            memcpy(c->hdr + c->hdr_got, p, n);
+            c->hdr_got += n;
+            c->rx_pos += n;
+            if (c->hdr_got == sizeof(c->hdr))
+            {
+                c->hdr_got = 0;
+                if (rfs_decode_response(c->hdr, &c->resp) < 0)
+                    return -1;
+                begin_payload(as, c, op);
+            }
+            break;
+
+        case RX_PAYLOAD:
+        {
+            uint64_t left = c->resp.payload_len - c->got;
+            n = left < avail ? (size_t)left : avail;
+            if (op->body)
+                memcpy(op->body + c->got, p, n);
+            if (c->resp.flags & RFS_F_DATA_SUM)
+                c->sum = rfs_fnv64(c->sum, p, n);
+            c->got += n;
+            c->rx_pos += n;
+            if (c->got == c->resp.payload_len)
+                payload_done(as, c);
+            break;
+        }
+
+        default:    /* RX_TRAILER */
+            n = sizeof(c->trailer) - c->trailer_got;
+            if (n > avail)
+                n = avail;
+            memcpy(c->trailer + c->trailer_got, p, n);
+            c->trailer_got += n;
+            c->rx_pos += n;
+            if (c->trailer_got == sizeof(c->trailer))
+                reply_done(as, c, rfs_get_u64(c->trailer) == c->sum);
+            break;
+        }
+    }
+    c->rx_pos = c->rx_len = 0;
+    return 0;
+}
+
+/**
+ * @brief Read everything the socket has and parse it.
+ *
+ * @return 0 once the socket would block, or -1 if the connection
+ *         failed or closed.
+ */
+static int conn_read(rfs_async_t *as, async_conn_t *c)
+{
+    while (1)
+    {
+        ssize_t n;
+        async_op_t *op = c->head;
+
+        if (c->stage == RX_PAYLOAD && op && op->body &&
+            c->resp.payload_len - c->got >= RFS_IO_CHUNK)
+        {
+            /* large payload: receive it in place, not via c->rx */
+            n = recv(c->sockfd, op->body + c->got,
+                     (size_t)(c->resp.payload_len - c->got), 0);
+            if (n > 0)
+            {
+                if (c->resp.flags & RFS_F_DATA_SUM)
+                    c->sum = rfs_fnv64(c->sum, op->body + c->got, (size_t)n);
+                c->got += (uint64_t)n;
+                if (c->got == c->resp.payload_len)
+                    payload_done(as, c);
+                continue;
+            }
+        }
+        else
+        {
+            n = recv(c->sockfd, c->rx, RFS_IO_CHUNK, 0);
+            if (n > 0)
+            {
+                c->rx_len = (size_t)n;
+                if (parse_replies(as, c) < 0)
+                    return -1;
+                continue;
+            }
+        }
+
+        if (n == 0)
+            return -1;
+        if (errno == EINTR)
+            continue;
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+}
+
+/*------------------------------------------------------------*/
+/*                         Requests                           */
+/*------------------------------------------------------------*/
+
+/** @brief Bytes of an operation's request on the wire. */
+static uint64_t op_total(const async_op_t *op)
+{
+    return op->head_len + op->payload_len + op->trailer_len;
+}
+
+/**
+ * @brief Describe the unsent rest of an operation's request.
+ *
+ * @return The number of iovecs filled (at most 3).
+ */
+static int op_iov(const async_op_t *op, struct iovec *iov)
+{
+    const uint8_t *base[3] = { op->head, op->payload, op->trailer };
+    uint64_t len[3] = { op->head_len, op->payload_len, op->trailer_len };
+    uint64_t skip = op->sent;
+    int n = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (skip >= len[i])
+        {
+            skip -= len[i];
+            continue;
+        }
+        iov[n].iov_base = (void *)(base[i] + skip);
+        iov[n].iov_len = (size_t)(len[i] - skip);
+        skip = 0;
+        n++;
+    }
+    return n;
+}
+
+/** @brief Register or drop interest in EPOLLOUT to match c->unsent. */
+static void update_interest(rfs_async_t *as, async_conn_t *c, int idx)
+{
+    int want = c->unsent != NULL;
+    if (want == c->want_out)
+        return;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)idx;
+    epoll_ctl(as->epfd, EPOLL_CTL_MOD, c->sockfd, &ev);
+    c->want_out = want;
+}
+
+/**
+ * @brief Send as much of the connection's unsent requests as it takes.
+ *
+ * Many requests go out in one sendmsg(), which is what makes a deep
+ * pipeline of small operations cheap.
+ *
+ * @return 0, or -1 if the connection failed.
+ */
+static int conn_write(rfs_async_t *as, async_conn_t *c, int idx)
+{
+    while (c->unsent)
+    {
+        struct iovec iov[ASYNC_IOV_MAX];
+        int n = 0;
+        for (async_op_t *op = c->unsent; op && n + 3 <= ASYNC_IOV_MAX; op = op->next)
+            n += op_iov(op, iov + n);
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)n;
+
+        ssize_t w = sendmsg(c->sockfd, &msg, MSG_NOSIGNAL);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+
+        uint64_t done = (uint64_t)w;
+        while (done > 0)
+        {
+            async_op_t *op = c->unsent;
+            uint64_t left = op_total(op) - op->sent;
+            uint64_t take = done < left ? done : left;
+            op->sent += take;
+            done -= take;
+            if (op->sent == op_total(op))
+                c->unsent = op->next;
+        }
+    }
+    update_interest(as, c, idx);
+    return 0;
+}
+
+/**
+ * @brief Borrow a pooled connection for @p c and add it to the loop.
+ *
+ * @return 0, or -1 if no connection could be made.
+ */
+static int conn_open(rfs_async_t *as, async_conn_t *c, int idx)
+{
+    int sockfd;
+    if (librfs_acquire(as->client, &sockfd) != RFS_E_OK)
+        return -1;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)idx;
+
+    int flags = fcntl(sockfd, F_GETFL);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+        epoll_ctl(as->epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0)
+    {
+        librfs_release(as->client, sockfd, 0);
+        return -1;
+    }
+    c->sockfd = sockfd;
+    c->want_out = 0;
+    return 0;
+}
+
+/**
+ * @brief Move every submitted operation onto a connection and send.
+ *
+ * An operation whose path already has one in flight joins it on the
+ * same connection, which answers in order, so a READ submitted after a
+ * WRITE of the same path sees it. Any other operation goes to the
+ * connection with the fewest outstanding; unopened connections are
+ * brought in as soon as the others have work queued.
+ */
+static void dispatch(rfs_async_t *as)
+{
+    pthread_mutex_lock(&as->lock);
+    async_op_t *op = as->sub_head;
+    as->sub_head = as->sub_tail = NULL;
+    pthread_mutex_unlock(&as->lock);
+
+    while (op)
+    {
+        async_op_t *next = op->next;
+        op->next = NULL;
+
+        int best = 0;
+        uint32_t slot = op->path_hash % ASYNC_PATH_SLOTS;
+        if (as->paths[slot].inflight > 0)
+            best = as->paths[slot].conn;
+        else
+        {
+            for (int i = 1; i < as->nconns; i++)
+            {
+                if (as->conns[i].depth < as->conns[best].depth)
+                    best = i;
+            }
+        }
+
+        async_conn_t *c = &as->conns[best];
+        if (c->sockfd < 0 && conn_open(as, c, best) < 0)
+        {
+            finish_op(as, op, RFS_E_CONNECT);
+            op = next;
+            continue;
+        }
+
+        if (c->tail)
+            c->tail->next = op;
+        else
+            c->head = op;
+        c->tail = op;
+        if (!c->unsent)
+            c->unsent = op;
+        c->depth++;
+        as->paths[slot].inflight++;
+        as->paths[slot].conn = best;
+        op = next;
+    }
+
+    for (int i = 0; i < as->nconns; i++)
+    {
+        async_conn_t *c = &as->conns[i];
+        if (c->sockfd >= 0 && c->unsent && conn_write(as, c, i) < 0)
+            fail_conn(as, c);
+    }
+}
+
+/*------------------------------------------------------------*/
+/*                        Event loop                          */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Event-loop thread: socket readiness, wake-ups, dispatch.
+ *
+ * @param arg The rfs_async_t.
+ *
+ * @return NULL once rfs_async_close() asks it to stop.
+ */
+static void *loop_main(void *arg)
+{
+    rfs_async_t *as = (rfs_async_t *)arg;
+    struct epoll_event events[ASYNC_MAX_EVENTS];
+
+    while (1)
+    {
+        int n = epoll_wait(as->epfd, events, ASYNC_MAX_EVENTS, -1);
+        for (int i = 0; i < n; i++)
+        {
+            uint32_t id = events[i].data.u32;
+            if (id == ASYNC_WAKE_ID)
+            {
+                uint64_t count;
+                ssize_t r = read(as->wakefd, &count, sizeof(count));
+                (void)r;    /* EAGAIN: another wake-up already drained it */
+                continue;
+            }
+
+            async_conn_t *c = &as->conns[id];
+            if (c->sockfd < 0)
+                continue;   /* failed earlier in this batch */
+            if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+                conn_read(as, c) < 0)
+            {
+                fail_conn(as, c);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && conn_write(as, c, (int)id) < 0)
+                fail_conn(as, c);
+        }
+
+        dispatch(as);
+
+        pthread_mutex_lock(&as->lock);
+        int stop = as->stopping;
+        pthread_mutex_unlock(&as->lock);
+        if (stop)
+            return NULL;
+    }
+}
+
+/** @brief Wake the loop thread. */
+static void wake(rfs_async_t *as)
+{
+    uint64_t one = 1;
+    if (write(as->wakefd, &one, sizeof(one)) < 0)
+        return;     /* counter saturated: the loop is awake anyway */
+}
+
+/*------------------------------------------------------------*/
+/*                         Handles                            */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Create an asynchronous handle on top of a client.
+ */
+rfs_async_t *rfs_async_open(rfs_client_t *client, int connections,
+                            int max_in_flight)
+{
+    if (!client || connections < 0 || max_in_flight < 0)
+        return NULL;
+    if (connections == 0)
+        connections = LIBRFS_ASYNC_CONNECTIONS;
+    if (connections > client->max_connections)
+        connections = client->max_connections;
+
+    rfs_async_t *as = calloc(1, sizeof(*as));
+    if (!as)
+        return NULL;
+    as->client = client;
+    as->nconns = connections;
+    as->max_in_flight = max_in_flight ? (size_t)max_in_flight : LIBRFS_ASYNC_DEPTH;
+    as->epfd = epoll_create1(EPOLL_CLOEXEC);
+    as->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    as->conns = calloc((size_t)connections, sizeof(async_conn_t));
+
+    int ok = as->epfd >= 0 && as->wakefd >= 0 && as->conns;
+    for (int i = 0; ok && i < connections; i++)
+    {
+        as->conns[i].sockfd = -1;
+        as->conns[i].rx = malloc(RFS_IO_CHUNK);
+        ok = as->conns[i].rx != NULL;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = ASYNC_WAKE_ID;
+    ok = ok && epoll_ctl(as->epfd, EPOLL_CTL_ADD, as->wakefd, &ev) == 0;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&as->lock, NULL);
+    pthread_cond_init(&as->changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (!ok || pthread_create(&as->thread, NULL, loop_main, as) != 0)
+    {
+        for (int i = 0; as->conns && i < connections; i++)
+            free(as->conns[i].rx);
+        free(as->conns);
+        if (as->epfd >= 0)
+            close(as->epfd);
+        if (as->wakefd >= 0)
+            close(as->wakefd);
+        pthread_mutex_destroy(&as->lock);
+        pthread_cond_destroy(&as->changed);
+        free(as);
+        return NULL;
+    }
+    return as;
+}
+
+/** @brief Free a completion nobody collected. */
+static void discard_completion(async_op_t *op)
+{
+    if (op->comp.op == RFS_OP_READ)
+        free(op->comp.data);
+    rfs_versions_free(op->comp.versions, op->comp.count);
+    free(op);
+}
+
+/**
+ * @brief Wait for every submitted operation, then free the handle.
+ */
+void rfs_async_close(rfs_async_t *as)
+{
+    if (!as)
+        return;
+
+    rfs_async_drain(as);
+    pthread_mutex_lock(&as->lock);
+    as->stopping = 1;
+    pthread_mutex_unlock(&as->lock);
+    wake(as);
+    pthread_join(as->thread, NULL);
+
+    for (int i = 0; i < as->nconns; i++)
+    {
+        async_conn_t *c = &as->conns[i];
+        if (c->sockfd >= 0)
+        {
+            /* every reply has been read, so it is back in step */
+            int flags = fcntl(c->sockfd, F_GETFL);
+            int ok = flags >= 0 && fcntl(c->sockfd, F_SETFL, flags & ~O_NONBLOCK) == 0;
+            librfs_release(as->client, c->sockfd, ok);
+        }
+        free(c->rx);
+    }
+
+    while (as->done_head)
+    {
+        async_op_t *op = as->done_head;
+        as->done_head = op->next;
+        discard_completion(op);
+    }
+
+    close(as->epfd);
+    close(as->wakefd);
+    pthread_mutex_destroy(&as->lock);
+    pthread_cond_destroy(&as->changed);
+    free(as->conns);
+    free(as);
+}
+
+/*------------------------------------------------------------*/
+/*                        Submission                          */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Build an operation and put it on the submission queue.
+ *
+ * @param as Async handle.
+ * @param type RFS_OP_*.
+ * @param cmd 5-byte command.
+ * @param remote_path Remote path.
+ * @param buf WRITE payload (NULL otherwise).
+ * @param len WRITE payload length.
+ * @param cb Callback, or NULL for the completion queue.
+ * @param user Passed back in the completion.
+ *
+ * @return RFS_E_OK, RFS_E_INVALID or RFS_E_NOMEM.
+ */
+static int submit(rfs_async_t *as, int type, const char *cmd,
+                  const char *remote_path, const void *buf, size_t len,
+                  rfs_callback_t cb, void *user)
+{
+    if (!as || !remote_path)
+        return RFS_E_INVALID;
+    size_t plen = strlen(remote_path);
+    if (plen >= RFS_MAX_PATH)
+        return RFS_E_INVALID;
+
+    async_op_t *op = malloc(sizeof(*op) + plen + 1 + RFS_REQ_HDR_LEN + plen);
+    if (!op)
+        return RFS_E_NOMEM;
+    memset(op, 0, sizeof(*op));
+    memcpy(op->path, remote_path, plen + 1);
+    op->head = (uint8_t *)op->path + plen + 1;
+    op->path_hash = rfs_fnv32(remote_path, plen);
+    op->cb = cb;
+    op->comp.op = type;
+    op->comp.user = user;
+
+    int sums = as->client->checksums &&
+               (type == RFS_OP_WRITE || type == RFS_OP_READ);
+    rfs_req_t req;
+    memcpy(req.cmd, cmd, 5);
+    req.flags = sums ? RFS_F_DATA_SUM : 0;
+    req.path_len = (uint32_t)plen;
+    req.payload_len = type == RFS_OP_WRITE ? len : 0;
+    req.arg = 0;
+    rfs_encode_request(op->head, &req);
+    memcpy(op->head + RFS_REQ_HDR_LEN, remote_path, plen);
+    op->head_len = RFS_REQ_HDR_LEN + plen;
+
+    if (type == RFS_OP_WRITE)
+    {
+        op->payload = (const uint8_t *)buf;
+        op->payload_len = len;
+        op->comp.data = (void *)buf;
+        op->comp.len = len;
+        if (sums)
+        {
+            rfs_put_u64(op->trailer, rfs_fnv64(RFS_FNV64_INIT, buf, len));
+            op->trailer_len = 8;
+        }
+    }
+
+    pthread_mutex_lock(&as->lock);
+    if (!pthread_equal(pthread_self(), as->thread))
+    {
+        while (as->outstanding >= as->max_in_flight)
+            pthread_cond_wait(&as->changed, &as->lock);
+    }
+    as->outstanding++;
+    int was_empty = as->sub_head == NULL;
+    if (as->sub_tail)
+        as->sub_tail->next = op;
+    else
+        as->sub_head = op;
+    as->sub_tail = op;
+    pthread_mutex_unlock(&as->lock);
+
+    /* one wake-up covers everything queued before the loop runs */
+    if (was_empty)
+        wake(as);
+    return RFS_E_OK;
+}
+
+/**
+ * @brief Queue a WRITE of @p len bytes from @p buf.
+ */
+int rfs_async_write(rfs_async_t *as, const char *remote_path,
+                    const void *buf, size_t len,
+                    rfs_callback_t cb, void *user)
+{
+    if (!buf && len > 0)
+        return RFS_E_INVALID;
+    return submit(as, RFS_OP_WRITE, "WRITE", remote_path,
+                  buf ? buf : "", len, cb, user);
+}
+
+/**
+ * @brief Queue a read of a whole file.
+ */
+int rfs_async_read(rfs_async_t *as, const char *remote_path,
+                   rfs_callback_t cb, void *user)
+{
+    return submit(as, RFS_OP_READ, "GET  ", remote_path, NULL, 0, cb, user);
+}
+
+/**
+ * @brief Queue a remove of a file and its versions.
+ */
+int rfs_async_remove(rfs_async_t *as, const char *remote_path,
+                     rfs_callback_t cb, void *user)
+{
+    return submit(as, RFS_OP_REMOVE, "RM   ", remote_path, NULL, 0, cb, user);
+}
+
+/**
+ * @brief Queue a STAT.
+ */
+int rfs_async_stat(rfs_async_t *as, const char *remote_path,
+                   rfs_callback_t cb, void *user)
+{
+    return submit(as, RFS_OP_STAT, "STAT ", remote_path, NULL, 0, cb, user);
+}
+
+/**
+ * @brief Queue a listing of a file's versions.
+ */
+int rfs_async_versions(rfs_async_t *as, const char *remote_path,
+                       rfs_callback_t cb, void *user)
+{
+    return submit(as, RFS_OP_VERSIONS, "LS   ", remote_path, NULL, 0, cb, user);
+}
+
+/*------------------------------------------------------------*/
+/*                        Collection                          */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Take completions of operations submitted without a callback.
+ */
+int rfs_async_poll(rfs_async_t *as, rfs_completion_t *out, int max,
+                   int timeout_ms)
+{
+    if (!as || !out || max <= 0)
+        return RFS_E_INVALID;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (timeout_ms > 0)
+    {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&as->lock);
+    while (!as->done_head && as->outstanding > 0 && timeout_ms != 0)
+    {
+        if (timeout_ms < 0)
+            pthread_cond_wait(&as->changed, &as->lock);
+        else if (pthread_cond_timedwait(&as->changed, &as->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+
+    int n = 0;
+    while (as->done_head && n < max)
+    {
+        async_op_t *op = as->done_head;
+        as->done_head = op->next;
+        if (!as->done_head)
+            as->done_tail = NULL;
+        out[n++] = op->comp;
+        free(op);
+    }
+    pthread_mutex_unlock(&as->lock);
+    return n;
+}
+
+/**
+ * @brief Wait until every submitted operation has completed.
+ */
+void rfs_async_drain(rfs_async_t *as)
+{
+    if (!as)
+        return;
+    pthread_mutex_lock(&as->lock);
+    while (as->outstanding > 0)
+        pthread_cond_wait(&as->changed, &as->lock);
+    pthread_mutex_unlock(&as->lock);
+}
@@ -0,0 +1,70 @@
+/*
+ * librfs_internal.h -- pieces of librfs shared between its own files
+ *
+ * Not installed with librfs.h: the client handle layout, the pool and
+ * reply decoders used by both the blocking calls (librfs.c) and the
+ * asynchronous interface (librfs_async.c).
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef LIBRFS_INTERNAL_H
+#define LIBRFS_INTERNAL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "librfs.h"
+
+/* One pooled connection. */
+typedef struct
+{
+    int sockfd;
+    int64_t idle_since_ms;      /* CLOCK_MONOTONIC time it was returned */
+} idle_conn_t;
+
+struct rfs_client
+{
+    char *host;
+    int port;
+    int max_connections;
+    int checksums;
+
+    pthread_mutex_t lock;
+    pthread_cond_t available;   /* signalled when a connection is returned */
+    idle_conn_t *idle;          /* pooled connections, most recent last */
+    int nidle;
+    int open;                   /* connections idle or in use */
+};
+
+/**
+ * @brief Borrow a connection from the pool (blocking socket, in step).
+ *
+ * @return RFS_E_OK or RFS_E_CONNECT.
+ */
+int librfs_acquire(rfs_client_t *cl, int *sockfd);
+
+/**
+ * @brief Return a borrowed connection; closed unless @p reusable.
+ */
+void librfs_release(rfs_client_t *cl, int sockfd, int reusable);
+
+/** @brief Map a v2 status to an RFS_E_* code. */
+int librfs_status_error(uint32_t status);
+
+/**
+ * @brief Decode a STAT reply (one entry) into an rfs_stat_t.
+ *
+ * @return RFS_E_OK or RFS_E_PROTOCOL.
+ */
+int librfs_parse_stat(const uint8_t *p, uint64_t len, rfs_stat_t *st);
+
+/**
+ * @brief Decode an LS reply into rfs_version_t entries.
+ *
+ * @return RFS_E_OK, RFS_E_NOMEM or RFS_E_PROTOCOL.
+ */
+int librfs_parse_versions(const uint8_t *p, uint64_t len,
+                          rfs_version_t **versions, size_t *count);
+
+#endif /* LIBRFS_INTERNAL_H */
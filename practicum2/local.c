@@ -0,0 +1,259 @@
+/*
+ * local.c -- Same-host transport helpers shared by the RFS client and
+ *            server (fd passing, in-kernel copies, local address check)
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ifaddrs.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "local.h"
+
+/**
+ * @brief Send an open file descriptor over a Unix domain socket.
+ *
+ * @param sockfd Connected AF_UNIX socket.
+ * @param fd Descriptor to pass.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int send_fd(int sockfd, int fd)
+{
+    char marker = 'F';
+    struct iovec iov = { &marker, 1 };
+
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type  = SCM_RIGHTS;
+    cm->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &fd, sizeof(int));
+
+    ssize_t n;
+    do
+        n = sendmsg(sockfd, &msg, 0);
+    while (n < 0 && errno == EINTR);
+
+    if (n != 1)
+    {
+        perror("sendmsg");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receive a file descriptor sent with send_fd().
+ *
+ * @param sockfd Connected AF_UNIX socket.
+ *
+ * @return The received descriptor, or -1 on error.
+ */
+int recv_fd(int sockfd)
+{
+    char marker;
+    struct iovec iov = { &marker, 1 };
+
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } ctrl;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    ssize_t n;
+    do
+        n = recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    while (n < 0 && errno == EINTR);
+
+    if (n != 1)
+    {
+        if (n < 0)
+            perror("recvmsg");
+        else
+            fprintf(stderr, "recv_fd: connection closed\n");
+        return -1;
+    }
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (!cm || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS ||
+        cm->cmsg_len != CMSG_LEN(sizeof(int)))
+    {
+        fprintf(stderr, "recv_fd: no descriptor received\n");
+        return -1;
+    }
+
+    int fd;
+    memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+    return fd;
+}
+
+/**
+ * @brief Copy @p len bytes from the start of @p src_fd to @p dst_fd.
+ *
+ * @param src_fd Source file, read from offset 0.
+ * @param dst_fd Destination file, written at its current offset.
+ * @param len Number of bytes to copy.
+ *
+ * @return 0 on success, or -1 on error or short source file.
+ */
+int copy_fd(int src_fd, int dst_fd, uint64_t len)
+{
+    return copy_fd_at(src_fd, 0, dst_fd, len);
+}
+
+/**
+ * @brief Copy @p len bytes from offset @p src_off of @p src_fd to @p dst_fd.
+ *
+ * @param src_fd Source file.
+ * @param src_off First byte of @p src_fd to copy.
+ * @param dst_fd Destination file, written at its current offset.
+ * @param len Number of bytes to copy.
+ *
+ * @return 0 on success, or -1 on error or short source file.
+ */
+int copy_fd_at(int src_fd, uint64_t src_off, int dst_fd, uint64_t len)
+{
+    loff_t in_off = (loff_t)src_off;
+    uint64_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t n = copy_file_range(src_fd, &in_off, dst_fd, NULL,
+                                    (size_t)(len - done), 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                errno == EOPNOTSUPP)
+                break;      /* fall back to read/write below */
+            perror("copy_file_range");
+            return -1;
+        }
+        if (n == 0)
+        {
+            fprintf(stderr, "copy_fd: source shorter than expected\n");
+            return -1;
+        }
+        done += (uint64_t)n;
+    }
+
+    char buf[64 * 1024];
+    while (done < len)
+    {
+        size_t want = sizeof(buf);
+        if (len - done < want)
+            want = (size_t)(len - done);
+
+        ssize_t n = pread(src_fd, buf, want, (off_t)(src_off + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            if (n < 0)
+                perror("pread");
+            else
+                fprintf(stderr, "copy_fd: source shorter than expected\n");
+            return -1;
+        }
+
+        size_t off = 0;
+        while (off < (size_t)n)
+        {
+            ssize_t w = write(dst_fd, buf + off, (size_t)n - off);
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0)
+            {
+                perror("write");
+                return -1;
+            }
+            off += (size_t)w;
+        }
+        done += (uint64_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Report whether a connected socket is a Unix domain socket.
+ *
+ * @param sockfd Connected socket file descriptor.
+ *
+ * @return 1 if @p sockfd is AF_UNIX, 0 otherwise.
+ */
+int sock_is_local(int sockfd)
+{
+    struct sockaddr_storage ss;
+    socklen_t len = sizeof(ss);
+
+    if (getsockname(sockfd, (struct sockaddr *)&ss, &len) < 0)
+        return 0;
+    return ss.ss_family == AF_UNIX;
+}
+
+/**
+ * @brief Report whether an IPv4 address belongs to this host.
+ *
+ * @param ip Dotted-quad IPv4 address string.
+ *
+ * @return 1 if @p ip is an address of this host, 0 otherwise.
+ */
+int ip_is_local(const char *ip)
+{
+    struct in_addr want;
+    if (inet_pton(AF_INET, ip, &want) <= 0)
+        return 0;
+
+    /* 127.0.0.0/8 */
+    if ((ntohl(want.s_addr) >> 24) == 127)
+        return 1;
+
+    struct ifaddrs *ifs;
+    if (getifaddrs(&ifs) < 0)
+        return 0;
+
+    int found = 0;
+    for (struct ifaddrs *i = ifs; i != NULL && !found; i = i->ifa_next)
+    {
+        if (i->ifa_addr && i->ifa_addr->sa_family == AF_INET)
+        {
+            struct sockaddr_in *sin = (struct sockaddr_in *)i->ifa_addr;
+            if (sin->sin_addr.s_addr == want.s_addr)
+                found = 1;
+        }
+    }
+    freeifaddrs(ifs);
+    return found;
+}
@@ -0,0 +1,98 @@
+/*
+ * local.h -- Same-host transport helpers shared by the RFS client and
+ *            server:
+ *   - Unix domain socket rendezvous path
+ *   - Passing open file descriptors over a Unix socket (SCM_RIGHTS)
+ *   - In-kernel file-to-file copies
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef LOCAL_H
+#define LOCAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Unix socket the server listens on next to its TCP port. */
+#define RFS_UNIX_PATH "/tmp/rfs.sock"
+
+/*
+ * Over the Unix socket, WRITE payloads of at least this many bytes are
+ * handed to the server as an open file descriptor instead of being
+ * copied through the socket.
+ */
+#define LOCAL_FD_THRESHOLD (64 * 1024)
+
+/**
+ * @brief Send an open file descriptor over a Unix domain socket.
+ *
+ * The descriptor travels as SCM_RIGHTS ancillary data attached to a
+ * single marker byte. The sender keeps its own copy of @p fd.
+ *
+ * @param sockfd Connected AF_UNIX socket.
+ * @param fd Descriptor to pass.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int send_fd(int sockfd, int fd);
+
+/**
+ * @brief Receive a file descriptor sent with send_fd().
+ *
+ * @param sockfd Connected AF_UNIX socket.
+ *
+ * @return The received descriptor (owned by the caller), or -1 on
+ *         error or if the peer sent no descriptor.
+ */
+int recv_fd(int sockfd);
+
+/**
+ * @brief Copy @p len bytes from the start of @p src_fd to @p dst_fd.
+ *
+ * Uses copy_file_range(2) so the data never passes through user
+ * space (and may be reflinked by the file system), falling back to a
+ * read/write loop when the kernel cannot copy between the two files.
+ *
+ * @param src_fd Source file, read from offset 0.
+ * @param dst_fd Destination file, written at its current offset.
+ * @param len Number of bytes to copy.
+ *
+ * @return 0 on success, or -1 on error or short source file.
+ */
+int copy_fd(int src_fd, int dst_fd, uint64_t len);
+
+/**
+ * @brief Like copy_fd(), but starting at offset @p src_off of @p src_fd.
+ *
+ * @param src_fd Source file.
+ * @param src_off First byte of @p src_fd to copy.
+ * @param dst_fd Destination file, written at its current offset.
+ * @param len Number of bytes to copy.
+ *
+ * @return 0 on success, or -1 on error or short source file.
+ */
+int copy_fd_at(int src_fd, uint64_t src_off, int dst_fd, uint64_t len);
+
+/**
+ * @brief Report whether a connected socket is a Unix domain socket.
+ *
+ * @param sockfd Connected socket file descriptor.
+ *
+ * @return 1 if @p sockfd is AF_UNIX, 0 otherwise.
+ */
+int sock_is_local(int sockfd);
+
+/**
+ * @brief Report whether an IPv4 address belongs to this host.
+ *
+ * Loopback addresses always count as local; otherwise the address is
+ * compared against every configured interface address.
+ *
+ * @param ip Dotted-quad IPv4 address string.
+ *
+ * @return 1 if @p ip is an address of this host, 0 otherwise.
+ */
+int ip_is_local(const char *ip);
+
+#endif /* LOCAL_H */
@@ -0,0 +1,317 @@
+/*
+ * multipart.c -- multipart uploads: registry and received ranges
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "multipart.h"
+
+/* One received byte range [start, end). */
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;
+} range_t;
+
+struct mp_upload
+{
+    uint64_t id;
+    char *remote_path;
+    char *tmp_path;
+    uint64_t size;
+    range_t *ranges;        /* sorted, non-overlapping, non-adjacent */
+    size_t nranges;
+    size_t cap;
+    int pins;               /* parts being written right now */
+    int closing;            /* mp_finish() / mp_abort() in progress */
+    time_t last_used;
+};
+
+static pthread_mutex_t mp_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mp_unpinned = PTHREAD_COND_INITIALIZER;
+
+static mp_upload_t *uploads[MP_MAX_UPLOADS];
+static uint64_t next_id = 0;
+
+static void free_upload(mp_upload_t *u)
+{
+    free(u->remote_path);
+    free(u->tmp_path);
+    free(u->ranges);
+    free(u);
+}
+
+/**
+ * @brief Drop uploads nobody has touched for MP_IDLE_SECS.
+ *
+ * Called with @c mp_lock held.
+ */
+static void expire_idle(void)
+{
+    time_t now = time(NULL);
+    for (int i = 0; i < MP_MAX_UPLOADS; i++)
+    {
+        mp_upload_t *u = uploads[i];
+        if (u && u->pins == 0 && !u->closing &&
+            now - u->last_used > MP_IDLE_SECS)
+        {
+            printf("Multipart upload %llu expired\n", (unsigned long long)u->id);
+            unlink(u->tmp_path);
+            free_upload(u);
+            uploads[i] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Find an open upload by id and path.
+ *
+ * Called with @c mp_lock held.
+ *
+ * @return Its slot in @c uploads, or -1.
+ */
+static int find_upload(uint64_t id, const char *remote_path)
+{
+    for (int i = 0; i < MP_MAX_UPLOADS; i++)
+    {
+        if (uploads[i] && uploads[i]->id == id &&
+            strcmp(uploads[i]->remote_path, remote_path) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Find an upload and take it out of service for closing.
+ *
+ * Waits until no part is being written. Called with @c mp_lock held.
+ *
+ * @return Its slot in @c uploads, or -1 if it is not open (or another
+ *         thread is already closing it).
+ */
+static int close_upload(uint64_t id, const char *remote_path)
+{
+    int i = find_upload(id, remote_path);
+    if (i < 0 || uploads[i]->closing)
+        return -1;
+
+    mp_upload_t *u = uploads[i];
+    u->closing = 1;
+    while (u->pins > 0)
+        pthread_cond_wait(&mp_unpinned, &mp_lock);
+    return i;
+}
+
+/**
+ * @brief Register a new upload.
+ */
+int mp_create(const char *remote_path, const char *tmp_path, uint64_t size,
+              uint64_t *id)
+{
+    mp_upload_t *u = calloc(1, sizeof(*u));
+    if (!u)
+        return -1;
+    u->remote_path = strdup(remote_path);
+    u->tmp_path = strdup(tmp_path);
+    if (!u->remote_path || !u->tmp_path)
+    {
+        free_upload(u);
+        return -1;
+    }
+    u->size = size;
+    u->last_used = time(NULL);
+
+    pthread_mutex_lock(&mp_lock);
+    expire_idle();
+
+    /* ids from a previous run of the server must not match new ones */
+    if (next_id == 0)
+        next_id = (uint64_t)time(NULL) << 20;
+
+    int slot = -1;
+    for (int i = 0; i < MP_MAX_UPLOADS && slot < 0; i++)
+    {
+        if (!uploads[i])
+            slot = i;
+    }
+    if (slot >= 0)
+    {
+        u->id = ++next_id;
+        uploads[slot] = u;
+        *id = u->id;
+    }
+    pthread_mutex_unlock(&mp_lock);
+
+    if (slot < 0)
+    {
+        free_upload(u);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Pin an open upload while a part is written into it.
+ */
+mp_upload_t *mp_get(uint64_t id, const char *remote_path)
+{
+    mp_upload_t *u = NULL;
+
+    pthread_mutex_lock(&mp_lock);
+    int i = find_upload(id, remote_path);
+    if (i >= 0 && !uploads[i]->closing)
+    {
+        u = uploads[i];
+        u->pins++;
+        u->last_used = time(NULL);
+    }
+    pthread_mutex_unlock(&mp_lock);
+    return u;
+}
+
+/**
+ * @brief Temp file of a pinned upload.
+ */
+const char *mp_tmp_path(const mp_upload_t *u)
+{
+    return u->tmp_path;
+}
+
+/**
+ * @brief Total size of a pinned upload.
+ */
+uint64_t mp_size(const mp_upload_t *u)
+{
+    return u->size;
+}
+
+/**
+ * @brief Record that a byte range has been written in full.
+ *
+ * The new range is merged with every range it overlaps or touches, so
+ * a complete upload ends up as the single range [0, size).
+ */
+int mp_add_range(mp_upload_t *u, uint64_t offset, uint64_t len)
+{
+    if (len == 0)
+        return 0;
+
+    uint64_t start = offset;
+    uint64_t end = offset + len;
+    int rc = 0;
+
+    pthread_mutex_lock(&mp_lock);
+
+    /* ranges [lo, hi) are absorbed by the new one */
+    size_t lo = 0;
+    while (lo < u->nranges && u->ranges[lo].end < start)
+        lo++;
+    size_t hi = lo;
+    while (hi < u->nranges && u->ranges[hi].start <= end)
+    {
+        if (u->ranges[hi].start < start)
+            start = u->ranges[hi].start;
+        if (u->ranges[hi].end > end)
+            end = u->ranges[hi].end;
+        hi++;
+    }
+
+    if (lo == hi && u->nranges == u->cap)
+    {
+        size_t cap = u->cap ? u->cap * 2 : 16;
+        range_t *r = realloc(u->ranges, cap * sizeof(*r));
+        if (!r)
+            rc = -1;
+        else
+        {
+            u->ranges = r;
+            u->cap = cap;
+        }
+    }
+
+    if (rc == 0)
+    {
+        /* replace ranges[lo, hi) by the one merged range */
+        memmove(&u->ranges[lo + 1], &u->ranges[hi],
+                (u->nranges - hi) * sizeof(range_t));
+        u->ranges[lo].start = start;
+        u->ranges[lo].end = end;
+        u->nranges = u->nranges - (hi - lo) + 1;
+    }
+
+    pthread_mutex_unlock(&mp_lock);
+    return rc;
+}
+
+/**
+ * @brief Release a pin taken by mp_get().
+ */
+void mp_put(mp_upload_t *u)
+{
+    pthread_mutex_lock(&mp_lock);
+    u->last_used = time(NULL);
+    if (--u->pins == 0 && u->closing)
+        pthread_cond_broadcast(&mp_unpinned);
+    pthread_mutex_unlock(&mp_lock);
+}
+
+/**
+ * @brief Close an upload for commit.
+ */
+int mp_finish(uint64_t id, const char *remote_path, char *tmp_path,
+              size_t tmp_size, uint64_t *size)
+{
+    pthread_mutex_lock(&mp_lock);
+    int i = close_upload(id, remote_path);
+    if (i < 0)
+    {
+        pthread_mutex_unlock(&mp_lock);
+        return -1;
+    }
+
+    mp_upload_t *u = uploads[i];
+    int complete = u->size == 0 ||
+                   (u->nranges == 1 && u->ranges[0].start == 0 &&
+                    u->ranges[0].end == u->size);
+    if (!complete)
+    {
+        u->closing = 0;
+        pthread_mutex_unlock(&mp_lock);
+        return 1;
+    }
+
+    uploads[i] = NULL;
+    pthread_mutex_unlock(&mp_lock);
+
+    snprintf(tmp_path, tmp_size, "%s", u->tmp_path);
+    *size = u->size;
+    free_upload(u);
+    return 0;
+}
+
+/**
+ * @brief Drop an upload and delete its temp file.
+ */
+int mp_abort(uint64_t id, const char *remote_path)
+{
+    pthread_mutex_lock(&mp_lock);
+    int i = close_upload(id, remote_path);
+    mp_upload_t *u = i >= 0 ? uploads[i] : NULL;
+    if (u)
+        uploads[i] = NULL;
+    pthread_mutex_unlock(&mp_lock);
+
+    if (!u)
+        return -1;
+    unlink(u->tmp_path);
+    free_upload(u);
+    return 0;
+}
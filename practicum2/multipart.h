@@ -0,0 +1,111 @@
+/*
+ * multipart.h -- multipart uploads: one file sent as parallel parts
+ *
+ * A client starts an upload with MPINI (remote path, total size) and
+ * gets back an upload id. It then sends byte ranges of the file with
+ * MPPUT, over as many connections as it likes and in any order; each
+ * part is written straight into the upload's temp file at its offset.
+ * MPEND commits the temp file as one new version once every byte has
+ * arrived, and MPABT throws the upload away.
+ *
+ * This module only keeps the registry of open uploads: which temp file
+ * belongs to which id, and which byte ranges have been received. A part
+ * counts only after it arrived whole (and, with a checksum, intact), so
+ * a part that failed half way is simply sent again. Sending a part
+ * twice is harmless.
+ *
+ * Uploads left idle for MP_IDLE_SECS are dropped, temp file and all.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef MULTIPART_H
+#define MULTIPART_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MP_MAX_UPLOADS 256   /* uploads open at once                  */
+#define MP_IDLE_SECS   600   /* idle time before an upload is dropped */
+
+typedef struct mp_upload mp_upload_t;
+
+/**
+ * @brief Register a new upload.
+ *
+ * @param remote_path Remote path the upload will commit to.
+ * @param tmp_path Temp file already created (and sized) for it.
+ * @param size Total file size in bytes.
+ * @param id Receives the upload id.
+ *
+ * @return 0 on success, or -1 if MP_MAX_UPLOADS are already open.
+ */
+int mp_create(const char *remote_path, const char *tmp_path, uint64_t size,
+              uint64_t *id);
+
+/**
+ * @brief Pin an open upload while a part is written into it.
+ *
+ * A pinned upload is not committed, aborted or expired until it is
+ * released with mp_put().
+ *
+ * @param id Upload id from mp_create().
+ * @param remote_path Must match the path the upload was created for.
+ *
+ * @return The upload, or NULL if no such upload is open.
+ */
+mp_upload_t *mp_get(uint64_t id, const char *remote_path);
+
+/** @brief Temp file of a pinned upload. */
+const char *mp_tmp_path(const mp_upload_t *u);
+
+/** @brief Total size of a pinned upload. */
+uint64_t mp_size(const mp_upload_t *u);
+
+/**
+ * @brief Record that a byte range has been written in full.
+ *
+ * @param u Pinned upload.
+ * @param offset First byte of the range.
+ * @param len Length of the range.
+ *
+ * @return 0 on success, or -1 on allocation failure.
+ */
+int mp_add_range(mp_upload_t *u, uint64_t offset, uint64_t len);
+
+/**
+ * @brief Release a pin taken by mp_get().
+ */
+void mp_put(mp_upload_t *u);
+
+/**
+ * @brief Close an upload for commit.
+ *
+ * Waits for parts still being written, then checks that every byte has
+ * arrived. If so the upload is removed from the registry and its temp
+ * file handed to the caller to commit; if not it stays open so the
+ * missing parts can still be sent.
+ *
+ * @param id Upload id.
+ * @param remote_path Must match the path the upload was created for.
+ * @param tmp_path Receives the temp file name on success.
+ * @param tmp_size Size of @p tmp_path.
+ * @param size Receives the file size on success.
+ *
+ * @return 0 if complete, 1 if parts are missing, or -1 if no such
+ *         upload is open.
+ */
+int mp_finish(uint64_t id, const char *remote_path, char *tmp_path,
+              size_t tmp_size, uint64_t *size);
+
+/**
+ * @brief Drop an upload and delete its temp file.
+ *
+ * @param id Upload id.
+ * @param remote_path Must match the path the upload was created for.
+ *
+ * @return 0 on success, or -1 if no such upload is open.
+ */
+int mp_abort(uint64_t id, const char *remote_path);
+
+#endif /* MULTIPART_H */
@@ -0,0 +1,273 @@
+/*
+ * protocol.c -- RFS v2 framing: header encoding, checksums, handshake
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "protocol.h"
+
+/**
+ * @brief Compute the 32-bit FNV-1a hash of a buffer.
+ *
+ * @param buf Bytes to hash.
+ * @param len Number of bytes.
+ *
+ * @return The hash value.
+ */
+uint32_t rfs_fnv32(const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t h = RFS_FNV32_INIT;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Fold a buffer into a running 64-bit FNV-1a hash.
+ *
+ * @param h Hash of the data seen so far (RFS_FNV64_INIT to start).
+ * @param buf Next bytes to hash.
+ * @param len Number of bytes.
+ *
+ * @return The updated hash value.
+ */
+uint64_t rfs_fnv64(uint64_t h, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * @brief Contribution of one entry to its directory's Merkle digest.
+ *
+ * FNV-1a-64 over the name, a type byte and the big-endian value.
+ */
+uint64_t rfs_tree_leaf(const char *name, size_t name_len, int is_dir,
+                       uint64_t value)
+{
+    uint8_t tail[9];
+    tail[0] = is_dir ? '/' : 0;
+    rfs_put_u64(tail + 1, value);
+    return rfs_fnv64(rfs_fnv64(RFS_FNV64_INIT, name, name_len), tail, sizeof(tail));
+}
+
+void rfs_put_u64(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--)
+    {
+        p[i] = (uint8_t)(v & 0xff);
+        v >>= 8;
+    }
+}
+
+uint64_t rfs_get_u64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    uint32_t net = htonl(v);
+    memcpy(p, &net, 4);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    uint32_t net;
+    memcpy(&net, p, 4);
+    return ntohl(net);
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    uint16_t net = htons(v);
+    memcpy(p, &net, 2);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    uint16_t net;
+    memcpy(&net, p, 2);
+    return ntohs(net);
+}
+
+/**
+ * @brief Encode a v2 request header into a buffer.
+ *
+ * @param hdr Receives RFS_REQ_HDR_LEN bytes.
+ * @param req Header fields, including @c path_len.
+ */
+void rfs_encode_request(uint8_t *hdr, const rfs_req_t *req)
+{
+    memcpy(hdr, req->cmd, 5);
+    hdr[5] = RFS_PROTO_V2;
+    put_u16(hdr + 6, req->flags);
+    put_u32(hdr + 8, req->path_len);
+    rfs_put_u64(hdr + 12, req->payload_len);
+    rfs_put_u64(hdr + 20, req->arg);
+    put_u32(hdr + 28, rfs_fnv32(hdr, 28));
+}
+
+/**
+ * @brief Decode and validate a v2 response header from a buffer.
+ *
+ * @param hdr RFS_RESP_HDR_LEN received bytes.
+ * @param resp Receives the decoded header.
+ *
+ * @return 0 on success, or -1 if the checksum or version is wrong.
+ */
+int rfs_decode_response(const uint8_t *hdr, rfs_resp_t *resp)
+{
+    if (get_u32(hdr + 24) != rfs_fnv32(hdr, 24) || hdr[6] != RFS_PROTO_V2)
+        return -1;
+
+    resp->status      = get_u32(hdr);
+    resp->flags       = get_u16(hdr + 4);
+    resp->payload_len = rfs_get_u64(hdr + 8);
+    resp->arg         = rfs_get_u64(hdr + 16);
+    return 0;
+}
+
+/**
+ * @brief Send a v2 request header followed by the path.
+ *
+ * @param sockfd Connected socket.
+ * @param req Header fields; @c path_len is set from @p path.
+ * @param path Remote path (may be empty, not NULL).
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int rfs_send_request(int sockfd, rfs_req_t *req, const char *path)
+{
+    uint8_t hdr[RFS_REQ_HDR_LEN];
+
+    req->path_len = (uint32_t)strlen(path);
+    rfs_encode_request(hdr, req);
+
+    if (send_all(sockfd, hdr, sizeof(hdr)) < 0 ||
+        send_all(sockfd, path, req->path_len) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Receive and validate a v2 request header.
+ *
+ * @param sockfd Connected socket.
+ * @param req Receives the decoded header.
+ *
+ * @return 0 on success, -1 if the connection closed or failed, or
+ *         -2 if the header checksum or version is wrong.
+ */
+int rfs_recv_request(int sockfd, rfs_req_t *req)
+{
+    uint8_t hdr[RFS_REQ_HDR_LEN];
+
+    if (recv_all(sockfd, hdr, sizeof(hdr)) < 0)
+        return -1;
+
+    if (get_u32(hdr + 28) != rfs_fnv32(hdr, 28) || hdr[5] != RFS_PROTO_V2)
+        return -2;
+
+    memcpy(req->cmd, hdr, 5);
+    req->flags       = get_u16(hdr + 6);
+    req->path_len    = get_u32(hdr + 8);
+    req->payload_len = rfs_get_u64(hdr + 12);
+    req->arg         = rfs_get_u64(hdr + 20);
+    return 0;
+}
+
+/**
+ * @brief Send a v2 response header.
+ *
+ * @param sockfd Connected socket.
+ * @param resp Header fields to send.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int rfs_send_response(int sockfd, const rfs_resp_t *resp)
+{
+    uint8_t hdr[RFS_RESP_HDR_LEN];
+
+    put_u32(hdr, resp->status);
+    put_u16(hdr + 4, resp->flags);
+    hdr[6] = RFS_PROTO_V2;
+    hdr[7] = 0;
+    rfs_put_u64(hdr + 8, resp->payload_len);
+    rfs_put_u64(hdr + 16, resp->arg);
+    put_u32(hdr + 24, rfs_fnv32(hdr, 24));
+
+    return send_all(sockfd, hdr, sizeof(hdr));
+}
+
+/**
+ * @brief Receive and validate a v2 response header.
+ *
+ * @param sockfd Connected socket.
+ * @param resp Receives the decoded header.
+ *
+ * @return 0 on success, or -1 on error or bad checksum.
+ */
+int rfs_recv_response(int sockfd, rfs_resp_t *resp)
+{
+    uint8_t hdr[RFS_RESP_HDR_LEN];
+
+    if (recv_all(sockfd, hdr, sizeof(hdr)) < 0)
+        return -1;
+
+    if (rfs_decode_response(hdr, resp) < 0)
+    {
+        fprintf(stderr, "rfs_recv_response: corrupt response header\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Client side of the version handshake.
+ *
+ * @param sockfd Freshly connected socket.
+ *
+ * @return The negotiated version, or -1 on failure.
+ */
+int rfs_client_hello(int sockfd)
+{
+    uint8_t msg[9];
+    memcpy(msg, "HELLO", 5);
+    put_u32(msg + 5, RFS_PROTO_MAX);
+
+    if (send_all(sockfd, msg, sizeof(msg)) < 0)
+        return -1;
+
+    uint8_t reply[4];
+    if (recv_all(sockfd, reply, sizeof(reply)) < 0)
+    {
+        fprintf(stderr, "Server does not support protocol v2\n");
+        return -1;
+    }
+
+    uint32_t version = get_u32(reply);
+    if (version < RFS_PROTO_V2 || version > RFS_PROTO_MAX)
+    {
+        fprintf(stderr, "Server chose unsupported protocol version %u\n", version);
+        return -1;
+    }
+    return (int)version;
+}
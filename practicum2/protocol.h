@@ -0,0 +1,296 @@
+/*
+ * protocol.h -- RFS wire protocol shared by the client and server
+ *
+ * Version 1 (legacy): a fixed 5-byte command followed by
+ * command-specific uint32 fields; one request per connection. Sizes
+ * are limited to 4 GB.
+ *
+ * Version 2: the client opens with the 5-byte command "HELLO" and a
+ * uint32 holding the highest version it speaks; the server answers
+ * with the uint32 version it picked. After that the connection carries
+ * any number of framed requests, each answered by one framed response:
+ *
+ *   request  (RFS_REQ_HDR_LEN = 32 bytes, then path, then payload)
+ *     0  cmd[5]        same command names as v1 ("WRITE", "GET  ", ...)
+ *     5  version       RFS_PROTO_V2
+ *     6  flags         uint16, RFS_F_* bits
+ *     8  path_len      uint32
+ *    12  payload_len   uint64
+ *    20  arg           uint64, command-specific argument
+ *    28  checksum      uint32, FNV-1a of bytes 0..27
+ *
+ *   response (RFS_RESP_HDR_LEN = 28 bytes, then payload)
+ *     0  status        uint32, RFS_OK or RFS_ERR_*
+ *     4  flags         uint16, RFS_F_* bits
+ *     6  version       RFS_PROTO_V2
+ *     7  reserved      0
+ *     8  payload_len   uint64
+ *    16  arg           uint64, command-specific result
+ *    24  checksum      uint32, FNV-1a of bytes 0..23
+ *
+ * All integers are big-endian. Payloads are streamed, so neither side
+ * ever needs to hold a whole file in memory. If RFS_F_DATA_SUM is set
+ * the payload is followed by an 8-byte FNV-1a-64 of the payload bytes.
+ *
+ * STAT and LIST (v2 only) answer from the server's metadata index. The
+ * reply payload is a sequence of entries (one for STAT, resp.arg of
+ * them for LIST), each:
+ *
+ *   uint32 path_len, path bytes, then RFS_ENTRY_FIXED bytes:
+ *   uint32 version, uint32 flags (RFS_ENTRY_CHECKSUM), uint64 size,
+ *   int64 mtime in ns since the epoch, uint64 FNV-1a-64 checksum
+ *
+ * LSDIR (v2 only) lists one directory a page at a time. The request arg
+ * is the continuation token from the previous reply (0 to start) and
+ * an optional 4-byte payload holds the page size in entries. The reply
+ * carries entries in the format above, named relative to the directory
+ * (RFS_ENTRY_DIR marks subdirectories; version is the number of stored
+ * versions), and resp.arg is the token for the next page, or 0 once the
+ * listing is complete. Tokens are opaque and stay valid across
+ * connections; entries come in directory order, not sorted.
+ *
+ * Conditional GET (v2 only): with RFS_F_IF_NONE_MATCH set, req.arg is
+ * the FNV-1a-64 checksum of the copy the client already holds. If the
+ * file still has that checksum the server answers RFS_NOT_MODIFIED with
+ * no payload (resp.arg echoes the checksum); otherwise it replies as to
+ * a plain GET.
+ *
+ * Delta upload (v2 only, see delta.h): SIGS replies with the block
+ * signatures of the current version of a file. DELTA carries a payload
+ * of block references and literal data built against them, with
+ * RFS_F_DATA_SUM; the server rebuilds and commits the new version, or
+ * answers RFS_ERR_STALE if the current version changed in between.
+ *
+ * TREE (v2 only) describes one directory for a tree comparison. resp.arg
+ * is the directory's Merkle digest (see rfs_tree_leaf()) and the payload
+ * holds its entries in the STAT format, named relative to it: files with
+ * their checksum, and non-empty subdirectories (RFS_ENTRY_DIR) with
+ * their digest as the checksum and their file count as the size. A
+ * directory without files is RFS_ERR_NOT_FOUND.
+ *
+ * Multipart upload (v2 only, see multipart.h): MPINI (arg = total size)
+ * replies with an upload id in resp.arg. Each MPPUT carries arg = id
+ * and a payload of a uint64 offset followed by the part's bytes; with
+ * RFS_F_DATA_SUM the trailing checksum covers the part's bytes only.
+ * MPEND (arg = id) commits the file as one new version, and MPABT
+ * (arg = id) abandons it.
+ *
+ * COPY and MOVE (v2 only) act on a file and all of its versions. The
+ * request path is the source and the payload is the destination path.
+ * resp.arg is the number of versions copied or moved. A destination
+ * that already exists is RFS_ERR_EXISTS, and a directory source is
+ * RFS_ERR_BAD_REQUEST.
+ *
+ * APPND and PATCH (v2 only) send only the bytes that change, with
+ * RFS_F_DATA_SUM. APPND adds the payload to the end of the current
+ * version in place, so the version number stays the same. A missing
+ * file is created. PATCH (arg = offset, at most the current size)
+ * overwrites part of the file, or extends it, as a new version. Both
+ * reply with the new file size in resp.arg.
+ *
+ * STATS (v2 only, empty path, arg = most entries wanted or 0 for all)
+ * reports the most requested paths. resp.arg is the number of entries.
+ * The payload is the total requests and bytes recorded (uint64 each),
+ * then per entry: uint32 path_len, path, uint64 requests, uint64
+ * bytes, most requested first. Counts are estimates (stats.h).
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RFS_PROTO_V1 1
+#define RFS_PROTO_V2 2
+#define RFS_PROTO_MAX RFS_PROTO_V2
+
+#define RFS_REQ_HDR_LEN  32
+#define RFS_RESP_HDR_LEN 28
+
+#define RFS_MAX_PATH  1024        /* longest remote path, including NUL */
+#define RFS_IO_CHUNK  (64 * 1024) /* streaming buffer size              */
+
+/* Header flags */
+#define RFS_F_DATA_SUM 0x0001     /* payload followed by FNV-1a-64 sum  */
+#define RFS_F_EVENT    0x0002     /* unsolicited WATCH event (watch.h)  */
+#define RFS_F_IF_NONE_MATCH 0x0004 /* GET: arg is the client's checksum */
+
+/* STAT / LIST entries */
+#define RFS_ENTRY_FIXED    32     /* bytes after the path in an entry   */
+#define RFS_ENTRY_CHECKSUM 0x1    /* entry's checksum field is valid    */
+#define RFS_ENTRY_DIR      0x2    /* LSDIR entry is a subdirectory      */
+
+/* WATCH event types (see watch.h for the event payload) */
+#define RFS_EV_WRITE 1
+#define RFS_EV_RM    2
+
+/* SNAP argument */
+#define RFS_SNAP_DELETE 1
+
+/* v2 response status codes */
+#define RFS_OK              0
+#define RFS_ERR_NOT_FOUND   1
+#define RFS_ERR_NOT_EMPTY   2
+#define RFS_ERR_TOO_LARGE   3
+#define RFS_ERR_IO          4
+#define RFS_ERR_BAD_REQUEST 5
+#define RFS_ERR_CHECKSUM    6
+#define RFS_ERR_UNSUPPORTED 7
+#define RFS_ERR_EXISTS      8
+#define RFS_ERR_READ_ONLY   9
+#define RFS_ERR_BUSY        10    /* server limit reached; retry later  */
+#define RFS_ERR_INCOMPLETE  11    /* MPEND before every part arrived    */
+#define RFS_NOT_MODIFIED    12    /* conditional GET: client copy is current */
+#define RFS_ERR_STALE       13    /* DELTA base is no longer the current version */
+
+/* FNV-1a parameters; the 64-bit form can be updated incrementally. */
+#define RFS_FNV32_INIT 0x811c9dc5u
+#define RFS_FNV64_INIT 0xcbf29ce484222325ull
+
+typedef struct
+{
+    char     cmd[5];
+    uint16_t flags;
+    uint32_t path_len;
+    uint64_t payload_len;
+    uint64_t arg;
+} rfs_req_t;
+
+typedef struct
+{
+    uint32_t status;
+    uint16_t flags;
+    uint64_t payload_len;
+    uint64_t arg;
+} rfs_resp_t;
+
+/* Provided by the program linking this module (rfs.c / server.c). */
+int send_all(int sockfd, const void *buf, size_t len);
+int recv_all(int sockfd, void *buf, size_t len);
+
+/**
+ * @brief Compute the 32-bit FNV-1a hash of a buffer.
+ *
+ * @param buf Bytes to hash.
+ * @param len Number of bytes.
+ *
+ * @return The hash value.
+ */
+uint32_t rfs_fnv32(const void *buf, size_t len);
+
+/**
+ * @brief Fold a buffer into a running 64-bit FNV-1a hash.
+ *
+ * Start with RFS_FNV64_INIT and feed consecutive pieces of the data;
+ * the result is the same as hashing everything in one call.
+ *
+ * @param h Hash of the data seen so far.
+ * @param buf Next bytes to hash.
+ * @param len Number of bytes.
+ *
+ * @return The updated hash value.
+ */
+uint64_t rfs_fnv64(uint64_t h, const void *buf, size_t len);
+
+/**
+ * @brief Contribution of one entry to its directory's Merkle digest.
+ *
+ * A directory's digest is the sum (mod 2^64) of this value over its
+ * files and its non-empty subdirectories, so it can be updated in
+ * place when one entry changes. Client and server must agree on it.
+ *
+ * @param name Entry name (one path component, not NUL-terminated).
+ * @param name_len Length of @p name.
+ * @param is_dir Non-zero for a subdirectory.
+ * @param value File checksum, or the subdirectory's digest.
+ *
+ * @return The leaf hash.
+ */
+uint64_t rfs_tree_leaf(const char *name, size_t name_len, int is_dir,
+                       uint64_t value);
+
+/** @brief Store @p v big-endian at @p p. */
+void rfs_put_u64(uint8_t *p, uint64_t v);
+
+/** @brief Load a big-endian uint64 from @p p. */
+uint64_t rfs_get_u64(const uint8_t *p);
+
+/**
+ * @brief Encode a v2 request header into a buffer.
+ *
+ * For callers that build requests in memory (librfs's async event
+ * loop) rather than sending them straight to a blocking socket.
+ *
+ * @param hdr Receives RFS_REQ_HDR_LEN bytes.
+ * @param req Header fields, including @c path_len.
+ */
+void rfs_encode_request(uint8_t *hdr, const rfs_req_t *req);
+
+/**
+ * @brief Decode and validate a v2 response header from a buffer.
+ *
+ * @param hdr RFS_RESP_HDR_LEN received bytes.
+ * @param resp Receives the decoded header.
+ *
+ * @return 0 on success, or -1 if the checksum or version is wrong.
+ */
+int rfs_decode_response(const uint8_t *hdr, rfs_resp_t *resp);
+
+/**
+ * @brief Send a v2 request header followed by the path.
+ *
+ * @param sockfd Connected socket.
+ * @param req Header fields; @c path_len is taken from @p path.
+ * @param path Remote path (may be empty, not NULL).
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int rfs_send_request(int sockfd, rfs_req_t *req, const char *path);
+
+/**
+ * @brief Receive and validate a v2 request header.
+ *
+ * @param sockfd Connected socket.
+ * @param req Receives the decoded header.
+ *
+ * @return 0 on success, -1 if the connection closed or failed, or
+ *         -2 if the header checksum or version is wrong.
+ */
+int rfs_recv_request(int sockfd, rfs_req_t *req);
+
+/**
+ * @brief Send a v2 response header.
+ *
+ * @param sockfd Connected socket.
+ * @param resp Header fields to send.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int rfs_send_response(int sockfd, const rfs_resp_t *resp);
+
+/**
+ * @brief Receive and validate a v2 response header.
+ *
+ * @param sockfd Connected socket.
+ * @param resp Receives the decoded header.
+ *
+ * @return 0 on success, or -1 on error or bad checksum.
+ */
+int rfs_recv_response(int sockfd, rfs_resp_t *resp);
+
+/**
+ * @brief Client side of the version handshake.
+ *
+ * Sends "HELLO" with RFS_PROTO_MAX and reads the server's choice.
+ *
+ * @param sockfd Freshly connected socket.
+ *
+ * @return The negotiated version (>= RFS_PROTO_V2), or -1 if the
+ *         server does not speak v2 or the exchange failed.
+ */
+int rfs_client_hello(int sockfd);
+
+#endif /* PROTOCOL_H */
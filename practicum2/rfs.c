@@ -6,15 +6,29 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
 
 #include "rfs.h"
+#include "local.h"
+#include "protocol.h"
+#include "cache.h"
+#include "delta.h"
+#include "timing.h"
 
 /*------------------------------------------------------------*/
 /*                   Utility Functions                        */
@@ -117,10 +131,65 @@ const char *basename_const(const char *path)
 }
 
 /**
- * @brief Establish a TCP connection to the remote file system server.
+ * @brief Server address: RFS_HOST from the environment, or SERVER_IP.
+ */
+static const char *server_host(void)
+{
+    const char *env = getenv("RFS_HOST");
+    return (env && env[0]) ? env : SERVER_IP;
+}
+
+/**
+ * @brief Server port: RFS_PORT from the environment, or SERVER_PORT.
+ */
+static int server_port(void)
+{
+    const char *env = getenv("RFS_PORT");
+    int port = env ? atoi(env) : 0;
+    return (port > 0 && port <= 65535) ? port : SERVER_PORT;
+}
+
+/**
+ * @brief Try to reach a same-host server through its Unix socket.
+ *
+ * @return A connected AF_UNIX socket, or -1 if the server is not
+ *         local or is not listening on RFS_UNIX_PATH.
+ */
+static int connect_local(void)
+{
+    const char *transport = getenv("RFS_TRANSPORT");
+    if ((transport && strcmp(transport, "tcp") == 0) ||
+        server_port() != SERVER_PORT)
+        return -1;
+
+    if (!ip_is_local(server_host()))
+        return -1;
+
+    int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sockfd < 0)
+        return -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", RFS_UNIX_PATH);
+
+    if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+/**
+ * @brief Establish a connection to the remote file system server.
  *
- * This function creates a TCP socket, populates a sockaddr_in using
- * SERVER_IP and SERVER_PORT (from rfs.h), and calls connect(2).
+ * A server on this host is reached through its Unix socket when
+ * possible (see connect_local()); otherwise this function creates a
+ * TCP socket, populates a sockaddr_in with the server address and
+ * port (SERVER_IP and SERVER_PORT from rfs.h, unless RFS_HOST or
+ * RFS_PORT override them), and calls connect(2).
  *
  * On success, the caller is responsible for closing the returned
  * socket descriptor.
@@ -130,6 +199,10 @@ const char *basename_const(const char *path)
  */
 int connect_to_server(void)
 {
+    int local = connect_local();
+    if (local >= 0)
+        return local;
+
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0)
     {
@@ -141,9 +214,9 @@ int connect_to_server(void)
     memset(&server_addr, 0, sizeof(server_addr));
 
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port   = htons(SERVER_PORT);
+    server_addr.sin_port   = htons((uint16_t)server_port());
 
-    if (inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr) <= 0)
+    if (inet_pton(AF_INET, server_host(), &server_addr.sin_addr) <= 0)
     {
         perror("inet_pton");
         close(sockfd);
@@ -158,180 +231,1048 @@ int connect_to_server(void)
         return -1;
     }
 
+    /* requests are a header, a path and a payload in separate writes */
+    int one = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    return sockfd;
+}
+
+/**
+ * @brief Connect to the server and negotiate protocol v2.
+ *
+ * @return A connected socket ready for framed requests, or -1 on
+ *         error (any created socket is closed).
+ */
+int open_session(void)
+{
+    double start = timing_on ? timing_now() : 0;
+    int sockfd = connect_to_server();
+    if (sockfd < 0)
+        return -1;
+
+    if (rfs_client_hello(sockfd) < 0)
+    {
+        close(sockfd);
+        return -1;
+    }
+    timing_connected(start);
     return sockfd;
 }
 
+/**
+ * @brief Build and send a v2 request header plus path.
+ *
+ * @param sockfd Session socket from open_session().
+ * @param cmd 5-byte command name.
+ * @param flags RFS_F_* bits.
+ * @param path Remote path ("" for commands without one).
+ * @param payload_len Number of payload bytes the caller will send.
+ * @param arg Command-specific argument.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int send_request(int sockfd, const char *cmd, uint16_t flags,
+                        const char *path, uint64_t payload_len, uint64_t arg)
+{
+    rfs_req_t req;
+    memcpy(req.cmd, cmd, 5);
+    req.flags       = flags;
+    req.payload_len = payload_len;
+    req.arg         = arg;
+    if (rfs_send_request(sockfd, &req, path) < 0)
+        return -1;
+    timing_sent();
+    return 0;
+}
+
+/**
+ * @brief Receive a response header (and note it for --stats).
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int recv_response(int sockfd, rfs_resp_t *resp)
+{
+    if (rfs_recv_response(sockfd, resp) < 0)
+        return -1;
+    timing_reply();
+    return 0;
+}
+
+/**
+ * @brief Stream a local file to the server as a request payload.
+ *
+ * The file is read through one RFS_IO_CHUNK buffer and followed by
+ * its FNV-1a-64 checksum (the request must carry RFS_F_DATA_SUM).
+ * Reads use pread(), so several threads may send ranges of the same
+ * descriptor at once.
+ *
+ * The kernel is asked to read up to two IO_WINDOWs ahead of the
+ * send, so the disk fills the page cache while earlier chunks are
+ * on the wire and pread() rarely waits for the device.
+ *
+ * @param sockfd Session socket.
+ * @param fd Open local file.
+ * @param offset First byte of the file to send.
+ * @param len Number of bytes announced in the request header.
+ *
+ * @return 0 on success, or -1 on I/O or networking error.
+ */
+static int send_file_data(int sockfd, int fd, uint64_t offset, uint64_t len)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    uint64_t sum = RFS_FNV64_INIT;
+    uint64_t done = 0;
+    uint64_t hinted = 0;        /* bytes of the range already hinted */
+
+    posix_fadvise(fd, (off_t)offset, (off_t)len, POSIX_FADV_SEQUENTIAL);
+    while (done < len)
+    {
+        if (hinted < len && hinted < done + IO_WINDOW)
+        {
+            uint64_t step = len - hinted < IO_WINDOW ? len - hinted : IO_WINDOW;
+            posix_fadvise(fd, (off_t)(offset + hinted), (off_t)step,
+                          POSIX_FADV_WILLNEED);
+            hinted += step;
+            continue;
+        }
+
+        size_t want = (len - done) < sizeof(buf) ? (size_t)(len - done) : sizeof(buf);
+        double read_start = timing_on ? timing_now() : 0;
+        ssize_t n = pread(fd, buf, want, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            fprintf(stderr, "Short read of local file\n");
+            return -1;
+        }
+        double read_sec = timing_on ? timing_now() - read_start : 0;
+        sum = rfs_fnv64(sum, buf, (size_t)n);
+        if (send_all(sockfd, buf, (size_t)n) < 0)
+            return -1;
+        timing_data((uint64_t)n, read_sec);
+        done += (uint64_t)n;
+    }
+
+    uint8_t trailer[8];
+    rfs_put_u64(trailer, sum);
+    if (send_all(sockfd, trailer, 8) < 0)
+        return -1;
+    timing_sent();
+    return 0;
+}
+
+/**
+ * @brief Receive a response payload into a local file.
+ *
+ * Data moves through one RFS_IO_CHUNK buffer. If the response
+ * carries RFS_F_DATA_SUM, the trailing checksum is verified.
+ * Writeback of each completed IO_WINDOW is started at once and the
+ * window before it is waited for, so the disk writes while the next
+ * window arrives and at most two windows are ever dirty, however
+ * large the file.
+ *
+ * @param sockfd Session socket.
+ * @param resp Response header describing the payload.
+ * @param fd Open local file to write to.
+ * @param sum_out If non-NULL, receives the FNV-1a-64 of the payload.
+ *
+ * @return 0 on success, 1 on a local write error or checksum
+ *         mismatch, or -1 on networking error.
+ */
+static int recv_file_data(int sockfd, const rfs_resp_t *resp, int fd,
+                          uint64_t *sum_out)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    uint64_t sum = RFS_FNV64_INIT;
+    uint64_t left = resp->payload_len;
+    uint64_t written = 0;
+    uint64_t flushed = 0;       /* bytes whose writeback was started */
+    uint64_t prev = 0;          /* start of the window still in flight */
+    int failed = 0;
+
+    while (left > 0)
+    {
+        size_t chunk = left < sizeof(buf) ? (size_t)left : sizeof(buf);
+        if (recv_all(sockfd, buf, chunk) < 0)
+            return -1;
+        sum = rfs_fnv64(sum, buf, chunk);
+        double write_start = timing_on ? timing_now() : 0;
+        if (!failed)
+        {
+            size_t off = 0;
+            while (off < chunk)
+            {
+                ssize_t n = write(fd, buf + off, chunk - off);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                {
+                    perror("write local");
+                    failed = 1;
+                    break;
+                }
+                off += (size_t)n;
+            }
+            written += off;
+            if (written - flushed >= IO_WINDOW)
+            {
+                sync_file_range(fd, (off64_t)flushed, (off64_t)(written - flushed),
+                                SYNC_FILE_RANGE_WRITE);
+                if (flushed > 0)
+                    sync_file_range(fd, (off64_t)prev, (off64_t)(flushed - prev),
+                                    SYNC_FILE_RANGE_WAIT_BEFORE |
+                                    SYNC_FILE_RANGE_WRITE |
+                                    SYNC_FILE_RANGE_WAIT_AFTER);
+                prev = flushed;
+                flushed = written;
+            }
+        }
+        timing_data(chunk, timing_on ? timing_now() - write_start : 0);
+        left -= chunk;
+    }
+
+    if (resp->flags & RFS_F_DATA_SUM)
+    {
+        uint8_t trailer[8];
+        if (recv_all(sockfd, trailer, 8) < 0)
+            return -1;
+        if (rfs_get_u64(trailer) != sum)
+        {
+            fprintf(stderr, "GET error: checksum mismatch\n");
+            failed = 1;
+        }
+    }
+    if (sum_out)
+        *sum_out = sum;
+    return failed;
+}
+
+/* One decoded STAT / LIST / LSDIR entry (layout in protocol.h). */
+typedef struct
+{
+    char path[RFS_MAX_PATH];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t checksum;
+} entry_t;
+
+/**
+ * @brief Receive one STAT / LIST / LSDIR entry.
+ *
+ * @param sockfd Connected socket positioned at an entry.
+ * @param e Receives the decoded entry.
+ * @param left Payload bytes remaining; decremented by the entry size.
+ *
+ * @return 0 on success, or -1 on error or a malformed entry.
+ */
+static int recv_entry(int sockfd, entry_t *e, uint64_t *left)
+{
+    uint32_t path_len;
+    uint8_t fixed[RFS_ENTRY_FIXED];
+
+    if (*left < 4 || recv_all(sockfd, &path_len, 4) < 0)
+        return -1;
+    path_len = ntohl(path_len);
+    if (path_len >= sizeof(e->path) || *left < 4 + (uint64_t)path_len + sizeof(fixed))
+        return -1;
+
+    if (recv_all(sockfd, e->path, path_len) < 0 ||
+        recv_all(sockfd, fixed, sizeof(fixed)) < 0)
+        return -1;
+    e->path[path_len] = '\0';
+    *left -= 4 + (uint64_t)path_len + sizeof(fixed);
+
+    uint32_t v;
+    memcpy(&v, fixed, 4);
+    e->version = ntohl(v);
+    memcpy(&v, fixed + 4, 4);
+    e->flags = ntohl(v);
+    e->size     = rfs_get_u64(fixed + 8);
+    e->mtime_ns = (int64_t)rfs_get_u64(fixed + 16);
+    e->checksum = rfs_get_u64(fixed + 24);
+    return 0;
+}
+
+/**
+ * @brief Format an entry's mtime like LS does.
+ */
+static void format_mtime(const entry_t *e, char *buf, size_t size)
+{
+    time_t t = (time_t)(e->mtime_ns / 1000000000LL);
+    struct tm tm_buf;
+    localtime_r(&t, &tm_buf);
+    strftime(buf, size, "%Y-%m-%d %H:%M:%S", &tm_buf);
+}
+
 /*------------------------------------------------------------*/
 /*                         WRITE                              */
 /*------------------------------------------------------------*/
 
+/* Shared state of one multipart upload (see write_multipart()). */
+typedef struct
+{
+    int fd;                     /* local file, read with pread()      */
+    const char *remote_path;
+    uint64_t id;                /* upload id from MPINI               */
+    uint64_t size;
+    uint64_t nparts;
+    pthread_mutex_t lock;
+    uint64_t next_part;         /* next part nobody has taken yet     */
+    int failed;
+    unsigned retries;           /* part attempts that had to be redone */
+} upload_t;
+
 /**
- * @brief Implement the WRITE client command.
+ * @brief Send one part of a multipart upload and wait for the reply.
  *
- * Reads the contents of @p local_path into memory, connects to the
- * remote server, and sends a WRITE request containing @p remote_path
- * and the file data. The server is expected to store the file under
- * the given remote path, possibly creating a versioned file.
+ * @param sockfd Session socket.
+ * @param up Upload the part belongs to.
+ * @param part Part number.
  *
- * @param local_path Path to the local file to be uploaded.
- * @param remote_path Remote file path under which the server should
- *                    store the uploaded file.
+ * @return 0 on success, 1 if the server refused the part for good, 2
+ *         if it may succeed when sent again, or -1 if the connection
+ *         failed.
+ */
+static int send_part(int sockfd, upload_t *up, uint64_t part)
+{
+    uint64_t offset = part * UPLOAD_PART_SIZE;
+    uint64_t len = up->size - offset < UPLOAD_PART_SIZE ?
+                   up->size - offset : UPLOAD_PART_SIZE;
+
+    uint8_t off_buf[8];
+    rfs_put_u64(off_buf, offset);
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, "MPPUT", RFS_F_DATA_SUM, up->remote_path,
+                     8 + len, up->id) < 0 ||
+        send_all(sockfd, off_buf, 8) < 0 ||
+        send_file_data(sockfd, up->fd, offset, len) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+        return -1;
+
+    if (resp.status == RFS_OK)
+        return 0;
+    if (resp.status == RFS_ERR_CHECKSUM || resp.status == RFS_ERR_IO)
+        return 2;
+    fprintf(stderr, "WRITE error: part %llu refused (status=%u)\n",
+            (unsigned long long)part, resp.status);
+    return 1;
+}
+
+/**
+ * @brief Upload thread: take parts until none are left.
  *
- * @return 0 on success, or 1 on any error (I/O, allocation, or
- *         networking).
+ * Each thread has its own session. A part that fails is sent again, on
+ * a new connection if the old one broke, up to UPLOAD_PART_TRIES times
+ * with a growing pause in between; after that the whole upload fails.
+ *
+ * @param arg The shared upload_t.
+ *
+ * @return NULL.
  */
-int do_write(const char *local_path, const char *remote_path)
+static void *upload_worker(void *arg)
 {
-    FILE *fp = fopen(local_path, "rb");
-    if (!fp)
+    upload_t *up = (upload_t *)arg;
+    int sockfd = -1;
+
+    while (1)
     {
-        perror("fopen local file");
-        return 1;
+        pthread_mutex_lock(&up->lock);
+        uint64_t part = up->next_part;
+        int done = up->failed || part >= up->nparts;
+        if (!done)
+            up->next_part++;
+        pthread_mutex_unlock(&up->lock);
+        if (done)
+            break;
+
+        int rc = -1;
+        for (int attempt = 0; attempt < UPLOAD_PART_TRIES; attempt++)
+        {
+            if (attempt > 0)
+            {
+                pthread_mutex_lock(&up->lock);
+                up->retries++;
+                pthread_mutex_unlock(&up->lock);
+                usleep(100000u << attempt);
+            }
+            if (sockfd < 0 && (sockfd = open_session()) < 0)
+                continue;
+
+            rc = send_part(sockfd, up, part);
+            if (rc < 0)
+            {
+                close(sockfd);
+                sockfd = -1;
+            }
+            if (rc == 0 || rc == 1)
+                break;
+        }
+
+        if (rc != 0)
+        {
+            pthread_mutex_lock(&up->lock);
+            up->failed = 1;
+            pthread_mutex_unlock(&up->lock);
+            break;
+        }
     }
 
-    if (fseek(fp, 0, SEEK_END) != 0)
+    if (sockfd >= 0)
+        close(sockfd);
+    return NULL;
+}
+
+/**
+ * @brief Upload a file as parts sent in parallel over @p streams
+ *        connections (MPINI / MPPUT / MPEND).
+ *
+ * The upload is started and committed on @p sockfd; the parts go over
+ * @p streams sessions of their own, each taking the next unsent part
+ * until none are left, so a slow connection simply sends fewer parts.
+ * On failure the upload is abandoned with MPABT.
+ *
+ * @param sockfd Session socket used to start and commit the upload.
+ * @param fd Open local file.
+ * @param file_size Size of the local file.
+ * @param remote_path Remote path to store the file under.
+ * @param streams Number of parallel connections.
+ *
+ * @return 0 on success, or 1 on error.
+ */
+static int write_multipart(int sockfd, int fd, uint64_t file_size,
+                           const char *remote_path, int streams)
+{
+    rfs_resp_t resp;
+    if (send_request(sockfd, "MPINI", 0, remote_path, 0, file_size) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+        return 1;
+    if (resp.status != RFS_OK)
     {
-        perror("fseek");
-        fclose(fp);
+        fprintf(stderr, "WRITE error: server could not start upload of '%s' "
+                "(status=%u)\n", remote_path, resp.status);
         return 1;
     }
 
-    long file_size_long = ftell(fp);
-    if (file_size_long < 0 || file_size_long > (long)UINT32_MAX)
+    upload_t up;
+    memset(&up, 0, sizeof(up));
+    up.fd = fd;
+    up.remote_path = remote_path;
+    up.id = resp.arg;
+    up.size = file_size;
+    up.nparts = (file_size + UPLOAD_PART_SIZE - 1) / UPLOAD_PART_SIZE;
+    pthread_mutex_init(&up.lock, NULL);
+
+    if ((uint64_t)streams > up.nparts)
+        streams = (int)up.nparts;
+
+    pthread_t threads[UPLOAD_MAX_STREAMS];
+    int started = 0;
+    for (int i = 0; i < streams; i++)
     {
-        fprintf(stderr, "File too large or ftell error\n");
-        fclose(fp);
+        if (pthread_create(&threads[started], NULL, upload_worker, &up) == 0)
+            started++;
+    }
+    if (started == 0)
+        up.failed = 1;
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&up.lock);
+
+    if (up.retries > 0)
+        printf("WRITE: %u part attempt(s) retried\n", up.retries);
+
+    const char *cmd = up.failed ? "MPABT" : "MPEND";
+    if (send_request(sockfd, cmd, 0, remote_path, 0, up.id) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+        return 1;
+    if (up.failed)
+        return 1;
+    if (resp.status != RFS_OK)
+    {
+        fprintf(stderr, "WRITE error: server could not store '%s' (status=%u)\n",
+                remote_path, resp.status);
         return 1;
     }
-    uint32_t file_size = (uint32_t)file_size_long;
-    rewind(fp);
+    return 0;
+}
 
-    uint8_t *file_buf = (uint8_t *)malloc(file_size);
-    if (!file_buf)
+/**
+ * @brief Implement the WRITE client command.
+ *
+ * Opens a v2 session and streams the contents of @p local_path to
+ * the server as the payload of a WRITE request for @p remote_path,
+ * followed by a checksum the server verifies before storing the
+ * file. The server is expected to store the file under the given
+ * remote path, possibly creating a versioned file.
+ *
+ * When the server is reached over its local Unix socket and the file
+ * is at least LOCAL_FD_THRESHOLD bytes, the open file is passed
+ * instead (WRFD) and the server copies it in the kernel.
+ *
+ * Otherwise, with @p streams > 1 and a file of more than one
+ * UPLOAD_PART_SIZE part, the file is sent as a multipart upload over
+ * that many connections (see write_multipart()).
+ *
+ * @param local_path Path to the local file to be uploaded.
+ * @param remote_path Remote file path under which the server should
+ *                    store the uploaded file.
+ * @param streams Number of parallel connections (1 for a plain WRITE).
+ *
+ * @return 0 on success, or 1 on any error (I/O or networking).
+ */
+int do_write(const char *local_path, const char *remote_path, int streams)
+{
+    int fd = open(local_path, O_RDONLY);
+    if (fd < 0)
     {
-        perror("malloc");
-        fclose(fp);
+        perror("open local file");
         return 1;
     }
 
-    size_t read_bytes = fread(file_buf, 1, file_size, fp);
-    fclose(fp);
-    if (read_bytes != file_size)
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
     {
-        fprintf(stderr, "Short read of local file\n");
-        free(file_buf);
+        fprintf(stderr, "Not a regular file: %s\n", local_path);
+        close(fd);
         return 1;
     }
+    uint64_t file_size = (uint64_t)st.st_size;
 
-    int sockfd = connect_to_server();
+    int sockfd = open_session();
     if (sockfd < 0)
     {
-        free(file_buf);
+        close(fd);
         return 1;
     }
 
     printf("Connected (WRITE)\n");
 
-    /* Send command */
-    const char cmd[5] = {'W','R','I','T','E'};
-    if (send_all(sockfd, cmd, 5) < 0)
+    /* Same-host server: hand over the open file instead of its bytes */
+    int by_fd = sock_is_local(sockfd) && file_size >= LOCAL_FD_THRESHOLD;
+    int multipart = !by_fd && streams > 1 && file_size > UPLOAD_PART_SIZE;
+    int rc;
+    if (multipart)
     {
+        rc = write_multipart(sockfd, fd, file_size, remote_path, streams);
         close(sockfd);
-        free(file_buf);
-        return 1;
+        close(fd);
+        if (rc != 0)
+            return 1;
+        printf("WRITE complete: %s -> %s (%llu bytes, %d streams)\n",
+               local_path, remote_path, (unsigned long long)file_size, streams);
+        return 0;
     }
+    else if (by_fd)
+        rc = send_request(sockfd, "WRFD ", 0, remote_path, 0, 0) < 0 ||
+             send_fd(sockfd, fd) < 0;
+    else
+        rc = send_request(sockfd, "WRITE", RFS_F_DATA_SUM, remote_path,
+                          file_size, 0) < 0 ||
+             send_file_data(sockfd, fd, 0, file_size) < 0;
 
-    /* Send lengths */
-    uint32_t path_len = (uint32_t)strlen(remote_path);
-    uint32_t path_len_net  = htonl(path_len);
-    uint32_t file_size_net = htonl(file_size);
+    rfs_resp_t resp;
+    if (rc == 0 && recv_response(sockfd, &resp) < 0)
+        rc = 1;
+    close(sockfd);
+    close(fd);
+
+    if (rc != 0)
+        return 1;
 
-    if (send_all(sockfd, &path_len_net, 4) < 0 ||
-        send_all(sockfd, &file_size_net, 4) < 0 ||
-        send_all(sockfd, remote_path, path_len) < 0 ||
-        send_all(sockfd, file_buf, file_size) < 0)
+    if (resp.status != RFS_OK)
     {
-        close(sockfd);
-        free(file_buf);
+        fprintf(stderr, "WRITE error: server could not store '%s' (status=%u)\n",
+                remote_path, resp.status);
         return 1;
     }
 
-    printf("WRITE complete: %s -> %s (%u bytes)\n",
-           local_path, remote_path, file_size);
-
-    close(sockfd);
-    free(file_buf);
+    printf("WRITE complete: %s -> %s (%llu bytes%s)\n",
+           local_path, remote_path, (unsigned long long)file_size,
+           by_fd ? ", local" : "");
     return 0;
 }
 
 /*------------------------------------------------------------*/
-/*                           GET                              */
-/*      Supports: GET [-v N] remote-path [local-path]         */
+/*                       APPEND / PATCH                       */
 /*------------------------------------------------------------*/
 
 /**
- * @brief Implement the GET client command with optional versioning.
- *
- * Requests a file from the remote server and writes it to a local
- * file. If @p version is greater than 0, the function requests a
- * specific version by appending ".v<version>" to @p remote_path
- * when communicating with the server.
- *
- * If @p maybe_local_path is non-NULL, the received data is written
- * to that path. Otherwise, the local file name defaults to the
- * basename of the (possibly versioned) remote path.
+ * @brief Send a local file as an APPND or PATCH payload.
  *
- * @param remote_path Base remote path of the file to retrieve.
- * @param maybe_local_path Optional local path to save the file; if
- *                         NULL, basename of the requested remote
- *                         path is used.
- * @param version Version number to retrieve; if > 0, a specific
- *                version is requested, otherwise the newest version
- *                is requested.
+ * @param cmd "APPND" or "PATCH".
+ * @param op Name printed in messages ("APPEND" or "PATCH").
+ * @param local_path Local file holding the bytes to send.
+ * @param remote_path Remote file to change.
+ * @param offset PATCH offset (ignored for APPND).
  *
- * @return 0 on success, or 1 on any error (not found, I/O, or
- *         networking).
+ * @return 0 on success, or 1 on error.
  */
-int do_get(const char *remote_path,
-           const char *maybe_local_path,
-           int version)
+static int send_update(const char *cmd, const char *op, const char *local_path,
+                       const char *remote_path, uint64_t offset)
 {
-    char local_path_buf[1024];
-    char remote_buf[1024];
-
-    /* Effective remote path to request from server */
-    const char *remote_to_send = remote_path;
-    if (version > 0)
+    int fd = open(local_path, O_RDONLY);
+    if (fd < 0)
     {
-        if (snprintf(remote_buf, sizeof(remote_buf),
-                     "%s.v%d", remote_path, version) >= (int)sizeof(remote_buf))
-        {
-            fprintf(stderr, "Remote path too long\n");
-            return 1;
-        }
-        remote_to_send = remote_buf;
+        perror("open local file");
+        return 1;
     }
 
-    /* Local path: explicit or basename of what we're requesting */
-    const char *local_path;
-    if (maybe_local_path != NULL)
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
     {
-        local_path = maybe_local_path;
+        fprintf(stderr, "Not a regular file: %s\n", local_path);
+        close(fd);
+        return 1;
     }
-    else
+    uint64_t len = (uint64_t)st.st_size;
+
+    int sockfd = open_session();
+    if (sockfd < 0)
     {
-        const char *base = basename_const(remote_to_send);
-        if (snprintf(local_path_buf, sizeof(local_path_buf),
-                     "%s", base) >= (int)sizeof(local_path_buf))
-        {
-            fprintf(stderr, "Local path too long\n");
-            return 1;
-        }
-        local_path = local_path_buf;
+        close(fd);
+        return 1;
     }
 
-    int sockfd = connect_to_server();
-    if (sockfd < 0)
+    printf("Connected (%s)\n", op);
+
+    rfs_resp_t resp;
+    int rc = send_request(sockfd, cmd, RFS_F_DATA_SUM, remote_path, len, offset) < 0 ||
+             send_file_data(sockfd, fd, 0, len) < 0 ||
+             recv_response(sockfd, &resp) < 0;
+    close(sockfd);
+    close(fd);
+    if (rc)
+        return 1;
+
+    if (resp.status == RFS_OK)
+    {
+        printf("%s complete: %s -> %s (%llu bytes sent, file now %llu bytes)\n",
+               op, local_path, remote_path, (unsigned long long)len,
+               (unsigned long long)resp.arg);
+        return 0;
+    }
+
+    if (resp.status == RFS_ERR_NOT_FOUND)
+        fprintf(stderr, "%s error: '%s' not found\n", op, remote_path);
+    else if (resp.status == RFS_ERR_BAD_REQUEST)
+        fprintf(stderr, "%s error: offset %llu is past the end of '%s'\n", op,
+                (unsigned long long)offset, remote_path);
+    else if (resp.status == RFS_ERR_READ_ONLY)
+        fprintf(stderr, "%s error: snapshots and the index cannot be changed\n", op);
+    else if (resp.status == RFS_ERR_UNSUPPORTED)
+        fprintf(stderr, "%s error: not supported by this server\n", op);
+    else
+        fprintf(stderr, "%s error: server could not change '%s' (status=%u)\n",
+                op, remote_path, resp.status);
+    return 1;
+}
+
+/**
+ * @brief Implement the APPEND client command.
+ *
+ * Adds the contents of a local file to the end of a remote file,
+ * creating it if needed. Only the new bytes are sent, and no new
+ * version is made.
+ *
+ * @param local_path Local file holding the bytes to append.
+ * @param remote_path Remote file to append to.
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_append(const char *local_path, const char *remote_path)
+{
+    return send_update("APPND", "APPEND", local_path, remote_path, 0);
+}
+
+/**
+ * @brief Implement the PATCH client command.
+ *
+ * Writes the contents of a local file into a remote file at @p offset
+ * (at most its current size). The result is stored as a new version;
+ * only the patch bytes are sent.
+ *
+ * @param local_path Local file holding the new bytes.
+ * @param remote_path Remote file to patch.
+ * @param offset Byte offset in the remote file.
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_patch(const char *local_path, const char *remote_path, uint64_t offset)
+{
+    return send_update("PATCH", "PATCH", local_path, remote_path, offset);
+}
+
+/*------------------------------------------------------------*/
+/*                           SYNC                             */
+/*        Supports: SYNC local-path [remote-path]             */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Receive a SIGS reply (layout in delta.h).
+ *
+ * @param sockfd Session socket.
+ * @param resp Response header of the SIGS reply.
+ * @param base Receives the signatures; free base->sigs afterwards.
+ *
+ * @return 0 on success, or -1 on networking or protocol error.
+ */
+static int recv_sigs(int sockfd, const rfs_resp_t *resp, delta_sigs_t *base)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    uint32_t v;
+
+    base->sigs = NULL;
+    if (resp->payload_len < DELTA_SIGS_HDR + 8 ||
+        recv_all(sockfd, buf, DELTA_SIGS_HDR) < 0)
+        return -1;
+    memcpy(&v, buf, 4);
+    base->block_size = ntohl(v);
+    memcpy(&v, buf + 4, 4);
+    base->nblocks = ntohl(v);
+    base->size = rfs_get_u64(buf + 8);
+
+    if (base->block_size == 0 || base->nblocks > DELTA_MAX_BLOCKS ||
+        resp->payload_len != DELTA_SIGS_HDR +
+                             (uint64_t)base->nblocks * DELTA_SIG_LEN + 8)
+    {
+        fprintf(stderr, "SYNC error: malformed signature reply\n");
+        return -1;
+    }
+
+    base->sigs = (delta_sig_t *)malloc((base->nblocks + 1) * sizeof(delta_sig_t));
+    if (!base->sigs)
+    {
+        perror("malloc");
+        return -1;
+    }
+
+    uint32_t per_chunk = sizeof(buf) / DELTA_SIG_LEN;
+    for (uint32_t j = 0; j < base->nblocks;)
+    {
+        uint32_t n = base->nblocks - j < per_chunk ? base->nblocks - j : per_chunk;
+        if (recv_all(sockfd, buf, (size_t)n * DELTA_SIG_LEN) < 0)
+            return -1;
+        for (uint32_t k = 0; k < n; k++, j++)
+        {
+            memcpy(&v, buf + k * DELTA_SIG_LEN, 4);
+            base->sigs[j].weak = ntohl(v);
+            base->sigs[j].strong = rfs_get_u64(buf + k * DELTA_SIG_LEN + 4);
+        }
+    }
+
+    if (recv_all(sockfd, buf, 8) < 0)
+        return -1;
+    base->checksum = rfs_get_u64(buf);
+    return 0;
+}
+
+/**
+ * @brief Build the DELTA payload for a local file in a temp file.
+ *
+ * The ops are spooled to an anonymous temp file, because the request
+ * header must carry the payload length before any of it is sent;
+ * memory stays bounded however large the file or the delta.
+ *
+ * @param fd Local file.
+ * @param size Its size.
+ * @param base Signatures of the server's current version.
+ * @param res Receives the delta statistics.
+ * @param out_len Receives the payload length.
+ *
+ * @return An open descriptor holding the payload, or -1 on error.
+ */
+static int build_delta(int fd, uint64_t size, const delta_sigs_t *base,
+                       delta_result_t *res, uint64_t *out_len)
+{
+    FILE *tmp = tmpfile();
+    if (!tmp)
+    {
+        perror("tmpfile");
+        return -1;
+    }
+    int dfd = dup(fileno(tmp));
+    fclose(tmp);
+    if (dfd < 0)
+    {
+        perror("dup");
+        return -1;
+    }
+
+    if (lseek(dfd, DELTA_HDR_LEN, SEEK_SET) < 0 ||
+        delta_generate(fd, size, base, dfd, res) < 0)
+    {
+        close(dfd);
+        return -1;
+    }
+
+    uint8_t hdr[DELTA_HDR_LEN];
+    uint32_t bs_net = htonl(base->block_size);
+    rfs_put_u64(hdr, base->checksum);
+    rfs_put_u64(hdr + 8, size);
+    rfs_put_u64(hdr + 16, res->checksum);
+    memcpy(hdr + 24, &bs_net, 4);
+
+    off_t end = -1;
+    if (pwrite(dfd, hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        (end = lseek(dfd, 0, SEEK_END)) < 0)
+    {
+        perror("write delta");
+        close(dfd);
+        return -1;
+    }
+    *out_len = (uint64_t)end;
+    return dfd;
+}
+
+/**
+ * @brief Execute the SYNC client command (delta upload).
+ *
+ * SIGS and DELTA go over one session. If the server has no copy, or
+ * its copy changed between the two requests (RFS_ERR_STALE), the
+ * whole file is sent with do_write() instead.
+ *
+ * @param local_path Path to the local file to upload.
+ * @param remote_path Remote path of the file to update.
+ *
+ * @return 0 on success, or 1 on any error (I/O or networking).
+ */
+int do_sync(const char *local_path, const char *remote_path)
+{
+    int fd = open(local_path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("open local file");
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    {
+        fprintf(stderr, "Not a regular file: %s\n", local_path);
+        close(fd);
+        return 1;
+    }
+    uint64_t file_size = (uint64_t)st.st_size;
+
+    int sockfd = open_session();
+    if (sockfd < 0)
+    {
+        close(fd);
+        return 1;
+    }
+
+    printf("Connected (SYNC)\n");
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, "SIGS ", 0, remote_path, 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+    {
+        close(sockfd);
+        close(fd);
+        return 1;
+    }
+
+    if (resp.status != RFS_OK)
+    {
+        close(sockfd);
+        close(fd);
+        if (resp.status == RFS_ERR_NOT_FOUND)
+        {
+            printf("SYNC: '%s' is not on the server; sending the whole file\n",
+                   remote_path);
+            return do_write(local_path, remote_path, 1);
+        }
+        fprintf(stderr, "SYNC error: server error for '%s' (status=%u)\n",
+                remote_path, resp.status);
+        return 1;
+    }
+
+    delta_sigs_t base;
+    delta_result_t res;
+    uint64_t delta_len = 0;
+    int dfd = -1;
+    if (recv_sigs(sockfd, &resp, &base) == 0)
+        dfd = build_delta(fd, file_size, &base, &res, &delta_len);
+    free(base.sigs);
+    close(fd);
+    if (dfd < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+
+    int rc = send_request(sockfd, "DELTA", RFS_F_DATA_SUM, remote_path,
+                          delta_len, 0) < 0 ||
+             send_file_data(sockfd, dfd, 0, delta_len) < 0 ||
+             recv_response(sockfd, &resp) < 0;
+    close(dfd);
+    close(sockfd);
+    if (rc != 0)
+        return 1;
+
+    if (resp.status == RFS_ERR_STALE)
+    {
+        printf("SYNC: '%s' changed on the server; sending the whole file\n",
+               remote_path);
+        return do_write(local_path, remote_path, 1);
+    }
+    if (resp.status != RFS_OK)
+    {
+        fprintf(stderr, "SYNC error: server could not store '%s' (status=%u)\n",
+                remote_path, resp.status);
+        return 1;
+    }
+
+    printf("SYNC complete: %s -> %s (%llu bytes, sent %llu: %llu literal, "
+           "%llu matched)\n",
+           local_path, remote_path, (unsigned long long)file_size,
+           (unsigned long long)delta_len, (unsigned long long)res.literal_bytes,
+           (unsigned long long)res.copied_bytes);
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+/*                           GET                              */
+/*      Supports: GET [-v N] remote-path [local-path]         */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Perform a GET by receiving the file as a descriptor (GETFD).
+ *
+ * Used when connected through the server's Unix socket. The server
+ * replies with a status and, on success, an open read-only descriptor
+ * for the requested version, which is copied to @p local_path in the
+ * kernel.
+ *
+ * @param sockfd Session socket over AF_UNIX.
+ * @param remote_path Remote path (possibly with .vN) to fetch.
+ * @param local_path Local file to create or overwrite.
+ * @param out_size Receives the number of bytes copied.
+ *
+ * @return 0 on success, or 1 on error (not found, I/O, networking).
+ */
+static int get_via_fd(int sockfd, const char *remote_path,
+                      const char *local_path, uint64_t *out_size)
+{
+    rfs_resp_t resp;
+    if (send_request(sockfd, "GETFD", 0, remote_path, 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+        return 1;
+
+    if (resp.status != RFS_OK)
+    {
+        fprintf(stderr, "GET error: remote file not found (%s)\n", remote_path);
+        return 1;
+    }
+
+    int fd = recv_fd(sockfd);
+    if (fd < 0)
+        return 1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        perror("fstat");
+        close(fd);
+        return 1;
+    }
+
+    int out = open(local_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+    {
+        perror("open local");
+        close(fd);
+        return 1;
+    }
+
+    double copy_start = timing_on ? timing_now() : 0;
+    int rc = copy_fd(fd, out, (uint64_t)st.st_size);
+    if (rc == 0)
+        timing_data((uint64_t)st.st_size, timing_on ? timing_now() - copy_start : 0);
+    close(fd);
+    if (close(out) < 0 || rc < 0)
+    {
+        fprintf(stderr, "Short write to '%s'\n", local_path);
+        return 1;
+    }
+
+    *out_size = (uint64_t)st.st_size;
+    return 0;
+}
+
+/**
+ * @brief Implement the GET client command with optional versioning.
+ *
+ * Requests a file from the remote server and streams it to a local
+ * file. If @p version is greater than 0, the function requests a
+ * specific version by appending ".v<version>" to @p remote_path
+ * when communicating with the server.
+ *
+ * The payload is written as it arrives and verified against the
+ * server's checksum; on a mismatch the local file is removed. Over
+ * the server's local Unix socket the file arrives as an open
+ * descriptor (see get_via_fd()) rather than through the socket.
+ *
+ * If @p maybe_local_path is non-NULL, the received data is written
+ * to that path. Otherwise, the local file name defaults to the
+ * basename of the (possibly versioned) remote path.
+ *
+ * @param remote_path Base remote path of the file to retrieve.
+ * @param maybe_local_path Optional local path to save the file; if
+ *                         NULL, basename of the requested remote
+ *                         path is used.
+ * @param version Version number to retrieve; if > 0, a specific
+ *                version is requested, otherwise the newest version
+ *                is requested.
+ *
+ * @return 0 on success, or 1 on any error (not found, I/O, or
+ *         networking).
+ */
+int do_get(const char *remote_path,
+           const char *maybe_local_path,
+           int version)
+{
+    char local_path_buf[1024];
+    char remote_buf[1024];
+
+    /* Effective remote path to request from server */
+    const char *remote_to_send = remote_path;
+    if (version > 0)
+    {
+        if (snprintf(remote_buf, sizeof(remote_buf),
+                     "%s.v%d", remote_path, version) >= (int)sizeof(remote_buf))
+        {
+            fprintf(stderr, "Remote path too long\n");
+            return 1;
+        }
+        remote_to_send = remote_buf;
+    }
+
+    /* Local path: explicit or basename of what we're requesting */
+    const char *local_path;
+    if (maybe_local_path != NULL)
+    {
+        local_path = maybe_local_path;
+    }
+    else
+    {
+        const char *base = basename_const(remote_to_send);
+        if (snprintf(local_path_buf, sizeof(local_path_buf),
+                     "%s", base) >= (int)sizeof(local_path_buf))
+        {
+            fprintf(stderr, "Local path too long\n");
+            return 1;
+        }
+        local_path = local_path_buf;
+    }
+
+    int sockfd = open_session();
+    if (sockfd < 0)
         return 1;
 
     if (version > 0)
@@ -339,273 +1280,1312 @@ int do_get(const char *remote_path,
     else
         printf("Connected (GET)\n");
 
-    const char cmd[5] = {'G','E','T',' ',' '};
-    if (send_all(sockfd, cmd, 5) < 0)
+    uint64_t file_size = 0;
+    int by_fd = sock_is_local(sockfd);
+
+    if (by_fd)
+    {
+        int rc = get_via_fd(sockfd, remote_to_send, local_path, &file_size);
+        close(sockfd);
+        if (rc != 0)
+            return 1;
+    }
+    else
+    {
+        /* with a cached copy, ask the server to skip the body if current */
+        char key[RFS_MAX_PATH + 64];
+        snprintf(key, sizeof(key), "%s:%d/%s", server_host(), server_port(),
+                 remote_to_send);
+        cache_entry_t ce;
+        int cache = cache_lookup(key, &ce);
+        uint32_t flags = RFS_F_DATA_SUM;
+        if (cache == 1)
+            flags |= RFS_F_IF_NONE_MATCH;
+
+        rfs_resp_t resp;
+        if (send_request(sockfd, "GET  ", flags, remote_to_send, 0,
+                         cache == 1 ? ce.checksum : 0) < 0 ||
+            recv_response(sockfd, &resp) < 0)
+        {
+            cache_close(&ce);
+            close(sockfd);
+            return 1;
+        }
+
+        if (resp.status == RFS_NOT_MODIFIED && cache == 1)
+        {
+            close(sockfd);
+            int fd = open(local_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                perror("open local");
+                cache_close(&ce);
+                return 1;
+            }
+            int rc = cache_copy_out(&ce, fd);
+            if (close(fd) < 0)
+                rc = -1;
+            cache_close(&ce);
+            if (rc != 0)
+            {
+                fprintf(stderr, "GET failed; removing partial '%s'\n", local_path);
+                unlink(local_path);
+                return 1;
+            }
+            printf("GET complete: %s -> %s (%llu bytes, cached)\n",
+                   remote_to_send, local_path, (unsigned long long)ce.size);
+            return 0;
+        }
+        cache_close(&ce);
+
+        if (resp.status != RFS_OK)
+        {
+            if (resp.status == RFS_ERR_NOT_FOUND)
+            {
+                if (cache >= 0)
+                    cache_drop(&ce);
+                fprintf(stderr, "GET error: remote file not found (%s)\n",
+                        remote_to_send);
+            }
+            else
+                fprintf(stderr, "GET error: server error for '%s' (status=%u)\n",
+                        remote_to_send, resp.status);
+            close(sockfd);
+            return 1;
+        }
+
+        /* read back afterwards to fill the cache */
+        int fd = open(local_path, (cache >= 0 ? O_RDWR : O_WRONLY) |
+                      O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            perror("open local");
+            close(sockfd);
+            return 1;
+        }
+
+        uint64_t sum = 0;
+        int rc = recv_file_data(sockfd, &resp, fd, &sum);
+        close(sockfd);
+        if (rc == 0 && cache >= 0 &&
+            cache_store(&ce, key, fd, resp.payload_len, sum) < 0)
+            fprintf(stderr, "GET: could not cache '%s'\n", remote_to_send);
+        if (close(fd) < 0 && rc == 0)
+            rc = 1;
+
+        if (rc != 0)
+        {
+            fprintf(stderr, "GET failed; removing partial '%s'\n", local_path);
+            unlink(local_path);
+            return 1;
+        }
+        file_size = resp.payload_len;
+    }
+
+    if (version > 0)
+    {
+        printf("GET -v %d complete: %s -> %s (%llu bytes%s)\n",
+               version, remote_to_send, local_path,
+               (unsigned long long)file_size, by_fd ? ", local" : "");
+    }
+    else
+    {
+        printf("GET complete: %s -> %s (%llu bytes%s)\n",
+               remote_to_send, local_path,
+               (unsigned long long)file_size, by_fd ? ", local" : "");
+    }
+
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+/*                            RM                              */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Implement the RM client command.
+ *
+ * Sends an RM request for @p remote_path to the server and interprets
+ * the returned status code. Depending on the result, it prints a
+ * success message or an appropriate error description.
+ *
+ * @param remote_path Remote path (file or directory) to remove.
+ *
+ * @return 0 on success, or 1 if the removal fails (not found,
+ *         directory not empty, or other server-side error).
+ */
+int do_rm(const char *remote_path)
+{
+    int sockfd = open_session();
+    if (sockfd < 0)
+        return 1;
+
+    printf("Connected (RM)\n");
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, "RM   ", 0, remote_path, 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+    close(sockfd);
+
+    uint32_t status = resp.status;
+
+    if (status == RFS_OK)
+    {
+        printf("RM success: '%s' deleted\n", remote_path);
+        return 0;
+    }
+    if (status == RFS_ERR_NOT_FOUND)
+    {
+        fprintf(stderr, "RM error: '%s' not found\n", remote_path);
+    }
+    else if (status == RFS_ERR_NOT_EMPTY)
+    {
+        fprintf(stderr, "RM error: directory not empty: '%s'\n", remote_path);
+    }
+    else
+    {
+        fprintf(stderr, "RM error: removal failed for '%s' (status=%u)\n",
+                remote_path, status);
+    }
+    return 1;
+}
+
+/*------------------------------------------------------------*/
+/*                        COPY / MOVE                         */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Implement the COPY and MOVE client commands.
+ *
+ * The server duplicates or renames the file together with all of its
+ * versions; no file data crosses the network.
+ *
+ * @param src Remote path of an existing file.
+ * @param dst Remote path it is copied or moved to (must not exist).
+ * @param move Non-zero for MOVE.
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_copy(const char *src, const char *dst, int move)
+{
+    const char *op = move ? "MOVE" : "COPY";
+    size_t dst_len = strlen(dst);
+    if (dst_len >= RFS_MAX_PATH)
+    {
+        fprintf(stderr, "%s error: destination path too long\n", op);
+        return 1;
+    }
+
+    int sockfd = open_session();
+    if (sockfd < 0)
+        return 1;
+
+    printf("Connected (%s)\n", op);
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, move ? "MOVE " : "COPY ", 0, src, dst_len, 0) < 0 ||
+        send_all(sockfd, dst, dst_len) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+    close(sockfd);
+
+    if (resp.status == RFS_OK)
+    {
+        printf("%s complete: '%s' -> '%s' (%llu versions)\n", op, src, dst,
+               (unsigned long long)resp.arg);
+        return 0;
+    }
+
+    if (resp.status == RFS_ERR_NOT_FOUND)
+        fprintf(stderr, "%s error: '%s' not found\n", op, src);
+    else if (resp.status == RFS_ERR_EXISTS)
+        fprintf(stderr, "%s error: '%s' already exists\n", op, dst);
+    else if (resp.status == RFS_ERR_READ_ONLY)
+        fprintf(stderr, "%s error: snapshots and the index cannot be changed\n", op);
+    else if (resp.status == RFS_ERR_BAD_REQUEST)
+        fprintf(stderr, "%s error: '%s' is not a file, or the paths are the same\n",
+                op, src);
+    else if (resp.status == RFS_ERR_UNSUPPORTED)
+        fprintf(stderr, "%s error: not supported by this server\n", op);
+    else
+        fprintf(stderr, "%s error: failed for '%s' (status=%u)\n", op, src, resp.status);
+    return 1;
+}
+
+/*------------------------------------------------------------*/
+/*                             LS                             */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Print a directory listing, one LSDIR page at a time.
+ *
+ * Pages are requested on the open session until the server returns a
+ * zero continuation token, and each page is printed as it arrives, so
+ * neither side ever holds the whole listing.
+ *
+ * @param sockfd Session socket from open_session().
+ * @param remote_path Remote directory.
+ * @param page_size Entries per page (0 for the server default).
+ *
+ * @return 0 on success, RFS_ERR_NOT_FOUND if @p remote_path is not a
+ *         directory, or 1 on any other error.
+ */
+static int list_directory(int sockfd, const char *remote_path, uint32_t page_size)
+{
+    uint64_t token = 0;
+    uint64_t entries = 0;
+    int first = 1;
+
+    do
+    {
+        uint32_t page_net = htonl(page_size);
+        rfs_resp_t resp;
+        if (send_request(sockfd, "LSDIR", 0, remote_path,
+                         page_size ? 4 : 0, token) < 0 ||
+            (page_size && send_all(sockfd, &page_net, 4) < 0) ||
+            recv_response(sockfd, &resp) < 0)
+            return 1;
+
+        if (resp.status != RFS_OK)
+        {
+            if (resp.status == RFS_ERR_NOT_FOUND)
+                return RFS_ERR_NOT_FOUND;
+            fprintf(stderr, "LS error: server error for '%s' (status=%u)\n",
+                    remote_path, resp.status);
+            return 1;
+        }
+
+        if (first)
+        {
+            printf("Contents of '%s':\n", remote_path);
+            printf("  %-30s  %8s  %12s  %s\n", "NAME", "VERSIONS", "SIZE",
+                   "LAST MODIFIED");
+            first = 0;
+        }
+
+        uint64_t left = resp.payload_len;
+        while (left > 0)
+        {
+            entry_t e;
+            if (recv_entry(sockfd, &e, &left) < 0)
+            {
+                fprintf(stderr, "LS error: malformed reply\n");
+                return 1;
+            }
+
+            char ts[64];
+            format_mtime(&e, ts, sizeof(ts));
+            if (e.flags & RFS_ENTRY_DIR)
+            {
+                char dir_name[RFS_MAX_PATH + 1];
+                snprintf(dir_name, sizeof(dir_name), "%s/", e.path);
+                printf("  %-30s  %8s  %12s  %s\n", dir_name, "-", "-", ts);
+            }
+            else
+            {
+                printf("  %-30s  %8u  %12llu  %s\n", e.path, e.version,
+                       (unsigned long long)e.size, ts);
+            }
+            entries++;
+        }
+        fflush(stdout);
+
+        token = resp.arg;
+    } while (token != 0);
+
+    printf("%llu entries\n", (unsigned long long)entries);
+    return 0;
+}
+
+/**
+ * @brief Implement the LS client command for version listing.
+ *
+ * Sends an LS request for @p remote_path to the server. The response
+ * payload holds a count of available versions followed by one entry
+ * per version; each is printed with its last modified timestamp in a
+ * tabular format.
+ *
+ * A path ending in '/', or one with no versions that names a directory,
+ * is listed as a directory instead (see list_directory()).
+ *
+ * @param remote_path Remote file path whose versions should be listed.
+ * @param page_size Directory entries per page (0 for the server default).
+ *
+ * @return 0 on success (including the case of zero versions), or 1 on
+ *         any error (networking or allocation).
+ */
+int do_ls(const char *remote_path, uint32_t page_size)
+{
+    int sockfd = open_session();
+    if (sockfd < 0)
+        return 1;
+
+    printf("Connected (LS)\n");
+
+    size_t len = strlen(remote_path);
+    if (len == 0 || remote_path[len - 1] == '/')
+    {
+        int rc = list_directory(sockfd, remote_path, page_size);
+        close(sockfd);
+        if (rc == RFS_ERR_NOT_FOUND)
+        {
+            fprintf(stderr, "LS error: no such directory '%s'\n", remote_path);
+            return 1;
+        }
+        return rc;
+    }
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, "LS   ", 0, remote_path, 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+
+    if (resp.status != RFS_OK || resp.payload_len < 4)
+    {
+        fprintf(stderr, "LS error: server error for '%s' (status=%u)\n",
+                remote_path, resp.status);
+        close(sockfd);
+        return 1;
+    }
+
+    /* Receive count */
+    uint32_t count_net;
+    if (recv_all(sockfd, &count_net, 4) < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+    uint32_t count = ntohl(count_net);
+
+    if (count == 0)
+    {
+        /* no file by that name; it may be a directory */
+        int rc = list_directory(sockfd, remote_path, page_size);
+        close(sockfd);
+        if (rc == RFS_ERR_NOT_FOUND)
+        {
+            printf("No versions found for '%s'\n", remote_path);
+            return 0;
+        }
+        return rc;
+    }
+
+    printf("Versions for '%s':\n", remote_path);
+    printf("  %-30s  %s\n", "NAME", "LAST MODIFIED");
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t name_len_net, ts_len_net;
+
+        if (recv_all(sockfd, &name_len_net, 4) < 0 ||
+            recv_all(sockfd, &ts_len_net, 4) < 0)
+        {
+            close(sockfd);
+            return 1;
+        }
+
+        uint32_t name_len = ntohl(name_len_net);
+        uint32_t ts_len   = ntohl(ts_len_net);
+
+        char *name_buf = (char *)malloc(name_len + 1);
+        char *ts_buf   = (char *)malloc(ts_len + 1);
+        if (!name_buf || !ts_buf)
+        {
+            perror("malloc");
+            free(name_buf);
+            free(ts_buf);
+            close(sockfd);
+            return 1;
+        }
+
+        if (recv_all(sockfd, name_buf, name_len) < 0 ||
+            recv_all(sockfd, ts_buf, ts_len) < 0)
+        {
+            free(name_buf);
+            free(ts_buf);
+            close(sockfd);
+            return 1;
+        }
+
+        name_buf[name_len] = '\0';
+        ts_buf[ts_len]     = '\0';
+
+        printf("  %-30s  %s\n", name_buf, ts_buf);
+
+        free(name_buf);
+        free(ts_buf);
+    }
+
+    close(sockfd);
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+/*                    STAT / LIST / STATS                     */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Implement the STAT client command.
+ *
+ * Prints the server's indexed metadata for one file:
+ *
+ *   path=<path> version=<N> size=<bytes> mtime=<time> checksum=<hex>
+ *
+ * @param remote_path Remote file to describe.
+ *
+ * @return 0 on success, or 1 if the file does not exist or on error.
+ */
+int do_stat(const char *remote_path)
+{
+    int sockfd = open_session();
+    if (sockfd < 0)
+        return 1;
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, "STAT ", 0, remote_path, 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+
+    if (resp.status != RFS_OK)
+    {
+        if (resp.status == RFS_ERR_NOT_FOUND)
+            fprintf(stderr, "STAT error: remote file not found (%s)\n", remote_path);
+        else
+            fprintf(stderr, "STAT error: server error for '%s' (status=%u)\n",
+                    remote_path, resp.status);
+        close(sockfd);
+        return 1;
+    }
+
+    entry_t e;
+    uint64_t left = resp.payload_len;
+    if (recv_entry(sockfd, &e, &left) < 0)
+    {
+        fprintf(stderr, "STAT error: malformed reply\n");
+        close(sockfd);
+        return 1;
+    }
+    close(sockfd);
+
+    char ts[64];
+    format_mtime(&e, ts, sizeof(ts));
+    printf("path=%s version=%u size=%llu mtime=\"%s\" checksum=",
+           e.path, e.version, (unsigned long long)e.size, ts);
+    if (e.flags & RFS_ENTRY_CHECKSUM)
+        printf("%016llx\n", (unsigned long long)e.checksum);
+    else
+        printf("-\n");
+    return 0;
+}
+
+/**
+ * @brief Implement the LIST client command.
+ *
+ * Prints every stored file under @p prefix with its current version,
+ * size and modification time, followed by a total.
+ *
+ * @param prefix Remote path prefix ("" for everything).
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_list(const char *prefix)
+{
+    int sockfd = open_session();
+    if (sockfd < 0)
+        return 1;
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, "LIST ", 0, prefix, 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+    if (resp.status != RFS_OK)
+    {
+        fprintf(stderr, "LIST error: server error (status=%u)\n", resp.status);
+        close(sockfd);
+        return 1;
+    }
+
+    uint64_t left = resp.payload_len;
+    uint64_t total_size = 0;
+    for (uint64_t i = 0; i < resp.arg; i++)
+    {
+        entry_t e;
+        if (recv_entry(sockfd, &e, &left) < 0)
+        {
+            fprintf(stderr, "LIST error: malformed reply\n");
+            close(sockfd);
+            return 1;
+        }
+
+        char ts[64];
+        format_mtime(&e, ts, sizeof(ts));
+        printf("  %-40s  v%-4u %12llu  %s\n", e.path, e.version,
+               (unsigned long long)e.size, ts);
+        total_size += e.size;
+    }
+    close(sockfd);
+
+    printf("%llu files, %llu bytes\n",
+           (unsigned long long)resp.arg, (unsigned long long)total_size);
+    return 0;
+}
+
+/**
+ * @brief Implement the STATS client command.
+ *
+ * Prints the server's most requested paths with their estimated
+ * request and byte counts, most requested first, followed by the
+ * totals since the server started.
+ *
+ * @param max Paths to show (0 for every path the server tracks).
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_stats(uint32_t max)
+{
+    int sockfd = open_session();
+    if (sockfd < 0)
+        return 1;
+
+    rfs_resp_t resp;
+    if (send_request(sockfd, "STATS", 0, "", 0, max) < 0 ||
+        recv_response(sockfd, &resp) < 0)
+    {
+        close(sockfd);
+        return 1;
+    }
+    if (resp.status != RFS_OK)
+    {
+        fprintf(stderr, "STATS error: server error (status=%u)\n", resp.status);
+        close(sockfd);
+        return 1;
+    }
+
+    uint8_t num[16];
+    if (resp.payload_len < sizeof(num) || recv_all(sockfd, num, sizeof(num)) < 0)
+    {
+        fprintf(stderr, "STATS error: malformed reply\n");
+        close(sockfd);
+        return 1;
+    }
+    uint64_t left = resp.payload_len - sizeof(num);
+    printf("%llu requests, %llu bytes since the server started\n",
+           (unsigned long long)rfs_get_u64(num),
+           (unsigned long long)rfs_get_u64(num + 8));
+    printf("  %-40s  %10s  %14s\n", "PATH", "REQUESTS", "BYTES");
+
+    for (uint64_t i = 0; i < resp.arg; i++)
+    {
+        char path[RFS_MAX_PATH];
+        uint32_t path_len;
+        if (left < 4 || recv_all(sockfd, &path_len, 4) < 0 ||
+            (path_len = ntohl(path_len)) >= sizeof(path) ||
+            left < 4 + (uint64_t)path_len + sizeof(num) ||
+            recv_all(sockfd, path, path_len) < 0 ||
+            recv_all(sockfd, num, sizeof(num)) < 0)
+        {
+            fprintf(stderr, "STATS error: malformed reply\n");
+            close(sockfd);
+            return 1;
+        }
+        path[path_len] = '\0';
+        left -= 4 + (uint64_t)path_len + sizeof(num);
+
+        printf("  %-40s  %10llu  %14llu\n", path,
+               (unsigned long long)rfs_get_u64(num),
+               (unsigned long long)rfs_get_u64(num + 8));
+    }
+    close(sockfd);
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+/*                            DIFF                            */
+/*------------------------------------------------------------*/
+
+#define DIFF_WINDOW 16          /* TREE requests in flight at once */
+
+/* One entry of a directory tree, local or remote. */
+typedef struct tree_node
+{
+    char *name;
+    int is_dir;
+    int known;                  /* value is valid (remote only)       */
+    uint64_t value;             /* file checksum or directory digest  */
+    uint64_t files;             /* files below a directory            */
+    struct tree_node *kids;     /* sorted by name (local only)        */
+    size_t nkids;
+} tree_node_t;
+
+/* A remote directory still to be compared, with its local counterpart. */
+typedef struct
+{
+    char *rel;                  /* path relative to the roots ("" = root) */
+    tree_node_t *local;         /* NULL if it only exists remotely        */
+} diff_item_t;
+
+/* State of one DIFF run. */
+typedef struct
+{
+    const char *local_root;
+    const char *remote_root;
+    diff_item_t *queue;
+    size_t queue_len;
+    size_t queue_cap;
+    char **fetch;               /* relative paths to GET with -g      */
+    size_t fetch_len;
+    size_t fetch_cap;
+    unsigned long differences;
+    unsigned long requests;
+    unsigned long round_trips;
+    int failed;
+} diff_t;
+
+static int cmp_node(const void *a, const void *b)
+{
+    return strcmp(((const tree_node_t *)a)->name, ((const tree_node_t *)b)->name);
+}
+
+/**
+ * @brief FNV-1a-64 of a local file's contents.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int hash_local_file(const char *path, uint64_t *sum_out)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    uint8_t *buf = (uint8_t *)malloc(RFS_IO_CHUNK);
+    if (!buf)
+    {
+        close(fd);
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    uint64_t sum = RFS_FNV64_INIT;
+    ssize_t n;
+    while ((n = read(fd, buf, RFS_IO_CHUNK)) != 0)
+    {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        sum = rfs_fnv64(sum, buf, (size_t)n);
+    }
+    free(buf);
+    close(fd);
+    *sum_out = sum;
+    return n < 0 ? -1 : 0;
+}
+
+/** @brief Free a tree's children (not the node itself). */
+static void tree_free(tree_node_t *node)
+{
+    for (size_t i = 0; i < node->nkids; i++)
+    {
+        tree_free(&node->kids[i]);
+        free(node->kids[i].name);
+    }
+    free(node->kids);
+    node->kids = NULL;
+    node->nkids = 0;
+}
+
+/**
+ * @brief Build the Merkle tree of a local directory.
+ *
+ * Files are hashed in full; directories without files are left out,
+ * as the server does. Names the server never lists (saved versions
+ * "name.vN") are skipped too.
+ *
+ * @param path Local directory.
+ * @param node Directory node to fill (name set by the caller).
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int tree_build_local(const char *path, tree_node_t *node)
+{
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        perror(path);
+        return -1;
+    }
+
+    size_t cap = 0;
+    int rc = 0;
+    struct dirent *de;
+    node->is_dir = 1;
+    node->known = 1;
+    while (rc == 0 && (de = readdir(dir)) != NULL)
+    {
+        const char *name = de->d_name;
+        const char *dot = strrchr(name, '.');
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+            (dot && dot[1] == 'v' && dot[2] && strspn(dot + 2, "0123456789") == strlen(dot + 2)))
+            continue;
+
+        char child[RFS_MAX_PATH];
+        struct stat st;
+        if (snprintf(child, sizeof(child), "%s/%s", path, name) >= (int)sizeof(child) ||
+            lstat(child, &st) < 0 || !(S_ISREG(st.st_mode) || S_ISDIR(st.st_mode)))
+            continue;
+
+        if (node->nkids == cap)
+        {
+            cap = cap ? cap * 2 : 16;
+            tree_node_t *kids = (tree_node_t *)realloc(node->kids, cap * sizeof(*kids));
+            if (!kids)
+            {
+                rc = -1;
+                break;
+            }
+            node->kids = kids;
+        }
+
+        tree_node_t *kid = &node->kids[node->nkids];
+        memset(kid, 0, sizeof(*kid));
+        if (S_ISDIR(st.st_mode))
+        {
+            if (tree_build_local(child, kid) < 0)
+                rc = -1;
+            else if (kid->files == 0)
+            {
+                tree_free(kid);
+                continue;
+            }
+        }
+        else if (hash_local_file(child, &kid->value) == 0)
+        {
+            kid->known = 1;
+            kid->files = 1;
+        }
+        else
+        {
+            perror(child);
+            rc = -1;
+        }
+        if (rc == 0 && (kid->name = strdup(name)) == NULL)
+            rc = -1;
+        if (rc < 0)
+        {
+            tree_free(kid);
+            break;
+        }
+        node->nkids++;
+    }
+    closedir(dir);
+    if (rc < 0)
+        return -1;
+
+    qsort(node->kids, node->nkids, sizeof(tree_node_t), cmp_node);
+    for (size_t i = 0; i < node->nkids; i++)
+    {
+        tree_node_t *kid = &node->kids[i];
+        node->value += rfs_tree_leaf(kid->name, strlen(kid->name), kid->is_dir,
+                                     kid->value);
+        node->files += kid->files;
+    }
+    return 0;
+}
+
+/** @brief Join a relative path and a name ("" + "a" is "a"). */
+static char *join_rel(const char *rel, const char *name)
+{
+    char *out;
+    if (asprintf(&out, "%s%s%s", rel, rel[0] ? "/" : "", name) < 0)
+        return NULL;
+    return out;
+}
+
+/** @brief Append a directory to the comparison queue. */
+static void diff_enqueue(diff_t *d, const char *rel, const char *name,
+                         tree_node_t *local)
+{
+    if (d->queue_len == d->queue_cap)
     {
-        close(sockfd);
-        return 1;
+        size_t cap = d->queue_cap ? d->queue_cap * 2 : 64;
+        diff_item_t *q = (diff_item_t *)realloc(d->queue, cap * sizeof(*q));
+        if (!q)
+        {
+            d->failed = 1;
+            return;
+        }
+        d->queue = q;
+        d->queue_cap = cap;
+    }
+    char *path = join_rel(rel, name);
+    if (!path)
+    {
+        d->failed = 1;
+        return;
     }
+    d->queue[d->queue_len].rel = path;
+    d->queue[d->queue_len].local = local;
+    d->queue_len++;
+}
 
-    uint32_t path_len = (uint32_t)strlen(remote_to_send);
-    uint32_t path_len_net = htonl(path_len);
+/** @brief Report one differing file, remembering it for -g if remote. */
+static void diff_report(diff_t *d, char mark, const char *rel, const char *name)
+{
+    char *path = join_rel(rel, name);
+    if (!path)
+    {
+        d->failed = 1;
+        return;
+    }
+    printf("%c %s\n", mark, path);
+    d->differences++;
 
-    if (send_all(sockfd, &path_len_net, 4) < 0 ||
-        send_all(sockfd, remote_to_send, path_len) < 0)
+    if (mark == '+' || !d->fetch_cap)
     {
-        close(sockfd);
-        return 1;
+        free(path);
+        return;
+    }
+    if (d->fetch_len == d->fetch_cap)
+    {
+        char **f = (char **)realloc(d->fetch, d->fetch_cap * 2 * sizeof(*f));
+        if (!f)
+        {
+            free(path);
+            d->failed = 1;
+            return;
+        }
+        d->fetch = f;
+        d->fetch_cap *= 2;
     }
+    d->fetch[d->fetch_len++] = path;
+}
 
-    /* Receive status */
-    uint32_t status_net;
-    if (recv_all(sockfd, &status_net, 4) < 0)
+/** @brief Report every file below a local-only directory as added. */
+static void diff_report_local(diff_t *d, const char *rel, const tree_node_t *node)
+{
+    for (size_t i = 0; i < node->nkids; i++)
     {
-        close(sockfd);
-        return 1;
+        const tree_node_t *kid = &node->kids[i];
+        if (!kid->is_dir)
+        {
+            diff_report(d, '+', rel, kid->name);
+            continue;
+        }
+        char *path = join_rel(rel, kid->name);
+        if (!path)
+        {
+            d->failed = 1;
+            return;
+        }
+        diff_report_local(d, path, kid);
+        free(path);
     }
-    uint32_t status = ntohl(status_net);
+}
 
-    if (status != 0)
+/**
+ * @brief Receive one TREE reply and compare it with the local side.
+ *
+ * Subdirectories whose digests differ (or exist only remotely) are
+ * queued for the next level; everything else is settled here.
+ *
+ * @return 0 on success, or -1 on a network or protocol error.
+ */
+static int diff_level_reply(int sockfd, diff_t *d, const diff_item_t *item)
+{
+    rfs_resp_t resp;
+    if (recv_response(sockfd, &resp) < 0)
+        return -1;
+    if (resp.status != RFS_OK && resp.status != RFS_ERR_NOT_FOUND)
     {
-        fprintf(stderr, "GET error: remote file not found (%s)\n",
-                remote_to_send);
-        close(sockfd);
-        return 1;
+        fprintf(stderr, "DIFF error: server error for '%s' (status=%u)\n",
+                item->rel[0] ? item->rel : "/", resp.status);
+        return -1;
     }
 
-    /* Receive file size */
-    uint32_t file_size_net;
-    if (recv_all(sockfd, &file_size_net, 4) < 0)
+    tree_node_t remote = { NULL, 1, 1, 0, 0, NULL, 0 };
+    uint64_t left = resp.payload_len;
+    size_t cap = 0;
+    int rc = 0;
+    while (left > 0)
     {
-        close(sockfd);
-        return 1;
+        entry_t e;
+        if (recv_entry(sockfd, &e, &left) < 0)
+        {
+            fprintf(stderr, "DIFF error: malformed reply\n");
+            rc = -1;
+            break;
+        }
+        if (remote.nkids == cap)
+        {
+            size_t new_cap = cap ? cap * 2 : 16;
+            tree_node_t *kids = (tree_node_t *)realloc(remote.kids,
+                                                       new_cap * sizeof(*kids));
+            if (!kids)
+            {
+                d->failed = 1;
+                continue;       /* keep draining the reply */
+            }
+            remote.kids = kids;
+            cap = new_cap;
+        }
+        tree_node_t *kid = &remote.kids[remote.nkids];
+        memset(kid, 0, sizeof(*kid));
+        kid->name = strdup(e.path);
+        kid->is_dir = (e.flags & RFS_ENTRY_DIR) != 0;
+        kid->known = (e.flags & RFS_ENTRY_CHECKSUM) != 0;
+        kid->value = e.checksum;
+        if (kid->name)
+            remote.nkids++;
+        else
+            d->failed = 1;
     }
-    uint32_t file_size = ntohl(file_size_net);
 
-    uint8_t *buf = (uint8_t *)malloc(file_size);
-    if (!buf)
+    const tree_node_t *local = item->local;
+    if (rc == 0 && !(local && resp.status == RFS_OK && resp.arg == local->value))
     {
-        perror("malloc");
-        close(sockfd);
-        return 1;
+        qsort(remote.kids, remote.nkids, sizeof(tree_node_t), cmp_node);
+
+        size_t i = 0;
+        size_t j = 0;
+        size_t nlocal = local ? local->nkids : 0;
+        while (i < nlocal || j < remote.nkids)
+        {
+            tree_node_t *l = i < nlocal ? &local->kids[i] : NULL;
+            tree_node_t *r = j < remote.nkids ? &remote.kids[j] : NULL;
+            int c = !l ? 1 : !r ? -1 : strcmp(l->name, r->name);
+            if (c == 0 && l->is_dir != r->is_dir)
+                c = -1;     /* a file replaced by a directory, or the reverse */
+
+            if (c < 0)
+            {
+                if (l->is_dir)
+                {
+                    char *path = join_rel(item->rel, l->name);
+                    if (path)
+                        diff_report_local(d, path, l);
+                    free(path);
+                }
+                else
+                    diff_report(d, '+', item->rel, l->name);
+                i++;
+            }
+            else if (c > 0)
+            {
+                if (r->is_dir)
+                    diff_enqueue(d, item->rel, r->name, NULL);
+                else
+                    diff_report(d, '-', item->rel, r->name);
+                j++;
+            }
+            else
+            {
+                int same = r->known && r->value == l->value;
+                if (!same && r->is_dir)
+                    diff_enqueue(d, item->rel, r->name, l);
+                else if (!same)
+                    diff_report(d, 'M', item->rel, r->name);
+                i++;
+                j++;
+            }
+        }
     }
 
-    if (recv_all(sockfd, buf, file_size) < 0)
+    tree_free(&remote);
+    return rc;
+}
+
+/**
+ * @brief GET the remote files recorded by a DIFF -g.
+ *
+ * @return 0 on success, or 1 if any download failed.
+ */
+static int diff_fetch(diff_t *d)
+{
+    int rc = 0;
+    for (size_t i = 0; i < d->fetch_len; i++)
     {
-        free(buf);
-        close(sockfd);
-        return 1;
+        char local[RFS_MAX_PATH];
+        char remote[RFS_MAX_PATH];
+        snprintf(local, sizeof(local), "%s/%s", d->local_root, d->fetch[i]);
+        snprintf(remote, sizeof(remote), "%s%s%s", d->remote_root,
+                 d->remote_root[0] ? "/" : "", d->fetch[i]);
+
+        /* create missing parent directories */
+        for (char *p = local + strlen(d->local_root) + 1; (p = strchr(p, '/')); p++)
+        {
+            *p = '\0';
+            if (mkdir(local, 0755) < 0 && errno != EEXIST)
+                perror(local);
+            *p = '/';
+        }
+        timing_begin("GET", remote);
+        int get_rc = do_get(remote, local, -1);
+        timing_end(get_rc);
+        if (get_rc != 0)
+            rc = 1;
     }
+    return rc;
+}
+
+/**
+ * @brief Execute the DIFF client command (Merkle tree comparison).
+ *
+ * Both trees are compared top-down. Each round trip asks for one level:
+ * up to DIFF_WINDOW TREE requests are pipelined on one session, and
+ * only subdirectories whose digests differ are looked at on the next
+ * level, so a large tree with a few changes costs about one round trip
+ * per level of the changed paths. Differences are printed as
+ * "M path" (contents differ), "+ path" (local only) or "- path"
+ * (remote only).
+ *
+ * @param local_dir Local directory.
+ * @param remote_dir Remote directory ("" or "/" for the root).
+ * @param fetch Non-zero to GET every file marked M or - afterwards.
+ *
+ * @return 0 if the trees are identical (or -g fetched everything),
+ *         2 if they differ, or 1 on error.
+ */
+int do_diff(const char *local_dir, const char *remote_dir, int fetch)
+{
+    while (remote_dir[0] == '/')
+        remote_dir++;
+    if (strcmp(remote_dir, ".") == 0)
+        remote_dir = "";
 
-    FILE *fp = fopen(local_path, "wb");
-    if (!fp)
+    tree_node_t local = { NULL, 1, 1, 0, 0, NULL, 0 };
+    if (tree_build_local(local_dir, &local) < 0)
     {
-        perror("fopen local");
-        free(buf);
-        close(sockfd);
+        tree_free(&local);
         return 1;
     }
 
-    size_t written = fwrite(buf, 1, file_size, fp);
-    fclose(fp);
-    free(buf);
-    close(sockfd);
-
-    if (written != file_size)
+    timing_begin("DIFF", remote_dir);
+    int sockfd = open_session();
+    if (sockfd < 0)
     {
-        fprintf(stderr, "Short write to '%s'\n", local_path);
+        timing_end(1);
+        tree_free(&local);
         return 1;
     }
 
-    if (version > 0)
+    diff_t d;
+    memset(&d, 0, sizeof(d));
+    d.local_root = local_dir;
+    d.remote_root = remote_dir;
+    if (fetch)
     {
-        printf("GET -v %d complete: %s -> %s (%u bytes)\n",
-               version, remote_to_send, local_path, file_size);
+        d.fetch_cap = 16;
+        d.fetch = (char **)malloc(d.fetch_cap * sizeof(char *));
+        if (!d.fetch)
+            d.failed = 1;
     }
-    else
+    diff_enqueue(&d, "", "", &local);
+
+    /* one level per pass; each pass pipelines that level's requests */
+    size_t done = 0;
+    int rc = 0;
+    while (rc == 0 && !d.failed && done < d.queue_len)
     {
-        printf("GET complete: %s -> %s (%u bytes)\n",
-               remote_to_send, local_path, file_size);
+        size_t level_end = d.queue_len;
+        size_t sent = done;
+        while (rc == 0 && done < level_end)
+        {
+            if (sent == done)
+                d.round_trips++;
+            while (sent < level_end && sent - done < DIFF_WINDOW)
+            {
+                char remote[RFS_MAX_PATH];
+                snprintf(remote, sizeof(remote), "%s%s%s", remote_dir,
+                         remote_dir[0] && d.queue[sent].rel[0] ? "/" : "",
+                         d.queue[sent].rel);
+                if (send_request(sockfd, "TREE ", 0, remote, 0, 0) < 0)
+                {
+                    rc = -1;
+                    break;
+                }
+                d.requests++;
+                sent++;
+            }
+            if (rc == 0)
+                rc = diff_level_reply(sockfd, &d, &d.queue[done]);
+            done++;
+        }
     }
+    close(sockfd);
 
-    return 0;
+    if (rc == 0 && !d.failed)
+        printf("DIFF: %lu difference%s (%lu requests, %lu round trips)\n",
+               d.differences, d.differences == 1 ? "" : "s",
+               d.requests, d.round_trips);
+    else if (d.failed)
+        fprintf(stderr, "DIFF error: out of memory\n");
+
+    int result = (rc < 0 || d.failed) ? 1 : d.differences ? 2 : 0;
+    timing_end(result == 1);
+    if (result == 2 && fetch)
+        result = diff_fetch(&d);
+
+    for (size_t i = 0; i < d.queue_len; i++)
+        free(d.queue[i].rel);
+    for (size_t i = 0; i < d.fetch_len; i++)
+        free(d.fetch[i]);
+    free(d.queue);
+    free(d.fetch);
+    tree_free(&local);
+    return result;
 }
 
 /*------------------------------------------------------------*/
-/*                            RM                              */
+/*                          SNAPSHOT                          */
 /*------------------------------------------------------------*/
 
 /**
- * @brief Implement the RM client command.
+ * @brief Implement the SNAPSHOT client command.
  *
- * Sends an RM request for @p remote_path to the server and interprets
- * the returned status code. Depending on the result, it prints a
- * success message or an appropriate error description.
+ * Asks the server to take (or delete) a point-in-time snapshot of the
+ * whole tree. A snapshot named N is then readable with
+ * "GET .snapshots/N/<path>".
  *
- * @param remote_path Remote path (file or directory) to remove.
+ * @param name Snapshot name (a single path component).
+ * @param delete Non-zero to delete the snapshot instead.
  *
- * @return 0 on success, or 1 if the removal fails (not found,
- *         directory not empty, or other server-side error).
+ * @return 0 on success, or 1 on error.
  */
-int do_rm(const char *remote_path)
+int do_snapshot(const char *name, int delete)
 {
-    int sockfd = connect_to_server();
+    int sockfd = open_session();
     if (sockfd < 0)
         return 1;
 
-    printf("Connected (RM)\n");
-
-    const char cmd[5] = {'R','M',' ',' ',' '};
-    if (send_all(sockfd, cmd, 5) < 0)
-    {
-        close(sockfd);
-        return 1;
-    }
-
-    uint32_t path_len = (uint32_t)strlen(remote_path);
-    uint32_t path_len_net = htonl(path_len);
-
-    if (send_all(sockfd, &path_len_net, 4) < 0 ||
-        send_all(sockfd, remote_path, path_len) < 0)
-    {
-        close(sockfd);
-        return 1;
-    }
+    printf("Connected (SNAPSHOT)\n");
 
-    /* Receive status */
-    uint32_t status_net;
-    if (recv_all(sockfd, &status_net, 4) < 0)
+    rfs_resp_t resp;
+    if (send_request(sockfd, "SNAP ", 0, name, 0,
+                     delete ? RFS_SNAP_DELETE : 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
     {
         close(sockfd);
         return 1;
     }
     close(sockfd);
 
-    uint32_t status = ntohl(status_net);
-
-    if (status == 0)
+    if (resp.status == RFS_OK)
     {
-        printf("RM success: '%s' deleted\n", remote_path);
+        if (delete)
+            printf("SNAPSHOT '%s' deleted\n", name);
+        else
+            printf("SNAPSHOT complete: '%s' (%llu files) -> .snapshots/%s/\n",
+                   name, (unsigned long long)resp.arg, name);
         return 0;
     }
-    if (status == 1)
-    {
-        fprintf(stderr, "RM error: '%s' not found\n", remote_path);
-    }
-    else if (status == 2)
-    {
-        fprintf(stderr, "RM error: directory not empty: '%s'\n", remote_path);
-    }
+
+    if (resp.status == RFS_ERR_EXISTS)
+        fprintf(stderr, "SNAPSHOT error: '%s' already exists\n", name);
+    else if (resp.status == RFS_ERR_NOT_FOUND)
+        fprintf(stderr, "SNAPSHOT error: '%s' not found\n", name);
+    else if (resp.status == RFS_ERR_BAD_REQUEST)
+        fprintf(stderr, "SNAPSHOT error: invalid name '%s'\n", name);
     else
-    {
-        fprintf(stderr, "RM error: removal failed for '%s' (status=%u)\n",
-                remote_path, status);
-    }
+        fprintf(stderr, "SNAPSHOT error: failed for '%s' (status=%u)\n",
+                name, resp.status);
     return 1;
 }
 
 /*------------------------------------------------------------*/
-/*                             LS                             */
+/*                            WATCH                           */
 /*------------------------------------------------------------*/
 
 /**
- * @brief Implement the LS client command for version listing.
+ * @brief Implement the WATCH client command.
  *
- * Sends an LS request for @p remote_path to the server, receives a
- * count of available versions, and then iterates through each entry,
- * printing the version name and its last modified timestamp in a
- * tabular format.
+ * Subscribes to changes under @p prefix and prints one line per event
+ * as the server pushes it:
  *
- * @param remote_path Remote file path whose versions should be listed.
+ *   EVENT WRITE <path> version=<N> size=<bytes>
+ *   EVENT RM <path>
  *
- * @return 0 on success (including the case of zero versions), or 1 on
- *         any error (networking or allocation).
+ * stdout is flushed after every event so the output can be piped.
+ *
+ * @param prefix Remote path prefix ("" for the whole tree).
+ * @param max_events Stop after this many events (0 = run until the
+ *                   server closes the connection or the process is
+ *                   interrupted).
+ *
+ * @return 0 on success, or 1 on error.
  */
-int do_ls(const char *remote_path)
+int do_watch(const char *prefix, unsigned long max_events)
 {
-    int sockfd = connect_to_server();
+    int sockfd = open_session();
     if (sockfd < 0)
         return 1;
 
-    printf("Connected (LS)\n");
-
-    const char cmd[5] = {'L','S',' ',' ',' '};
-    if (send_all(sockfd, cmd, 5) < 0)
-    {
-        close(sockfd);
-        return 1;
-    }
-
-    uint32_t path_len = (uint32_t)strlen(remote_path);
-    uint32_t path_len_net = htonl(path_len);
-
-    if (send_all(sockfd, &path_len_net, 4) < 0 ||
-        send_all(sockfd, remote_path, path_len) < 0)
+    rfs_resp_t resp;
+    if (send_request(sockfd, "WATCH", 0, prefix, 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
     {
         close(sockfd);
         return 1;
     }
-
-    /* Receive count */
-    uint32_t count_net;
-    if (recv_all(sockfd, &count_net, 4) < 0)
+    if (resp.status != RFS_OK)
     {
+        fprintf(stderr, "WATCH error: server refused (status=%u)\n", resp.status);
         close(sockfd);
         return 1;
     }
-    uint32_t count = ntohl(count_net);
-
-    if (count == 0)
-    {
-        printf("No versions found for '%s'\n", remote_path);
-        close(sockfd);
-        return 0;
-    }
 
-    printf("Versions for '%s':\n", remote_path);
-    printf("  %-30s  %s\n", "NAME", "LAST MODIFIED");
+    printf("Watching '%s'\n", prefix);
+    fflush(stdout);
 
-    for (uint32_t i = 0; i < count; i++)
+    unsigned long seen = 0;
+    while (max_events == 0 || seen < max_events)
     {
-        uint32_t name_len_net, ts_len_net;
-
-        if (recv_all(sockfd, &name_len_net, 4) < 0 ||
-            recv_all(sockfd, &ts_len_net, 4) < 0)
-        {
-            close(sockfd);
-            return 1;
-        }
-
-        uint32_t name_len = ntohl(name_len_net);
-        uint32_t ts_len   = ntohl(ts_len_net);
-
-        char *name_buf = (char *)malloc(name_len + 1);
-        char *ts_buf   = (char *)malloc(ts_len + 1);
-        if (!name_buf || !ts_buf)
-        {
-            perror("malloc");
-            free(name_buf);
-            free(ts_buf);
-            close(sockfd);
-            return 1;
-        }
+        if (recv_response(sockfd, &resp) < 0)
+            break;      /* server stopped or dropped us */
 
-        if (recv_all(sockfd, name_buf, name_len) < 0 ||
-            recv_all(sockfd, ts_buf, ts_len) < 0)
+        if (!(resp.flags & RFS_F_EVENT) || resp.payload_len < 16 ||
+            resp.payload_len - 16 >= RFS_MAX_PATH)
         {
-            free(name_buf);
-            free(ts_buf);
+            fprintf(stderr, "WATCH error: malformed event\n");
             close(sockfd);
             return 1;
         }
 
-        name_buf[name_len] = '\0';
-        ts_buf[ts_len]     = '\0';
-
-        printf("  %-30s  %s\n", name_buf, ts_buf);
-
-        free(name_buf);
-        free(ts_buf);
+        uint8_t fixed[16];
+        char path[RFS_MAX_PATH];
+        size_t path_len = (size_t)resp.payload_len - 16;
+        if (recv_all(sockfd, fixed, sizeof(fixed)) < 0 ||
+            recv_all(sockfd, path, path_len) < 0)
+            break;
+        path[path_len] = '\0';
+
+        uint32_t event, version;
+        memcpy(&event, fixed, 4);
+        memcpy(&version, fixed + 4, 4);
+        event   = ntohl(event);
+        version = ntohl(version);
+
+        if (event == RFS_EV_WRITE)
+            printf("EVENT WRITE %s version=%u size=%llu\n", path, version,
+                   (unsigned long long)rfs_get_u64(fixed + 8));
+        else
+            printf("EVENT RM %s\n", path);
+        fflush(stdout);
+        seen++;
     }
 
     close(sockfd);
@@ -628,31 +2608,24 @@ int do_ls(const char *remote_path)
  */
 int do_stop(void)
 {
-    int sockfd = connect_to_server();
+    int sockfd = open_session();
     if (sockfd < 0)
         return 1;
 
     printf("Connected (STOP)\n");
 
-    const char cmd[5] = {'S','T','O','P',' '};
-    if (send_all(sockfd, cmd, 5) < 0)
+    rfs_resp_t resp;
+    if (send_request(sockfd, "STOP ", 0, "", 0, 0) < 0 ||
+        recv_response(sockfd, &resp) < 0)
     {
         close(sockfd);
         return 1;
     }
 
-    uint32_t status_net;
-    if (recv_all(sockfd, &status_net, 4) < 0)
-    {
-        close(sockfd);
-        return 1;
-    }
-
-    uint32_t status = ntohl(status_net);
-    if (status == 0)
+    if (resp.status == RFS_OK)
         printf("Server is shutting down.\n");
     else
-        printf("STOP command failed (status=%u).\n", status);
+        printf("STOP command failed (status=%u).\n", resp.status);
 
     close(sockfd);
     return 0;
@@ -667,12 +2640,26 @@ int do_stop(void)
  *
  * Parses command-line arguments and dispatches to the appropriate
  * client handler:
- *  - WRITE local-path [remote-path]
+ *  - WRITE [-j N] local-path [remote-path]
+ *  - SYNC  local-path [remote-path]
+ *  - APPEND local-path remote-path
+ *  - PATCH -o OFFSET local-path remote-path
+ *  - DIFF  [-g] local-dir [remote-dir]
  *  - GET   [-v N] remote-path [local-path]
  *  - RM    remote-path
- *  - LS    remote-path
+ *  - COPY  remote-path new-remote-path
+ *  - MOVE  remote-path new-remote-path
+ *  - LS    [-n N] remote-path
+ *  - STAT  remote-path
+ *  - LIST  [prefix]
+ *  - STATS [-n N]
+ *  - SNAPSHOT [-d] name
+ *  - WATCH [-n N] [prefix]
  *  - STOP
  *
+ * A leading --stats option prints a timing line for each transfer to
+ * stderr (see timing.h).
+ *
  * On incorrect usage or unknown commands, a usage message is printed
  * to stderr.
  *
@@ -686,15 +2673,36 @@ int do_stop(void)
  */
 int main(int argc, char *argv[])
 {
+    if (argc >= 2 && strcmp(argv[1], "--stats") == 0)
+    {
+        timing_enable();
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
     if (argc < 2)
     {
         fprintf(stderr,
-                "Usage:\n"
-                "  %s WRITE local-path [remote-path]\n"
+                "Usage: %s [--stats] COMMAND ...\n"
+                "  %s WRITE [-j N] local-path [remote-path]\n"
+                "  %s SYNC  local-path [remote-path]\n"
+                "  %s APPEND local-path remote-path\n"
+                "  %s PATCH -o OFFSET local-path remote-path\n"
+                "  %s DIFF  [-g] local-dir [remote-dir]\n"
                 "  %s GET   [-v N] remote-path [local-path]\n"
                 "  %s RM    remote-path\n"
-                "  %s LS    remote-path\n"
+                "  %s COPY  remote-path new-remote-path\n"
+                "  %s MOVE  remote-path new-remote-path\n"
+                "  %s LS    [-n N] remote-path\n"
+                "  %s STAT  remote-path\n"
+                "  %s LIST  [prefix]\n"
+                "  %s STATS [-n N]\n"
+                "  %s SNAPSHOT [-d] name\n"
+                "  %s WATCH [-n N] [prefix]\n"
                 "  %s STOP\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
                 argv[0], argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
@@ -702,15 +2710,79 @@ int main(int argc, char *argv[])
     const char *cmd = argv[1];
 
     if (strcmp(cmd, "WRITE") == 0)
+    {
+        int streams = 1;
+        int idx = 2;
+        if (argc >= 4 && strcmp(argv[2], "-j") == 0)
+        {
+            streams = atoi(argv[3]);
+            idx = 4;
+        }
+        if (argc <= idx || streams < 1 || streams > UPLOAD_MAX_STREAMS)
+        {
+            fprintf(stderr, "Usage: %s WRITE [-j N] local-path [remote-path]\n"
+                    "  (N = 1..%d parallel connections)\n",
+                    argv[0], UPLOAD_MAX_STREAMS);
+            return 1;
+        }
+        const char *local_path  = argv[idx];
+        const char *remote_path = (argc > idx + 1) ? argv[idx + 1] : argv[idx];
+        timing_begin("WRITE", remote_path);
+        int rc = do_write(local_path, remote_path, streams);
+        timing_end(rc);
+        return rc;
+    }
+    else if (strcmp(cmd, "SYNC") == 0)
     {
         if (argc < 3)
         {
-            fprintf(stderr, "Usage: %s WRITE local-path [remote-path]\n", argv[0]);
+            fprintf(stderr, "Usage: %s SYNC local-path [remote-path]\n", argv[0]);
+            return 1;
+        }
+        const char *remote_path = argc > 3 ? argv[3] : argv[2];
+        timing_begin("SYNC", remote_path);
+        int rc = do_sync(argv[2], remote_path);
+        timing_end(rc);
+        return rc;
+    }
+    else if (strcmp(cmd, "APPEND") == 0)
+    {
+        if (argc < 4)
+        {
+            fprintf(stderr, "Usage: %s APPEND local-path remote-path\n", argv[0]);
+            return 1;
+        }
+        timing_begin("APPEND", argv[3]);
+        int rc = do_append(argv[2], argv[3]);
+        timing_end(rc);
+        return rc;
+    }
+    else if (strcmp(cmd, "PATCH") == 0)
+    {
+        char *end = NULL;
+        unsigned long long offset = 0;
+        if (argc >= 4 && strcmp(argv[2], "-o") == 0)
+            offset = strtoull(argv[3], &end, 10);
+        if (argc < 6 || !end || *end != '\0' || argv[3][0] == '-')
+        {
+            fprintf(stderr, "Usage: %s PATCH -o OFFSET local-path remote-path\n", argv[0]);
+            return 1;
+        }
+        timing_begin("PATCH", argv[5]);
+        int rc = do_patch(argv[4], argv[5], (uint64_t)offset);
+        timing_end(rc);
+        return rc;
+    }
+    else if (strcmp(cmd, "DIFF") == 0)
+    {
+        int fetch = argc > 2 && strcmp(argv[2], "-g") == 0;
+        int idx = fetch ? 3 : 2;
+        if (argc <= idx)
+        {
+            fprintf(stderr, "Usage: %s DIFF [-g] local-dir [remote-dir]\n", argv[0]);
             return 1;
         }
-        const char *local_path  = argv[2];
-        const char *remote_path = (argc >= 4) ? argv[3] : argv[2];
-        return do_write(local_path, remote_path);
+        return do_diff(argv[idx], argc > idx + 1 ? argv[idx + 1] : argv[idx], fetch);
     }
     else if (strcmp(cmd, "GET") == 0)
     {
@@ -742,7 +2814,10 @@ int main(int argc, char *argv[])
         if (argc > idx + 1)
             local_path = argv[idx + 1];
 
-        return do_get(remote_path, local_path, version);
+        timing_begin("GET", remote_path);
+        int rc = do_get(remote_path, local_path, version);
+        timing_end(rc);
+        return rc;
     }
     else if (strcmp(cmd, "RM") == 0)
     {
@@ -753,14 +2828,71 @@ int main(int argc, char *argv[])
         }
         return do_rm(argv[2]);
     }
+    else if (strcmp(cmd, "COPY") == 0 || strcmp(cmd, "MOVE") == 0)
+    {
+        if (argc < 4)
+        {
+            fprintf(stderr, "Usage: %s %s remote-path new-remote-path\n", argv[0], cmd);
+            return 1;
+        }
+        return do_copy(argv[2], argv[3], strcmp(cmd, "MOVE") == 0);
+    }
     else if (strcmp(cmd, "LS") == 0)
+    {
+        uint32_t page_size = 0;
+        int idx = 2;
+        if (argc >= 4 && strcmp(argv[2], "-n") == 0)
+        {
+            page_size = (uint32_t)strtoul(argv[3], NULL, 10);
+            idx = 4;
+        }
+        if (argc <= idx)
+        {
+            fprintf(stderr, "Usage: %s LS [-n N] remote-path\n", argv[0]);
+            return 1;
+        }
+        return do_ls(argv[idx], page_size);
+    }
+    else if (strcmp(cmd, "STAT") == 0)
     {
         if (argc < 3)
         {
-            fprintf(stderr, "Usage: %s LS remote-path\n", argv[0]);
+            fprintf(stderr, "Usage: %s STAT remote-path\n", argv[0]);
+            return 1;
+        }
+        return do_stat(argv[2]);
+    }
+    else if (strcmp(cmd, "LIST") == 0)
+    {
+        return do_list(argc >= 3 ? argv[2] : "");
+    }
+    else if (strcmp(cmd, "STATS") == 0)
+    {
+        uint32_t max = 0;
+        if (argc >= 4 && strcmp(argv[2], "-n") == 0)
+            max = (uint32_t)strtoul(argv[3], NULL, 10);
+        return do_stats(max);
+    }
+    else if (strcmp(cmd, "SNAPSHOT") == 0)
+    {
+        int delete = (argc >= 4 && strcmp(argv[2], "-d") == 0);
+        if (argc < 3 + delete)
+        {
+            fprintf(stderr, "Usage: %s SNAPSHOT [-d] name\n", argv[0]);
             return 1;
         }
-        return do_ls(argv[2]);
+        return do_snapshot(argv[2 + delete], delete);
+    }
+    else if (strcmp(cmd, "WATCH") == 0)
+    {
+        unsigned long max_events = 0;
+        int idx = 2;
+        if (argc >= 4 && strcmp(argv[2], "-n") == 0)
+        {
+            max_events = strtoul(argv[3], NULL, 10);
+            idx = 4;
+        }
+        return do_watch(argc > idx ? argv[idx] : "", max_events);
     }
     else if (strcmp(cmd, "STOP") == 0)
     {
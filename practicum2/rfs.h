@@ -12,9 +12,17 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#ifndef SERVER_IP
 #define SERVER_IP   "34.19.98.211"
+#endif
 #define SERVER_PORT 2000
 
+#define UPLOAD_PART_SIZE   (8 * 1024 * 1024) /* bytes per multipart part   */
+#define UPLOAD_PART_TRIES  4                 /* attempts per part          */
+#define UPLOAD_MAX_STREAMS 32                /* largest WRITE -j accepted  */
+
+#define IO_WINDOW (4 * 1024 * 1024) /* WRITE readahead / GET writeback step */
+
 /**
  * @brief Send exactly len bytes over a connected socket.
  *
@@ -63,9 +71,16 @@ int recv_all(int sockfd, void *buf, size_t len);
 const char *basename_const(const char *path);
 
 /**
- * @brief Establish a TCP connection to the remote file system server.
+ * @brief Establish a connection to the remote file system server.
+ *
+ * If SERVER_IP is an address of this host and the server's Unix
+ * socket (RFS_UNIX_PATH) accepts a connection, that is used so the
+ * TCP stack is skipped entirely. Otherwise a TCP socket is connected
+ * to SERVER_IP:SERVER_PORT. Setting RFS_TRANSPORT=tcp in the
+ * environment forces TCP. RFS_HOST and RFS_PORT select another
+ * server; another port also means TCP, since the Unix socket belongs
+ * to the server on SERVER_PORT.
  *
- * Creates a TCP socket and connects it to SERVER_IP:SERVER_PORT.
  * On success, the caller owns the returned socket descriptor and is
  * responsible for closing it.
  *
@@ -74,25 +89,74 @@ const char *basename_const(const char *path);
  */
 int connect_to_server(void);
 
+/**
+ * @brief Connect to the server and negotiate protocol v2.
+ *
+ * Calls connect_to_server() and performs the HELLO handshake (see
+ * protocol.h). The returned socket accepts any number of framed
+ * requests.
+ *
+ * @return A connected socket on success, or -1 on error.
+ */
+int open_session(void);
+
 /**
  * @brief Execute the WRITE client command.
  *
- * Reads the contents of @p local_path and sends a WRITE request to
- * the server, storing the data under @p remote_path on the remote
- * file system.
+ * Streams the contents of @p local_path to the server in a v2 WRITE
+ * request, storing the data under @p remote_path on the remote file
+ * system. Files of any size are sent through a fixed-size buffer.
+ * With @p streams > 1, a file larger than UPLOAD_PART_SIZE is split
+ * into parts sent in parallel over that many connections, each part
+ * retried on its own if it fails, and committed as one new version.
  *
  * @param local_path Path to the local file to upload.
  * @param remote_path Remote path under which the server should store
  *                    the file (possibly as a versioned object).
+ * @param streams Number of parallel connections (1 for a plain WRITE).
+ *
+ * @return 0 on success, or 1 on I/O or networking error.
+ */
+int do_write(const char *local_path, const char *remote_path, int streams);
+
+/**
+ * @brief Execute the SYNC client command (delta upload).
  *
- * @return 0 on success, or 1 on I/O, allocation, or networking error.
+ * Fetches the block signatures of the server's current version of
+ * @p remote_path and uploads only the parts of @p local_path that
+ * differ, as block references and literal data (see delta.h). The
+ * server rebuilds the file and stores it as a new version, exactly as
+ * a WRITE would. Falls back to a whole-file WRITE if the remote file
+ * does not exist or changes before the delta arrives.
+ *
+ * @param local_path Path to the local file to upload.
+ * @param remote_path Remote path of the file to update.
+ *
+ * @return 0 on success, or 1 on I/O or networking error.
  */
-int do_write(const char *local_path, const char *remote_path);
+int do_sync(const char *local_path, const char *remote_path);
+
+/**
+ * @brief Execute the DIFF client command (Merkle tree comparison).
+ *
+ * Compares a local directory with a remote one top-down using the
+ * server's per-directory digests (TREE), descending only into
+ * subdirectories that differ, and prints "M path", "+ path" (local
+ * only) or "- path" (remote only) for each differing file.
+ *
+ * @param local_dir Local directory.
+ * @param remote_dir Remote directory ("" or "/" for the root).
+ * @param fetch Non-zero to GET every file marked M or - afterwards.
+ *
+ * @return 0 if the trees are identical (or -g fetched everything),
+ *         2 if they differ, or 1 on error.
+ */
+int do_diff(const char *local_dir, const char *remote_dir, int fetch);
 
 /**
  * @brief Execute the GET client command with optional versioning.
  *
- * Requests a file from the server and writes it to a local file.
+ * Requests a file from the server and streams it to a local file.
  * If @p version is greater than 0, a specific version is requested;
  * otherwise, the newest version is retrieved.
  *
@@ -120,18 +184,132 @@ int do_get(const char *remote_path, const char *maybe_local_path, int version);
  */
 int do_rm(const char *remote_path);
 
+/**
+ * @brief Execute the APPEND client command.
+ *
+ * Adds the contents of @p local_path to the end of @p remote_path,
+ * creating it if needed. Only the new bytes are sent; the remote file
+ * grows in place and keeps its version number.
+ *
+ * @param local_path Local file holding the bytes to append.
+ * @param remote_path Remote file to append to.
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_append(const char *local_path, const char *remote_path);
+
+/**
+ * @brief Execute the PATCH client command.
+ *
+ * Writes the contents of @p local_path into @p remote_path at
+ * @p offset, which may extend the file but not leave a hole. The
+ * result is stored as a new version; only the patch bytes are sent.
+ *
+ * @param local_path Local file holding the new bytes.
+ * @param remote_path Remote file to patch.
+ * @param offset Byte offset in the remote file (at most its size).
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_patch(const char *local_path, const char *remote_path, uint64_t offset);
+
+/**
+ * @brief Execute the COPY or MOVE client command.
+ *
+ * The server copies or renames @p src, with all of its versions, to
+ * @p dst; no file data crosses the network.
+ *
+ * @param src Remote path of an existing file.
+ * @param dst Remote path it is copied or moved to (must not exist).
+ * @param move Non-zero for MOVE, zero for COPY.
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_copy(const char *src, const char *dst, int move);
+
 /**
  * @brief Execute the LS client command to list file versions.
  *
  * Requests versioning information for @p remote_path from the server,
- * then prints each version name and its last modified timestamp.
+ * then prints each version name and its last modified timestamp. If
+ * @p remote_path is a directory, its entries are listed instead with
+ * their version counts and sizes, fetched in pages.
  *
  * @param remote_path Remote file path whose versions should be listed.
+ * @param page_size Directory entries per page (0 for the server default).
  *
  * @return 0 on success (including when no versions exist), or 1 on
  *         networking or allocation error.
  */
-int do_ls(const char *remote_path);
+int do_ls(const char *remote_path, uint32_t page_size);
+
+/**
+ * @brief Execute the STAT client command.
+ *
+ * Prints the server's indexed metadata (version, size, mtime and
+ * checksum) for one file without transferring it.
+ *
+ * @param remote_path Remote file to describe.
+ *
+ * @return 0 on success, or 1 if not found or on error.
+ */
+int do_stat(const char *remote_path);
+
+/**
+ * @brief Execute the LIST client command.
+ *
+ * Lists every stored file whose path starts with @p prefix, with its
+ * current version, size and modification time, as recorded in the
+ * server's metadata index.
+ *
+ * @param prefix Remote path prefix ("" for the whole tree).
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_list(const char *prefix);
+
+/**
+ * @brief Execute the STATS client command.
+ *
+ * Shows the server's heavy hitters: the paths read and written most
+ * often, with estimated request and byte counts (count-min sketch, so
+ * they may be slightly high).
+ *
+ * @param max Paths to show (0 for every tracked path).
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_stats(uint32_t max);
+
+/**
+ * @brief Execute the SNAPSHOT client command.
+ *
+ * Asks the server to capture a point-in-time snapshot of the whole
+ * tree (hard links, no data copies) under .snapshots/@p name, or to
+ * delete that snapshot.
+ *
+ * @param name Snapshot name (a single path component).
+ * @param delete Non-zero to delete the snapshot instead of creating it.
+ *
+ * @return 0 on success, or 1 on error (exists, not found, invalid
+ *         name, or networking).
+ */
+int do_snapshot(const char *name, int delete);
+
+/**
+ * @brief Execute the WATCH client command.
+ *
+ * Subscribes to change notifications for every remote path starting
+ * with @p prefix and prints each WRITE or RM as the server pushes it,
+ * replacing LS polling.
+ *
+ * @param prefix Remote path prefix ("" for the whole tree).
+ * @param max_events Number of events to print before returning, or 0
+ *                   to keep watching until the connection ends.
+ *
+ * @return 0 on success, or 1 on error.
+ */
+int do_watch(const char *prefix, unsigned long max_events);
 
 /**
  * @brief Execute the STOP client command.
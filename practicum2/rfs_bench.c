@@ -0,0 +1,1009 @@
+/*
+ * rfs_bench.c -- closed-loop load generator for the RFS server
+ *
+ * Each of -c worker threads opens one protocol v2 connection and
+ * issues requests back to back for -d seconds, choosing the operation
+ * from the -m mix and the key from a Zipf(-z) distribution over -k
+ * keys. Every request is timed from the first byte sent to the last
+ * byte of the reply received.
+ *
+ * With -L the workers instead share one librfs client handle (pool of
+ * -c connections) and issue every request through the library calls,
+ * which measures the in-process API a service would embed.
+ *
+ * With -A N a single thread drives the librfs asynchronous interface
+ * instead: it keeps N requests in flight over -c pipelined connections,
+ * issuing a new request from each completion callback.
+ *
+ * The report is one JSON object on stdout (throughput, MB/s and
+ * p50/p99/p999 latency overall and per operation) so it can be fed to
+ * scripts; a short human-readable summary goes to stderr. The exit
+ * status is 1 if any connection failed during the run.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "protocol.h"
+#include "local.h"
+#include "librfs.h"
+
+#define BENCH_PORT 2000
+#define BENCH_PREFIX "bench/k"
+
+/* Operations, in the order used by -m and the report */
+enum { OP_WRITE, OP_GET, OP_LS, OP_RM, NUM_OPS };
+
+static const char *op_names[NUM_OPS]    = { "WRITE", "GET", "LS", "RM" };
+static const char  op_cmds[NUM_OPS][6]  = { "WRITE", "GET  ", "LS   ", "RM   " };
+
+/* Latencies of one operation type, in microseconds */
+typedef struct
+{
+    uint32_t *us;
+    size_t count;
+    size_t cap;
+    uint64_t bytes;     /* payload bytes moved (sent for WRITE, received otherwise) */
+    uint64_t errors;
+    uint64_t misses;    /* GET / LS / RM of a key that does not exist */
+} op_stats_t;
+
+typedef struct
+{
+    int id;
+    pthread_t tid;
+    uint64_t rng;
+    op_stats_t ops[NUM_OPS];
+    int failed;         /* connection lost; thread stopped early */
+} worker_t;
+
+/* Command-line configuration */
+static const char *host = "127.0.0.1";
+static int port = BENCH_PORT;
+static int use_unix = 0;
+static int concurrency = 4;
+static double duration = 10.0;
+static int num_keys = 1000;
+static double zipf_s = 0.99;
+static uint64_t size_min = 4096;
+static uint64_t size_max = 4096;
+static int mix[NUM_OPS] = { 20, 70, 5, 5 };
+static int prepopulate = 1;
+static int use_lib = 0;
+static rfs_client_t *lib_client = NULL;     /* shared by workers with -L */
+static int async_depth = 0;                 /* -A: requests kept in flight */
+static rfs_async_t *lib_async = NULL;
+
+/* Shared run state */
+static double *zipf_cdf = NULL;
+static uint8_t *payload = NULL;
+static volatile int running = 1;
+static struct timespec stop_at;
+
+/*------------------------------------------------------------*/
+/*                      Socket helpers                        */
+/*      (send_all / recv_all come from librfs)                */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Open a v2 session to the server under test.
+ *
+ * @return A connected socket after a successful HELLO, or -1.
+ */
+static int open_session(void)
+{
+    int sockfd;
+
+    if (use_unix)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", RFS_UNIX_PATH);
+
+        sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sockfd < 0 ||
+            connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            perror("connect");
+            if (sockfd >= 0)
+                close(sockfd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+        {
+            fprintf(stderr, "Invalid host address: %s\n", host);
+            return -1;
+        }
+
+        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (sockfd < 0 ||
+            connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            perror("connect");
+            if (sockfd >= 0)
+                close(sockfd);
+            return -1;
+        }
+
+        /* requests are small writes followed by a read; don't batch them */
+        int one = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    if (rfs_client_hello(sockfd) < 0)
+    {
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+/**
+ * @brief Read and discard @p len bytes from a socket.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int drain(int sockfd, uint64_t len)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    while (len > 0)
+    {
+        size_t chunk = len < sizeof(buf) ? (size_t)len : sizeof(buf);
+        if (recv_all(sockfd, buf, chunk) < 0)
+            return -1;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+/*                 Random numbers and key choice              */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief xorshift64* step: fast, per-thread, good enough for load mixes.
+ */
+static uint64_t next_rand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+/** @brief Uniform double in [0, 1). */
+static double next_unit(uint64_t *state)
+{
+    return (double)(next_rand(state) >> 11) / 9007199254740992.0;
+}
+
+/**
+ * @brief Precompute the Zipf CDF over @c num_keys keys.
+ *
+ * Key i (0-based) has weight 1 / (i + 1)^s; s = 0 is uniform.
+ *
+ * @return 0 on success, or -1 on allocation failure.
+ */
+static int build_zipf(void)
+{
+    zipf_cdf = (double *)malloc((size_t)num_keys * sizeof(double));
+    if (!zipf_cdf)
+        return -1;
+
+    double total = 0;
+    for (int i = 0; i < num_keys; i++)
+    {
+        total += 1.0 / pow((double)(i + 1), zipf_s);
+        zipf_cdf[i] = total;
+    }
+    for (int i = 0; i < num_keys; i++)
+        zipf_cdf[i] /= total;
+    return 0;
+}
+
+/** @brief Draw a key index from the Zipf distribution. */
+static int pick_key(uint64_t *state)
+{
+    double u = next_unit(state);
+    int lo = 0, hi = num_keys - 1;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (zipf_cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/** @brief Draw an operation according to the -m mix. */
+static int pick_op(uint64_t *state)
+{
+    int total = 0;
+    for (int i = 0; i < NUM_OPS; i++)
+        total += mix[i];
+
+    int r = (int)(next_rand(state) % (uint64_t)total);
+    for (int i = 0; i < NUM_OPS; i++)
+    {
+        if (r < mix[i])
+            return i;
+        r -= mix[i];
+    }
+    return OP_GET;
+}
+
+/** @brief Draw a WRITE size uniformly from [size_min, size_max]. */
+static uint64_t pick_size(uint64_t *state)
+{
+    if (size_max <= size_min)
+        return size_min;
+    return size_min + next_rand(state) % (size_max - size_min + 1);
+}
+
+/*------------------------------------------------------------*/
+/*                        Requests                            */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Issue one request and consume its reply.
+ *
+ * @param sockfd Open v2 session.
+ * @param op OP_WRITE, OP_GET, OP_LS or OP_RM.
+ * @param path Remote path.
+ * @param size WRITE payload size (ignored otherwise).
+ * @param bytes Receives the payload bytes moved.
+ *
+ * @return RFS_OK or a v2 status code, or -1 if the connection failed.
+ */
+static int do_request(int sockfd, int op, const char *path, uint64_t size,
+                      uint64_t *bytes)
+{
+    rfs_req_t req;
+    memcpy(req.cmd, op_cmds[op], 5);
+    req.flags = 0;
+    req.payload_len = (op == OP_WRITE) ? size : 0;
+    req.arg = 0;
+
+    if (rfs_send_request(sockfd, &req, path) < 0)
+        return -1;
+
+    *bytes = 0;
+    if (op == OP_WRITE)
+    {
+        uint64_t left = size;
+        while (left > 0)
+        {
+            size_t chunk = left < size_max ? (size_t)left : (size_t)size_max;
+            if (send_all(sockfd, payload, chunk) < 0)
+                return -1;
+            left -= chunk;
+        }
+        *bytes = size;
+    }
+
+    rfs_resp_t resp;
+    if (rfs_recv_response(sockfd, &resp) < 0)
+        return -1;
+    if (resp.payload_len > 0)
+    {
+        if (drain(sockfd, resp.payload_len) < 0)
+            return -1;
+        if (resp.flags & RFS_F_DATA_SUM)
+            (void)drain(sockfd, 8);
+        if (op != OP_WRITE)
+            *bytes = resp.payload_len;
+    }
+    return (int)resp.status;
+}
+
+/**
+ * @brief Map a librfs result to the status convention of do_request().
+ *
+ * RFS_E_* codes above -100 are negated v2 status codes; the rest mean
+ * the connection failed.
+ */
+static int lib_status(int rc)
+{
+    return rc > -100 ? -rc : -1;
+}
+
+/**
+ * @brief Issue one request through the librfs client handle (-L).
+ *
+ * @param op OP_WRITE, OP_GET, OP_LS or OP_RM.
+ * @param path Remote path.
+ * @param size WRITE payload size (ignored otherwise).
+ * @param buf GET destination of at least @c size_max bytes.
+ * @param bytes Receives the payload bytes moved.
+ *
+ * @return RFS_OK or a v2 status code, or -1 if the connection failed.
+ */
+static int do_lib_request(int op, const char *path, uint64_t size,
+                          uint8_t *buf, uint64_t *bytes)
+{
+    int rc;
+    size_t len = 0;
+    *bytes = 0;
+
+    switch (op)
+    {
+    case OP_WRITE:
+        rc = rfs_write(lib_client, path, payload, (size_t)size);
+        if (rc == RFS_E_OK)
+            *bytes = size;
+        break;
+    case OP_GET:
+        rc = rfs_read(lib_client, path, buf, (size_t)size_max, &len);
+        if (rc == RFS_E_OK)
+            *bytes = len;
+        break;
+    case OP_LS:
+    {
+        rfs_version_t *v;
+        size_t count;
+        rc = rfs_versions(lib_client, path, &v, &count);
+        if (rc == RFS_E_OK)
+            rfs_versions_free(v, count);
+        break;
+    }
+    default:
+        rc = rfs_remove(lib_client, path);
+        break;
+    }
+    return lib_status(rc);
+}
+
+/**
+ * @brief Append one latency sample.
+ *
+ * @return 0 on success, or -1 on allocation failure.
+ */
+static int record(op_stats_t *s, uint32_t us)
+{
+    if (s->count == s->cap)
+    {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        uint32_t *p = (uint32_t *)realloc(s->us, cap * sizeof(uint32_t));
+        if (!p)
+            return -1;
+        s->us = p;
+        s->cap = cap;
+    }
+    s->us[s->count++] = us;
+    return 0;
+}
+
+/** @brief Microseconds from @p a to @p b. */
+static uint64_t usec_between(const struct timespec *a, const struct timespec *b)
+{
+    int64_t ns = (int64_t)(b->tv_sec - a->tv_sec) * 1000000000LL +
+                 (b->tv_nsec - a->tv_nsec);
+    return ns > 0 ? (uint64_t)ns / 1000 : 0;
+}
+
+/** @brief Non-zero once @p now is past @c stop_at. */
+static int past_deadline(const struct timespec *now)
+{
+    return now->tv_sec > stop_at.tv_sec ||
+           (now->tv_sec == stop_at.tv_sec && now->tv_nsec >= stop_at.tv_nsec);
+}
+
+/**
+ * @brief Worker thread: closed loop of requests until the deadline.
+ *
+ * @param arg The thread's worker_t.
+ *
+ * @return NULL.
+ */
+static void *worker_main(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+
+    int sockfd = -1;
+    uint8_t *buf = NULL;
+    if (use_lib)
+        buf = (uint8_t *)malloc((size_t)size_max);
+    else
+        sockfd = open_session();
+    if (use_lib ? !buf : sockfd < 0)
+    {
+        w->failed = 1;
+        return NULL;
+    }
+
+    char path[64];
+    struct timespec start, end;
+
+    while (running)
+    {
+        int op = pick_op(&w->rng);
+        uint64_t size = (op == OP_WRITE) ? pick_size(&w->rng) : 0;
+        snprintf(path, sizeof(path), "%s%d", BENCH_PREFIX, pick_key(&w->rng));
+
+        uint64_t bytes = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int status = use_lib ? do_lib_request(op, path, size, buf, &bytes)
+                             : do_request(sockfd, op, path, size, &bytes);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (past_deadline(&end))
+            break;          /* finished after the window: not counted */
+
+        op_stats_t *s = &w->ops[op];
+        if (status < 0)
+        {
+            s->errors++;
+            w->failed = 1;
+            break;
+        }
+        if (status == RFS_ERR_NOT_FOUND)
+            s->misses++;
+        else if (status != RFS_OK)
+            s->errors++;
+
+        uint64_t us = usec_between(&start, &end);
+        if (record(s, us > UINT32_MAX ? UINT32_MAX : (uint32_t)us) < 0)
+            break;
+        s->bytes += bytes;
+    }
+
+    if (sockfd >= 0)
+        close(sockfd);
+    free(buf);
+    return NULL;
+}
+
+/*------------------------------------------------------------*/
+/*                   Asynchronous run (-A)                    */
+/*------------------------------------------------------------*/
+
+/* One of the -A requests kept in flight */
+typedef struct
+{
+    worker_t *w;        /* stats; only touched on the event-loop thread */
+    int op;
+    uint64_t size;
+    struct timespec start;
+} async_slot_t;
+
+static void async_done(rfs_completion_t *c);
+
+/**
+ * @brief Submit the next request of a slot.
+ *
+ * @return RFS_E_OK or the submission error.
+ */
+static int async_issue(async_slot_t *slot)
+{
+    worker_t *w = slot->w;
+    char path[64];
+    slot->op = pick_op(&w->rng);
+    slot->size = (slot->op == OP_WRITE) ? pick_size(&w->rng) : 0;
+    snprintf(path, sizeof(path), "%s%d", BENCH_PREFIX, pick_key(&w->rng));
+
+    clock_gettime(CLOCK_MONOTONIC, &slot->start);
+    switch (slot->op)
+    {
+    case OP_WRITE:
+        return rfs_async_write(lib_async, path, payload, (size_t)slot->size,
+                               async_done, slot);
+    case OP_GET:
+        return rfs_async_read(lib_async, path, async_done, slot);
+    case OP_LS:
+        return rfs_async_versions(lib_async, path, async_done, slot);
+    default:
+        return rfs_async_remove(lib_async, path, async_done, slot);
+    }
+}
+
+/**
+ * @brief Completion callback: record the request and issue the next.
+ *
+ * Runs on the librfs event-loop thread, which is the only thread that
+ * touches the slots' stats during the run. A transport failure is
+ * counted as an error but not timed, and retires the slot, as it stops
+ * a blocking worker.
+ */
+static void async_done(rfs_completion_t *c)
+{
+    async_slot_t *slot = (async_slot_t *)c->user;
+    worker_t *w = slot->w;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    uint64_t bytes = 0;
+    if (c->result == RFS_E_OK)
+        bytes = slot->op == OP_WRITE ? slot->size : c->len;
+    if (c->op == RFS_OP_READ)
+        free(c->data);
+    if (c->op == RFS_OP_VERSIONS)
+        rfs_versions_free(c->versions, c->count);
+
+    if (!running || past_deadline(&end))
+        return;         /* finished after the window: not counted */
+
+    op_stats_t *s = &w->ops[slot->op];
+    int status = lib_status(c->result);
+    if (status < 0)
+    {
+        s->errors++;
+        w->failed = 1;
+        return;
+    }
+    if (status == RFS_ERR_NOT_FOUND)
+        s->misses++;
+    else if (status != RFS_OK)
+        s->errors++;
+
+    uint64_t us = usec_between(&slot->start, &end);
+    if (record(s, us > UINT32_MAX ? UINT32_MAX : (uint32_t)us) < 0)
+        return;
+    s->bytes += bytes;
+
+    if (async_issue(slot) != RFS_E_OK)
+        w->failed = 1;
+}
+
+/**
+ * @brief Start the -A run: fill the pipeline with async_depth requests.
+ *
+ * @param w Worker record that collects every sample.
+ *
+ * @return The slots to free after rfs_async_close(), or NULL on error.
+ */
+static async_slot_t *async_start(worker_t *w)
+{
+    lib_async = rfs_async_open(lib_client, concurrency, async_depth);
+    async_slot_t *slots = (async_slot_t *)calloc((size_t)async_depth,
+                                                 sizeof(async_slot_t));
+    if (!lib_async || !slots)
+    {
+        free(slots);
+        return NULL;
+    }
+    for (int i = 0; i < async_depth; i++)
+    {
+        slots[i].w = w;
+        if (async_issue(&slots[i]) != RFS_E_OK)
+            w->failed = 1;
+    }
+    return slots;
+}
+
+/*------------------------------------------------------------*/
+/*                         Reporting                          */
+/*------------------------------------------------------------*/
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/** @brief Nearest-rank percentile of a sorted sample array. */
+static uint32_t percentile(const uint32_t *sorted, size_t n, double p)
+{
+    if (n == 0)
+        return 0;
+    size_t rank = (size_t)ceil(p / 100.0 * (double)n);
+    if (rank < 1)
+        rank = 1;
+    return sorted[rank - 1];
+}
+
+/**
+ * @brief Print one latency/throughput object for a merged sample set.
+ *
+ * @param s Merged stats; @c us is sorted in place.
+ * @param secs Measured run time.
+ */
+static void print_stats(op_stats_t *s, double secs)
+{
+    qsort(s->us, s->count, sizeof(uint32_t), cmp_u32);
+
+    double sum = 0;
+    for (size_t i = 0; i < s->count; i++)
+        sum += s->us[i];
+
+    printf("{\"ops\":%zu,\"ops_per_s\":%.1f,\"mb_per_s\":%.3f,"
+           "\"errors\":%llu,\"misses\":%llu,"
+           "\"latency_us\":{\"mean\":%.1f,\"p50\":%u,\"p99\":%u,"
+           "\"p999\":%u,\"max\":%u}}",
+           s->count, (double)s->count / secs,
+           (double)s->bytes / secs / 1e6,
+           (unsigned long long)s->errors, (unsigned long long)s->misses,
+           s->count ? sum / (double)s->count : 0.0,
+           percentile(s->us, s->count, 50),
+           percentile(s->us, s->count, 99),
+           percentile(s->us, s->count, 99.9),
+           s->count ? s->us[s->count - 1] : 0);
+}
+
+/**
+ * @brief Append every sample of @p src to @p dst.
+ *
+ * @return 0 on success, or -1 on allocation failure.
+ */
+static int merge(op_stats_t *dst, const op_stats_t *src)
+{
+    if (dst->count + src->count > dst->cap)
+    {
+        size_t cap = dst->count + src->count;
+        uint32_t *p = (uint32_t *)realloc(dst->us, (cap ? cap : 1) * sizeof(uint32_t));
+        if (!p)
+            return -1;
+        dst->us = p;
+        dst->cap = cap;
+    }
+    if (src->count)
+        memcpy(dst->us + dst->count, src->us, src->count * sizeof(uint32_t));
+    dst->count  += src->count;
+    dst->bytes  += src->bytes;
+    dst->errors += src->errors;
+    dst->misses += src->misses;
+    return 0;
+}
+
+/*------------------------------------------------------------*/
+/*                           Setup                            */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Parse a byte count with an optional K/M/G suffix.
+ *
+ * @return The value, or 0 if @p s is not a valid size.
+ */
+static uint64_t parse_size(const char *s)
+{
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (end == s)
+        return 0;
+    switch (*end)
+    {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    default: break;
+    }
+    return *end == '\0' ? (uint64_t)v : 0;
+}
+
+/**
+ * @brief Parse "-s SIZE" or "-s MIN:MAX".
+ *
+ * @return 0 on success, or -1 on a malformed argument.
+ */
+static int parse_sizes(const char *arg)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", arg);
+
+    char *colon = strchr(buf, ':');
+    if (colon)
+    {
+        *colon = '\0';
+        size_min = parse_size(buf);
+        size_max = parse_size(colon + 1);
+    }
+    else
+    {
+        size_min = size_max = parse_size(buf);
+    }
+    return (size_min == 0 || size_max < size_min) ? -1 : 0;
+}
+
+/**
+ * @brief Parse "-m write=20,get=70,ls=5,rm=5" (omitted ops get 0).
+ *
+ * @return 0 on success, or -1 on a malformed argument.
+ */
+static int parse_mix(const char *arg)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    memset(mix, 0, sizeof(mix));
+
+    int total = 0;
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ","))
+    {
+        char *eq = strchr(tok, '=');
+        if (!eq)
+            return -1;
+        *eq = '\0';
+
+        int op;
+        for (op = 0; op < NUM_OPS; op++)
+        {
+            if (strcasecmp(tok, op_names[op]) == 0)
+                break;
+        }
+        if (op == NUM_OPS)
+            return -1;
+
+        mix[op] = atoi(eq + 1);
+        if (mix[op] < 0)
+            return -1;
+        total += mix[op];
+    }
+    return total > 0 ? 0 : -1;
+}
+
+/**
+ * @brief WRITE every key once so GETs hit from the start.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int populate(void)
+{
+    int sockfd = open_session();
+    if (sockfd < 0)
+        return -1;
+
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    char path[64];
+    for (int i = 0; i < num_keys; i++)
+    {
+        uint64_t bytes;
+        snprintf(path, sizeof(path), "%s%d", BENCH_PREFIX, i);
+        if (do_request(sockfd, OP_WRITE, path, pick_size(&rng), &bytes) != RFS_OK)
+        {
+            fprintf(stderr, "rfs-bench: prepopulating %s failed\n", path);
+            close(sockfd);
+            return -1;
+        }
+    }
+    close(sockfd);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -H host        server IPv4 address (default 127.0.0.1)\n"
+            "  -p port        server port (default %d)\n"
+            "  -U             use the local Unix socket %s instead of TCP\n"
+            "  -L             issue requests through librfs (one shared client\n"
+            "                 handle pooling -c connections)\n"
+            "  -A N           one thread keeps N requests in flight through the\n"
+            "                 librfs async interface over -c connections\n"
+            "  -c N           concurrent connections (default 4)\n"
+            "  -d SECS        measured duration (default 10)\n"
+            "  -k N           number of distinct keys (default 1000)\n"
+            "  -z S           Zipf exponent for key choice, 0 = uniform (default 0.99)\n"
+            "  -s SIZE[:MAX]  WRITE size or uniform range, K/M/G suffixes (default 4K)\n"
+            "  -m MIX         op weights, e.g. write=20,get=70,ls=5,rm=5 (default)\n"
+            "  -P             skip prepopulating the keys\n",
+            prog, BENCH_PORT, RFS_UNIX_PATH);
+}
+
+/**
+ * @brief Entry point for rfs-bench.
+ *
+ * Parses options, optionally writes every key once, runs the worker
+ * threads for the requested duration, and prints the JSON report.
+ *
+ * @return 0 if the run completed, or 1 on usage or setup errors.
+ */
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:ULA:c:d:k:z:s:m:P")) != -1)
+    {
+        switch (opt)
+        {
+        case 'H': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'U': use_unix = 1; break;
+        case 'L': use_lib = 1; break;
+        case 'A': async_depth = atoi(optarg); use_lib = 1; break;
+        case 'c': concurrency = atoi(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'k': num_keys = atoi(optarg); break;
+        case 'z': zipf_s = atof(optarg); break;
+        case 's':
+            if (parse_sizes(optarg) < 0)
+            {
+                fprintf(stderr, "Invalid size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            if (parse_mix(optarg) < 0)
+            {
+                fprintf(stderr, "Invalid mix: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'P': prepopulate = 0; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (concurrency <= 0 || duration <= 0 || num_keys <= 0 || zipf_s < 0 ||
+        async_depth < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    payload = (uint8_t *)malloc((size_t)size_max);
+    worker_t *workers = (worker_t *)calloc((size_t)concurrency, sizeof(worker_t));
+    if (!payload || !workers || build_zipf() < 0)
+    {
+        perror("malloc");
+        return 1;
+    }
+    uint64_t fill = 0x12345678;
+    for (uint64_t i = 0; i < size_max; i++)
+        payload[i] = (uint8_t)next_rand(&fill);
+
+    if (use_lib)
+    {
+        rfs_options_t opts;
+        memset(&opts, 0, sizeof(opts));
+        opts.host = use_unix ? RFS_UNIX_PATH : host;
+        opts.port = port;
+        opts.max_connections = concurrency;
+        opts.no_checksums = 1;      /* same bytes on the wire as raw mode */
+        lib_client = rfs_client_open(&opts);
+        if (!lib_client)
+        {
+            fprintf(stderr, "rfs-bench: cannot create librfs client\n");
+            return 1;
+        }
+    }
+
+    if (prepopulate && populate() < 0)
+        return 1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    stop_at = start;
+    stop_at.tv_sec  += (time_t)duration;
+    stop_at.tv_nsec += (long)((duration - (double)(time_t)duration) * 1e9);
+    if (stop_at.tv_nsec >= 1000000000L)
+    {
+        stop_at.tv_sec++;
+        stop_at.tv_nsec -= 1000000000L;
+    }
+
+    for (int i = 0; i < concurrency; i++)
+    {
+        workers[i].id  = i;
+        workers[i].rng = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1) ^ (uint64_t)time(NULL);
+    }
+
+    async_slot_t *slots = NULL;
+    if (async_depth > 0)
+    {
+        slots = async_start(&workers[0]);
+        if (!slots)
+        {
+            fprintf(stderr, "rfs-bench: cannot start the async run\n");
+            return 1;
+        }
+    }
+    for (int i = 0; async_depth == 0 && i < concurrency; i++)
+    {
+        if (pthread_create(&workers[i].tid, NULL, worker_main, &workers[i]) != 0)
+        {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+
+    struct timespec tick = { 0, 50 * 1000000L };
+    struct timespec now;
+    do
+    {
+        nanosleep(&tick, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (!past_deadline(&now));
+    running = 0;
+
+    int failed = 0;
+    if (async_depth > 0)
+    {
+        rfs_async_close(lib_async);
+        free(slots);
+    }
+    for (int i = 0; i < concurrency; i++)
+    {
+        if (async_depth == 0)
+            pthread_join(workers[i].tid, NULL);
+        failed += workers[i].failed;
+    }
+
+    double secs = (double)usec_between(&start, &stop_at) / 1e6;
+
+    op_stats_t per_op[NUM_OPS];
+    op_stats_t all;
+    memset(per_op, 0, sizeof(per_op));
+    memset(&all, 0, sizeof(all));
+    for (int i = 0; i < concurrency; i++)
+    {
+        for (int op = 0; op < NUM_OPS; op++)
+        {
+            if (merge(&per_op[op], &workers[i].ops[op]) < 0 ||
+                merge(&all, &workers[i].ops[op]) < 0)
+            {
+                perror("realloc");
+                return 1;
+            }
+            free(workers[i].ops[op].us);
+        }
+    }
+
+    printf("{\"config\":{\"transport\":\"%s\",\"api\":\"%s\",\"concurrency\":%d,"
+           "\"depth\":%d,\"duration_s\":%.2f,\"keys\":%d,\"zipf\":%.2f,"
+           "\"size_min\":%llu,\"size_max\":%llu,"
+           "\"mix\":{\"write\":%d,\"get\":%d,\"ls\":%d,\"rm\":%d}},"
+           "\"failed_connections\":%d,\"total\":",
+           use_unix ? "unix" : "tcp",
+           async_depth ? "librfs-async" : use_lib ? "librfs" : "raw",
+           concurrency, async_depth ? async_depth : 1, secs, num_keys, zipf_s,
+           (unsigned long long)size_min, (unsigned long long)size_max,
+           mix[OP_WRITE], mix[OP_GET], mix[OP_LS], mix[OP_RM], failed);
+    print_stats(&all, secs);
+    printf(",\"ops\":{");
+    int first = 1;
+    for (int op = 0; op < NUM_OPS; op++)
+    {
+        if (per_op[op].count == 0)
+            continue;
+        printf("%s\"%s\":", first ? "" : ",", op_names[op]);
+        print_stats(&per_op[op], secs);
+        first = 0;
+    }
+    printf("}}\n");
+
+    fprintf(stderr, "rfs-bench: %zu ops in %.1f s = %.0f ops/s, %.2f MB/s, "
+            "p50 %u us, p99 %u us, p999 %u us%s\n",
+            all.count, secs, (double)all.count / secs,
+            (double)all.bytes / secs / 1e6,
+            percentile(all.us, all.count, 50),
+            percentile(all.us, all.count, 99),
+            percentile(all.us, all.count, 99.9),
+            failed ? " (some connections failed)" : "");
+
+    for (int op = 0; op < NUM_OPS; op++)
+        free(per_op[op].us);
+    free(all.us);
+    free(workers);
+    rfs_client_close(lib_client);
+    free(payload);
+    free(zipf_cdf);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,498 @@
+/*
+ * sched.c -- per-client token buckets and round-robin slot dispatch
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#define _GNU_SOURCE     /* struct ucred */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sched.h"
+#include "protocol.h"
+
+#define SCHED_BUCKETS 256
+#define SCHED_KEY_LEN 64
+
+/* A request waiting for an execution slot. Lives on its thread's stack. */
+typedef struct waiter
+{
+    struct waiter *next;
+    pthread_cond_t cond;
+    int granted;
+} waiter_t;
+
+struct sched_client
+{
+    struct sched_client *hnext;        /* hash chain                    */
+    char key[SCHED_KEY_LEN];
+    int refs;
+    time_t last_used;
+
+    double req_tokens;
+    double byte_tokens;
+    struct timespec refilled;
+    uint64_t since_yield;
+
+    waiter_t *wq_head[2];              /* FIFO of waiters per class     */
+    waiter_t *wq_tail[2];
+    struct sched_client *rnext[2];     /* link in ring[cls]             */
+    int in_ring[2];
+};
+
+/* Clients with waiters of a class, in round-robin order. */
+typedef struct
+{
+    sched_client_t *head;
+    sched_client_t *tail;
+} ring_t;
+
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int    max_slots  = 1;
+static int    bulk_slots = 1;   /* max_slots minus those reserved small */
+static int    active     = 0;
+static int    active_bulk = 0;
+static double req_rate  = 0;
+static double byte_rate = 0;
+
+static sched_client_t *table[SCHED_BUCKETS];
+static int num_clients = 0;
+
+static ring_t ring[2];
+static int smalls_in_a_row = 0;
+
+/* Requests that bypass rate limits share this record's queues. */
+static sched_client_t anonymous = { .key = "(anonymous)", .refs = 1 };
+
+/**
+ * @brief Configure the scheduler.
+ *
+ * At least one slot is always left to bulk requests, so @p reserved
+ * is capped at @p slots - 1 (a single slot is shared).
+ *
+ * @param slots Maximum requests executing at once.
+ * @param reserved Slots only small requests may use.
+ * @param rps Requests per second per client (0 = no limit).
+ * @param bps Bytes per second per client (0 = no limit).
+ */
+void sched_init(int slots, int reserved, double rps, double bps)
+{
+    max_slots = slots > 0 ? slots : 1;
+    if (reserved < 0)
+        reserved = 0;
+    if (reserved > max_slots - 1)
+        reserved = max_slots - 1;
+    bulk_slots = max_slots - reserved;
+    req_rate  = rps > 0 ? rps : 0;
+    byte_rate = bps > 0 ? bps : 0;
+}
+
+/**
+ * @brief Seconds elapsed from @p a to @p b.
+ */
+static double elapsed(const struct timespec *a, const struct timespec *b)
+{
+    return (double)(b->tv_sec - a->tv_sec) +
+           (double)(b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief Add the tokens @p c earned since its last refill.
+ *
+ * Each bucket holds at most one second's worth (at least one request
+ * or one quantum of bytes). Must be called with @c sched_lock held.
+ */
+static void refill(sched_client_t *c)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double dt = elapsed(&c->refilled, &now);
+    c->refilled = now;
+
+    if (req_rate > 0)
+    {
+        double cap = req_rate > 1 ? req_rate : 1;
+        c->req_tokens += dt * req_rate;
+        if (c->req_tokens > cap)
+            c->req_tokens = cap;
+    }
+    if (byte_rate > 0)
+    {
+        double cap = byte_rate > SCHED_QUANTUM ? byte_rate : SCHED_QUANTUM;
+        c->byte_tokens += dt * byte_rate;
+        if (c->byte_tokens > cap)
+            c->byte_tokens = cap;
+    }
+}
+
+/**
+ * @brief Sleep for @p secs seconds with @c sched_lock released.
+ */
+static void sleep_unlocked(double secs)
+{
+    struct timespec ts;
+    ts.tv_sec  = (time_t)secs;
+    ts.tv_nsec = (long)((secs - (double)ts.tv_sec) * 1e9);
+
+    pthread_mutex_unlock(&sched_lock);
+    nanosleep(&ts, NULL);
+    pthread_mutex_lock(&sched_lock);
+}
+
+/**
+ * @brief Build the rate-limit key for a socket's peer.
+ *
+ * TCP peers are keyed by IP address (not port, so reconnecting does
+ * not reset the limits); Unix-socket peers by user id.
+ */
+static void peer_key(int sock, char *key, size_t size)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+
+    if (getpeername(sock, (struct sockaddr *)&addr, &len) == 0)
+    {
+        char ip[INET6_ADDRSTRLEN];
+        if (addr.ss_family == AF_INET &&
+            inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr,
+                      ip, sizeof(ip)))
+        {
+            snprintf(key, size, "%s", ip);
+            return;
+        }
+        if (addr.ss_family == AF_INET6 &&
+            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&addr)->sin6_addr,
+                      ip, sizeof(ip)))
+        {
+            snprintf(key, size, "%s", ip);
+            return;
+        }
+        if (addr.ss_family == AF_UNIX)
+        {
+            struct ucred cred;
+            socklen_t clen = sizeof(cred);
+            if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &clen) == 0)
+            {
+                snprintf(key, size, "uid:%u", (unsigned)cred.uid);
+                return;
+            }
+        }
+    }
+    snprintf(key, size, "unknown");
+}
+
+/**
+ * @brief Free idle, unreferenced client records.
+ *
+ * Called when the table grows past SCHED_MAX_CLIENTS. A client idle
+ * for SCHED_IDLE_SECS has refilled its buckets, so forgetting it
+ * changes nothing. Must be called with @c sched_lock held.
+ */
+static void evict_idle(void)
+{
+    time_t now = time(NULL);
+    for (int b = 0; b < SCHED_BUCKETS; b++)
+    {
+        sched_client_t **pp = &table[b];
+        while (*pp)
+        {
+            sched_client_t *c = *pp;
+            if (c->refs == 0 && now - c->last_used >= SCHED_IDLE_SECS)
+            {
+                *pp = c->hnext;
+                free(c);
+                num_clients--;
+            }
+            else
+            {
+                pp = &c->hnext;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Find (or create) the client record for a connected socket.
+ *
+ * @param sock Connected client socket.
+ *
+ * @return A referenced record, or NULL on allocation failure.
+ */
+sched_client_t *sched_client_get(int sock)
+{
+    char key[SCHED_KEY_LEN];
+    peer_key(sock, key, sizeof(key));
+    unsigned b = rfs_fnv32(key, strlen(key)) % SCHED_BUCKETS;
+
+    pthread_mutex_lock(&sched_lock);
+
+    sched_client_t *c;
+    for (c = table[b]; c; c = c->hnext)
+    {
+        if (strcmp(c->key, key) == 0)
+            break;
+    }
+
+    if (!c)
+    {
+        if (num_clients >= SCHED_MAX_CLIENTS)
+            evict_idle();
+
+        c = (sched_client_t *)calloc(1, sizeof(*c));
+        if (!c)
+        {
+            pthread_mutex_unlock(&sched_lock);
+            return NULL;
+        }
+        snprintf(c->key, sizeof(c->key), "%s", key);
+        c->req_tokens  = req_rate > 1 ? req_rate : 1;
+        c->byte_tokens = byte_rate > SCHED_QUANTUM ? byte_rate : SCHED_QUANTUM;
+        clock_gettime(CLOCK_MONOTONIC, &c->refilled);
+        c->hnext = table[b];
+        table[b] = c;
+        num_clients++;
+    }
+
+    c->refs++;
+    c->last_used = time(NULL);
+    pthread_mutex_unlock(&sched_lock);
+    return c;
+}
+
+/**
+ * @brief Drop a reference taken by sched_client_get().
+ *
+ * The record is kept (with its bucket state) until evict_idle().
+ *
+ * @param c Client record, or NULL.
+ */
+void sched_client_put(sched_client_t *c)
+{
+    if (!c)
+        return;
+    pthread_mutex_lock(&sched_lock);
+    c->refs--;
+    c->last_used = time(NULL);
+    pthread_mutex_unlock(&sched_lock);
+}
+
+/**
+ * @brief Pick the class of the next waiting request to run.
+ *
+ * Small requests go first, except that a bulk request is let through
+ * after SCHED_BULK_EVERY consecutive small ones so bulk work cannot
+ * starve. Bulk requests only run while fewer than @c bulk_slots are
+ * bulk. Must be called with @c sched_lock held.
+ *
+ * @return SCHED_SMALL, SCHED_BULK, or -1 if no waiter may run.
+ */
+static int next_class(void)
+{
+    int bulk_ok = ring[SCHED_BULK].head && active_bulk < bulk_slots;
+    if (ring[SCHED_SMALL].head &&
+        !(bulk_ok && smalls_in_a_row >= SCHED_BULK_EVERY))
+        return SCHED_SMALL;
+    return bulk_ok ? SCHED_BULK : -1;
+}
+
+/**
+ * @brief Hand the slot being released to the next waiting request.
+ *
+ * The class is chosen by next_class(); within a class, clients take
+ * turns. Must be called with @c sched_lock held.
+ *
+ * @return 1 if the slot was handed over, 0 if no waiter may run.
+ */
+static int dispatch(void)
+{
+    int cls = next_class();
+    if (cls < 0)
+        return 0;
+
+    smalls_in_a_row = (cls == SCHED_SMALL) ? smalls_in_a_row + 1 : 0;
+    if (cls == SCHED_BULK)
+        active_bulk++;
+
+    /* pop the client at the head of the ring */
+    ring_t *r = &ring[cls];
+    sched_client_t *c = r->head;
+    r->head = c->rnext[cls];
+    if (!r->head)
+        r->tail = NULL;
+    c->in_ring[cls] = 0;
+
+    /* wake its oldest waiter */
+    waiter_t *w = c->wq_head[cls];
+    c->wq_head[cls] = w->next;
+    if (!c->wq_head[cls])
+        c->wq_tail[cls] = NULL;
+    w->granted = 1;
+    pthread_cond_signal(&w->cond);
+
+    /* still has work: go to the back of the line */
+    if (c->wq_head[cls])
+    {
+        c->rnext[cls] = NULL;
+        if (r->tail)
+            r->tail->rnext[cls] = c;
+        else
+            r->head = c;
+        r->tail = c;
+        c->in_ring[cls] = 1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Take an execution slot, queueing behind other clients if
+ *        none is free. Must be called with @c sched_lock held.
+ */
+static void acquire_slot(sched_client_t *c, int cls)
+{
+    if (active < max_slots && next_class() < 0 &&
+        (cls == SCHED_SMALL || active_bulk < bulk_slots))
+    {
+        active++;
+        if (cls == SCHED_BULK)
+            active_bulk++;
+        return;
+    }
+
+    waiter_t w;
+    w.next = NULL;
+    w.granted = 0;
+    pthread_cond_init(&w.cond, NULL);
+
+    if (c->wq_tail[cls])
+        c->wq_tail[cls]->next = &w;
+    else
+        c->wq_head[cls] = &w;
+    c->wq_tail[cls] = &w;
+
+    if (!c->in_ring[cls])
+    {
+        ring_t *r = &ring[cls];
+        c->rnext[cls] = NULL;
+        if (r->tail)
+            r->tail->rnext[cls] = c;
+        else
+            r->head = c;
+        r->tail = c;
+        c->in_ring[cls] = 1;
+    }
+
+    /* a slot may be free if everyone queued ahead was just served */
+    if (active < max_slots && next_class() >= 0)
+    {
+        active++;
+        dispatch();
+    }
+
+    while (!w.granted)
+        pthread_cond_wait(&w.cond, &sched_lock);
+    pthread_cond_destroy(&w.cond);
+}
+
+/**
+ * @brief Give up an execution slot of class @p cls. Must be called
+ *        with @c sched_lock held.
+ */
+static void release_slot(int cls)
+{
+    if (cls == SCHED_BULK)
+        active_bulk--;
+    if (!dispatch())
+        active--;
+}
+
+/**
+ * @brief Wait until a request from @p c may run.
+ *
+ * @param c Client record, or NULL.
+ * @param cls SCHED_SMALL or SCHED_BULK.
+ */
+void sched_begin(sched_client_t *c, int cls)
+{
+    pthread_mutex_lock(&sched_lock);
+
+    if (!c)
+    {
+        c = &anonymous;
+    }
+    else if (req_rate > 0)
+    {
+        refill(c);
+        while (c->req_tokens < 1)
+        {
+            sleep_unlocked((1 - c->req_tokens) / req_rate);
+            refill(c);
+        }
+        c->req_tokens -= 1;
+    }
+
+    c->since_yield = 0;
+    acquire_slot(c, cls);
+    pthread_mutex_unlock(&sched_lock);
+}
+
+/**
+ * @brief Charge streamed bytes to @p c.
+ *
+ * @param c Client record (may be NULL).
+ * @param cls Class the request was admitted with.
+ * @param bytes Number of bytes just transferred.
+ */
+void sched_charge(sched_client_t *c, int cls, uint64_t bytes)
+{
+    if (!c)
+        return;
+
+    pthread_mutex_lock(&sched_lock);
+
+    double wait = 0;
+    if (byte_rate > 0)
+    {
+        refill(c);
+        c->byte_tokens -= (double)bytes;
+        if (c->byte_tokens < 0)
+            wait = -c->byte_tokens / byte_rate;
+    }
+
+    c->since_yield += bytes;
+    int others_waiting = ring[SCHED_SMALL].head || ring[SCHED_BULK].head;
+
+    if (wait > 0 || (c->since_yield >= SCHED_QUANTUM && others_waiting))
+    {
+        c->since_yield = 0;
+        release_slot(cls);
+        if (wait > 0)
+            sleep_unlocked(wait);
+        acquire_slot(c, cls);
+    }
+
+    pthread_mutex_unlock(&sched_lock);
+}
+
+/**
+ * @brief Release the execution slot taken by sched_begin().
+ *
+ * @param c Client record (may be NULL).
+ * @param cls Class the request was admitted with.
+ */
+void sched_end(sched_client_t *c, int cls)
+{
+    pthread_mutex_lock(&sched_lock);
+    release_slot(cls);
+    if (c)
+        c->last_used = time(NULL);
+    pthread_mutex_unlock(&sched_lock);
+}
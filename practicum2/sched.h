@@ -0,0 +1,111 @@
+/*
+ * sched.h -- per-client rate limiting and fair request scheduling
+ *
+ * Every request passes an admission gate before its handler runs:
+ *
+ *   1. Rate limits. Each client (peer IP address, or peer uid on the
+ *      Unix socket) has two token buckets: requests per second and
+ *      bytes per second. A request waits for one request token; data
+ *      streamed by the handler is charged against the byte bucket as
+ *      it moves.
+ *
+ *   2. Execution slots. At most `slots` requests run at once, and
+ *      `reserved` of them only take small requests (LS, STAT, RM,
+ *      small GET/WRITE), so bulk transfers can never fill the server:
+ *      a small request finds a slot even while every bulk slot is held
+ *      by a transfer blocked on a slow peer. Waiting requests are
+ *      queued per client and class and dispatched round-robin across
+ *      clients, small requests ahead of bulk transfers, so one client
+ *      cannot monopolize the server.
+ *
+ *   3. Interleaving. A bulk transfer gives its slot back every
+ *      SCHED_QUANTUM bytes when others are waiting, and while it
+ *      sleeps for byte tokens, so a small request never waits behind
+ *      a whole large file.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+#define SCHED_SMALL 0               /* LS, RM, small GET / WRITE, ...   */
+#define SCHED_BULK  1               /* large transfers, SNAP            */
+
+#define SCHED_SMALL_BYTES (64 * 1024)   /* larger transfers are bulk    */
+#define SCHED_QUANTUM     (1024 * 1024) /* bulk bytes between yields    */
+#define SCHED_BULK_EVERY  8   /* serve one bulk after this many smalls  */
+#define SCHED_RESERVED    1   /* small-only slots unless -S is given    */
+
+#define SCHED_MAX_CLIENTS 4096  /* idle clients are evicted beyond this */
+#define SCHED_IDLE_SECS   10
+
+typedef struct sched_client sched_client_t;
+
+/**
+ * @brief Configure the scheduler. Call once before serving requests.
+ *
+ * @param slots Maximum number of requests executing at once (>= 1).
+ * @param reserved Slots only small requests may use (at most
+ *                 @p slots - 1; bulk always keeps one).
+ * @param req_rate Requests per second allowed per client (0 = no limit).
+ * @param byte_rate Bytes per second allowed per client (0 = no limit).
+ */
+void sched_init(int slots, int reserved, double req_rate, double byte_rate);
+
+/**
+ * @brief Find (or create) the client record for a connected socket.
+ *
+ * Connections from the same address share one record and therefore
+ * one set of rate limits.
+ *
+ * @param sock Connected client socket.
+ *
+ * @return A referenced client record (release with sched_client_put()),
+ *         or NULL if memory could not be allocated.
+ */
+sched_client_t *sched_client_get(int sock);
+
+/**
+ * @brief Drop a reference taken by sched_client_get().
+ *
+ * @param c Client record, or NULL.
+ */
+void sched_client_put(sched_client_t *c);
+
+/**
+ * @brief Wait until a request from @p c may run.
+ *
+ * Blocks for a request token and then for an execution slot.
+ *
+ * @param c Client record, or NULL to bypass rate limits (a slot is
+ *          still taken).
+ * @param cls SCHED_SMALL or SCHED_BULK; pass the same class to
+ *            sched_charge() and sched_end().
+ */
+void sched_begin(sched_client_t *c, int cls);
+
+/**
+ * @brief Charge streamed bytes to @p c inside sched_begin()/sched_end().
+ *
+ * Sleeps if the client is over its byte rate, and periodically yields
+ * the execution slot to waiting requests. Either way the slot is
+ * given up while waiting and reacquired before returning.
+ *
+ * @param c Client record (may be NULL).
+ * @param cls Class the request was admitted with.
+ * @param bytes Number of bytes just transferred.
+ */
+void sched_charge(sched_client_t *c, int cls, uint64_t bytes);
+
+/**
+ * @brief Release the execution slot taken by sched_begin().
+ *
+ * @param c Client record (may be NULL).
+ * @param cls Class the request was admitted with.
+ */
+void sched_end(sched_client_t *c, int cls);
+
+#endif /* SCHED_H */
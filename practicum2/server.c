@@ -1,11 +1,23 @@
 /*
  * server.c -- RFS server with:
- *   - Multi-threaded client support
+ *   - Multi-threaded client support (optionally one SO_REUSEPORT
+ *     listener per core, each with its own worker set)
  *   - WRITE with versioning
  *   - GET returning newest version (or specific version via path)
  *   - RM removing all versions
+ *   - COPY / MOVE of a file with its version history, on the server
+ *   - APPEND in place and PATCH at an offset, sending changed bytes only
  *   - LS listing all versions + timestamps
  *   - STOP shutting down the server
+ *   - SNAP taking hard-linked point-in-time snapshots
+ *   - Per-client rate limits and fair, size-aware request scheduling
+ *   - WATCH pushing change events to subscribed clients
+ *   - STAT / LIST answered from a memory-mapped metadata index
+ *   - TREE exposing per-directory Merkle digests kept in that index
+ *   - Old versions moved, compressed, to a cold tier (tier.h)
+ *   - STATS reporting the most requested paths (stats.h)
+ *   - Protocol v1 (one request per connection) and v2 (HELLO
+ *     handshake, framed requests with 64-bit sizes, streamed data)
  *
  * Sooji Kim | CS5600 | Northeastern University
  * Fall 2025 | Dec 6 2025
@@ -18,17 +30,65 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/un.h>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <dirent.h>
 
 #include "server.h"
+#include "local.h"
+#include "protocol.h"
+#include "snapshot.h"
+#include "watch.h"
+#include "sched.h"
+#include "index.h"
+#include "multipart.h"
+#include "delta.h"
+#include "tier.h"
+#include "stats.h"
 
 static pthread_mutex_t fs_mutex = PTHREAD_MUTEX_INITIALIZER;
 static volatile int server_running = 1;
-static int listen_sock = -1;
+
+/*
+ * One acceptor per listening socket. In the default mode there is a
+ * single acceptor; with -l N (or -l 0 for one per core) there are N
+ * acceptors, each bound to the server port with SO_REUSEPORT so the kernel
+ * spreads incoming connections across them.
+ *
+ * Each acceptor owns a small queue of accepted sockets and its own set
+ * of worker threads. Workers are created on demand when no idle worker
+ * is available and exit after sitting idle for WORKER_IDLE_SECS, so in
+ * steady state accepting a connection costs a queue push instead of a
+ * pthread_create().
+ */
+typedef struct
+{
+    int id;
+    int sock;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;      /* signalled when pending gains a socket */
+    pthread_cond_t  space;      /* signalled when pending loses a socket */
+    int pending[ACCEPT_QUEUE_LEN];
+    int head;
+    int count;
+
+    int num_workers;
+    int idle_workers;
+} acceptor_t;
+
+static acceptor_t *acceptors = NULL;
+static int num_acceptors = 0;
 
 /**
  * @brief Receive exactly @p len bytes from a socket.
@@ -117,7 +177,7 @@ int send_all(int sockfd, const void *buf, size_t len)
  */
 int ensure_directories(const char *full_path)
 {
-    char tmp[1024];
+    char tmp[SERVER_PATH_MAX];
     size_t len = strlen(full_path);
 
     if (len >= sizeof(tmp))
@@ -144,627 +204,3606 @@ int ensure_directories(const char *full_path)
 }
 
 /**
- * @brief Thread entry point for handling a single client connection.
+ * @brief Move the current version of a file aside as its next .vN.
  *
- * This function processes one client request per connection. It reads
- * a 5-byte command and executes one of:
- *  - WRITE: store file with versioning (.vN) under SERVER_ROOT
- *  - GET:   return requested file contents
- *  - LS:    list all versions and timestamps for a path
- *  - RM:    remove a file and all of its versions, or remove a directory
- *  - STOP:  shut down the server (sets @c server_running to 0)
- *
- * Concurrency control over the underlying file system is provided by
- * the global @c fs_mutex.
+ * If @p full_path names an existing regular file, it is renamed to
+ * the first unused "<full_path>.vN" (N = 1, 2, ...), leaving the base
+ * name free for the newest version. A number taken by a version in the
+ * cold tier is not free. Must be called with @c fs_mutex held.
  *
- * @param arg Pointer to a dynamically allocated integer holding the
- *            client socket file descriptor. This pointer is freed
- *            inside the function.
+ * @param full_path Full path (including SERVER_ROOT) of the file.
+ * @param remote_path Remote path of the same file.
  *
- * @return Always returns NULL (for pthreads API).
+ * @return The version number the next file stored at @p full_path
+ *         will have (1 if there was no previous version).
  */
-void *handle_client(void *arg)
+static int save_previous_version(const char *full_path, const char *remote_path)
 {
-    int client_sock = *(int *)arg;
-    free(arg);
-
-    char cmd[5];
-    if (recv_all(client_sock, cmd, 5) < 0)
-    {
-        close(client_sock);
-        return NULL;
-    }
-
-    /*------------------------------------------------------------*/
-    /*                         WRITE (versioning)                 */
-    /*------------------------------------------------------------*/
-    if (memcmp(cmd, "WRITE", 5) == 0)
+    struct stat st;
+    if (stat(full_path, &st) == 0 && S_ISREG(st.st_mode))
     {
-        uint32_t path_len_net, file_size_net;
-        if (recv_all(client_sock, &path_len_net, 4) < 0 ||
-            recv_all(client_sock, &file_size_net, 4) < 0)
+        int version = 1;
+        while (1)
         {
-            close(client_sock);
-            return NULL;
+            char version_path[1100];
+            char remote_version[RFS_MAX_PATH + 16];
+            snprintf(version_path, sizeof(version_path),
+                     "%s.v%d", full_path, version);
+            snprintf(remote_version, sizeof(remote_version),
+                     "%s.v%d", remote_path, version);
+
+            struct stat vst;
+            if (stat(version_path, &vst) < 0 && tier_stat(remote_version, &vst) < 0)
+            {
+                if (errno == ENOENT)
+                {
+                    if (rename(full_path, version_path) == 0)
+                        printf("Saved previous version as %s\n", version_path);
+                    break;
+                }
+            }
+            version++;
         }
+        return version + 1;
+    }
+    return 1;
+}
 
-        uint32_t path_len  = ntohl(path_len_net);
-        uint32_t file_size = ntohl(file_size_net);
+/**
+ * @brief Wake every acceptor so its accept loop can exit.
+ *
+ * shutdown(2) on a listening socket makes a blocked accept(2) return
+ * immediately on Linux; the sockets themselves are closed by main()
+ * once the acceptor threads have been joined.
+ */
+static void stop_acceptors(void)
+{
+    for (int i = 0; i < num_acceptors; i++)
+    {
+        if (acceptors[i].sock >= 0)
+            shutdown(acceptors[i].sock, SHUT_RDWR);
+    }
+}
 
-        char *remote_path = (char *)malloc(path_len + 1);
-        uint8_t *file_buf = (uint8_t *)malloc(file_size);
+/*------------------------------------------------------------*/
+/*                 Connection and I/O helpers                 */
+/*------------------------------------------------------------*/
 
-        if (!remote_path || !file_buf)
-        {
-            perror("malloc");
-            free(remote_path);
-            free(file_buf);
-            close(client_sock);
-            return NULL;
-        }
+/* Growable byte buffer used to assemble reply payloads. */
+typedef struct
+{
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} buf_t;
 
-        if (recv_all(client_sock, remote_path, path_len) < 0 ||
-            recv_all(client_sock, file_buf, file_size) < 0)
-        {
-            free(remote_path);
-            free(file_buf);
-            close(client_sock);
-            return NULL;
-        }
-        remote_path[path_len] = '\0';
+/* Buffer capacity an arena keeps between requests; more is freed. */
+#define ARENA_KEEP_BYTES (1024 * 1024)
 
-        char full_path[1024];
-        snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+/*
+ * Scratch memory of one worker thread, reused by every request it
+ * serves. It lives on the worker's stack; the buffers grow to the
+ * largest reply seen (up to ARENA_KEEP_BYTES) and then stay, so a
+ * steady stream of requests makes no heap calls. Streaming I/O uses
+ * fixed RFS_IO_CHUNK buffers on the same stack.
+ */
+struct arena
+{
+    char path[RFS_MAX_PATH];    /* remote path of the current request  */
+    buf_t reply;                /* reply payload (conn_reply())        */
+    buf_t block;                /* SIGS block buffer                   */
+};
 
-        printf("WRITE: %s (%u bytes)\n", full_path, file_size);
+/*
+ * Per-connection state. A v1 connection carries exactly one request;
+ * a v2 connection (opened with HELLO) carries a sequence of framed
+ * requests until the client closes it.
+ */
+typedef struct
+{
+    int sock;
+    int proto;                  /* RFS_PROTO_V1 or RFS_PROTO_V2        */
+    sched_client_t *client;     /* rate-limit record for the peer      */
+    int scheduled;              /* inside sched_begin()/sched_end()    */
+    int sched_class;            /* SCHED_SMALL or SCHED_BULK           */
+    arena_t *arena;             /* the serving worker's scratch memory */
+    uint64_t moved;             /* file bytes moved by the request     */
+} conn_t;
+
+/* Command handler results */
+#define CONN_KEEP   0   /* request finished; the connection may continue */
+#define CONN_CLOSE -1   /* framing lost, peer gone, or STOP              */
+#define CONN_DETACH 1   /* socket handed off (WATCH); do not close it    */
 
-        pthread_mutex_lock(&fs_mutex);
+/**
+ * @brief Append @p n bytes to a growable buffer.
+ *
+ * @param b Buffer to append to (zero-initialized before first use).
+ * @param p Bytes to append.
+ * @param n Number of bytes.
+ *
+ * @return 0 on success, or -1 if memory could not be allocated.
+ */
+static int buf_append(buf_t *b, const void *p, size_t n)
+{
+    if (b->len + n > b->cap)
+    {
+        size_t cap = b->cap ? b->cap : 256;
+        while (cap < b->len + n)
+            cap *= 2;
+        uint8_t *data = (uint8_t *)realloc(b->data, cap);
+        if (!data)
+            return -1;
+        b->data = data;
+        b->cap  = cap;
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+    return 0;
+}
 
-        if (ensure_directories(full_path) < 0)
-        {
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            free(file_buf);
-            close(client_sock);
-            return NULL;
-        }
+/**
+ * @brief Append a network-order uint32 to a growable buffer.
+ *
+ * @param b Buffer to append to.
+ * @param v Value to append.
+ *
+ * @return 0 on success, or -1 on allocation failure.
+ */
+static int buf_append_u32(buf_t *b, uint32_t v)
+{
+    uint32_t net = htonl(v);
+    return buf_append(b, &net, 4);
+}
 
-        /* --- versioning: if file exists, rename to .vN --- */
-        struct stat st;
-        if (stat(full_path, &st) == 0 && S_ISREG(st.st_mode))
-        {
-            int version = 1;
-            while (1)
-            {
-                char version_path[1024];
-                snprintf(version_path, sizeof(version_path),
-                         "%s.v%d", full_path, version);
+/**
+ * @brief Make room for @p n bytes in a buffer, keeping its contents.
+ *
+ * @return 0 on success, or -1 if memory could not be allocated.
+ */
+static int buf_reserve(buf_t *b, size_t n)
+{
+    if (n <= b->cap)
+        return 0;
+    uint8_t *data = (uint8_t *)realloc(b->data, n);
+    if (!data)
+        return -1;
+    b->data = data;
+    b->cap  = n;
+    return 0;
+}
 
-                struct stat vst;
-                if (stat(version_path, &vst) < 0)
-                {
-                    if (errno == ENOENT)
-                    {
-                        if (rename(full_path, version_path) == 0)
-                            printf("Saved previous version as %s\n", version_path);
-                        break;
-                    }
-                }
-                version++;
-            }
-        }
+/**
+ * @brief Empty a buffer, releasing its memory only if it grew past
+ *        ARENA_KEEP_BYTES.
+ */
+static void buf_recycle(buf_t *b)
+{
+    if (b->cap > ARENA_KEEP_BYTES)
+    {
+        free(b->data);
+        b->data = NULL;
+        b->cap = 0;
+    }
+    b->len = 0;
+}
 
-        /* --- write newest version --- */
-        FILE *fp = fopen(full_path, "wb");
-        if (!fp)
-        {
-            perror("fopen");
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            free(file_buf);
-            close(client_sock);
-            return NULL;
-        }
-        fwrite(file_buf, 1, file_size, fp);
-        fclose(fp);
+/**
+ * @brief The connection's reply buffer, emptied for a new reply.
+ *
+ * Handlers assemble their reply payload here instead of in a buffer of
+ * their own, so its memory is reused from request to request.
+ */
+static buf_t *conn_reply(conn_t *c)
+{
+    c->arena->reply.len = 0;
+    return &c->arena->reply;
+}
 
-        pthread_mutex_unlock(&fs_mutex);
+/**
+ * @brief Release everything an arena holds (the worker is exiting).
+ */
+static void arena_release(arena_t *a)
+{
+    free(a->reply.data);
+    free(a->block.data);
+    memset(a, 0, sizeof(*a));
+}
 
-        free(remote_path);
-        free(file_buf);
-        close(client_sock);
-        return NULL;
-    }
+/**
+ * @brief Receive a remote path of known length from a client.
+ *
+ * @param client_sock Connected client socket file descriptor.
+ * @param path_len Number of path bytes that follow on the socket.
+ * @param path Receives the null-terminated path (RFS_MAX_PATH bytes).
+ *
+ * @return 0 on success, or -1 on error or if the path is longer than
+ *         RFS_MAX_PATH allows.
+ */
+static int recv_path(int client_sock, uint32_t path_len, char *path)
+{
+    if (path_len >= RFS_MAX_PATH ||
+        recv_all(client_sock, path, path_len) < 0)
+        return -1;
+    path[path_len] = '\0';
+    return 0;
+}
 
-    /*------------------------------------------------------------*/
-    /*                              GET                            */
-    /*------------------------------------------------------------*/
-    if (memcmp(cmd, "GET  ", 5) == 0)
-    {
-        uint32_t path_len_net;
-        if (recv_all(client_sock, &path_len_net, 4) < 0)
-        {
-            close(client_sock);
-            return NULL;
-        }
-        uint32_t path_len = ntohl(path_len_net);
+/**
+ * @brief Receive a v1 length-prefixed remote path from a client.
+ *
+ * Reads a 4-byte network-order length followed by that many bytes of
+ * path.
+ *
+ * @param client_sock Connected client socket file descriptor.
+ * @param path Receives the path (RFS_MAX_PATH bytes).
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int recv_remote_path(int client_sock, char *path)
+{
+    uint32_t path_len_net;
+    if (recv_all(client_sock, &path_len_net, 4) < 0)
+        return -1;
+    return recv_path(client_sock, ntohl(path_len_net), path);
+}
 
-        char *remote_path = (char *)malloc(path_len + 1);
-        if (!remote_path)
-        {
-            close(client_sock);
-            return NULL;
-        }
+/**
+ * @brief Charge @p bytes of streamed data to the connection's client.
+ *
+ * Only requests admitted by the scheduler are charged; draining the
+ * payload of a rejected request is not. Every byte also counts toward
+ * the request's @c moved total for STATS.
+ *
+ * @param c Client connection.
+ * @param bytes Number of bytes just transferred.
+ */
+static void charge(conn_t *c, uint64_t bytes)
+{
+    c->moved += bytes;
+    if (c->scheduled)
+        sched_charge(c->client, c->sched_class, bytes);
+}
 
-        if (recv_all(client_sock, remote_path, path_len) < 0)
+/**
+ * @brief Write exactly @p len bytes to a file descriptor.
+ *
+ * @param fd Destination file descriptor.
+ * @param buf Bytes to write.
+ * @param len Number of bytes.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    size_t total = 0;
+    while (total < len)
+    {
+        ssize_t n = write(fd, p + total, len - total);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
         {
-            free(remote_path);
-            close(client_sock);
-            return NULL;
+            perror("write");
+            return -1;
         }
-        remote_path[path_len] = '\0';
+        total += (size_t)n;
+    }
+    return 0;
+}
 
-        char full_path[1024];
-        snprintf(full_path, sizeof(full_path), "%s/%s",
-                 SERVER_ROOT, remote_path);
+/**
+ * @brief Stream @p len payload bytes from a socket into a file.
+ *
+ * Data moves through one RFS_IO_CHUNK buffer, so memory use does not
+ * depend on @p len. If @p fd is negative, or once a write to it
+ * fails, the rest of the payload is still read and discarded so the
+ * connection stays in step with the client.
+ *
+ * @param c Client connection; received bytes are charged to it.
+ * @param fd Destination file, or -1 to discard the payload.
+ * @param len Number of payload bytes.
+ * @param sum If non-NULL, receives the FNV-1a-64 of the payload.
+ *
+ * @return 0 on success, 1 if writing to @p fd failed, or -1 if the
+ *         connection failed.
+ */
+static int recv_to_fd(conn_t *c, int fd, uint64_t len, uint64_t *sum)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    uint64_t h = RFS_FNV64_INIT;
+    int write_failed = (fd < 0);
 
-        printf("GET: %s\n", full_path);
+    while (len > 0)
+    {
+        size_t chunk = len < sizeof(buf) ? (size_t)len : sizeof(buf);
+        if (recv_all(c->sock, buf, chunk) < 0)
+            return -1;
+        if (sum)
+            h = rfs_fnv64(h, buf, chunk);
+        if (!write_failed && write_all(fd, buf, chunk) < 0)
+            write_failed = 1;
+        len -= chunk;
+        charge(c, chunk);
+    }
 
-        pthread_mutex_lock(&fs_mutex);
+    if (sum)
+        *sum = h;
+    return (write_failed && fd >= 0) ? 1 : 0;
+}
 
-        FILE *fp = fopen(full_path, "rb");
-        if (!fp)
-        {
-            uint32_t status = htonl(1);
-            send_all(client_sock, &status, 4);
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            close(client_sock);
-            return NULL;
-        }
+/**
+ * @brief Stream @p len bytes of a file to a socket.
+ *
+ * Without a checksum the kernel moves the data with sendfile(2), at
+ * most SCHED_QUANTUM bytes per call so the transfer can be throttled
+ * and interleaved; when @p sum is requested the file is read through
+ * one RFS_IO_CHUNK buffer and hashed on the way out.
+ *
+ * @param c Client connection; sent bytes are charged to it.
+ * @param fd Source file, read from offset 0.
+ * @param len Number of bytes to send.
+ * @param sum If non-NULL, receives the FNV-1a-64 of the data sent.
+ *
+ * @return 0 on success, or -1 on error (the connection is then out
+ *         of step and must be closed).
+ */
+static int send_from_fd(conn_t *c, int fd, uint64_t len, uint64_t *sum)
+{
+    off_t off = 0;
 
-        if (fseek(fp, 0, SEEK_END) != 0)
+    if (!sum)
+    {
+        while ((uint64_t)off < len)
         {
-            uint32_t status = htonl(2);
-            send_all(client_sock, &status, 4);
-            fclose(fp);
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            close(client_sock);
-            return NULL;
+            size_t want = (len - (uint64_t)off) > SCHED_QUANTUM
+                              ? SCHED_QUANTUM : (size_t)(len - (uint64_t)off);
+            ssize_t n = sendfile(c->sock, fd, &off, want);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS) && off == 0)
+                break;      /* unsupported: fall back to read/send */
+            if (n <= 0)
+            {
+                if (n < 0)
+                    perror("sendfile");
+                return -1;
+            }
+            charge(c, (uint64_t)n);
         }
+        if ((uint64_t)off == len)
+            return 0;
+    }
 
-        long fsize = ftell(fp);
-        if (fsize < 0 || fsize > (long)UINT32_MAX)
+    uint8_t buf[RFS_IO_CHUNK];
+    uint64_t h = RFS_FNV64_INIT;
+    while ((uint64_t)off < len)
+    {
+        size_t chunk = (len - (uint64_t)off) < sizeof(buf)
+                           ? (size_t)(len - (uint64_t)off) : sizeof(buf);
+        ssize_t n = pread(fd, buf, chunk, off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
         {
-            uint32_t status = htonl(3);
-            send_all(client_sock, &status, 4);
-            fclose(fp);
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            close(client_sock);
-            return NULL;
+            if (n < 0)
+                perror("pread");
+            return -1;
         }
-        rewind(fp);
+        if (sum)
+            h = rfs_fnv64(h, buf, (size_t)n);
+        if (send_all(c->sock, buf, (size_t)n) < 0)
+            return -1;
+        off += n;
+        charge(c, (uint64_t)n);
+    }
 
-        uint8_t *buf = (uint8_t *)malloc((size_t)fsize);
-        if (!buf)
-        {
-            uint32_t status = htonl(4);
-            send_all(client_sock, &status, 4);
-            fclose(fp);
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            close(client_sock);
-            return NULL;
-        }
+    if (sum)
+        *sum = h;
+    return 0;
+}
 
-        size_t read_bytes = fread(buf, 1, (size_t)fsize, fp);
-        fclose(fp);
-        pthread_mutex_unlock(&fs_mutex);
+/**
+ * @brief Send a v2 response header.
+ *
+ * @param c Connection to reply on (must be v2).
+ * @param status RFS_OK or an RFS_ERR_* code.
+ * @param flags RFS_F_* bits describing the payload.
+ * @param payload_len Number of payload bytes that will follow.
+ * @param arg Command-specific result value.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int send_reply(conn_t *c, uint32_t status, uint16_t flags,
+                      uint64_t payload_len, uint64_t arg)
+{
+    rfs_resp_t resp;
+    resp.status      = status;
+    resp.flags       = flags;
+    resp.payload_len = payload_len;
+    resp.arg         = arg;
+    return rfs_send_response(c->sock, &resp);
+}
 
-        if (read_bytes != (size_t)fsize)
-        {
-            uint32_t status = htonl(5);
-            send_all(client_sock, &status, 4);
-            free(remote_path);
-            free(buf);
-            close(client_sock);
-            return NULL;
-        }
+/**
+ * @brief Send a status-only reply in the connection's protocol.
+ *
+ * v1 replies are a bare network-order uint32; v2 replies are a
+ * response header with an empty payload.
+ *
+ * @param c Connection to reply on.
+ * @param v1_status Status code to send to a v1 client.
+ * @param v2_status Status code to send to a v2 client.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int send_status(conn_t *c, uint32_t v1_status, uint32_t v2_status)
+{
+    if (c->proto == RFS_PROTO_V1)
+    {
+        uint32_t net = htonl(v1_status);
+        return send_all(c->sock, &net, 4);
+    }
+    return send_reply(c, v2_status, 0, 0, 0);
+}
 
-        uint32_t status = htonl(0);
-        send_all(client_sock, &status, 4);
+/*------------------------------------------------------------*/
+/*                   Temp files and commits                   */
+/*------------------------------------------------------------*/
 
-        uint32_t fsize_net = htonl((uint32_t)fsize);
-        send_all(client_sock, &fsize_net, 4);
+/**
+ * @brief Create a temp file next to @p full_path for an upload.
+ *
+ * Intermediate directories are created first. The temp file lives in
+ * the destination directory (so committing it is a rename on the same
+ * file system) and is named "<full_path>" RFS_TMP_MARKER "XXXXXX".
+ *
+ * @param full_path Final path (including SERVER_ROOT) of the file.
+ * @param tmp_path Receives the temp file name.
+ * @param tmp_size Size of @p tmp_path.
+ *
+ * @return An open descriptor for the temp file, or -1 on error.
+ */
+static int open_temp(const char *full_path, char *tmp_path, size_t tmp_size)
+{
+    if (snprintf(tmp_path, tmp_size, "%s%sXXXXXX",
+                 full_path, RFS_TMP_MARKER) >= (int)tmp_size)
+        return -1;
 
-        send_all(client_sock, buf, (size_t)fsize);
+    pthread_mutex_lock(&fs_mutex);
+    int fd = -1;
+    if (ensure_directories(full_path) == 0)
+    {
+        fd = mkstemp(tmp_path);
+        if (fd < 0)
+            perror("mkstemp");
+        else
+            fchmod(fd, 0644);
+    }
+    pthread_mutex_unlock(&fs_mutex);
+    return fd;
+}
 
-        free(remote_path);
-        free(buf);
-        close(client_sock);
-        return NULL;
+/**
+ * @brief Install a fully written temp file as the newest version.
+ *
+ * Under @c fs_mutex the current version is moved aside to .vN and
+ * the temp file is renamed into place, so readers only ever see
+ * complete files and the lock is held for metadata operations only.
+ * The metadata index is updated and watchers are notified under the
+ * same lock, so both see commits in order.
+ *
+ * @param tmp_path Temp file created by open_temp().
+ * @param full_path Final path (including SERVER_ROOT) of the file.
+ * @param remote_path Remote path, as indexed and reported to watchers.
+ * @param size Size of the new version in bytes.
+ * @param sum FNV-1a-64 of the contents if already known, else NULL.
+ *
+ * @return 0 on success, or -1 on error (the temp file is removed).
+ */
+static int commit_temp(const char *tmp_path, const char *full_path,
+                       const char *remote_path, uint64_t size,
+                       const uint64_t *sum)
+{
+    struct stat st;
+    int64_t mtime_ns = 0;
+    if (stat(tmp_path, &st) == 0)
+        mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+    pthread_mutex_lock(&fs_mutex);
+    int version = save_previous_version(full_path, remote_path);
+    int rc = rename(tmp_path, full_path);
+    if (rc == 0)
+    {
+        index_put(remote_path, (uint32_t)version, size, mtime_ns, sum);
+        watch_notify(RFS_EV_WRITE, remote_path, (uint32_t)version, size);
     }
+    pthread_mutex_unlock(&fs_mutex);
 
-    /*------------------------------------------------------------*/
-    /*                        LS (list versions)                  */
-    /*------------------------------------------------------------*/
-    if (memcmp(cmd, "LS   ", 5) == 0)
+    if (rc < 0)
     {
-        uint32_t path_len_net;
-        if (recv_all(client_sock, &path_len_net, 4) < 0)
-        {
-            close(client_sock);
-            return NULL;
-        }
-        uint32_t path_len = ntohl(path_len_net);
+        perror("rename");
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
 
-        char *remote_path = (char *)malloc(path_len + 1);
-        if (!remote_path)
-        {
-            close(client_sock);
-            return NULL;
-        }
+/*------------------------------------------------------------*/
+/*                       Command handlers                     */
+/*------------------------------------------------------------*/
 
-        if (recv_all(client_sock, remote_path, path_len) < 0)
-        {
-            free(remote_path);
-            close(client_sock);
-            return NULL;
-        }
-        remote_path[path_len] = '\0';
+/**
+ * @brief WRITE: store a file with versioning (.vN) under SERVER_ROOT.
+ *
+ * The payload is streamed into a temp file without holding
+ * @c fs_mutex and then committed with commit_temp(). With
+ * RFS_F_DATA_SUM the trailing checksum is verified before committing.
+ * v1 clients get no reply; v2 clients get a status.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c payload_len is the file size.
+ * @param remote_path Remote path to store the file under.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_write(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    char full_path[SERVER_PATH_MAX];
+    char tmp_path[1100];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
 
-        char full_path[1024];
-        snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+    printf("WRITE: %s (%llu bytes)\n", full_path,
+           (unsigned long long)req->payload_len);
 
-        printf("LS: %s\n", full_path);
+    uint32_t status = RFS_OK;
+    int want_sum = (req->flags & RFS_F_DATA_SUM) != 0;
 
-        pthread_mutex_lock(&fs_mutex);
+    int fd = -1;
+    if (snapshot_path(remote_path) || index_reserved(remote_path))
+        status = RFS_ERR_READ_ONLY;     /* still drain the payload below */
+    else if ((fd = open_temp(full_path, tmp_path, sizeof(tmp_path))) < 0)
+        status = RFS_ERR_IO;
 
-        uint32_t count = 0;
-        struct stat st;
+    uint64_t sum = 0;
+    int rc = recv_to_fd(c, fd, req->payload_len, want_sum ? &sum : NULL);
+    if (rc == 0 && want_sum)
+    {
+        uint8_t trailer[8];
+        if (recv_all(c->sock, trailer, 8) < 0)
+            rc = -1;
+        else if (rfs_get_u64(trailer) != sum)
+            status = RFS_ERR_CHECKSUM;
+    }
+    if (rc > 0)
+        status = RFS_ERR_IO;
+
+    if (fd >= 0)
+    {
+        if (close(fd) < 0 && status == RFS_OK)
+            status = RFS_ERR_IO;
+        if (rc < 0 || status != RFS_OK)
+            unlink(tmp_path);
+        else if (commit_temp(tmp_path, full_path, remote_path,
+                             req->payload_len, want_sum ? &sum : NULL) < 0)
+            status = RFS_ERR_IO;
+    }
+
+    if (rc < 0)
+        return CONN_CLOSE;
+
+    if (c->proto == RFS_PROTO_V2 && send_reply(c, status, 0, 0, 0) < 0)
+        return CONN_CLOSE;
+    return CONN_KEEP;
+}
+
+/**
+ * @brief MPINI: start a multipart upload.
+ *
+ * Creates the upload's temp file at its full size (sparse) and
+ * registers it; parts then arrive with MPPUT. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c arg is the total file size.
+ * @param remote_path Remote path the upload will commit to.
+ *
+ * @return CONN_KEEP or CONN_CLOSE; on success the reply's arg is the
+ *         upload id.
+ */
+static int cmd_mp_init(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+    if (req->payload_len != 0)
+    {
+        if (recv_to_fd(c, -1, req->payload_len, NULL) < 0)
+            return CONN_CLOSE;
+        return send_reply(c, RFS_ERR_BAD_REQUEST, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+
+    char full_path[SERVER_PATH_MAX];
+    char tmp_path[1100];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("MPINI: %s (%llu bytes)\n", full_path, (unsigned long long)req->arg);
+
+    if (snapshot_path(remote_path) || index_reserved(remote_path))
+        return send_reply(c, RFS_ERR_READ_ONLY, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    int fd = open_temp(full_path, tmp_path, sizeof(tmp_path));
+    if (fd < 0)
+        return send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    uint32_t status = RFS_OK;
+    uint64_t id = 0;
+    if (req->arg > (uint64_t)INT64_MAX || ftruncate(fd, (off_t)req->arg) < 0)
+        status = RFS_ERR_TOO_LARGE;
+    close(fd);
+
+    if (status == RFS_OK && mp_create(remote_path, tmp_path, req->arg, &id) < 0)
+        status = RFS_ERR_BUSY;
+    if (status != RFS_OK)
+        unlink(tmp_path);
+
+    return send_reply(c, status, 0, 0, id) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief MPPUT: receive one part of a multipart upload.
+ *
+ * The payload is an 8-byte offset followed by the part's bytes, which
+ * are streamed straight into the temp file at that offset. Parts of
+ * the same upload may arrive concurrently on different connections.
+ * The part is recorded only once it has arrived whole and, with
+ * RFS_F_DATA_SUM, its checksum matches; otherwise the client simply
+ * sends it again. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c arg is the upload id.
+ * @param remote_path Remote path the upload was started for.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_mp_put(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    int want_sum = (req->flags & RFS_F_DATA_SUM) != 0;
+    uint32_t status = RFS_OK;
+    uint64_t offset = 0;
+    uint64_t len = 0;
+
+    if (req->payload_len < 8)
+        status = RFS_ERR_BAD_REQUEST;
+    else
+    {
+        uint8_t off_buf[8];
+        if (recv_all(c->sock, off_buf, 8) < 0)
+            return CONN_CLOSE;
+        offset = rfs_get_u64(off_buf);
+        len = req->payload_len - 8;
+    }
+
+    mp_upload_t *u = NULL;
+    int fd = -1;
+    if (status == RFS_OK && !(u = mp_get(req->arg, remote_path)))
+        status = RFS_ERR_NOT_FOUND;
+    else if (status == RFS_OK &&
+             (len > mp_size(u) || offset > mp_size(u) - len))
+        status = RFS_ERR_BAD_REQUEST;
+    else if (status == RFS_OK &&
+             ((fd = open(mp_tmp_path(u), O_WRONLY)) < 0 ||
+              lseek(fd, (off_t)offset, SEEK_SET) < 0))
+        status = RFS_ERR_IO;
+
+    /* on error the rest of the payload is still drained */
+    uint64_t sum = 0;
+    int rc = recv_to_fd(c, status == RFS_OK ? fd : -1,
+                        req->payload_len < 8 ? req->payload_len : len,
+                        want_sum ? &sum : NULL);
+    if (rc == 0 && want_sum)
+    {
+        uint8_t trailer[8];
+        if (recv_all(c->sock, trailer, 8) < 0)
+            rc = -1;
+        else if (status == RFS_OK && rfs_get_u64(trailer) != sum)
+            status = RFS_ERR_CHECKSUM;
+    }
+    if (rc > 0)
+        status = RFS_ERR_IO;
+
+    if (fd >= 0 && close(fd) < 0 && status == RFS_OK)
+        status = RFS_ERR_IO;
+    if (rc == 0 && status == RFS_OK && mp_add_range(u, offset, len) < 0)
+        status = RFS_ERR_IO;
+    if (u)
+        mp_put(u);
+
+    if (rc < 0)
+        return CONN_CLOSE;
+    return send_reply(c, status, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief MPEND: commit a multipart upload as one new version.
+ *
+ * Waits for parts still in flight, then commits the temp file with
+ * commit_temp() exactly like a WRITE. If some bytes have not arrived
+ * the upload stays open and RFS_ERR_INCOMPLETE is returned. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c arg is the upload id.
+ * @param remote_path Remote path the upload was started for.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_mp_end(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    char full_path[SERVER_PATH_MAX];
+    char tmp_path[1100];
+    uint64_t size = 0;
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    uint32_t status;
+    int rc = mp_finish(req->arg, remote_path, tmp_path, sizeof(tmp_path), &size);
+    if (rc < 0)
+        status = RFS_ERR_NOT_FOUND;
+    else if (rc > 0)
+        status = RFS_ERR_INCOMPLETE;
+    else
+        status = commit_temp(tmp_path, full_path, remote_path, size, NULL) < 0
+                     ? RFS_ERR_IO : RFS_OK;
+
+    printf("MPEND: %s (%s)\n", full_path, status == RFS_OK ? "committed" : "failed");
+
+    return send_reply(c, status, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief MPABT: abandon a multipart upload and delete its temp file.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c arg is the upload id.
+ * @param remote_path Remote path the upload was started for.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_mp_abort(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    uint32_t status = mp_abort(req->arg, remote_path) < 0 ? RFS_ERR_NOT_FOUND : RFS_OK;
+    return send_reply(c, status, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief Continue an FNV-1a-64 checksum over the contents of a file.
+ *
+ * @param fd Open file, read with pread() from offset 0.
+ * @param size Expected size.
+ * @param seed Checksum of the data before the file (RFS_FNV64_INIT
+ *             for none).
+ * @param sum Receives the checksum.
+ *
+ * @return 0 on success, or -1 on a read error or if the file is not
+ *         exactly @p size bytes long.
+ */
+static int hash_file_from(int fd, uint64_t size, uint64_t seed, uint64_t *sum)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    uint64_t h = seed;
+    off_t off = 0;
+    ssize_t n;
+    while ((n = pread(fd, buf, sizeof(buf), off)) > 0)
+    {
+        h = rfs_fnv64(h, buf, (size_t)n);
+        off += n;
+    }
+    if (n < 0 || (uint64_t)off != size)
+        return -1;
+    *sum = h;
+    return 0;
+}
+
+/**
+ * @brief Compute the FNV-1a-64 checksum of an open file.
+ *
+ * @param fd Open file, read with pread() from offset 0.
+ * @param size Expected size.
+ * @param sum Receives the checksum.
+ *
+ * @return 0 on success, or -1 on a read error or if the file is not
+ *         exactly @p size bytes long.
+ */
+static int hash_file(int fd, uint64_t size, uint64_t *sum)
+{
+    return hash_file_from(fd, size, RFS_FNV64_INIT, sum);
+}
+
+/**
+ * @brief Decide whether a conditional GET can skip the body.
+ *
+ * The checksum of the current version comes from the index when known.
+ * Otherwise (an old version, a snapshot, or a file the index has no
+ * checksum for yet) the file is hashed here: reading it locally is far
+ * cheaper than sending it. A checksum computed for an indexed file is
+ * stored for the next request.
+ *
+ * @param remote_path Remote path requested.
+ * @param fd The open file about to be sent.
+ * @param size Its size.
+ * @param e Its index entry, read together with the open, or NULL.
+ * @param client_sum Checksum of the client's copy.
+ *
+ * @return Non-zero if the client's copy is identical.
+ */
+static int client_copy_current(const char *remote_path, int fd, uint64_t size,
+                               const index_entry_t *e, uint64_t client_sum)
+{
+    uint64_t h;
+    if (e && e->size == size && (e->flags & INDEX_F_CHECKSUM))
+        h = e->checksum;
+    else if (hash_file(fd, size, &h) < 0)
+        return 0;
+    else if (e && e->size == size)
+        index_set_checksum(remote_path, e->version, size, h);
+    return h == client_sum;
+}
+
+/**
+ * @brief Open a .vN version that is missing from the hot tier in the
+ *        cold tier, decompressed. Called without @c fs_mutex.
+ *
+ * @param remote_path Remote path of the version.
+ *
+ * @return An open descriptor, or -1 if it is not a cold version.
+ */
+static int open_cold(const char *remote_path)
+{
+    const char *slash = strrchr(remote_path, '/');
+    if (snapshot_path(remote_path) ||
+        !index_is_version_name(slash ? slash + 1 : remote_path))
+        return -1;
+
+    int fd = tier_open(remote_path);
+    if (fd >= 0)
+        printf("GET: %s read from the cold tier\n", remote_path);
+    return fd;
+}
+
+/**
+ * @brief Open a stored file for reading, in either tier.
+ *
+ * The hot tier is tried under @c fs_mutex; a .vN version that is not
+ * there is then looked for in the cold tier and decompressed, without
+ * the lock.
+ *
+ * @param full_path Full path (including SERVER_ROOT) of the file.
+ * @param remote_path Remote path of the same file.
+ *
+ * @return An open descriptor, or -1 if the file does not exist.
+ */
+static int open_stored(const char *full_path, const char *remote_path)
+{
+    pthread_mutex_lock(&fs_mutex);
+    int fd = open(full_path, O_RDONLY);
+    pthread_mutex_unlock(&fs_mutex);
+
+    if (fd < 0 && errno == ENOENT)
+        fd = open_cold(remote_path);
+    return fd;
+}
+
+/**
+ * @brief GET: return the contents of a file (or a .vN version).
+ *
+ * The file is opened under @c fs_mutex, which pins that version even
+ * if a WRITE renames it to .vN afterwards, and then streamed to the
+ * client without holding the lock. v1 clients receive
+ * status / uint32 size / data; v2 clients receive a response header
+ * with a 64-bit length, and a trailing checksum if they asked for it.
+ * A v2 GET with RFS_F_IF_NONE_MATCH whose checksum still matches is
+ * answered RFS_NOT_MODIFIED with no payload. A version in the cold tier
+ * is decompressed first (open_cold()), conditional or not.
+ *
+ * @param c Client connection.
+ * @param req Request header (flags may include RFS_F_DATA_SUM and
+ *            RFS_F_IF_NONE_MATCH; then @c arg is the client's checksum).
+ * @param remote_path Remote path to read.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_get(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    char full_path[SERVER_PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("GET: %s\n", full_path);
+
+    int conditional = c->proto == RFS_PROTO_V2 && (req->flags & RFS_F_IF_NONE_MATCH);
+    char path_buf[RFS_MAX_PATH];
+    index_entry_t e;
+    int indexed = 0;
+
+    /*
+     * A conditional GET reads the entry and opens the file as one step.
+     * Cold versions are not indexed, so their checksum is computed.
+     */
+    int fd;
+    if (conditional)
+    {
+        pthread_mutex_lock(&fs_mutex);
+        fd = open(full_path, O_RDONLY);
+        if (fd >= 0)
+            indexed = index_get(remote_path, &e, path_buf, sizeof(path_buf)) == 1;
+        int missing = fd < 0 && errno == ENOENT;
+        pthread_mutex_unlock(&fs_mutex);
+        if (missing)
+            fd = open_cold(remote_path);
+    }
+    else
+        fd = open_stored(full_path, remote_path);
+
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)))
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    if (fd < 0)
+        return send_status(c, 1, RFS_ERR_NOT_FOUND) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    uint64_t fsize = (uint64_t)st.st_size;
+    int want_sum = c->proto == RFS_PROTO_V2 && (req->flags & RFS_F_DATA_SUM);
+
+    if (conditional &&
+        client_copy_current(remote_path, fd, fsize, indexed ? &e : NULL, req->arg))
+    {
+        close(fd);
+        printf("GET: %s not modified\n", full_path);
+        return send_reply(c, RFS_NOT_MODIFIED, 0, 0, req->arg) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+
+    if (c->proto == RFS_PROTO_V1)
+    {
+        if (fsize > UINT32_MAX)
+        {
+            close(fd);
+            return send_status(c, 3, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+        }
+        uint32_t hdr[2] = { htonl(0), htonl((uint32_t)fsize) };
+        if (send_all(c->sock, hdr, sizeof(hdr)) < 0)
+        {
+            close(fd);
+            return CONN_CLOSE;
+        }
+    }
+    else if (send_reply(c, RFS_OK, want_sum ? RFS_F_DATA_SUM : 0, fsize, 0) < 0)
+    {
+        close(fd);
+        return CONN_CLOSE;
+    }
+
+    uint64_t sum = 0;
+    int rc = send_from_fd(c, fd, fsize, want_sum ? &sum : NULL);
+    close(fd);
+    if (rc < 0)
+        return CONN_CLOSE;
+
+    if (want_sum)
+    {
+        uint8_t trailer[8];
+        rfs_put_u64(trailer, sum);
+        if (send_all(c->sock, trailer, 8) < 0)
+            return CONN_CLOSE;
+    }
+    return CONN_KEEP;
+}
+
+/**
+ * @brief Read exactly @p len bytes of a file at @p off.
+ *
+ * @return 0 on success, or -1 on error or end of file.
+ */
+static int read_at(int fd, void *buf, size_t len, uint64_t off)
+{
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0)
+    {
+        ssize_t n = pread(fd, p, len, (off_t)off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            if (n < 0)
+                perror("pread");
+            return -1;
+        }
+        p += n;
+        off += (uint64_t)n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief SIGS: block signatures of a file, for a delta upload.
+ *
+ * The file is opened under @c fs_mutex like GET and read once, a
+ * block at a time, while the signatures (see delta.h) stream out
+ * through one RFS_IO_CHUNK buffer. The whole-file checksum computed
+ * on the way is stored in the index if it had none, so the DELTA
+ * that follows does not hash the file again. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Remote file to describe.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_sigs(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    char full_path[SERVER_PATH_MAX];
+    char path_buf[RFS_MAX_PATH];
+    index_entry_t e;
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("SIGS: %s\n", full_path);
+
+    pthread_mutex_lock(&fs_mutex);
+    int fd = open(full_path, O_RDONLY);
+    int indexed = fd >= 0 && index_get(remote_path, &e, path_buf, sizeof(path_buf)) == 1;
+    pthread_mutex_unlock(&fs_mutex);
+
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)))
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0)
+        return send_reply(c, RFS_ERR_NOT_FOUND, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    uint64_t size = (uint64_t)st.st_size;
+    uint32_t bs = delta_block_size(size);
+    uint32_t nblocks = (uint32_t)((size + bs - 1) / bs);
+    if (buf_reserve(&c->arena->block, bs) < 0)
+    {
+        close(fd);
+        return send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+
+    uint8_t *block = c->arena->block.data;
+    uint8_t out[RFS_IO_CHUNK];
+    uint32_t v;
+    v = htonl(bs);
+    memcpy(out, &v, 4);
+    v = htonl(nblocks);
+    memcpy(out + 4, &v, 4);
+    rfs_put_u64(out + 8, size);
+    size_t len = DELTA_SIGS_HDR;
+
+    uint64_t h = RFS_FNV64_INIT;
+    int rc = send_reply(c, RFS_OK, 0,
+                        DELTA_SIGS_HDR + (uint64_t)nblocks * DELTA_SIG_LEN + 8, 0);
+    for (uint32_t j = 0; rc == 0 && j < nblocks; j++)
+    {
+        uint64_t off = (uint64_t)j * bs;
+        size_t n = size - off < bs ? (size_t)(size - off) : bs;
+        if (read_at(fd, block, n, off) < 0)
+        {
+            rc = -1;
+            break;
+        }
+        h = rfs_fnv64(h, block, n);
+
+        v = htonl(delta_weak_sum(block, n));
+        memcpy(out + len, &v, 4);
+        rfs_put_u64(out + len + 4, rfs_fnv64(RFS_FNV64_INIT, block, n));
+        len += DELTA_SIG_LEN;
+        if (len + DELTA_SIG_LEN + 8 > sizeof(out))
+        {
+            rc = send_all(c->sock, out, len);
+            charge(c, len);
+            len = 0;
+        }
+    }
+    close(fd);
+
+    if (rc == 0)
+    {
+        rfs_put_u64(out + len, h);
+        len += 8;
+        rc = send_all(c->sock, out, len);
+        charge(c, len);
+    }
+    if (rc < 0)
+        return CONN_CLOSE;
+
+    if (indexed && e.size == size && !(e.flags & INDEX_F_CHECKSUM))
+        index_set_checksum(remote_path, e.version, e.size, h);
+    return CONN_KEEP;
+}
+
+/* State of a DELTA being applied (see apply_delta()). */
+typedef struct
+{
+    conn_t *c;
+    uint64_t left;              /* payload bytes not yet received      */
+    uint64_t payload_sum;       /* FNV-1a-64 of the payload so far     */
+    int base_fd;
+    uint64_t base_size;
+    uint32_t block_size;
+    int out_fd;                 /* temp file of the new version        */
+    uint64_t out_len;
+    uint64_t out_sum;           /* FNV-1a-64 of the new version so far */
+} delta_apply_t;
+
+/**
+ * @brief Receive @p n bytes of a DELTA payload.
+ *
+ * @return 0 on success, or -1 if the connection failed.
+ */
+static int delta_recv(delta_apply_t *d, void *buf, size_t n)
+{
+    if (recv_all(d->c->sock, buf, n) < 0)
+        return -1;
+    d->payload_sum = rfs_fnv64(d->payload_sum, buf, n);
+    d->left -= n;
+    charge(d->c, n);
+    return 0;
+}
+
+/**
+ * @brief Append bytes to the new version.
+ *
+ * @return 0 on success, or -1 on a write error.
+ */
+static int delta_emit(delta_apply_t *d, const uint8_t *p, size_t n)
+{
+    d->out_sum = rfs_fnv64(d->out_sum, p, n);
+    d->out_len += n;
+    return write_all(d->out_fd, p, n);
+}
+
+/**
+ * @brief Apply the ops of a DELTA payload (after its header).
+ *
+ * Literals are streamed from the socket into the temp file and block
+ * references are copied from the base through one RFS_IO_CHUNK buffer.
+ * Stops at the first bad op or local error; the caller drains what is
+ * left of the payload.
+ *
+ * @return RFS_OK or an RFS_ERR_* status, or -1 if the connection failed.
+ */
+static int apply_delta(delta_apply_t *d)
+{
+    uint8_t buf[RFS_IO_CHUNK];
+    uint32_t nblocks = (uint32_t)((d->base_size + d->block_size - 1) / d->block_size);
+
+    while (d->left > 0)
+    {
+        uint8_t op[9];
+        uint32_t v;
+        if (d->left < 5)
+            return RFS_ERR_BAD_REQUEST;
+        if (delta_recv(d, op, 5) < 0)
+            return -1;
+        memcpy(&v, op + 1, 4);
+        v = ntohl(v);
+
+        if (op[0] == DELTA_OP_LITERAL)
+        {
+            if (v > d->left)
+                return RFS_ERR_BAD_REQUEST;
+            while (v > 0)
+            {
+                size_t n = v < sizeof(buf) ? v : sizeof(buf);
+                if (delta_recv(d, buf, n) < 0)
+                    return -1;
+                if (delta_emit(d, buf, n) < 0)
+                    return RFS_ERR_IO;
+                v -= (uint32_t)n;
+            }
+        }
+        else if (op[0] == DELTA_OP_COPY)
+        {
+            if (d->left < 4)
+                return RFS_ERR_BAD_REQUEST;
+            uint32_t count;
+            if (delta_recv(d, &count, 4) < 0)
+                return -1;
+            count = ntohl(count);
+            if (v >= nblocks || count > nblocks - v)
+                return RFS_ERR_BAD_REQUEST;
+
+            uint64_t off = (uint64_t)v * d->block_size;
+            uint64_t end = off + (uint64_t)count * d->block_size;
+            if (end > d->base_size)
+                end = d->base_size;
+            while (off < end)
+            {
+                size_t n = end - off < sizeof(buf) ? (size_t)(end - off) : sizeof(buf);
+                if (read_at(d->base_fd, buf, n, off) < 0 || delta_emit(d, buf, n) < 0)
+                    return RFS_ERR_IO;
+                off += n;
+            }
+        }
+        else
+            return RFS_ERR_BAD_REQUEST;
+    }
+    return RFS_OK;
+}
+
+/**
+ * @brief DELTA: store a new version rebuilt from the current one.
+ *
+ * The current version is opened under @c fs_mutex and must still have
+ * the checksum the client's delta was built against, else the reply is
+ * RFS_ERR_STALE and the client falls back to a WRITE. The result is
+ * built in a temp file (apply_delta()), must match the size and
+ * checksum the client announced, and is then committed like a WRITE.
+ * On any error the rest of the payload is still drained so the
+ * connection stays in step. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header; the payload is described in delta.h.
+ * @param remote_path Remote path to store the new version under.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_delta(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    char full_path[SERVER_PATH_MAX];
+    char tmp_path[1100];
+    char path_buf[RFS_MAX_PATH];
+    index_entry_t e;
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("DELTA: %s (%llu bytes)\n", full_path,
+           (unsigned long long)req->payload_len);
+
+    delta_apply_t d = { c, req->payload_len, RFS_FNV64_INIT, -1, 0, 0, -1, 0,
+                        RFS_FNV64_INIT };
+    uint8_t hdr[DELTA_HDR_LEN];
+    if (d.left < DELTA_HDR_LEN)
+    {
+        /* too short for the header: drain it (and its checksum) and refuse */
+        uint64_t drain = d.left + ((req->flags & RFS_F_DATA_SUM) ? 8 : 0);
+        if (recv_to_fd(c, -1, drain, NULL) < 0)
+            return CONN_CLOSE;
+        return send_reply(c, RFS_ERR_BAD_REQUEST, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+    if (delta_recv(&d, hdr, DELTA_HDR_LEN) < 0)
+        return CONN_CLOSE;
+
+    int status = RFS_OK;
+    uint64_t base_sum = rfs_get_u64(hdr);
+    uint64_t new_size = rfs_get_u64(hdr + 8);
+    uint64_t new_sum = rfs_get_u64(hdr + 16);
+    uint32_t bs_net;
+    memcpy(&bs_net, hdr + 24, 4);
+    d.block_size = ntohl(bs_net);
+
+    if (snapshot_path(remote_path) || index_reserved(remote_path))
+        status = RFS_ERR_READ_ONLY;
+    else
+    {
+        pthread_mutex_lock(&fs_mutex);
+        d.base_fd = open(full_path, O_RDONLY);
+        int indexed = d.base_fd >= 0 &&
+                      index_get(remote_path, &e, path_buf, sizeof(path_buf)) == 1;
+        pthread_mutex_unlock(&fs_mutex);
+
+        struct stat st;
+        if (d.base_fd < 0 || fstat(d.base_fd, &st) < 0 || !S_ISREG(st.st_mode))
+            status = RFS_ERR_NOT_FOUND;
+        else
+        {
+            d.base_size = (uint64_t)st.st_size;
+            if (d.block_size != delta_block_size(d.base_size) ||
+                !client_copy_current(remote_path, d.base_fd, d.base_size,
+                                     indexed ? &e : NULL, base_sum))
+                status = RFS_ERR_STALE;
+            else if ((d.out_fd = open_temp(full_path, tmp_path, sizeof(tmp_path))) < 0)
+                status = RFS_ERR_IO;
+        }
+    }
+
+    int rc = 0;
+    if (status == RFS_OK)
+    {
+        rc = apply_delta(&d);
+        if (rc > 0)
+            status = rc;
+    }
+    if (rc >= 0 && d.left > 0 && recv_to_fd(c, -1, d.left, NULL) < 0)
+        rc = -1;
+    if (rc >= 0 && (req->flags & RFS_F_DATA_SUM))
+    {
+        uint8_t trailer[8];
+        if (recv_all(c->sock, trailer, 8) < 0)
+            rc = -1;
+        else if (status == RFS_OK && rfs_get_u64(trailer) != d.payload_sum)
+            status = RFS_ERR_CHECKSUM;
+    }
+    if (status == RFS_OK && (d.out_len != new_size || d.out_sum != new_sum))
+    {
+        fprintf(stderr, "DELTA: %s rebuilt file does not match\n", full_path);
+        status = RFS_ERR_CHECKSUM;
+    }
+
+    if (d.base_fd >= 0)
+        close(d.base_fd);
+    if (d.out_fd >= 0)
+    {
+        if (close(d.out_fd) < 0 && status == RFS_OK)
+            status = RFS_ERR_IO;
+        if (rc < 0 || status != RFS_OK)
+            unlink(tmp_path);
+        else if (commit_temp(tmp_path, full_path, remote_path, new_size, &new_sum) < 0)
+            status = RFS_ERR_IO;
+    }
+
+    if (rc < 0)
+        return CONN_CLOSE;
+    return send_reply(c, (uint32_t)status, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/*------------------------------------------------------------*/
+/*                       APPEND and PATCH                     */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Fill @p out with the data of @p in, sharing it where possible.
+ *
+ * A reflink (FICLONE) shares the blocks; otherwise copy_fd() copies
+ * them in the kernel.
+ *
+ * @param in Source file.
+ * @param out Empty destination file.
+ * @param size Size of @p in.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int clone_data(int in, int out, uint64_t size)
+{
+    if (ioctl(out, FICLONE, in) == 0)
+        return 0;
+    return copy_fd(in, out, size);
+}
+
+/**
+ * @brief Give a stored file an inode of its own before changing it.
+ *
+ * Snapshots and COPY share inodes through hard links. The file is
+ * cloned into a temp file that is renamed over it, so the other names
+ * keep the old contents. Must be called with @c fs_mutex held.
+ *
+ * @param full_path Full path (including SERVER_ROOT) of the file.
+ * @param st Its metadata.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int unshare_file(const char *full_path, const struct stat *st)
+{
+    char tmp_path[1100];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s%sXXXXXX",
+                 full_path, RFS_TMP_MARKER) >= (int)sizeof(tmp_path))
+        return -1;
+    int in = open(full_path, O_RDONLY);
+    int out = in >= 0 ? mkstemp(tmp_path) : -1;
+    int rc = out >= 0 && fchmod(out, 0644) == 0 &&
+             clone_data(in, out, (uint64_t)st->st_size) == 0 ? 0 : -1;
+    if (in >= 0)
+        close(in);
+    if (out >= 0)
+    {
+        if (close(out) < 0)
+            rc = -1;
+        if (rc == 0 && rename(tmp_path, full_path) < 0)
+            rc = -1;
+        if (rc < 0)
+            unlink(tmp_path);
+    }
+    return rc;
+}
+
+/**
+ * @brief Add a received temp file to the end of the current version.
+ *
+ * Under @c fs_mutex the data is copied onto the end of the file in
+ * the kernel, so the cost is the appended bytes only. A missing file
+ * is created from the temp file as version 1. If the copy fails, the
+ * file is truncated back. The index checksum, when known, is carried
+ * on over the new bytes.
+ *
+ * @param tmp_path Temp file holding the data.
+ * @param tmp_fd Its open descriptor.
+ * @param full_path Full path (including SERVER_ROOT) of the file.
+ * @param remote_path Remote path of the file.
+ * @param len Bytes to append.
+ * @param sum FNV-1a-64 of the appended bytes if known, else NULL.
+ * @param new_size Receives the size of the file afterwards.
+ *
+ * @return RFS_OK or an RFS_ERR_* code. The temp file is gone either way.
+ */
+static uint32_t append_commit(const char *tmp_path, int tmp_fd,
+                              const char *full_path, const char *remote_path,
+                              uint64_t len, const uint64_t *sum,
+                              uint64_t *new_size)
+{
+    uint32_t status = RFS_OK;
+    struct stat st;
+
+    pthread_mutex_lock(&fs_mutex);
+    if (stat(full_path, &st) < 0)
+    {
+        if (errno != ENOENT || fstat(tmp_fd, &st) < 0 || rename(tmp_path, full_path) < 0)
+            status = RFS_ERR_IO;
+        else
+        {
+            int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+            index_put(remote_path, 1, len, mtime_ns, sum);
+            watch_notify(RFS_EV_WRITE, remote_path, 1, len);
+            *new_size = len;
+        }
+        pthread_mutex_unlock(&fs_mutex);
+        if (status != RFS_OK)
+            unlink(tmp_path);
+        return status;
+    }
+
+    int out = -1;
+    if (!S_ISREG(st.st_mode))
+        status = RFS_ERR_BAD_REQUEST;
+    else if ((st.st_nlink > 1 && unshare_file(full_path, &st) < 0) ||
+             (out = open(full_path, O_WRONLY)) < 0 ||
+             lseek(out, 0, SEEK_END) != st.st_size)
+        status = RFS_ERR_IO;
+    else if (copy_fd(tmp_fd, out, len) < 0)
+    {
+        if (ftruncate(out, st.st_size) < 0)
+            perror("ftruncate");
+        status = RFS_ERR_IO;
+    }
+
+    struct stat now;
+    if (status == RFS_OK && fstat(out, &now) == 0)
+    {
+        index_entry_t e;
+        char path_buf[RFS_MAX_PATH];
+        uint64_t h;
+        uint32_t version;
+        int known = 0;
+        if (index_get(remote_path, &e, path_buf, sizeof(path_buf)) == 1)
+        {
+            version = e.version;
+            known = (e.flags & INDEX_F_CHECKSUM) && e.size == (uint64_t)st.st_size &&
+                    hash_file_from(tmp_fd, len, e.checksum, &h) == 0;
+        }
+        else
+            version = index_count_versions(AT_FDCWD, full_path, remote_path);
+
+        *new_size = (uint64_t)now.st_size;
+        int64_t mtime_ns = (int64_t)now.st_mtim.tv_sec * 1000000000LL + now.st_mtim.tv_nsec;
+        index_put(remote_path, version, *new_size, mtime_ns, known ? &h : NULL);
+        watch_notify(RFS_EV_WRITE, remote_path, version, *new_size);
+    }
+    if (out >= 0 && close(out) < 0)
+        status = RFS_ERR_IO;
+    pthread_mutex_unlock(&fs_mutex);
+
+    unlink(tmp_path);
+    return status;
+}
+
+/**
+ * @brief APPEND: add data to the end of a file, without a new version.
+ *
+ * The payload is received into a temp file first, so a failed upload
+ * never leaves a partial append, and then added with append_commit().
+ * Cost is proportional to the appended bytes, whatever the file size.
+ * The version number stays the same: the file grows in place, like a
+ * log. Readers that opened it earlier see its old length, and those
+ * bytes do not change. A snapshot or COPY that shares the file's inode
+ * keeps the old contents. A missing file is created. v2 only; the
+ * reply's @c arg is the new size.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c payload_len is the number of bytes to
+ *            append (with RFS_F_DATA_SUM, followed by their checksum).
+ * @param remote_path Remote file to append to.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_append(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    char full_path[SERVER_PATH_MAX];
+    char tmp_path[1100];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("APPEND: %s (%llu bytes)\n", full_path,
+           (unsigned long long)req->payload_len);
+
+    uint32_t status = RFS_OK;
+    int want_sum = (req->flags & RFS_F_DATA_SUM) != 0;
+
+    int fd = -1;
+    if (snapshot_path(remote_path) || index_reserved(remote_path))
+        status = RFS_ERR_READ_ONLY;     /* still drain the payload below */
+    else if ((fd = open_temp(full_path, tmp_path, sizeof(tmp_path))) < 0)
+        status = RFS_ERR_IO;
+
+    uint64_t sum = 0;
+    int rc = recv_to_fd(c, fd, req->payload_len, want_sum ? &sum : NULL);
+    if (rc == 0 && want_sum)
+    {
+        uint8_t trailer[8];
+        if (recv_all(c->sock, trailer, 8) < 0)
+            rc = -1;
+        else if (rfs_get_u64(trailer) != sum)
+            status = RFS_ERR_CHECKSUM;
+    }
+    if (rc > 0)
+        status = RFS_ERR_IO;
+
+    uint64_t new_size = 0;
+    if (fd >= 0)
+    {
+        if (rc < 0 || status != RFS_OK)
+            unlink(tmp_path);
+        else
+            status = append_commit(tmp_path, fd, full_path, remote_path,
+                                   req->payload_len, want_sum ? &sum : NULL,
+                                   &new_size);
+        close(fd);
+    }
+
+    if (rc < 0)
+        return CONN_CLOSE;
+    return send_reply(c, status, 0, 0, new_size) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief PATCH: overwrite part of a file, as a new version.
+ *
+ * The current version is cloned into a temp file (a reflink where the
+ * file system has them, so only the changed blocks take new space;
+ * otherwise a copy in the kernel), the payload is written over it at
+ * @c arg, and the result is committed like a WRITE: the old version is
+ * kept as .vN. Only the changed bytes cross the network. The patch may
+ * extend the file but not leave a hole, so @c arg is at most the
+ * current size. Like a WRITE, a PATCH racing another commit is based
+ * on whichever version it opened, and both stay in the history. v2
+ * only; the reply's @c arg is the new size.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c arg is the offset, @c payload_len the
+ *            number of bytes (with RFS_F_DATA_SUM, followed by their
+ *            checksum).
+ * @param remote_path Remote file to patch.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_patch(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    char full_path[SERVER_PATH_MAX];
+    char tmp_path[1100];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("PATCH: %s (%llu bytes at %llu)\n", full_path,
+           (unsigned long long)req->payload_len, (unsigned long long)req->arg);
+
+    uint32_t status = RFS_OK;
+    int want_sum = (req->flags & RFS_F_DATA_SUM) != 0;
+    struct stat st;
+    int base = -1;
+    int fd = -1;
+
+    if (snapshot_path(remote_path) || index_reserved(remote_path))
+        status = RFS_ERR_READ_ONLY;     /* still drain the payload below */
+    else
+    {
+        pthread_mutex_lock(&fs_mutex);
+        base = open(full_path, O_RDONLY);
+        pthread_mutex_unlock(&fs_mutex);
+
+        if (base < 0 || fstat(base, &st) < 0 || !S_ISREG(st.st_mode))
+            status = RFS_ERR_NOT_FOUND;
+        else if (req->arg > (uint64_t)st.st_size)
+            status = RFS_ERR_BAD_REQUEST;
+        else if ((fd = open_temp(full_path, tmp_path, sizeof(tmp_path))) < 0)
+            status = RFS_ERR_IO;
+        else if (clone_data(base, fd, (uint64_t)st.st_size) < 0 ||
+                 lseek(fd, (off_t)req->arg, SEEK_SET) < 0)
+            status = RFS_ERR_IO;
+    }
+    if (base >= 0)
+        close(base);
+
+    uint64_t sum = 0;
+    int rc = recv_to_fd(c, status == RFS_OK ? fd : -1, req->payload_len,
+                        want_sum ? &sum : NULL);
+    if (rc == 0 && want_sum)
+    {
+        uint8_t trailer[8];
+        if (recv_all(c->sock, trailer, 8) < 0)
+            rc = -1;
+        else if (rfs_get_u64(trailer) != sum)
+            status = RFS_ERR_CHECKSUM;
+    }
+    if (rc > 0)
+        status = RFS_ERR_IO;
+
+    uint64_t new_size = 0;
+    if (fd >= 0)
+    {
+        new_size = req->arg + req->payload_len > (uint64_t)st.st_size
+                 ? req->arg + req->payload_len : (uint64_t)st.st_size;
+        /* a reflink keeps the old mtime; the new version is from now */
+        if (status == RFS_OK && futimens(fd, NULL) < 0)
+            status = RFS_ERR_IO;
+        if (close(fd) < 0 && status == RFS_OK)
+            status = RFS_ERR_IO;
+        if (rc < 0 || status != RFS_OK)
+            unlink(tmp_path);
+        else if (commit_temp(tmp_path, full_path, remote_path, new_size, NULL) < 0)
+            status = RFS_ERR_IO;
+    }
+
+    if (rc < 0)
+        return CONN_CLOSE;
+    return send_reply(c, status, 0, 0, status == RFS_OK ? new_size : 0) < 0
+           ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief Append one LS entry (name + timestamp) to a listing.
+ *
+ * @param out Listing being built.
+ * @param name Entry name to report.
+ * @param mtime Last modification time of the entry.
+ *
+ * @return 0 on success, or -1 on allocation failure.
+ */
+static int append_version_entry(buf_t *out, const char *name, time_t mtime)
+{
+    char ts_buf[64];
+    struct tm tm_buf;
+
+    localtime_r(&mtime, &tm_buf);
+    strftime(ts_buf, sizeof(ts_buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
+
+    uint32_t name_len = (uint32_t)strlen(name);
+    uint32_t ts_len   = (uint32_t)strlen(ts_buf);
+
+    if (buf_append_u32(out, name_len) < 0 ||
+        buf_append_u32(out, ts_len) < 0 ||
+        buf_append(out, name, name_len) < 0 ||
+        buf_append(out, ts_buf, ts_len) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief LS: list all versions of a file and their timestamps.
+ *
+ * The listing is encoded as a uint32 count followed by, per entry,
+ * uint32 name length, uint32 timestamp length, name, and timestamp.
+ * v1 clients receive exactly that; v2 clients receive it as the
+ * payload of a response.
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Remote file whose versions to list.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_ls(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    char full_path[SERVER_PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("LS: %s\n", full_path);
+
+    buf_t *entries = conn_reply(c);
+    uint32_t count = 0;
+    int oom = 0;
+
+    pthread_mutex_lock(&fs_mutex);
+
+    /* Base file (current version) */
+    struct stat st;
+    if (stat(full_path, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        if (append_version_entry(entries, remote_path, st.st_mtime) < 0)
+            oom = 1;
+        count++;
+    }
+
+    /* Versioned files: file.v1, file.v2, ... in either tier */
+    for (int version = 1; !oom; version++)
+    {
+        char v_full_path[1100];
+        char name_buf[RFS_MAX_PATH + 16];
+        snprintf(v_full_path, sizeof(v_full_path), "%s.v%d", full_path, version);
+        snprintf(name_buf, sizeof(name_buf), "%s.v%d", remote_path, version);
+
+        struct stat vst;
+        if (stat(v_full_path, &vst) < 0 && tier_stat(name_buf, &vst) < 0)
+            break;
+
+        if (S_ISREG(vst.st_mode))
+        {
+            if (append_version_entry(entries, name_buf, vst.st_mtime) < 0)
+                oom = 1;
+            count++;
+        }
+    }
+
+    pthread_mutex_unlock(&fs_mutex);
+
+    int rc = CONN_KEEP;
+    if (oom)
+    {
+        perror("realloc");
+        rc = (c->proto == RFS_PROTO_V2 &&
+              send_reply(c, RFS_ERR_IO, 0, 0, 0) == 0) ? CONN_KEEP : CONN_CLOSE;
+    }
+    else
+    {
+        uint32_t count_net = htonl(count);
+        if ((c->proto == RFS_PROTO_V2 &&
+             send_reply(c, RFS_OK, 0, 4 + entries->len, count) < 0) ||
+            send_all(c->sock, &count_net, 4) < 0 ||
+            send_all(c->sock, entries->data, entries->len) < 0)
+            rc = CONN_CLOSE;
+    }
+    return rc;
+}
+
+/**
+ * @brief Append one STAT / LIST entry (see protocol.h) to a buffer.
+ *
+ * @param out Buffer to append to.
+ * @param e Index entry to encode.
+ * @param wire_flags Extra RFS_ENTRY_* bits (RFS_ENTRY_DIR for LSDIR).
+ *
+ * @return 0 on success, or -1 on allocation failure.
+ */
+static int append_index_entry(buf_t *out, const index_entry_t *e,
+                              uint32_t wire_flags)
+{
+    uint8_t fixed[RFS_ENTRY_FIXED];
+    uint32_t v;
+
+    v = htonl(e->version);
+    memcpy(fixed, &v, 4);
+    v = htonl(((e->flags & INDEX_F_CHECKSUM) ? RFS_ENTRY_CHECKSUM : 0) | wire_flags);
+    memcpy(fixed + 4, &v, 4);
+    rfs_put_u64(fixed + 8, e->size);
+    rfs_put_u64(fixed + 16, (uint64_t)e->mtime_ns);
+    rfs_put_u64(fixed + 24, e->checksum);
+
+    uint32_t path_len = (uint32_t)strlen(e->path);
+    if (buf_append_u32(out, path_len) < 0 ||
+        buf_append(out, e->path, path_len) < 0 ||
+        buf_append(out, fixed, sizeof(fixed)) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief STAT: return the indexed metadata of one file.
+ *
+ * Answered from the metadata index. If the checksum is not known yet
+ * (the file arrived without one, or the index was rebuilt) it is
+ * computed now from the same version and stored for next time.
+ * v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Remote file to describe.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_stat(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    char full_path[SERVER_PATH_MAX];
+    char path_buf[RFS_MAX_PATH];
+    index_entry_t e;
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    /* read the entry and open the file as one step against commits */
+    int fd = -1;
+    pthread_mutex_lock(&fs_mutex);
+    int found = index_get(remote_path, &e, path_buf, sizeof(path_buf));
+    if (found == 1 && !(e.flags & INDEX_F_CHECKSUM))
+        fd = open(full_path, O_RDONLY);
+    pthread_mutex_unlock(&fs_mutex);
+
+    if (found < 0)
+        return send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    if (found == 0)
+        return send_reply(c, RFS_ERR_NOT_FOUND, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    if (fd >= 0)
+    {
+        uint64_t h;
+        int ok = hash_file(fd, e.size, &h) == 0;
+        close(fd);
+        if (ok)
+        {
+            e.checksum = h;
+            e.flags |= INDEX_F_CHECKSUM;
+            index_set_checksum(remote_path, e.version, e.size, h);
+        }
+    }
+
+    buf_t *out = conn_reply(c);
+    if (append_index_entry(out, &e, 0) < 0)
+        return send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    return (send_reply(c, RFS_OK, 0, out->len, 1) < 0 ||
+            send_all(c->sock, out->data, out->len) < 0) ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief LIST: every stored file under a path prefix, from the index.
+ *
+ * Entries are sorted by path and carry the same fields as STAT;
+ * unknown checksums are reported as such rather than computed. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Path prefix ("" for the whole tree).
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_list(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    printf("LIST: %s\n", remote_path[0] ? remote_path : "(all)");
+
+    index_list_t list;
+    buf_t *out = conn_reply(c);
+    int ok = index_list(remote_path, &list) == 0;
+    for (size_t i = 0; ok && i < list.count; i++)
+    {
+        if (append_index_entry(out, &list.entries[i], 0) < 0)
+            ok = 0;
+    }
+
+    int rc;
+    if (!ok)
+        rc = send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    else
+        rc = (send_reply(c, RFS_OK, 0, out->len, list.count) < 0 ||
+              send_all(c->sock, out->data, out->len) < 0) ? CONN_CLOSE : CONN_KEEP;
+
+    index_list_free(&list);
+    return rc;
+}
+
+/**
+ * @brief Describe one directory entry for LSDIR.
+ *
+ * Files are answered from the metadata index when possible, so a page
+ * costs one mmap lookup per file; files the index does not know (the
+ * snapshot area) are stat'ed and their versions counted on disk.
+ *
+ * @param dir Open directory being listed.
+ * @param dir_path Remote path of the directory.
+ * @param name Entry name within the directory.
+ * @param out Buffer to append the encoded entry to.
+ *
+ * @return 1 if an entry was appended, 0 if the name is skipped, or -1
+ *         on allocation failure.
+ */
+static int append_dir_entry(DIR *dir, const char *dir_path, const char *name,
+                            buf_t *out)
+{
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+        strstr(name, RFS_TMP_MARKER) != NULL || index_is_version_name(name))
+        return 0;
+
+    char child[RFS_MAX_PATH];
+    if (snprintf(child, sizeof(child), "%s/%s", dir_path, name) >= (int)sizeof(child) ||
+        index_reserved(child))
+        return 0;
+
+    char path_buf[RFS_MAX_PATH];
+    index_entry_t e;
+    if (index_get(child, &e, path_buf, sizeof(path_buf)) == 1)
+    {
+        e.path = name;
+        return append_index_entry(out, &e, 0) < 0 ? -1 : 1;
+    }
+
+    struct stat st;
+    if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) < 0 ||
+        !(S_ISREG(st.st_mode) || S_ISDIR(st.st_mode)))
+        return 0;
+
+    memset(&e, 0, sizeof(e));
+    e.path = name;
+    e.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    if (S_ISDIR(st.st_mode))
+        return append_index_entry(out, &e, RFS_ENTRY_DIR) < 0 ? -1 : 1;
+
+    e.version = index_count_versions(dirfd(dir), name, child);
+    e.size = (uint64_t)st.st_size;
+    return append_index_entry(out, &e, 0) < 0 ? -1 : 1;
+}
+
+/**
+ * @brief LSDIR: list one directory a page at a time.
+ *
+ * The continuation token (req->arg) is the directory stream position
+ * after the last entry of the previous page (telldir()), so each page
+ * resumes with seekdir() instead of rescanning, and the server never
+ * holds more than one page in memory. The page ends after the requested
+ * number of entries (an optional 4-byte payload, default
+ * LSDIR_PAGE_DEFAULT) or LSDIR_PAGE_BYTES of reply, whichever is first.
+ * Saved versions, upload temp files and the index are not listed.
+ * v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c arg is the continuation token.
+ * @param remote_path Directory to list.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_lsdir(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    uint32_t limit = LSDIR_PAGE_DEFAULT;
+    if (req->payload_len == 4)
+    {
+        uint32_t limit_net;
+        if (recv_all(c->sock, &limit_net, 4) < 0)
+            return CONN_CLOSE;
+        limit = ntohl(limit_net);
+    }
+    else if (req->payload_len != 0)
+    {
+        if (recv_to_fd(c, -1, req->payload_len, NULL) < 0)
+            return CONN_CLOSE;
+        return send_reply(c, RFS_ERR_BAD_REQUEST, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+    if (limit == 0 || limit > LSDIR_PAGE_MAX)
+        limit = limit == 0 ? LSDIR_PAGE_DEFAULT : LSDIR_PAGE_MAX;
+
+    char full_path[SERVER_PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("LSDIR: %s (token %llu)\n", full_path, (unsigned long long)req->arg);
+
+    DIR *dir = opendir(full_path);
+    if (!dir)
+    {
+        uint32_t status = (errno == ENOENT || errno == ENOTDIR) ?
+                          RFS_ERR_NOT_FOUND : RFS_ERR_IO;
+        return send_reply(c, status, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+    if (req->arg != 0)
+        seekdir(dir, (long)req->arg);
+
+    buf_t *out = conn_reply(c);
+    uint32_t count = 0;
+    uint64_t next = 0;
+    int oom = 0;
+
+    while (1)
+    {
+        if (count >= limit || out->len >= LSDIR_PAGE_BYTES)
+        {
+            next = (uint64_t)telldir(dir);
+            break;
+        }
+
+        errno = 0;
+        struct dirent *de = readdir(dir);
+        if (!de)
+            break;
+
+        int rc = append_dir_entry(dir, remote_path, de->d_name, out);
+        if (rc < 0)
+        {
+            oom = 1;
+            break;
+        }
+        count += (uint32_t)rc;
+    }
+    int read_err = errno;
+    closedir(dir);
+
+    int rc;
+    if (oom || (next == 0 && read_err != 0))
+        rc = send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    else
+        rc = (send_reply(c, RFS_OK, 0, out->len, next) < 0 ||
+              send_all(c->sock, out->data, out->len) < 0) ? CONN_CLOSE : CONN_KEEP;
+    return rc;
+}
+
+/**
+ * @brief Compute the checksums the index is missing under a directory.
+ *
+ * After a rebuild the index knows no checksums, so directory digests
+ * are incomplete until each file has been hashed once. This hashes
+ * them on first use, the way STAT does for a single file.
+ *
+ * @param dir_path Remote directory ("" for the root).
+ */
+static void fill_checksums(const char *dir_path)
+{
+    char prefix[RFS_MAX_PATH];
+    if (snprintf(prefix, sizeof(prefix), "%s%s", dir_path,
+                 dir_path[0] ? "/" : "") >= (int)sizeof(prefix))
+        return;
+
+    index_list_t list;
+    if (index_list(prefix, &list) < 0)
+        return;
+
+    for (size_t i = 0; i < list.count; i++)
+    {
+        const index_entry_t *e = &list.entries[i];
+        if (e->flags & INDEX_F_CHECKSUM)
+            continue;
+
+        char full_path[SERVER_PATH_MAX];
+        char path_buf[RFS_MAX_PATH];
+        index_entry_t cur;
+        snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, e->path);
+
+        int fd = -1;
+        pthread_mutex_lock(&fs_mutex);
+        if (index_get(e->path, &cur, path_buf, sizeof(path_buf)) == 1 &&
+            !(cur.flags & INDEX_F_CHECKSUM))
+            fd = open(full_path, O_RDONLY);
+        pthread_mutex_unlock(&fs_mutex);
+
+        uint64_t h;
+        if (fd >= 0 && hash_file(fd, cur.size, &h) == 0)
+            index_set_checksum(e->path, cur.version, cur.size, h);
+        if (fd >= 0)
+            close(fd);
+    }
+    index_list_free(&list);
+}
+
+/**
+ * @brief TREE: one level of a Merkle tree comparison.
+ *
+ * Replies with the directory's digest in resp.arg and its files and
+ * non-empty subdirectories as STAT entries (see protocol.h). Digests
+ * come straight from the index, which keeps them current on every
+ * commit and removal, so a client only descends into subdirectories
+ * whose digest differs from its own. The digest and the entries are
+ * read without a common lock; a commit in between only makes the
+ * client look one level deeper. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Directory to describe ("" for the root).
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_tree(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    printf("TREE: %s\n", remote_path[0] ? remote_path : "(root)");
+
+    uint64_t digest;
+    uint64_t files;
+    uint64_t unknown;
+    int found = index_get_dir(remote_path, &digest, &files, &unknown);
+    if (found == 1 && unknown > 0)
+    {
+        fill_checksums(remote_path);
+        found = index_get_dir(remote_path, &digest, &files, &unknown);
+    }
+    if (found < 0)
+        return send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    char full_path[SERVER_PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+    DIR *dir = found ? opendir(full_path) : NULL;
+    if (!dir)
+        return send_reply(c, RFS_ERR_NOT_FOUND, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    buf_t *out = conn_reply(c);
+    int oom = 0;
+    struct dirent *de;
+    while (!oom && (de = readdir(dir)) != NULL)
+    {
+        const char *name = de->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+            strstr(name, RFS_TMP_MARKER) != NULL || index_is_version_name(name))
+            continue;
+
+        char child[RFS_MAX_PATH];
+        if (snprintf(child, sizeof(child), "%s%s%s", remote_path,
+                     remote_path[0] ? "/" : "", name) >= (int)sizeof(child) ||
+            snapshot_path(child) || index_reserved(child))
+            continue;
+
+        char path_buf[RFS_MAX_PATH];
+        index_entry_t e;
+        uint32_t wire_flags = 0;
+        if (index_get(child, &e, path_buf, sizeof(path_buf)) != 1)
+        {
+            uint64_t sub_files;
+            uint64_t sub_unknown;
+            memset(&e, 0, sizeof(e));
+            if (index_get_dir(child, &e.checksum, &sub_files, &sub_unknown) != 1)
+                continue;
+            e.size = sub_files;
+            e.flags = sub_unknown == 0 ? INDEX_F_CHECKSUM : 0;
+            wire_flags = RFS_ENTRY_DIR;
+        }
+        e.path = name;
+        if (append_index_entry(out, &e, wire_flags) < 0)
+            oom = 1;
+    }
+    closedir(dir);
+
+    int rc;
+    if (oom)
+        rc = send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    else
+        rc = (send_reply(c, RFS_OK, 0, out->len, digest) < 0 ||
+              send_all(c->sock, out->data, out->len) < 0) ? CONN_CLOSE : CONN_KEEP;
+    return rc;
+}
+
+/**
+ * @brief RM: remove a file and all of its versions, or a directory.
+ *
+ * v1 status codes: 0 ok, 1 not found, 2 directory not empty,
+ * 3 rmdir failed, 4 unlink failed, 5 stat failed. v2 clients receive
+ * RFS_OK, RFS_ERR_NOT_FOUND, RFS_ERR_NOT_EMPTY or RFS_ERR_IO.
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Remote file or directory to remove.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_rm(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    char full_path[SERVER_PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("RM: %s\n", full_path);
+
+    uint32_t status = 0;
+
+    if (snapshot_path(remote_path) || index_reserved(remote_path))
+    {
+        /* snapshots are removed with SNAP -d, never piecemeal */
+        return send_status(c, 4, RFS_ERR_READ_ONLY) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+
+    pthread_mutex_lock(&fs_mutex);
+
+    struct stat st;
+    if (stat(full_path, &st) < 0)
+    {
+        if (errno == ENOENT) status = 1;   /* not found */
+        else status = 5;
+    }
+    else if (S_ISDIR(st.st_mode))
+    {
+        if (rmdir(full_path) < 0)
+        {
+            if (errno == ENOTEMPTY) status = 2;  /* dir not empty */
+            else status = 3;
+        }
+    }
+    else
+    {
+        /* delete base file */
+        if (unlink(full_path) < 0)
+        {
+            status = 4;
+        }
+        else
+        {
+            printf("Removed %s\n", full_path);
+            index_remove(remote_path);
+        }
+
+        /* delete version files: file.v1, file.v2, ... in both tiers */
+        int version = 1;
+        while (1)
+        {
+            char version_path[1100];
+            char remote_version[RFS_MAX_PATH + 16];
+            snprintf(version_path, sizeof(version_path),
+                     "%s.v%d", full_path, version);
+            snprintf(remote_version, sizeof(remote_version),
+                     "%s.v%d", remote_path, version);
+
+            int cold = tier_remove(remote_version) == 0;
+            struct stat vst;
+            if (stat(version_path, &vst) < 0)
+            {
+                if (errno == ENOENT && cold)
+                {
+                    printf("Removed %s (cold)\n", version_path);
+                    version++;
+                    continue;
+                }
+                if (errno == ENOENT) break;
+                status = 4;
+                break;
+            }
+
+            if (unlink(version_path) == 0)
+                printf("Removed %s\n", version_path);
+
+            version++;
+        }
+    }
+
+    if (status == 0)
+        watch_notify(RFS_EV_RM, remote_path, 0, 0);
+
+    pthread_mutex_unlock(&fs_mutex);
+
+    uint32_t v2_status = status == 0 ? RFS_OK
+                       : status == 1 ? RFS_ERR_NOT_FOUND
+                       : status == 2 ? RFS_ERR_NOT_EMPTY
+                       : RFS_ERR_IO;
+    return send_status(c, status, v2_status) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/*------------------------------------------------------------*/
+/*                         COPY and MOVE                      */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Give @p dst the contents of @p src without copying data.
+ *
+ * A reflink (FICLONE) is tried first. Where the file system has none,
+ * a hard link is made instead, as snapshots do. That is safe because
+ * APPEND, the only write in place, first calls unshare_file() on a
+ * file with more than one link. Only if both fail are the bytes copied. A reflink or copy keeps the source's
+ * mtime, which LS reports per version.
+ *
+ * @param src Full path of the stored file.
+ * @param dst Full path of the new name (must not exist).
+ *
+ * @return 0 on success, or -1 on error (nothing is left at @p dst).
+ */
+static int clone_file(const char *src, const char *dst)
+{
+    int in = open(src, O_RDONLY);
+    if (in < 0)
+        return -1;
+
+    struct stat st;
+    int out = fstat(in, &st) == 0 ? open(dst, O_WRONLY | O_CREAT | O_EXCL, 0644) : -1;
+    if (out < 0)
+    {
+        close(in);
+        return -1;
+    }
+
+    int rc = -1;
+    if (ioctl(out, FICLONE, in) == 0)
+        rc = 0;
+    else
+    {
+        close(out);
+        unlink(dst);
+        out = -1;
+        if (link(src, dst) == 0)
+        {
+            close(in);
+            return 0;
+        }
+        out = open(dst, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (out >= 0 && copy_fd(in, out, (uint64_t)st.st_size) == 0)
+            rc = 0;
+    }
+
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    if (rc == 0 && futimens(out, times) < 0)
+        rc = -1;
+    if (out >= 0 && close(out) < 0)
+        rc = -1;
+    close(in);
+    if (rc < 0)
+        unlink(dst);
+    return rc;
+}
+
+/**
+ * @brief Remote name of a file's @p n-th stored copy: the current
+ *        version for n = 0, else "<path>.v<n>".
+ *
+ * @return 0 on success, or -1 if it does not fit in @p size bytes.
+ */
+static int stored_name(char *out, size_t size, const char *remote_path, int n)
+{
+    int len = n == 0 ? snprintf(out, size, "%s", remote_path)
+                     : snprintf(out, size, "%s.v%d", remote_path, n);
+    return len < (int)size ? 0 : -1;
+}
+
+/**
+ * @brief Whether a file's @p n-th stored copy exists, in either tier.
+ */
+static int stored_exists(const char *remote_path, int n)
+{
+    char name[RFS_MAX_PATH + 16];
+    char full_path[1100];
+    struct stat st;
+    if (stored_name(name, sizeof(name), remote_path, n) < 0)
+        return 0;
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, name);
+    return lstat(full_path, &st) == 0 || (n > 0 && tier_stat(name, &st) == 0);
+}
+
+/**
+ * @brief Copy or move a file's @p n-th stored copy to another name.
+ *
+ * A hot copy is renamed or cloned (clone_file()); a version in the
+ * cold tier is renamed or linked there. Must be called with
+ * @c fs_mutex held.
+ *
+ * @param from Remote path of the source file.
+ * @param to Remote path of the destination file.
+ * @param n 0 for the current version, else the .vN number.
+ * @param move Non-zero to move rather than copy.
+ *
+ * @return 1 if it was transferred, 0 if there is no such copy, or -1
+ *         on error.
+ */
+static int transfer_stored(const char *from, const char *to, int n, int move)
+{
+    char src[RFS_MAX_PATH + 16];
+    char dst[RFS_MAX_PATH + 16];
+    char src_full[1100];
+    char dst_full[1100];
+    if (stored_name(src, sizeof(src), from, n) < 0 ||
+        stored_name(dst, sizeof(dst), to, n) < 0)
+        return -1;
+    snprintf(src_full, sizeof(src_full), "%s/%s", SERVER_ROOT, src);
+    snprintf(dst_full, sizeof(dst_full), "%s/%s", SERVER_ROOT, dst);
+
+    struct stat st;
+    if (stat(src_full, &st) == 0)
+    {
+        if (!move)
+            return clone_file(src_full, dst_full) == 0 ? 1 : -1;
+        if (rename(src_full, dst_full) < 0)
+            return -1;
+        tier_remove(src);   /* a copy left by an interrupted tier move */
+        return 1;
+    }
+    if (errno != ENOENT)
+        return -1;
+    if (n == 0 || tier_stat(src, &st) < 0)
+        return 0;
+    return (move ? tier_rename(src, dst) : tier_link(src, dst)) == 0 ? 1 : -1;
+}
+
+/**
+ * @brief Undo the first @p count transfers of a failed COPY or MOVE.
+ *
+ * Must be called with @c fs_mutex held.
+ */
+static void undo_transfer(const char *from, const char *to, int count, int move)
+{
+    for (int n = 0; n < count; n++)
+    {
+        if (move)
+        {
+            transfer_stored(to, from, n, 1);
+            continue;
+        }
+        char dst[RFS_MAX_PATH + 16];
+        char dst_full[1100];
+        if (stored_name(dst, sizeof(dst), to, n) < 0)
+            continue;
+        snprintf(dst_full, sizeof(dst_full), "%s/%s", SERVER_ROOT, dst);
+        if (unlink(dst_full) < 0 && n > 0)
+            tier_remove(dst);
+    }
+}
+
+/**
+ * @brief Copy or move a stored file and all of its versions.
+ *
+ * The payload holds the destination path. Under @c fs_mutex the
+ * current version and every .vN (in both tiers) are renamed, for
+ * MOVE, or cloned without copying data, for COPY; the index and
+ * watchers then see one RM (MOVE only) and one WRITE, as for any
+ * commit. The destination must not exist yet, and a failure halfway
+ * is undone. A snapshot can be a COPY source, so a file can be
+ * restored from one. v2 only; the reply's @c arg is the number of
+ * versions transferred.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c payload_len is the destination length.
+ * @param remote_path Source file.
+ * @param move Non-zero for MOVE.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int copy_or_move(conn_t *c, const rfs_req_t *req, const char *remote_path,
+                        int move)
+{
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    char dest[RFS_MAX_PATH];
+    if (req->payload_len >= sizeof(dest))
+    {
+        if (recv_to_fd(c, -1, req->payload_len, NULL) < 0)
+            return CONN_CLOSE;
+        return send_reply(c, RFS_ERR_BAD_REQUEST, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    }
+    if (recv_path(c->sock, (uint32_t)req->payload_len, dest) < 0)
+        return CONN_CLOSE;
+
+    const char *op = move ? "MOVE" : "COPY";
+    char src_full[1100];    /* SERVER_ROOT + '/' + up to RFS_MAX_PATH */
+    char dst_full[1100];
+    snprintf(src_full, sizeof(src_full), "%s/%s", SERVER_ROOT, remote_path);
+    snprintf(dst_full, sizeof(dst_full), "%s/%s", SERVER_ROOT, dest);
+    printf("%s: %s -> %s\n", op, src_full, dst_full);
+
+    if ((move && snapshot_path(remote_path)) || index_reserved(remote_path) ||
+        snapshot_path(dest) || index_reserved(dest))
+        return send_reply(c, RFS_ERR_READ_ONLY, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    if (dest[0] == '\0' || strcmp(dest, remote_path) == 0)
+        return send_reply(c, RFS_ERR_BAD_REQUEST, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    uint32_t status = RFS_OK;
+    int count = 0;
+    struct stat st;
+
+    pthread_mutex_lock(&fs_mutex);
+    if (stat(src_full, &st) < 0)
+        status = errno == ENOENT ? RFS_ERR_NOT_FOUND : RFS_ERR_IO;
+    else if (!S_ISREG(st.st_mode))
+        status = RFS_ERR_BAD_REQUEST;
+    else if (stored_exists(dest, 0) || stored_exists(dest, 1))
+        status = RFS_ERR_EXISTS;
+    else if (ensure_directories(dst_full) < 0)
+        status = RFS_ERR_IO;
+
+    while (status == RFS_OK)
+    {
+        int rc = transfer_stored(remote_path, dest, count, move);
+        if (rc == 0)
+            break;
+        if (rc < 0)
+        {
+            perror(op);
+            undo_transfer(remote_path, dest, count, move);
+            status = RFS_ERR_IO;
+            break;
+        }
+        count++;
+    }
+
+    if (status == RFS_OK)
+    {
+        index_entry_t e;
+        char path_buf[RFS_MAX_PATH];
+        int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        int known = index_get(remote_path, &e, path_buf, sizeof(path_buf)) == 1 &&
+                    (e.flags & INDEX_F_CHECKSUM) && e.size == (uint64_t)st.st_size;
+        index_put(dest, (uint32_t)count, (uint64_t)st.st_size, mtime_ns,
+                  known ? &e.checksum : NULL);
+        if (move)
+        {
+            index_remove(remote_path);
+            watch_notify(RFS_EV_RM, remote_path, 0, 0);
+        }
+        watch_notify(RFS_EV_WRITE, dest, (uint32_t)count, (uint64_t)st.st_size);
+        printf("%s: %d versions\n", op, count);
+    }
+    pthread_mutex_unlock(&fs_mutex);
+
+    return send_reply(c, status, 0, 0, (uint64_t)count) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief COPY: duplicate a file and its versions (see copy_or_move()).
+ */
+static int cmd_copy(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    return copy_or_move(c, req, remote_path, 0);
+}
+
+/**
+ * @brief MOVE: rename a file and its versions (see copy_or_move()).
+ */
+static int cmd_move(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    return copy_or_move(c, req, remote_path, 1);
+}
+
+/**
+ * @brief WRFD: WRITE from a file descriptor passed over the Unix socket.
+ *
+ * After the request the client sends its open local file as
+ * SCM_RIGHTS. The data is copied file-to-file in the kernel into a
+ * temp file, never through the socket, and committed like WRITE.
+ *
+ * @param c Client connection (must be AF_UNIX).
+ * @param req Request header (unused).
+ * @param remote_path Remote path to store the file under.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_write_fd(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    int src_fd = recv_fd(c->sock);
+    if (src_fd < 0)
+        return CONN_CLOSE;
+
+    char full_path[SERVER_PATH_MAX];
+    char tmp_path[1100];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    uint32_t status = RFS_OK;
+    struct stat sst;
+    if (snapshot_path(remote_path) || index_reserved(remote_path))
+        status = RFS_ERR_READ_ONLY;
+    else if (fstat(src_fd, &sst) < 0 || !S_ISREG(sst.st_mode))
+        status = RFS_ERR_BAD_REQUEST;
+
+    if (status == RFS_OK)
+    {
+        printf("WRITE (fd): %s (%lld bytes)\n",
+               full_path, (long long)sst.st_size);
+
+        int dst_fd = open_temp(full_path, tmp_path, sizeof(tmp_path));
+        if (dst_fd < 0)
+        {
+            status = RFS_ERR_IO;
+        }
+        else
+        {
+            if (copy_fd(src_fd, dst_fd, (uint64_t)sst.st_size) < 0)
+                status = RFS_ERR_IO;
+            if (close(dst_fd) < 0)
+                status = RFS_ERR_IO;
+
+            if (status != RFS_OK)
+                unlink(tmp_path);
+            else if (commit_temp(tmp_path, full_path, remote_path,
+                                 (uint64_t)sst.st_size, NULL) < 0)
+                status = RFS_ERR_IO;
+        }
+    }
+
+    close(src_fd);
+
+    uint32_t v1_status = status == RFS_OK ? 0
+                       : status == RFS_ERR_IO ? 6 : 3;
+    int rc = send_status(c, v1_status, status) < 0 ? CONN_CLOSE : CONN_KEEP;
+
+    /* copied in the kernel; bill the client's byte rate afterwards */
+    if (status == RFS_OK)
+        charge(c, (uint64_t)sst.st_size);
+    return rc;
+}
+
+/**
+ * @brief GETFD: answer a GET on the Unix socket with a file descriptor.
+ *
+ * Sends a status and, on success, an open read-only descriptor for
+ * the requested version as SCM_RIGHTS. Opening under @c fs_mutex pins
+ * the current version: a later WRITE renames it to .vN but the
+ * descriptor keeps the inode.
+ *
+ * @param c Client connection (must be AF_UNIX).
+ * @param req Request header (unused).
+ * @param remote_path Remote path to read.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_get_fd(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    char full_path[SERVER_PATH_MAX];
+    snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+
+    printf("GET (fd): %s\n", full_path);
+
+    int fd = open_stored(full_path, remote_path);
+
+    int rc = CONN_KEEP;
+    if (send_status(c, fd < 0 ? 1 : 0,
+                    fd < 0 ? RFS_ERR_NOT_FOUND : RFS_OK) < 0)
+        rc = CONN_CLOSE;
+    else if (fd >= 0 && send_fd(c->sock, fd) < 0)
+        rc = CONN_CLOSE;
+
+    if (fd >= 0)
+    {
+        /* the client reads the data itself; bill its byte rate anyway */
+        struct stat st;
+        if (rc == CONN_KEEP && fstat(fd, &st) == 0)
+            charge(c, (uint64_t)st.st_size);
+        close(fd);
+    }
+    return rc;
+}
+
+/**
+ * @brief SNAP: create or delete a point-in-time snapshot.
+ *
+ * The path names the snapshot; @c req->arg is 0 to create it or
+ * RFS_SNAP_DELETE to delete it. Creation holds @c fs_mutex for the
+ * whole walk, so no WRITE or RM can commit halfway through and the
+ * snapshot is a consistent view of every current version. Only
+ * metadata is touched (one hard link per file). The reply's @c arg
+ * is the number of files linked.
+ *
+ * @param c Client connection.
+ * @param req Request header.
+ * @param remote_path Snapshot name.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_snapshot(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    uint64_t files = 0;
+    uint32_t status;
+
+    if (req->arg == RFS_SNAP_DELETE)
+    {
+        printf("SNAP: delete %s\n", remote_path);
+        status = snapshot_delete(remote_path);
+    }
+    else
+    {
+        printf("SNAP: create %s\n", remote_path);
+        pthread_mutex_lock(&fs_mutex);
+        status = snapshot_create(remote_path, &files);
+        pthread_mutex_unlock(&fs_mutex);
+        if (status == RFS_OK)
+            printf("Snapshot %s: %llu files\n", remote_path,
+                   (unsigned long long)files);
+    }
+
+    if (c->proto == RFS_PROTO_V1)
+        return send_status(c, status, status) < 0 ? CONN_CLOSE : CONN_KEEP;
+    return send_reply(c, status, 0, 0, files) < 0 ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief WATCH: subscribe to change events under a path prefix.
+ *
+ * The connection is handed to the notifier in watch.c, which sends
+ * the reply and then one event per committed WRITE or RM whose remote
+ * path starts with @p remote_path. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Path prefix to watch ("" for everything).
+ *
+ * @return CONN_DETACH on success, otherwise CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_watch(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    printf("WATCH: %s\n", remote_path[0] ? remote_path : "(all)");
+
+    if (watch_add(c->sock, remote_path) < 0)
+        return send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    return CONN_DETACH;
+}
+
+/**
+ * @brief STATS: the most requested paths and what they moved.
+ *
+ * Reads the heavy-hitter heap and count-min sketches of stats.c; the
+ * counts are estimates and may be slightly high. The payload is the
+ * total requests and bytes recorded (8 bytes each), then one entry per
+ * path, most requested first: u32 path length, the path, u64 requests,
+ * u64 bytes. v2 only.
+ *
+ * @param c Client connection.
+ * @param req Request header; @c arg caps the entries (0 = all tracked).
+ * @param remote_path Unused.
+ *
+ * @return CONN_KEEP or CONN_CLOSE.
+ */
+static int cmd_stats(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)remote_path;
+
+    if (c->proto == RFS_PROTO_V1)
+        return CONN_CLOSE;
+
+    printf("STATS\n");
+
+    stats_entry_t top[STATS_TOP_K];
+    uint64_t total_req, total_bytes;
+    int n = stats_top(top, &total_req, &total_bytes);
+    if (req->arg > 0 && req->arg < (uint64_t)n)
+        n = (int)req->arg;
+
+    buf_t *out = conn_reply(c);
+    uint8_t num[16];
+    rfs_put_u64(num, total_req);
+    rfs_put_u64(num + 8, total_bytes);
+    int ok = buf_append(out, num, sizeof(num)) == 0;
+    for (int i = 0; ok && i < n; i++)
+    {
+        uint32_t path_len = (uint32_t)strlen(top[i].path);
+        rfs_put_u64(num, top[i].requests);
+        rfs_put_u64(num + 8, top[i].bytes);
+        ok = buf_append_u32(out, path_len) == 0 &&
+             buf_append(out, top[i].path, path_len) == 0 &&
+             buf_append(out, num, sizeof(num)) == 0;
+    }
+
+    if (!ok)
+        return send_reply(c, RFS_ERR_IO, 0, 0, 0) < 0 ? CONN_CLOSE : CONN_KEEP;
+    return (send_reply(c, RFS_OK, 0, out->len, (uint64_t)n) < 0 ||
+            send_all(c->sock, out->data, out->len) < 0) ? CONN_CLOSE : CONN_KEEP;
+}
+
+/**
+ * @brief STOP: shut down the server (sets @c server_running to 0).
+ *
+ * @param c Client connection.
+ * @param req Request header (unused).
+ * @param remote_path Unused.
+ *
+ * @return Always CONN_CLOSE.
+ */
+static int cmd_stop(conn_t *c, const rfs_req_t *req, const char *remote_path)
+{
+    (void)req;
+    (void)remote_path;
+
+    printf("STOP command received — shutting down server.\n");
+
+    /* reply first: once the acceptors stop, main() may exit at any time */
+    send_status(c, 0, RFS_OK);
+
+    server_running = 0;
+    stop_acceptors();
+    return CONN_CLOSE;
+}
+
+/*
+ * Command table shared by v1 and v2. @c v1_has_path says whether a v1
+ * request carries a length-prefixed path after the command (WRITE is
+ * parsed separately because its v1 header also carries the size).
+ */
+typedef int (*cmd_handler_t)(conn_t *c, const rfs_req_t *req,
+                             const char *remote_path);
+
+static const struct
+{
+    char cmd[5];
+    int v1_has_path;
+    cmd_handler_t handler;
+} commands[] = {
+    { {'W','R','I','T','E'}, 1, cmd_write    },
+    { {'G','E','T',' ',' '}, 1, cmd_get      },
+    { {'L','S',' ',' ',' '}, 1, cmd_ls       },
+    { {'R','M',' ',' ',' '}, 1, cmd_rm       },
+    { {'W','R','F','D',' '}, 1, cmd_write_fd },
+    { {'G','E','T','F','D'}, 1, cmd_get_fd   },
+    { {'S','N','A','P',' '}, 1, cmd_snapshot },
+    { {'W','A','T','C','H'}, 1, cmd_watch    },
+    { {'S','T','A','T',' '}, 1, cmd_stat     },
+    { {'L','I','S','T',' '}, 1, cmd_list     },
+    { {'L','S','D','I','R'}, 1, cmd_lsdir    },
+    { {'M','P','I','N','I'}, 1, cmd_mp_init  },
+    { {'M','P','P','U','T'}, 1, cmd_mp_put   },
+    { {'M','P','E','N','D'}, 1, cmd_mp_end   },
+    { {'M','P','A','B','T'}, 1, cmd_mp_abort },
+    { {'S','I','G','S',' '}, 1, cmd_sigs     },
+    { {'D','E','L','T','A'}, 1, cmd_delta    },
+    { {'T','R','E','E',' '}, 1, cmd_tree     },
+    { {'C','O','P','Y',' '}, 1, cmd_copy     },
+    { {'M','O','V','E',' '}, 1, cmd_move     },
+    { {'A','P','P','N','D'}, 1, cmd_append   },
+    { {'P','A','T','C','H'}, 1, cmd_patch    },
+    { {'S','T','A','T','S'}, 1, cmd_stats    },
+    { {'S','T','O','P',' '}, 0, cmd_stop     },
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+/**
+ * @brief Look up a command in the command table.
+ *
+ * @param cmd 5-byte command name.
+ *
+ * @return Index into @c commands, or -1 if unknown.
+ */
+static int find_command(const char *cmd)
+{
+    for (size_t i = 0; i < NUM_COMMANDS; i++)
+    {
+        if (memcmp(cmd, commands[i].cmd, 5) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+/*------------------------------------------------------------*/
+/*                      Connection handling                   */
+/*------------------------------------------------------------*/
+
+/**
+ * @brief Classify a request for the scheduler.
+ *
+ * Transfers larger than SCHED_SMALL_BYTES, WRFD (only used for large
+ * files) and SNAP (walks the whole tree) are bulk; everything else is
+ * small. A GET is sized with a stat of the file, so a concurrent
+ * WRITE may make the guess slightly stale, which is harmless. SIGS and
+ * DELTA read the whole current version, so they are sized the same way.
+ *
+ * @param req Request header.
+ * @param remote_path Remote path of the request.
+ *
+ * @return SCHED_SMALL or SCHED_BULK.
+ */
+static int request_class(const rfs_req_t *req, const char *remote_path)
+{
+    if (memcmp(req->cmd, "WRITE", 5) == 0 ||
+        memcmp(req->cmd, "MPPUT", 5) == 0 ||
+        memcmp(req->cmd, "APPND", 5) == 0 ||
+        memcmp(req->cmd, "PATCH", 5) == 0)
+        return req->payload_len > SCHED_SMALL_BYTES ? SCHED_BULK : SCHED_SMALL;
+
+    if (memcmp(req->cmd, "WRFD ", 5) == 0 ||
+        memcmp(req->cmd, "SNAP ", 5) == 0)
+        return SCHED_BULK;
+
+    if (memcmp(req->cmd, "GET  ", 5) == 0 ||
+        memcmp(req->cmd, "GETFD", 5) == 0 ||
+        memcmp(req->cmd, "SIGS ", 5) == 0 ||
+        memcmp(req->cmd, "DELTA", 5) == 0)
+    {
+        char full_path[SERVER_PATH_MAX];
+        struct stat st;
+        snprintf(full_path, sizeof(full_path), "%s/%s", SERVER_ROOT, remote_path);
+        if (stat(full_path, &st) == 0 && st.st_size > SCHED_SMALL_BYTES)
+            return SCHED_BULK;
+    }
+    return SCHED_SMALL;
+}
 
-        /* Base file (current version) */
-        if (stat(full_path, &st) == 0 && S_ISREG(st.st_mode))
-            count++;
+/**
+ * @brief Whether a request is counted in the heavy-hitter stats.
+ *
+ * File reads and writes are; metadata requests and STATS are not.
+ *
+ * @param req Request header.
+ *
+ * @return Non-zero to count it.
+ */
+static int request_tracked(const rfs_req_t *req)
+{
+    static const char tracked[][5] = {
+        {'G','E','T',' ',' '}, {'G','E','T','F','D'}, {'W','R','I','T','E'},
+        {'W','R','F','D',' '}, {'A','P','P','N','D'}, {'P','A','T','C','H'},
+        {'D','E','L','T','A'},
+    };
+    for (size_t i = 0; i < sizeof(tracked) / sizeof(tracked[0]); i++)
+    {
+        if (memcmp(req->cmd, tracked[i], 5) == 0)
+            return 1;
+    }
+    return 0;
+}
 
-        /* Versioned files: file.v1, file.v2, ... */
-        int version = 1;
-        while (1)
-        {
-            char v_full_path[1024];
-            snprintf(v_full_path, sizeof(v_full_path), "%s.v%d", full_path, version);
+/**
+ * @brief Run one request through the scheduler and its handler.
+ *
+ * @param c Client connection.
+ * @param idx Index of the command in @c commands.
+ * @param req Request header.
+ * @param remote_path Remote path of the request.
+ *
+ * @return The handler's result (CONN_KEEP, CONN_CLOSE or CONN_DETACH).
+ */
+static int run_command(conn_t *c, int idx, const rfs_req_t *req,
+                       const char *remote_path)
+{
+    c->sched_class = request_class(req, remote_path);
+    sched_begin(c->client, c->sched_class);
+    c->scheduled = 1;
+    c->moved = 0;
+    int rc = commands[idx].handler(c, req, remote_path);
+    c->scheduled = 0;
+    sched_end(c->client, c->sched_class);
+    if (request_tracked(req))
+        stats_record(remote_path, c->moved);
+    buf_recycle(&c->arena->reply);
+    buf_recycle(&c->arena->block);
+    return rc;
+}
 
-            struct stat vst;
-            if (stat(v_full_path, &vst) < 0)
-            {
-                if (errno == ENOENT)
-                    break;
-                else
-                    break;
-            }
+/**
+ * @brief Serve a v2 connection after the HELLO handshake.
+ *
+ * Answers the client's version offer, then reads framed requests
+ * until the client closes the connection, a header fails its
+ * checksum, or a handler asks for the connection to be closed.
+ *
+ * @param client_sock Connected client socket (HELLO already read).
+ * @param client Scheduler record for the peer.
+ * @param arena Scratch memory of the serving worker.
+ *
+ * @return CONN_DETACH if a handler took ownership of the socket,
+ *         otherwise CONN_CLOSE.
+ */
+static int serve_v2(int client_sock, sched_client_t *client, arena_t *arena)
+{
+    uint32_t offer_net;
+    if (recv_all(client_sock, &offer_net, 4) < 0)
+        return CONN_CLOSE;
 
-            if (S_ISREG(vst.st_mode))
-                count++;
+    uint32_t offer = ntohl(offer_net);
+    uint32_t version = offer < RFS_PROTO_MAX ? offer : RFS_PROTO_MAX;
+    uint32_t version_net = htonl(version);
+    if (send_all(client_sock, &version_net, 4) < 0 || version < RFS_PROTO_V2)
+        return CONN_CLOSE;
 
-            version++;
-        }
+    conn_t c = { client_sock, RFS_PROTO_V2, client, 0, SCHED_SMALL, arena, 0 };
+    char *remote_path = arena->path;
 
-        uint32_t count_net = htonl(count);
-        if (send_all(client_sock, &count_net, 4) < 0)
+    while (1)
+    {
+        /* a clean close between requests is not an error */
+        char peek;
+        if (recv(client_sock, &peek, 1, MSG_PEEK) <= 0)
+            return CONN_CLOSE;
+
+        rfs_req_t req;
+        int rc = rfs_recv_request(client_sock, &req);
+        if (rc == -2)
         {
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            close(client_sock);
-            return NULL;
+            fprintf(stderr, "Corrupt request header; closing connection\n");
+            send_reply(&c, RFS_ERR_CHECKSUM, 0, 0, 0);
+            return CONN_CLOSE;
         }
+        if (rc < 0)
+            return CONN_CLOSE;
 
-        if (count == 0)
+        if (recv_path(client_sock, req.path_len, remote_path) < 0)
         {
-            pthread_mutex_unlock(&fs_mutex);
-            free(remote_path);
-            close(client_sock);
-            return NULL;
+            send_reply(&c, RFS_ERR_BAD_REQUEST, 0, 0, 0);
+            return CONN_CLOSE;
         }
 
-        /* Send base file info, if it exists */
-        if (stat(full_path, &st) == 0 && S_ISREG(st.st_mode))
+        int idx = find_command(req.cmd);
+        if (idx < 0)
         {
-            char name_buf[1024];
-            char ts_buf[64];
-            struct tm tm_buf;
-
-            snprintf(name_buf, sizeof(name_buf), "%s", remote_path);
-            localtime_r(&st.st_mtime, &tm_buf);
-            strftime(ts_buf, sizeof(ts_buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
-
-            uint32_t name_len = (uint32_t)strlen(name_buf);
-            uint32_t ts_len   = (uint32_t)strlen(ts_buf);
-            uint32_t name_len_net = htonl(name_len);
-            uint32_t ts_len_net   = htonl(ts_len);
-
-            if (send_all(client_sock, &name_len_net, 4) < 0 ||
-                send_all(client_sock, &ts_len_net, 4) < 0 ||
-                send_all(client_sock, name_buf, name_len) < 0 ||
-                send_all(client_sock, ts_buf, ts_len) < 0)
-            {
-                pthread_mutex_unlock(&fs_mutex);
-                free(remote_path);
-                close(client_sock);
-                return NULL;
-            }
+            fprintf(stderr, "Unknown command received\n");
+            if (recv_to_fd(&c, -1, req.payload_len, NULL) < 0 ||
+                send_reply(&c, RFS_ERR_UNSUPPORTED, 0, 0, 0) < 0)
+                return CONN_CLOSE;
+            continue;
         }
 
-        /* Send each version file info */
-        version = 1;
-        while (1)
-        {
-            char v_full_path[1024];
-            snprintf(v_full_path, sizeof(v_full_path), "%s.v%d",
-                     full_path, version);
-
-            struct stat vst;
-            if (stat(v_full_path, &vst) < 0)
-            {
-                if (errno == ENOENT)
-                    break;
-                else
-                    break;
-            }
-
-            if (S_ISREG(vst.st_mode))
-            {
-                char name_buf[1024];
-                char ts_buf[64];
-                struct tm tm_buf;
-
-                snprintf(name_buf, sizeof(name_buf),
-                         "%s.v%d", remote_path, version);
-                localtime_r(&vst.st_mtime, &tm_buf);
-                strftime(ts_buf, sizeof(ts_buf),
-                         "%Y-%m-%d %H:%M:%S", &tm_buf);
-
-                uint32_t name_len = (uint32_t)strlen(name_buf);
-                uint32_t ts_len   = (uint32_t)strlen(ts_buf);
-                uint32_t name_len_net = htonl(name_len);
-                uint32_t ts_len_net   = htonl(ts_len);
-
-                if (send_all(client_sock, &name_len_net, 4) < 0 ||
-                    send_all(client_sock, &ts_len_net, 4) < 0 ||
-                    send_all(client_sock, name_buf, name_len) < 0 ||
-                    send_all(client_sock, ts_buf, ts_len) < 0)
-                {
-                    pthread_mutex_unlock(&fs_mutex);
-                    free(remote_path);
-                    close(client_sock);
-                    return NULL;
-                }
-            }
-
-            version++;
-        }
+        rc = run_command(&c, idx, &req, remote_path);
+        if (rc != CONN_KEEP)
+            return rc;
+    }
+}
 
-        pthread_mutex_unlock(&fs_mutex);
-        free(remote_path);
+/**
+ * @brief Handle a single client connection.
+ *
+ * Called by an acceptor worker thread for each accepted socket. The
+ * first 5 bytes select the protocol: "HELLO" starts a v2 session (see
+ * serve_v2() and protocol.h); anything else is a v1 command, of which
+ * exactly one is processed per connection:
+ *  - WRITE: store file with versioning (.vN) under SERVER_ROOT
+ *  - GET:   return requested file contents
+ *  - LS:    list all versions and timestamps for a path
+ *  - RM:    remove a file and all of its versions, or remove a directory
+ *  - STOP:  shut down the server (sets @c server_running to 0)
+ *  - WRFD / GETFD: WRITE and GET over the local Unix socket, with the
+ *          data passed as an open file descriptor
+ *  - SNAP:  create (or delete) a hard-linked snapshot of the tree
+ *  - WATCH: (v2 only) stream change events for a path prefix
+ *  - STAT / LIST: (v2 only) metadata of one file, or of every file
+ *          under a prefix, from the memory-mapped index
+ *  - LSDIR: (v2 only) one page of a directory listing
+ *  - MPINI / MPPUT / MPEND / MPABT: (v2 only) multipart upload, with
+ *          parts sent in parallel over several connections
+ *  - SIGS / DELTA: (v2 only) block signatures of a file, and a new
+ *          version sent as changes against them (delta.h)
+ *  - TREE:  (v2 only) Merkle digest and entries of one directory
+ *  - COPY / MOVE: (v2 only) duplicate or rename a file together with
+ *          its versions, without moving data over the network
+ *  - APPND / PATCH: (v2 only) add to the end of a file in place, or
+ *          overwrite part of it as a new version
+ *  - STATS: (v2 only) the most requested paths, with estimated
+ *          request and byte counts (stats.h)
+ *
+ * Concurrency control over the underlying file system is provided by
+ * the global @c fs_mutex, which is held only for metadata operations;
+ * file data is streamed without it. Every request is admitted through
+ * the per-client scheduler (sched.h) before its handler runs.
+ *
+ * The client socket is closed before returning, unless WATCH handed
+ * it to the notifier thread. Requests are received into the worker's
+ * @p arena, so serving them makes no heap calls.
+ *
+ * @param client_sock Connected client socket file descriptor.
+ * @param arena The calling worker's scratch memory.
+ */
+void handle_client(int client_sock, arena_t *arena)
+{
+    char cmd[5];
+    if (recv_all(client_sock, cmd, 5) < 0)
+    {
         close(client_sock);
-        return NULL;
+        return;
     }
 
-    /*------------------------------------------------------------*/
-    /*                        RM (remove + versions)              */
-    /*------------------------------------------------------------*/
-    if (memcmp(cmd, "RM   ", 5) == 0)
+    sched_client_t *client = sched_client_get(client_sock);
+
+    if (memcmp(cmd, "HELLO", 5) == 0)
     {
-        uint32_t path_len_net;
-        if (recv_all(client_sock, &path_len_net, 4) < 0)
-        {
+        if (serve_v2(client_sock, client, arena) != CONN_DETACH)
             close(client_sock);
-            return NULL;
-        }
-        uint32_t path_len = ntohl(path_len_net);
+        sched_client_put(client);
+        return;
+    }
 
-        char *remote_path = (char *)malloc(path_len + 1);
-        if (!remote_path)
-        {
-            close(client_sock);
-            return NULL;
-        }
+    int have_path = 0;
+    rfs_req_t req;
+    memset(&req, 0, sizeof(req));
+    memcpy(req.cmd, cmd, 5);
 
-        if (recv_all(client_sock, remote_path, path_len) < 0)
+    int idx = find_command(cmd);
+    if (idx < 0)
+    {
+        fprintf(stderr, "Unknown command received\n");
+    }
+    else if (memcmp(cmd, "WRITE", 5) == 0)
+    {
+        /* v1 WRITE: path_len, file_size, path, data */
+        uint32_t path_len_net, file_size_net;
+        if (recv_all(client_sock, &path_len_net, 4) == 0 &&
+            recv_all(client_sock, &file_size_net, 4) == 0)
         {
-            free(remote_path);
-            close(client_sock);
-            return NULL;
+            req.payload_len = ntohl(file_size_net);
+            have_path = recv_path(client_sock, ntohl(path_len_net),
+                                  arena->path) == 0;
         }
-        remote_path[path_len] = '\0';
+    }
+    else if (commands[idx].v1_has_path)
+    {
+        have_path = recv_remote_path(client_sock, arena->path) == 0;
+    }
+    else
+    {
+        arena->path[0] = '\0';
+        have_path = 1;
+    }
 
-        char full_path[1024];
-        snprintf(full_path, sizeof(full_path), "%s/%s",
-                 SERVER_ROOT, remote_path);
+    if (have_path)
+    {
+        conn_t c = { client_sock, RFS_PROTO_V1, client, 0, SCHED_SMALL, arena, 0 };
+        run_command(&c, idx, &req, arena->path);
+    }
 
-        printf("RM: %s\n", full_path);
+    close(client_sock);
+    sched_client_put(client);
+}
 
-        uint32_t status = 0;
+/*------------------------------------------------------------*/
+/*                    Acceptors and workers                   */
+/*------------------------------------------------------------*/
 
-        pthread_mutex_lock(&fs_mutex);
+/**
+ * @brief Worker thread loop for one acceptor.
+ *
+ * Pops accepted sockets off the acceptor's pending queue and serves
+ * them with handle_client(). A worker that has been idle for
+ * WORKER_IDLE_SECS exits, as long as MIN_IDLE_WORKERS others remain.
+ *
+ * @param arg Pointer to the owning acceptor_t.
+ *
+ * @return Always returns NULL (for pthreads API).
+ */
+static void *worker_main(void *arg)
+{
+    acceptor_t *a = (acceptor_t *)arg;
+    arena_t arena;
+    memset(&arena, 0, sizeof(arena));
 
-        struct stat st;
-        if (stat(full_path, &st) < 0)
-        {
-            if (errno == ENOENT) status = 1;   /* not found */
-            else status = 5;
-        }
-        else if (S_ISDIR(st.st_mode))
-        {
-            if (rmdir(full_path) < 0)
-            {
-                if (errno == ENOTEMPTY) status = 2;  /* dir not empty */
-                else status = 3;
-            }
-        }
-        else
+    pthread_mutex_lock(&a->lock);
+    while (1)
+    {
+        while (a->count == 0 && server_running)
         {
-            /* delete base file */
-            if (unlink(full_path) < 0)
-                status = 4;
-            else
-                printf("Removed %s\n", full_path);
-
-            /* delete version files: file.v1, file.v2, ... */
-            int version = 1;
-            while (1)
-            {
-                char version_path[1024];
-                snprintf(version_path, sizeof(version_path),
-                         "%s.v%d", full_path, version);
-
-                struct stat vst;
-                if (stat(version_path, &vst) < 0)
-                {
-                    if (errno == ENOENT) break;
-                    status = 4;
-                    break;
-                }
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += WORKER_IDLE_SECS;
 
-                if (unlink(version_path) == 0)
-                    printf("Removed %s\n", version_path);
+            a->idle_workers++;
+            int rc = pthread_cond_timedwait(&a->ready, &a->lock, &deadline);
+            a->idle_workers--;
 
-                version++;
-            }
+            if (rc == ETIMEDOUT && a->count == 0 &&
+                a->num_workers > MIN_IDLE_WORKERS)
+                goto out;
         }
 
-        pthread_mutex_unlock(&fs_mutex);
+        if (a->count == 0)
+            break;      /* shutting down */
 
-        uint32_t net = htonl(status);
-        send_all(client_sock, &net, 4);
+        int client = a->pending[a->head];
+        a->head = (a->head + 1) % ACCEPT_QUEUE_LEN;
+        a->count--;
+        pthread_cond_signal(&a->space);
+        pthread_mutex_unlock(&a->lock);
 
-        free(remote_path);
-        close(client_sock);
-        return NULL;
+        handle_client(client, &arena);
+
+        pthread_mutex_lock(&a->lock);
     }
+out:
+    a->num_workers--;
+    pthread_mutex_unlock(&a->lock);
+    arena_release(&arena);
+    return NULL;
+}
+
+/**
+ * @brief Accept loop for one listening socket.
+ *
+ * Accepted sockets are pushed onto the acceptor's pending queue. If
+ * there are fewer idle workers than queued sockets, a new worker is
+ * started. When the queue is full the loop waits for a worker to take
+ * a socket, leaving further connections in the kernel backlog.
+ *
+ * @param arg Pointer to the acceptor_t to run.
+ *
+ * @return Always returns NULL (for pthreads API).
+ */
+static void *acceptor_main(void *arg)
+{
+    acceptor_t *a = (acceptor_t *)arg;
 
-    /*------------------------------------------------------------*/
-    /*                        STOP (shutdown)                     */
-    /*------------------------------------------------------------*/
-    if (memcmp(cmd, "STOP ", 5) == 0)
+    while (server_running)
     {
-        printf("STOP command received — shutting down server.\n");
+        struct sockaddr_storage caddr;
+        socklen_t clen = sizeof(caddr);
+
+        int client = accept(a->sock, (struct sockaddr *)&caddr, &clen);
+        if (!server_running)
+        {
+            if (client >= 0)
+                close(client);
+            break;
+        }
 
-        server_running = 0;
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            continue;
+        }
 
-        if (listen_sock >= 0)
+        /* replies are a header then a payload in separate writes;
+         * Nagle would hold the payload for the client's delayed ACK */
+        if (caddr.ss_family == AF_INET)
         {
-            close(listen_sock);
-            listen_sock = -1;
+            int one = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
         }
 
-        uint32_t status = htonl(0);
-        send_all(client_sock, &status, 4);
+        pthread_mutex_lock(&a->lock);
+        while (a->count == ACCEPT_QUEUE_LEN && server_running)
+            pthread_cond_wait(&a->space, &a->lock);
 
-        close(client_sock);
-        return NULL;
+        a->pending[(a->head + a->count) % ACCEPT_QUEUE_LEN] = client;
+        a->count++;
+
+        if (a->idle_workers < a->count)
+        {
+            pthread_t tid;
+            if (pthread_create(&tid, NULL, worker_main, a) == 0)
+            {
+                pthread_detach(tid);
+                a->num_workers++;
+            }
+            else if (a->num_workers == 0)
+            {
+                /* nobody to hand the socket to; drop it */
+                perror("pthread_create");
+                a->count--;
+                close(client);
+            }
+        }
+        pthread_cond_signal(&a->ready);
+        pthread_mutex_unlock(&a->lock);
     }
 
-    fprintf(stderr, "Unknown command received\n");
-    close(client_sock);
+    /* wake idle workers so they notice the shutdown */
+    pthread_mutex_lock(&a->lock);
+    pthread_cond_broadcast(&a->ready);
+    pthread_cond_broadcast(&a->space);
+    pthread_mutex_unlock(&a->lock);
     return NULL;
 }
 
+/* TCP port and Unix socket path (-p / -u; "" disables the socket) */
+static int listen_port = SERVER_PORT;
+static const char *unix_path = RFS_UNIX_PATH;
+
 /**
- * @brief Entry point for the RFS server.
- *
- * Initializes the server root directory, creates a listening socket,
- * binds and listens on SERVER_PORT, and then enters an accept loop
- * while @c server_running is non-zero.
+ * @brief Create a listening socket bound to the server port.
  *
- * For each accepted client connection, a detached thread is spawned
- * running handle_client(), which processes exactly one command per
- * connection.
+ * @param reuse_port If non-zero, SO_REUSEPORT is set so several
+ *                   sockets can share the port.
+ * @param backlog Backlog passed to listen(2).
  *
- * The STOP command causes @c server_running to be set to 0 and the
- * listening socket to be closed, allowing the main loop to exit
- * cleanly.
- *
- * @return 0 on normal shutdown, or 1 if a critical socket, bind, or
- *         listen error occurs at startup.
+ * @return The listening socket, or -1 on error.
  */
-int main(void)
+static int open_listener(int reuse_port, int backlog)
 {
-    mkdir(SERVER_ROOT, 0755);
-
-    listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_sock < 0)
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
     {
         perror("socket");
-        return 1;
+        return -1;
     }
 
     int opt = 1;
-    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuse_port &&
+        setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+    {
+        perror("setsockopt(SO_REUSEPORT)");
+        close(sock);
+        return -1;
+    }
 
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
 
     addr.sin_family      = AF_INET;
-    addr.sin_port        = htons(SERVER_PORT);
+    addr.sin_port        = htons((uint16_t)listen_port);
     addr.sin_addr.s_addr = INADDR_ANY;
 
-    if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
     {
         perror("bind");
-        close(listen_sock);
-        return 1;
+        close(sock);
+        return -1;
     }
 
-    if (listen(listen_sock, 16) < 0)
+    if (listen(sock, backlog) < 0)
     {
         perror("listen");
-        close(listen_sock);
-        return 1;
+        close(sock);
+        return -1;
     }
+    return sock;
+}
 
-    printf("Server running at port %d\n", SERVER_PORT);
+/**
+ * @brief Create the Unix domain listening socket (RFS_UNIX_PATH unless
+ *        -u names another).
+ *
+ * A stale socket file left by a previous run is removed first. The
+ * socket is made world-writable so any local user can reach the
+ * server, just as they could over TCP.
+ *
+ * @param backlog Backlog passed to listen(2).
+ *
+ * @return The listening socket, or -1 on error or if disabled.
+ */
+static int open_unix_listener(int backlog)
+{
+    if (!unix_path[0])
+        return -1;
 
-    while (server_running)
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0)
     {
-        struct sockaddr_in caddr;
-        socklen_t clen = sizeof(caddr);
+        perror("socket(AF_UNIX)");
+        return -1;
+    }
 
-        int client = accept(listen_sock, (struct sockaddr *)&caddr, &clen);
-        if (!server_running)
-            break;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", unix_path);
 
-        if (client < 0)
+    unlink(unix_path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind(AF_UNIX)");
+        close(sock);
+        return -1;
+    }
+    chmod(unix_path, 0666);
+
+    if (listen(sock, backlog) < 0)
+    {
+        perror("listen(AF_UNIX)");
+        close(sock);
+        unlink(unix_path);
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ * @brief Entry point for the RFS server.
+ *
+ * Usage: server [-l listeners] [-b backlog] [-s slots] [-S reserved]
+ *               [-r requests/s] [-B bytes/s] [-p port] [-u unix-path]
+ *               [-C cold-root] [-T age]
+ *
+ *  - -l N  number of listening sockets / accept loops (default 1).
+ *          N > 1 binds every socket with SO_REUSEPORT; N = 0 means one
+ *          per online CPU.
+ *  - -b N  listen(2) backlog for each socket (default DEFAULT_BACKLOG).
+ *  - -s N  requests executing at once (default DEFAULT_SLOTS_PER_CPU
+ *          per online CPU).
+ *  - -S N  of those slots, how many only run small requests (default
+ *          SCHED_RESERVED; capped so bulk transfers keep one).
+ *  - -r N  requests per second allowed per client (default unlimited).
+ *  - -B N  bytes per second allowed per client (default unlimited).
+ *  - -p N  TCP port (default SERVER_PORT).
+ *  - -u P  Unix socket path (default RFS_UNIX_PATH; "" for none), so
+ *          a second server on the same host leaves the first one's
+ *          socket alone.
+ *  - -C D  cold tier root: saved versions older than the -T age are
+ *          moved there, compressed (tier.h). Off unless given.
+ *  - -T A  age after which versions go cold: seconds, or with an m, h
+ *          or d suffix (default TIER_DEFAULT_AGE, one day).
+ *
+ * Initializes the server root directory, opens the listeners, starts
+ * one acceptor thread per listener, and waits for them to exit. In
+ * addition to the TCP listeners, an acceptor is started on the Unix
+ * socket for clients on the same host (if the socket
+ * cannot be created the server runs TCP-only). Each
+ * accepted connection is served by one of its acceptor's workers via
+ * handle_client(), which processes exactly one command per connection.
+ *
+ * The STOP command sets @c server_running to 0 and shuts down every
+ * listening socket, allowing the acceptors and main() to exit cleanly.
+ * The metadata index is opened (or rebuilt) before the listeners
+ * start and flushed clean on the way out, so the next start can map it
+ * instead of walking the tree.
+ *
+ * @return 0 on normal shutdown, or 1 on invalid arguments or if a
+ *         critical socket, bind, or listen error occurs at startup.
+ */
+int main(int argc, char *argv[])
+{
+    int listeners = 1;
+    int backlog   = DEFAULT_BACKLOG;
+    int slots     = 0;
+    int reserved  = SCHED_RESERVED;
+    double req_rate  = 0;
+    double byte_rate = 0;
+    const char *cold_root = NULL;
+    long tier_age = TIER_DEFAULT_AGE;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:b:s:S:r:B:p:u:C:T:")) != -1)
+    {
+        switch (opt)
         {
-            if (!server_running)
-                break;
-            perror("accept");
-            continue;
+        case 'l':
+            listeners = atoi(optarg);
+            break;
+        case 'b':
+            backlog = atoi(optarg);
+            break;
+        case 's':
+            slots = atoi(optarg);
+            break;
+        case 'S':
+            reserved = atoi(optarg);
+            break;
+        case 'r':
+            req_rate = atof(optarg);
+            break;
+        case 'B':
+            byte_rate = atof(optarg);
+            break;
+        case 'p':
+            listen_port = atoi(optarg);
+            break;
+        case 'u':
+            unix_path = optarg;
+            break;
+        case 'C':
+            cold_root = optarg;
+            break;
+        case 'T':
+            tier_age = tier_parse_age(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-l listeners] [-b backlog] [-s slots]"
+                    " [-S reserved] [-r requests/s] [-B bytes/s] [-p port] [-u unix-path]"
+                    " [-C cold-root] [-T age]\n",
+                    argv[0]);
+            return 1;
         }
+    }
+
+    if (listeners == 0)
+    {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        listeners = (ncpu > 0) ? (int)ncpu : 1;
+    }
+    if (listeners < 0 || listeners > MAX_LISTENERS || backlog <= 0 ||
+        slots < 0 || reserved < 0 || req_rate < 0 || byte_rate < 0 ||
+        listen_port <= 0 || listen_port > 65535 || tier_age < 0)
+    {
+        fprintf(stderr, "Invalid listener count, backlog, slots, rate, port or age\n");
+        return 1;
+    }
+    if (slots == 0)
+    {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        slots = DEFAULT_SLOTS_PER_CPU * (ncpu > 0 ? (int)ncpu : 1);
+    }
+    sched_init(slots, reserved, req_rate, byte_rate);
+
+    mkdir(SERVER_ROOT, 0755);
+
+    if (watch_init() < 0)
+        return 1;
+    /* before the index, whose rebuild counts cold versions too */
+    if (cold_root && tier_init(SERVER_ROOT, cold_root, tier_age, &fs_mutex) < 0)
+        fprintf(stderr, "Cold tier unavailable; versions stay in %s\n", SERVER_ROOT);
+    if (index_open(SERVER_ROOT) < 0)
+        fprintf(stderr, "Metadata index unavailable; LIST and STAT disabled\n");
+
+    /* one extra slot for the Unix socket acceptor */
+    acceptors = (acceptor_t *)calloc((size_t)listeners + 1, sizeof(acceptor_t));
+    if (!acceptors)
+    {
+        perror("calloc");
+        return 1;
+    }
 
-        int *arg = (int *)malloc(sizeof(int));
-        if (!arg)
+    for (int i = 0; i < listeners; i++)
+    {
+        acceptor_t *a = &acceptors[i];
+        a->id   = i;
+        a->sock = open_listener(listeners > 1, backlog);
+        if (a->sock < 0)
         {
-            perror("malloc");
-            close(client);
-            continue;
+            for (int j = 0; j < i; j++)
+                close(acceptors[j].sock);
+            free(acceptors);
+            return 1;
         }
-        *arg = client;
+        pthread_mutex_init(&a->lock, NULL);
+        pthread_cond_init(&a->ready, NULL);
+        pthread_cond_init(&a->space, NULL);
+        num_acceptors++;
+    }
+
+    int unix_sock = open_unix_listener(backlog);
+    if (unix_sock >= 0)
+    {
+        acceptor_t *a = &acceptors[num_acceptors];
+        a->id   = num_acceptors;
+        a->sock = unix_sock;
+        pthread_mutex_init(&a->lock, NULL);
+        pthread_cond_init(&a->ready, NULL);
+        pthread_cond_init(&a->space, NULL);
+        num_acceptors++;
+    }
 
-        pthread_t tid;
-        if (pthread_create(&tid, NULL, handle_client, arg) != 0)
+    printf("Server running at port %d (%d listener%s, backlog %d)\n",
+           listen_port, listeners, listeners == 1 ? "" : "s", backlog);
+    if (unix_sock >= 0)
+        printf("Local clients: %s\n", unix_path);
+    printf("Scheduler: %d slots, per-client limits: ", slots);
+    if (req_rate > 0)
+        printf("%.0f req/s, ", req_rate);
+    else
+        printf("unlimited req/s, ");
+    if (byte_rate > 0)
+        printf("%.0f bytes/s\n", byte_rate);
+    else
+        printf("unlimited bytes/s\n");
+
+    int started = 0;
+    for (int i = 0; i < num_acceptors; i++)
+    {
+        if (pthread_create(&acceptors[i].thread, NULL,
+                           acceptor_main, &acceptors[i]) != 0)
         {
             perror("pthread_create");
-            free(arg);
-            close(client);
-            continue;
+            server_running = 0;
+            stop_acceptors();
+            break;
         }
-        pthread_detach(tid);
+        started++;
     }
 
-    if (listen_sock >= 0)
-        close(listen_sock);
+    for (int i = 0; i < started; i++)
+        pthread_join(acceptors[i].thread, NULL);
+
+    for (int i = 0; i < num_acceptors; i++)
+        close(acceptors[i].sock);
+    if (unix_sock >= 0)
+        unlink(unix_path);
+
+    tier_stop();
+
+    /* marks the index clean so the next start maps it as is */
+    index_close();
 
     printf("Server shutting down.\n");
     return 0;
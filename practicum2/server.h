@@ -1,11 +1,18 @@
 /*
  * server.h -- RFS server with:
- *   - Multi-threaded client support
+ *   - Multi-threaded client support (optionally one SO_REUSEPORT
+ *     listener per core, each with its own worker set)
  *   - WRITE with versioning
  *   - GET returning newest version (or specific version via path)
  *   - RM removing all versions
  *   - LS listing all versions + timestamps
  *   - STOP shutting down the server
+ *   - SNAP taking hard-linked point-in-time snapshots
+ *   - WATCH pushing change events to subscribed clients
+ *   - STAT / LIST answered from a memory-mapped metadata index
+ *   - Per-client rate limits and fair, size-aware request scheduling
+ *   - Protocol v1 (one request per connection) and v2 (HELLO
+ *     handshake, framed requests with 64-bit sizes, streamed data)
  *
  * Sooji Kim | CS5600 | Northeastern University
  * Fall 2025 | Dec 6 2025
@@ -16,9 +23,32 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "protocol.h"
+
 #define SERVER_PORT 2000
 #define SERVER_ROOT "./rfs_root"
 
+/* Longest SERVER_ROOT "/" <remote path>, including NUL: the root's
+ * sizeof() counts the '/' in place of its NUL. */
+#define SERVER_PATH_MAX (sizeof(SERVER_ROOT) + RFS_MAX_PATH)
+
+/* Uploads are written to "<path>" RFS_TMP_MARKER "XXXXXX" and renamed
+ * into place once complete. */
+#define RFS_TMP_MARKER ".rfs-tmp."
+
+#define DEFAULT_BACKLOG   16   /* listen(2) backlog unless -b is given  */
+#define MAX_LISTENERS     256  /* upper bound for -l                    */
+#define ACCEPT_QUEUE_LEN  64   /* accepted sockets queued per acceptor  */
+#define MIN_IDLE_WORKERS  2    /* workers kept per acceptor when idle   */
+#define WORKER_IDLE_SECS  30   /* idle time before a spare worker exits */
+#define DEFAULT_SLOTS_PER_CPU 2 /* scheduler slots per core unless -s   */
+#define LSDIR_PAGE_DEFAULT 1000 /* LSDIR entries per page unless asked  */
+#define LSDIR_PAGE_MAX    10000 /* largest page a client may ask for    */
+#define LSDIR_PAGE_BYTES (256 * 1024) /* reply size that ends a page    */
+
+/* Scratch memory a worker thread reuses across requests (server.c). */
+typedef struct arena arena_t;
+
 /**
  * @brief Receive exactly @p len bytes from a socket.
  *
@@ -65,19 +95,15 @@ int send_all(int sockfd, const void *buf, size_t len);
 int ensure_directories(const char *full_path);
 
 /**
- * @brief Thread entry point for serving a single client connection.
+ * @brief Serve a single client connection.
  *
  * Reads a command from the client socket and handles one of the
- * supported operations (WRITE, GET, LS, RM, STOP). The argument
- * is expected to be a pointer to a dynamically allocated integer
- * holding the client socket descriptor, which is freed inside the
- * function.
- *
- * @param arg Pointer to an int containing the client socket file
- *            descriptor, allocated on the heap.
+ * supported operations (WRITE, GET, LS, RM, STOP). Called from an
+ * acceptor's worker thread; the socket is closed before returning.
  *
- * @return Always returns NULL (suitable for use with pthread_create()).
+ * @param client_sock Connected client socket file descriptor.
+ * @param arena The calling worker's scratch memory.
  */
-void *handle_client(void *arg);
+void handle_client(int client_sock, arena_t *arena);
 
 #endif /* SERVER_H */
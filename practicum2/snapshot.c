@@ -0,0 +1,292 @@
+/*
+ * snapshot.c -- Point-in-time snapshots of the RFS tree (hard links)
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "snapshot.h"
+#include "index.h"
+#include "server.h"
+#include "protocol.h"
+
+/**
+ * @brief Report whether a remote path lies inside the snapshot area.
+ *
+ * Leading "/" and "./" components are ignored, since the server joins
+ * the path onto SERVER_ROOT unchanged.
+ *
+ * @param remote_path Client-supplied remote path.
+ *
+ * @return 1 if @p remote_path is SNAPSHOT_DIR or below it, else 0.
+ */
+int snapshot_path(const char *remote_path)
+{
+    const char *p = remote_path;
+    while (*p == '/' || (p[0] == '.' && p[1] == '/'))
+        p += (*p == '/') ? 1 : 2;
+
+    size_t n = strlen(SNAPSHOT_DIR);
+    return strncmp(p, SNAPSHOT_DIR, n) == 0 && (p[n] == '\0' || p[n] == '/');
+}
+
+/**
+ * @brief Check that a snapshot name is a single, ordinary component.
+ *
+ * @param name Proposed snapshot name.
+ *
+ * @return 1 if valid, 0 otherwise.
+ */
+static int valid_name(const char *name)
+{
+    if (name[0] == '\0' || name[0] == '.' || strlen(name) > 255)
+        return 0;
+    return strchr(name, '/') == NULL;
+}
+
+/**
+ * @brief Recursively mirror a directory with hard links.
+ *
+ * Subdirectories are recreated and every regular file is linked with
+ * linkat(2). Working relative to directory descriptors keeps the walk
+ * to one syscall per entry and avoids rebuilding long path strings.
+ *
+ * @param src_dir Open descriptor of the directory to copy from.
+ * @param dst_dir Open descriptor of the (empty) directory to fill.
+ * @param top Non-zero for SERVER_ROOT itself, whose SNAPSHOT_DIR and
+ *            INDEX_FILE entries are skipped.
+ * @param files Incremented for each file linked.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int link_tree(int src_dir, int dst_dir, int top, uint64_t *files)
+{
+    int fd = dup(src_dir);
+    if (fd < 0)
+        return -1;
+
+    DIR *d = fdopendir(fd);
+    if (!d)
+    {
+        close(fd);
+        return -1;
+    }
+
+    int rc = 0;
+    struct dirent *de;
+    while (rc == 0 && (de = readdir(d)) != NULL)
+    {
+        const char *name = de->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        if (top && (strcmp(name, SNAPSHOT_DIR) == 0 ||
+                    strncmp(name, INDEX_FILE, strlen(INDEX_FILE)) == 0))
+            continue;       /* a linked index would share the live mmap */
+        if (strstr(name, RFS_TMP_MARKER) != NULL)
+            continue;       /* upload still in flight */
+
+        unsigned char type = de->d_type;
+        if (type == DT_UNKNOWN)
+        {
+            struct stat st;
+            if (fstatat(src_dir, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+            {
+                rc = -1;
+                break;
+            }
+            type = S_ISDIR(st.st_mode) ? DT_DIR
+                 : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if (type == DT_DIR)
+        {
+            if (mkdirat(dst_dir, name, 0755) < 0)
+            {
+                rc = -1;
+                break;
+            }
+            int sub_src = openat(src_dir, name, O_RDONLY | O_DIRECTORY);
+            int sub_dst = openat(dst_dir, name, O_RDONLY | O_DIRECTORY);
+            if (sub_src < 0 || sub_dst < 0)
+                rc = -1;
+            else
+                rc = link_tree(sub_src, sub_dst, 0, files);
+            if (sub_src >= 0)
+                close(sub_src);
+            if (sub_dst >= 0)
+                close(sub_dst);
+        }
+        else if (type == DT_REG)
+        {
+            if (linkat(src_dir, name, dst_dir, name, 0) < 0)
+                rc = -1;
+            else
+                (*files)++;
+        }
+    }
+
+    if (rc < 0)
+        perror("snapshot");
+    closedir(d);
+    return rc;
+}
+
+/**
+ * @brief Recursively delete a directory tree.
+ *
+ * @param parent Descriptor of the directory containing @p name.
+ * @param name Directory to remove.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int remove_tree(int parent, const char *name)
+{
+    int fd = openat(parent, name, O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return -1;
+
+    DIR *d = fdopendir(fd);
+    if (!d)
+    {
+        close(fd);
+        return -1;
+    }
+
+    int rc = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL)
+    {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+
+        if (unlinkat(fd, de->d_name, 0) < 0)
+        {
+            if (errno == EISDIR || errno == EPERM)
+            {
+                if (remove_tree(fd, de->d_name) < 0)
+                    rc = -1;
+            }
+            else
+            {
+                rc = -1;
+            }
+        }
+    }
+    closedir(d);
+
+    if (unlinkat(parent, name, AT_REMOVEDIR) < 0)
+        rc = -1;
+    return rc;
+}
+
+/**
+ * @brief Take a snapshot of everything under SERVER_ROOT.
+ *
+ * @param name Snapshot name (a single path component).
+ * @param files Receives the number of files linked.
+ *
+ * @return RFS_OK or an RFS_ERR_* code.
+ */
+uint32_t snapshot_create(const char *name, uint64_t *files)
+{
+    *files = 0;
+    if (!valid_name(name))
+        return RFS_ERR_BAD_REQUEST;
+
+    int root = open(SERVER_ROOT, O_RDONLY | O_DIRECTORY);
+    if (root < 0)
+        return RFS_ERR_IO;
+
+    if (mkdirat(root, SNAPSHOT_DIR, 0755) < 0 && errno != EEXIST)
+    {
+        close(root);
+        return RFS_ERR_IO;
+    }
+
+    int snaps = openat(root, SNAPSHOT_DIR, O_RDONLY | O_DIRECTORY);
+    if (snaps < 0)
+    {
+        close(root);
+        return RFS_ERR_IO;
+    }
+
+    struct stat st;
+    if (fstatat(snaps, name, &st, 0) == 0)
+    {
+        close(snaps);
+        close(root);
+        return RFS_ERR_EXISTS;
+    }
+
+    /* build under a hidden name, publish with one rename */
+    char staging[300];
+    snprintf(staging, sizeof(staging), ".building-%s", name);
+    if (fstatat(snaps, staging, &st, 0) == 0)
+        remove_tree(snaps, staging);   /* left over from a crash */
+
+    uint32_t status = RFS_OK;
+    if (mkdirat(snaps, staging, 0755) < 0)
+    {
+        status = RFS_ERR_IO;
+    }
+    else
+    {
+        int dst = openat(snaps, staging, O_RDONLY | O_DIRECTORY);
+        if (dst < 0 || link_tree(root, dst, 1, files) < 0)
+            status = RFS_ERR_IO;
+        if (dst >= 0)
+            close(dst);
+
+        if (status == RFS_OK && renameat(snaps, staging, snaps, name) < 0)
+            status = RFS_ERR_IO;
+        if (status != RFS_OK)
+            remove_tree(snaps, staging);
+    }
+
+    close(snaps);
+    close(root);
+    return status;
+}
+
+/**
+ * @brief Delete a snapshot and everything in it.
+ *
+ * @param name Snapshot name.
+ *
+ * @return RFS_OK or an RFS_ERR_* code.
+ */
+uint32_t snapshot_delete(const char *name)
+{
+    if (!valid_name(name))
+        return RFS_ERR_BAD_REQUEST;
+
+    char snaps_path[512];
+    snprintf(snaps_path, sizeof(snaps_path), "%s/%s", SERVER_ROOT, SNAPSHOT_DIR);
+
+    int snaps = open(snaps_path, O_RDONLY | O_DIRECTORY);
+    if (snaps < 0)
+        return RFS_ERR_NOT_FOUND;
+
+    char doomed[300];
+    snprintf(doomed, sizeof(doomed), ".deleting-%s", name);
+
+    uint32_t status = RFS_OK;
+    if (renameat(snaps, name, snaps, doomed) < 0)
+        status = (errno == ENOENT) ? RFS_ERR_NOT_FOUND : RFS_ERR_IO;
+    else if (remove_tree(snaps, doomed) < 0)
+        status = RFS_ERR_IO;
+
+    close(snaps);
+    return status;
+}
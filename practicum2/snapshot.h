@@ -0,0 +1,64 @@
+/*
+ * snapshot.h -- Point-in-time snapshots of the RFS tree
+ *
+ * A snapshot is a directory SERVER_ROOT/.snapshots/<name> that mirrors
+ * the tree at the time it was taken, with every stored file (current
+ * versions and .vN) hard-linked rather than copied. WRITE and PATCH
+ * rename the old file to .vN and install a new inode; APPEND, the one
+ * write in place, first gives a file with st_nlink > 1 an inode of its
+ * own (unshare_file() in server.c). So a link keeps the snapshot's
+ * view stable at the cost of one directory entry per file.
+ *
+ * Snapshots are read through the normal GET / LS paths, e.g.
+ *   GET .snapshots/nightly/reports/q3.txt
+ * and are read-only to WRITE and RM.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+
+#define SNAPSHOT_DIR ".snapshots"   /* relative to SERVER_ROOT */
+
+/**
+ * @brief Report whether a remote path lies inside the snapshot area.
+ *
+ * @param remote_path Client-supplied remote path.
+ *
+ * @return 1 if @p remote_path is SNAPSHOT_DIR or below it, else 0.
+ */
+int snapshot_path(const char *remote_path);
+
+/**
+ * @brief Take a snapshot of everything under SERVER_ROOT.
+ *
+ * The tree is linked into a hidden staging directory which is renamed
+ * to its final name once complete, so a snapshot is never visible half
+ * built. Upload temp files are skipped. The caller must hold the lock
+ * that serialises commits so the snapshot is consistent.
+ *
+ * @param name Snapshot name (a single path component).
+ * @param files Receives the number of files linked.
+ *
+ * @return RFS_OK, RFS_ERR_BAD_REQUEST for an invalid name,
+ *         RFS_ERR_EXISTS if the snapshot exists, or RFS_ERR_IO.
+ */
+uint32_t snapshot_create(const char *name, uint64_t *files);
+
+/**
+ * @brief Delete a snapshot and everything in it.
+ *
+ * The snapshot is first renamed out of the way so it disappears
+ * atomically, then removed. Does not need the commit lock.
+ *
+ * @param name Snapshot name.
+ *
+ * @return RFS_OK, RFS_ERR_BAD_REQUEST, RFS_ERR_NOT_FOUND or
+ *         RFS_ERR_IO.
+ */
+uint32_t snapshot_delete(const char *name);
+
+#endif /* SNAPSHOT_H */
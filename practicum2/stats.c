@@ -0,0 +1,227 @@
+/*
+ * stats.c -- count-min sketches and the heavy-hitter heap
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "stats.h"
+
+/* A path in the heap, keyed by its request estimate when last seen. */
+typedef struct
+{
+    char path[RFS_MAX_PATH];
+    uint64_t hash;
+    uint64_t count;
+} heap_entry_t;
+
+static uint64_t req_sketch[STATS_DEPTH][STATS_WIDTH];
+static uint64_t byte_sketch[STATS_DEPTH][STATS_WIDTH];
+static uint64_t total_requests;
+static uint64_t total_bytes;
+
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static heap_entry_t heap[STATS_TOP_K];  /* min-heap on count            */
+static int heap_len = 0;
+
+/*
+ * Smallest count in the heap once it is full, else 0. Estimates only
+ * grow, so a path whose estimate is below this cannot be in the heap
+ * and need not take the lock.
+ */
+static uint64_t heap_floor = 0;
+
+/**
+ * @brief Hash a path and derive its counter in every sketch row.
+ *
+ * The rows use h1 + i * h2 of one 64-bit hash (Kirsch-Mitzenmacher),
+ * mixed first so that FNV's weak low bits spread over the row.
+ *
+ * @param path Remote path.
+ * @param col Receives STATS_DEPTH column indexes.
+ *
+ * @return The path's 64-bit hash (used to find it in the heap).
+ */
+static uint64_t path_columns(const char *path, uint32_t col[STATS_DEPTH])
+{
+    uint64_t h = rfs_fnv64(RFS_FNV64_INIT, path, strlen(path));
+    uint64_t m = h;
+    m ^= m >> 33;
+    m *= 0xff51afd7ed558ccdULL;
+    m ^= m >> 33;
+    m *= 0xc4ceb9fe1a85ec53ULL;
+    m ^= m >> 33;
+
+    uint32_t h1 = (uint32_t)m;
+    uint32_t h2 = (uint32_t)(m >> 32) | 1;
+    for (int i = 0; i < STATS_DEPTH; i++)
+        col[i] = (h1 + (uint32_t)i * h2) & (STATS_WIDTH - 1);
+    return h;
+}
+
+/**
+ * @brief Add to a path's counters and return its new estimate.
+ *
+ * @param sketch Sketch to update.
+ * @param col The path's columns (path_columns()).
+ * @param n Amount to add (0 just reads the estimate).
+ *
+ * @return Smallest counter of the path, i.e. its estimate.
+ */
+static uint64_t sketch_add(uint64_t sketch[STATS_DEPTH][STATS_WIDTH],
+                           const uint32_t col[STATS_DEPTH], uint64_t n)
+{
+    uint64_t est = UINT64_MAX;
+    for (int i = 0; i < STATS_DEPTH; i++)
+    {
+        uint64_t v = n ? __atomic_add_fetch(&sketch[i][col[i]], n, __ATOMIC_RELAXED)
+                       : __atomic_load_n(&sketch[i][col[i]], __ATOMIC_RELAXED);
+        if (v < est)
+            est = v;
+    }
+    return est;
+}
+
+/**
+ * @brief Restore the heap order below slot @p i after its count grew.
+ *
+ * Caller holds heap_lock.
+ */
+static void heap_sift_down(int i)
+{
+    while (1)
+    {
+        int l = 2 * i + 1;
+        int r = l + 1;
+        int min = i;
+        if (l < heap_len && heap[l].count < heap[min].count)
+            min = l;
+        if (r < heap_len && heap[r].count < heap[min].count)
+            min = r;
+        if (min == i)
+            return;
+        heap_entry_t tmp = heap[i];
+        heap[i] = heap[min];
+        heap[min] = tmp;
+        i = min;
+    }
+}
+
+/**
+ * @brief Restore the heap order above slot @p i after an insert.
+ *
+ * Caller holds heap_lock.
+ */
+static void heap_sift_up(int i)
+{
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (heap[parent].count <= heap[i].count)
+            return;
+        heap_entry_t tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+/**
+ * @brief Count one request.
+ */
+void stats_record(const char *path, uint64_t bytes)
+{
+    uint32_t col[STATS_DEPTH];
+    uint64_t h = path_columns(path, col);
+
+    __atomic_add_fetch(&total_requests, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&total_bytes, bytes, __ATOMIC_RELAXED);
+    if (bytes)
+        sketch_add(byte_sketch, col, bytes);
+    uint64_t est = sketch_add(req_sketch, col, 1);
+
+    if (est < __atomic_load_n(&heap_floor, __ATOMIC_RELAXED))
+        return;
+
+    pthread_mutex_lock(&heap_lock);
+    int i;
+    for (i = 0; i < heap_len; i++)
+    {
+        if (heap[i].hash == h && strcmp(heap[i].path, path) == 0)
+            break;
+    }
+
+    if (i < heap_len)
+    {
+        /* already tracked: estimates only grow, so sift toward the leaves */
+        if (est > heap[i].count)
+        {
+            heap[i].count = est;
+            heap_sift_down(i);
+        }
+    }
+    else if (heap_len < STATS_TOP_K)
+    {
+        i = heap_len++;
+        snprintf(heap[i].path, sizeof(heap[i].path), "%s", path);
+        heap[i].hash = h;
+        heap[i].count = est;
+        heap_sift_up(i);
+    }
+    else if (est > heap[0].count)
+    {
+        /* evict the least requested path */
+        snprintf(heap[0].path, sizeof(heap[0].path), "%s", path);
+        heap[0].hash = h;
+        heap[0].count = est;
+        heap_sift_down(0);
+    }
+
+    if (heap_len == STATS_TOP_K)
+        __atomic_store_n(&heap_floor, heap[0].count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+/** @brief qsort() order: most requests first, then by path. */
+static int entry_cmp(const void *a, const void *b)
+{
+    const stats_entry_t *x = a;
+    const stats_entry_t *y = b;
+    if (x->requests != y->requests)
+        return x->requests < y->requests ? 1 : -1;
+    return strcmp(x->path, y->path);
+}
+
+/**
+ * @brief Report the heaviest paths.
+ *
+ * The heap holds each path's estimate from its last request; the
+ * sketches are read again here so that both counts are current.
+ */
+int stats_top(stats_entry_t *out, uint64_t *total_req_out,
+              uint64_t *total_bytes_out)
+{
+    pthread_mutex_lock(&heap_lock);
+    int n = heap_len;
+    for (int i = 0; i < n; i++)
+        memcpy(out[i].path, heap[i].path, sizeof(out[i].path));
+    pthread_mutex_unlock(&heap_lock);
+
+    for (int i = 0; i < n; i++)
+    {
+        uint32_t col[STATS_DEPTH];
+        path_columns(out[i].path, col);
+        out[i].requests = sketch_add(req_sketch, col, 0);
+        out[i].bytes = sketch_add(byte_sketch, col, 0);
+    }
+    qsort(out, (size_t)n, sizeof(out[0]), entry_cmp);
+
+    *total_req_out = __atomic_load_n(&total_requests, __ATOMIC_RELAXED);
+    *total_bytes_out = __atomic_load_n(&total_bytes, __ATOMIC_RELAXED);
+    return n;
+}
@@ -0,0 +1,61 @@
+/*
+ * stats.h -- heavy-hitter path tracking for the server (STATS)
+ *
+ * Every GET, GETFD, WRITE, WRFD, APPND, PATCH and DELTA is recorded
+ * with the path it named and the file bytes it moved. Counts are kept
+ * in two count-min sketches (requests and bytes) of STATS_DEPTH rows
+ * by STATS_WIDTH counters, so memory does not grow with the number of
+ * paths. A sketch never undercounts; with N requests in total, an
+ * estimate exceeds the true count by more than N * e / STATS_WIDTH
+ * (about 0.07% of N) with probability below e^-STATS_DEPTH (2%).
+ *
+ * The STATS_TOP_K paths with the highest request estimates are kept in
+ * a min-heap. Recording a path that cannot enter the heap (its
+ * estimate is below the heap's smallest) is a few relaxed atomic adds
+ * and no lock; only the hot paths take the heap lock.
+ *
+ * Counts cover the server's lifetime; they are not persisted.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+#include "protocol.h"
+
+#define STATS_DEPTH 4       /* sketch rows (independent hashes)  */
+#define STATS_WIDTH 4096    /* counters per row (power of two)   */
+#define STATS_TOP_K 32      /* paths kept in the heavy-hitter heap */
+
+/* One heavy hitter, as reported by stats_top(). */
+typedef struct
+{
+    char path[RFS_MAX_PATH];
+    uint64_t requests;      /* estimated requests naming the path */
+    uint64_t bytes;         /* estimated file bytes moved         */
+} stats_entry_t;
+
+/**
+ * @brief Count one request.
+ *
+ * @param path Remote path the request named.
+ * @param bytes File bytes it moved (sent or received).
+ */
+void stats_record(const char *path, uint64_t bytes);
+
+/**
+ * @brief Report the heaviest paths.
+ *
+ * @param out Receives up to STATS_TOP_K entries, most requested first.
+ * @param total_requests Receives the number of requests recorded.
+ * @param total_bytes Receives the bytes those requests moved.
+ *
+ * @return The number of entries written.
+ */
+int stats_top(stats_entry_t *out, uint64_t *total_requests,
+              uint64_t *total_bytes);
+
+#endif /* STATS_H */
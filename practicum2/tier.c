@@ -0,0 +1,475 @@
+/*
+ * tier.c -- hot/cold tiering of old versions (compressed with zlib)
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#define _GNU_SOURCE     /* O_TMPFILE, st_mtim */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "tier.h"
+#include "index.h"
+#include "protocol.h"
+#include "server.h"
+#include "snapshot.h"
+
+static char hot_dir[1024];
+static char cold_dir[1024];
+static long tier_age = 0;
+static int tier_on = 0;
+static pthread_mutex_t *commit_mutex = NULL;
+
+static pthread_t tier_thread;
+static pthread_mutex_t tier_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tier_wake = PTHREAD_COND_INITIALIZER;
+static int tier_stopping = 0;
+
+/* Totals of one pass, reported when it moved anything. */
+static uint64_t pass_files = 0;
+static uint64_t pass_bytes = 0;
+static uint64_t pass_stored = 0;
+
+/**
+ * @brief Parse an age such as "90", "30m", "12h" or "7d".
+ */
+long tier_parse_age(const char *s)
+{
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (errno != 0 || end == s || v < 0)
+        return -1;
+
+    long unit = 1;
+    switch (*end)
+    {
+    case '\0':
+    case 's':
+        break;
+    case 'm':
+        unit = 60;
+        break;
+    case 'h':
+        unit = 60 * 60;
+        break;
+    case 'd':
+        unit = 24 * 60 * 60;
+        break;
+    default:
+        return -1;
+    }
+    if (*end != '\0' && end[1] != '\0')
+        return -1;
+    return v * unit;
+}
+
+/**
+ * @brief Build the cold path of a version ("<cold root>/<path>.gz").
+ *
+ * @return 0 on success, or -1 if it does not fit.
+ */
+static int cold_path(const char *version_path, char *out, size_t size)
+{
+    return snprintf(out, size, "%s/%s.gz", cold_dir, version_path) < (int)size ? 0 : -1;
+}
+
+/**
+ * @brief Create the directories above a cold path.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+static int make_parents(const char *path)
+{
+    char tmp[1100];
+    if (snprintf(tmp, sizeof(tmp), "%s", path) >= (int)sizeof(tmp))
+        return -1;
+    for (size_t i = strlen(cold_dir) + 1; tmp[i]; i++)
+    {
+        if (tmp[i] == '/')
+        {
+            tmp[i] = '\0';
+            if (mkdir(tmp, 0755) < 0 && errno != EEXIST)
+                return -1;
+            tmp[i] = '/';
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Look up a version in the cold tier.
+ */
+int tier_stat(const char *version_path, struct stat *st)
+{
+    char path[1100];
+    if (!tier_on || cold_path(version_path, path, sizeof(path)) < 0)
+        return -1;
+    return stat(path, st) == 0 && S_ISREG(st->st_mode) ? 0 : -1;
+}
+
+/**
+ * @brief Delete a version from the cold tier.
+ */
+int tier_remove(const char *version_path)
+{
+    char path[1100];
+    if (!tier_on || cold_path(version_path, path, sizeof(path)) < 0)
+        return -1;
+    return unlink(path);
+}
+
+/**
+ * @brief Resolve both cold paths of a rename or link and create the
+ *        directories above the second.
+ *
+ * @return 0 on success, or -1 with errno set.
+ */
+static int cold_pair(const char *from, const char *to, char *src, char *dst,
+                     size_t size)
+{
+    if (!tier_on)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+    if (cold_path(from, src, size) < 0 || cold_path(to, dst, size) < 0)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    struct stat st;
+    if (stat(src, &st) < 0)
+        return -1;
+    return make_parents(dst);
+}
+
+/**
+ * @brief Rename a version within the cold tier (MOVE).
+ */
+int tier_rename(const char *from, const char *to)
+{
+    char src[1100];
+    char dst[1100];
+    if (cold_pair(from, to, src, dst, sizeof(src)) < 0)
+        return -1;
+    return rename(src, dst);
+}
+
+/**
+ * @brief Give a cold version a second name (COPY).
+ */
+int tier_link(const char *from, const char *to)
+{
+    char src[1100];
+    char dst[1100];
+    if (cold_pair(from, to, src, dst, sizeof(src)) < 0)
+        return -1;
+    return link(src, dst);
+}
+
+/**
+ * @brief Open a cold version for reading.
+ *
+ * The data is decompressed into an O_TMPFILE file on the cold tier's
+ * file system (or a temp file unlinked at once where O_TMPFILE is not
+ * supported), which disappears when the descriptor is closed.
+ */
+int tier_open(const char *version_path)
+{
+    char path[1100];
+    if (!tier_on || cold_path(version_path, path, sizeof(path)) < 0)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    int src = open(path, O_RDONLY);
+    if (src < 0)
+        return -1;
+    struct stat st;
+    fstat(src, &st);
+
+    int out = open(cold_dir, O_TMPFILE | O_RDWR, 0600);
+    if (out < 0)
+    {
+        char tmp[1100];
+        snprintf(tmp, sizeof(tmp), "%s/%sXXXXXX", cold_dir, RFS_TMP_MARKER);
+        out = mkstemp(tmp);
+        if (out >= 0)
+            unlink(tmp);
+    }
+    gzFile gz = gzdopen(src, "rb");
+    if (out < 0 || !gz)
+    {
+        if (gz)
+            gzclose(gz);
+        else
+            close(src);
+        if (out >= 0)
+            close(out);
+        errno = EIO;
+        return -1;
+    }
+
+    uint8_t buf[RFS_IO_CHUNK];
+    int n;
+    int failed = 0;
+    while (!failed && (n = gzread(gz, buf, sizeof(buf))) > 0)
+    {
+        for (int off = 0; off < n;)
+        {
+            ssize_t w = write(out, buf + off, (size_t)(n - off));
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0)
+            {
+                failed = 1;
+                break;
+            }
+            off += (int)w;
+        }
+    }
+    if (n < 0 || gzclose(gz) != Z_OK)
+        failed = 1;
+
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    if (failed || futimens(out, times) < 0 || lseek(out, 0, SEEK_SET) < 0)
+    {
+        fprintf(stderr, "Tier: cannot read %s\n", path);
+        close(out);
+        errno = EIO;
+        return -1;
+    }
+    return out;
+}
+
+/**
+ * @brief Compress one version into the cold tier and drop the hot copy.
+ *
+ * @param dir Open hot directory holding the version.
+ * @param rel Remote path of @p dir.
+ * @param name Version file name.
+ * @param st Its metadata, read by the caller.
+ */
+static void move_version(int dir, const char *rel, const char *name,
+                         const struct stat *st)
+{
+    char version_path[RFS_MAX_PATH];
+    char dst[1100];
+    char tmp[1200];
+    if (snprintf(version_path, sizeof(version_path), "%s%s%s", rel,
+                 rel[0] ? "/" : "", name) >= (int)sizeof(version_path) ||
+        cold_path(version_path, dst, sizeof(dst)) < 0 ||
+        snprintf(tmp, sizeof(tmp), "%s%sXXXXXX", dst, RFS_TMP_MARKER) >= (int)sizeof(tmp) ||
+        make_parents(dst) < 0)
+        return;
+
+    int src = openat(dir, name, O_RDONLY);
+    if (src < 0)
+        return;
+    int fd = mkstemp(tmp);
+    int gz_fd = fd >= 0 ? dup(fd) : -1;
+    gzFile gz = gz_fd >= 0 ? gzdopen(gz_fd, "wb") : NULL;
+    int failed = !gz;
+    if (!gz && gz_fd >= 0)
+        close(gz_fd);
+
+    uint8_t buf[RFS_IO_CHUNK];
+    ssize_t n = 0;
+    while (!failed && (n = read(src, buf, sizeof(buf))) != 0)
+    {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 || gzwrite(gz, buf, (unsigned)n) != (int)n)
+            failed = 1;
+    }
+    close(src);
+    if (gz && gzclose(gz) != Z_OK)
+        failed = 1;
+
+    struct timespec times[2] = { st->st_atim, st->st_mtim };
+    struct stat cst;
+    if (failed || futimens(fd, times) < 0 || fsync(fd) < 0 || fstat(fd, &cst) < 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(tmp);
+        }
+        fprintf(stderr, "Tier: cannot compress %s\n", version_path);
+        return;
+    }
+    close(fd);
+
+    /* install the cold copy only if the hot one is still this version */
+    int moved = 0;
+    struct stat now;
+    pthread_mutex_lock(commit_mutex);
+    if (fstatat(dir, name, &now, AT_SYMLINK_NOFOLLOW) == 0 &&
+        now.st_ino == st->st_ino && now.st_size == st->st_size &&
+        now.st_mtim.tv_sec == st->st_mtim.tv_sec &&
+        now.st_mtim.tv_nsec == st->st_mtim.tv_nsec &&
+        rename(tmp, dst) == 0)
+    {
+        unlinkat(dir, name, 0);
+        moved = 1;
+    }
+    pthread_mutex_unlock(commit_mutex);
+
+    if (!moved)
+    {
+        unlink(tmp);
+        return;
+    }
+    pass_files++;
+    pass_bytes += (uint64_t)st->st_size;
+    pass_stored += (uint64_t)cst.st_size;
+}
+
+/** @brief Whether tier_stop() was called. */
+static int stopping(void)
+{
+    pthread_mutex_lock(&tier_lock);
+    int stop = tier_stopping;
+    pthread_mutex_unlock(&tier_lock);
+    return stop;
+}
+
+/**
+ * @brief Move every old enough version below a hot directory.
+ *
+ * @param dir Open hot directory (closed by this function).
+ * @param rel Its remote path ("" for the root).
+ * @param cutoff Versions modified before this time move.
+ */
+static void tier_dir(int dir, const char *rel, time_t cutoff)
+{
+    DIR *d = fdopendir(dir);
+    if (!d)
+    {
+        close(dir);
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL && !stopping())
+    {
+        const char *name = de->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+            strstr(name, RFS_TMP_MARKER) != NULL)
+            continue;
+        if (rel[0] == '\0' && (strcmp(name, SNAPSHOT_DIR) == 0 ||
+                               strncmp(name, INDEX_FILE, strlen(INDEX_FILE)) == 0))
+            continue;
+
+        struct stat st;
+        if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+            continue;
+
+        if (S_ISDIR(st.st_mode))
+        {
+            char child[RFS_MAX_PATH];
+            if (snprintf(child, sizeof(child), "%s%s%s", rel, rel[0] ? "/" : "",
+                         name) >= (int)sizeof(child))
+                continue;
+            int sub = openat(dirfd(d), name, O_RDONLY | O_DIRECTORY);
+            if (sub >= 0)
+                tier_dir(sub, child, cutoff);
+        }
+        else if (S_ISREG(st.st_mode) && index_is_version_name(name) &&
+                 st.st_mtime < cutoff)
+            move_version(dirfd(d), rel, name, &st);
+    }
+    closedir(d);
+}
+
+/**
+ * @brief Tiering thread: one pass over the hot tree, then sleep.
+ *
+ * Passes run every @c tier_age seconds, but at least every
+ * TIER_MAX_INTERVAL seconds so a long age is still honoured promptly.
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *tier_main(void *arg)
+{
+    (void)arg;
+    long interval = tier_age < TIER_MAX_INTERVAL ? tier_age : TIER_MAX_INTERVAL;
+    if (interval < 1)
+        interval = 1;
+
+    while (!stopping())
+    {
+        pass_files = pass_bytes = pass_stored = 0;
+        int root = open(hot_dir, O_RDONLY | O_DIRECTORY);
+        if (root >= 0)
+            tier_dir(root, "", time(NULL) - tier_age);
+        if (pass_files > 0)
+            printf("Tier: moved %llu versions to %s (%llu bytes -> %llu compressed)\n",
+                   (unsigned long long)pass_files, cold_dir,
+                   (unsigned long long)pass_bytes, (unsigned long long)pass_stored);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += interval;
+        pthread_mutex_lock(&tier_lock);
+        while (!tier_stopping &&
+               pthread_cond_timedwait(&tier_wake, &tier_lock, &deadline) != ETIMEDOUT)
+            ;
+        pthread_mutex_unlock(&tier_lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start moving old versions to the cold tier.
+ */
+int tier_init(const char *hot_root, const char *cold_root, long age,
+              pthread_mutex_t *commit_lock)
+{
+    snprintf(hot_dir, sizeof(hot_dir), "%s", hot_root);
+    snprintf(cold_dir, sizeof(cold_dir), "%s", cold_root);
+    if (mkdir(cold_dir, 0755) < 0 && errno != EEXIST)
+    {
+        perror("mkdir(cold root)");
+        return -1;
+    }
+
+    tier_age = age;
+    commit_mutex = commit_lock;
+    tier_on = 1;
+    if (pthread_create(&tier_thread, NULL, tier_main, NULL) != 0)
+    {
+        perror("pthread_create(tier)");
+        tier_on = 0;
+        return -1;
+    }
+    printf("Tiering: versions older than %ld s move to %s\n", age, cold_dir);
+    return 0;
+}
+
+/**
+ * @brief Stop the tiering thread (waits for the file it is moving).
+ */
+void tier_stop(void)
+{
+    if (!tier_on)
+        return;
+    pthread_mutex_lock(&tier_lock);
+    tier_stopping = 1;
+    pthread_cond_signal(&tier_wake);
+    pthread_mutex_unlock(&tier_lock);
+    pthread_join(tier_thread, NULL);
+}
@@ -0,0 +1,122 @@
+/*
+ * tier.h -- hot/cold tiering of old versions
+ *
+ * When the server is started with a cold root (-C), a background thread
+ * moves saved versions (.vN files) older than an age threshold (-T) out
+ * of SERVER_ROOT. They are stored gzip-compressed under the cold root,
+ * at the same relative path plus ".gz":
+ *
+ *   rfs_root/reports/q3.txt.v2  ->  <cold root>/reports/q3.txt.v2.gz
+ *
+ * Current versions always stay hot, so the hot tier only holds recent
+ * data. Compressed versions keep their modification time and can be
+ * read with zcat.
+ *
+ * A version is compressed into a temp file beside its cold location,
+ * synced and renamed into place. Only then is the hot copy unlinked,
+ * under the commit lock, and only if it was not removed or replaced
+ * meanwhile. A crash in between leaves both copies; the hot one is
+ * used and the next pass moves it again.
+ *
+ * GET -v (and GETFD) of a cold version decompresses it into an
+ * unlinked temp file; LS, RM, COPY, MOVE, LSDIR and version numbering
+ * look at both tiers. Snapshots link the hot tier only, so a snapshot taken after a
+ * version went cold does not contain it.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef TIER_H
+#define TIER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define TIER_DEFAULT_AGE  (24 * 60 * 60)  /* seconds, unless -T is given  */
+#define TIER_MAX_INTERVAL 300             /* most seconds between passes  */
+
+/**
+ * @brief Parse an age such as "90", "30m", "12h" or "7d".
+ *
+ * @param s Number with an optional s, m, h or d suffix.
+ *
+ * @return The age in seconds, or -1 if @p s is not valid.
+ */
+long tier_parse_age(const char *s);
+
+/**
+ * @brief Start moving old versions to the cold tier.
+ *
+ * @param hot_root Server root directory.
+ * @param cold_root Cold tier root (created if missing).
+ * @param age Versions last modified more than @p age seconds ago move.
+ * @param commit_lock Lock the server holds while committing, listing
+ *                    and removing versions.
+ *
+ * @return 0 on success, or -1 on error (tiering stays off).
+ */
+int tier_init(const char *hot_root, const char *cold_root, long age,
+              pthread_mutex_t *commit_lock);
+
+/**
+ * @brief Stop the tiering thread (waits for the file it is moving).
+ */
+void tier_stop(void);
+
+/**
+ * @brief Look up a version in the cold tier.
+ *
+ * @param version_path Remote path of the version ("a/b.txt.v3").
+ * @param st Receives the compressed file's metadata; its mtime is the
+ *           version's.
+ *
+ * @return 0 if the version is cold, else -1.
+ */
+int tier_stat(const char *version_path, struct stat *st);
+
+/**
+ * @brief Open a cold version for reading.
+ *
+ * @param version_path Remote path of the version ("a/b.txt.v3").
+ *
+ * @return A descriptor of an unlinked temp file holding the
+ *         decompressed data (at offset 0), or -1 with errno set
+ *         (ENOENT if the version is not cold).
+ */
+int tier_open(const char *version_path);
+
+/**
+ * @brief Delete a version from the cold tier.
+ *
+ * @param version_path Remote path of the version ("a/b.txt.v3").
+ *
+ * @return 0 on success, or -1 if it was not there or unlink failed.
+ */
+int tier_remove(const char *version_path);
+
+/**
+ * @brief Rename a version within the cold tier (MOVE).
+ *
+ * @param from Remote path of the version ("a/b.txt.v3").
+ * @param to Remote path it is to have ("c/d.txt.v3").
+ *
+ * @return 0 on success, or -1 with errno set (ENOENT if @p from is
+ *         not cold).
+ */
+int tier_rename(const char *from, const char *to);
+
+/**
+ * @brief Give a cold version a second name (COPY).
+ *
+ * Cold files are never modified, so the copy is a hard link.
+ *
+ * @param from Remote path of the version ("a/b.txt.v3").
+ * @param to Remote path the copy is to have ("c/d.txt.v3").
+ *
+ * @return 0 on success, or -1 with errno set (ENOENT if @p from is
+ *         not cold).
+ */
+int tier_link(const char *from, const char *to);
+
+#endif /* TIER_H */
@@ -0,0 +1,208 @@
+/*
+ * timing.c -- per-operation timing for the rfs client (--stats)
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "timing.h"
+#include "protocol.h"
+
+int timing_on = 0;
+
+/* Times are timing_now() seconds; 0 means "not yet". */
+typedef struct
+{
+    char op[16];
+    char path[RFS_MAX_PATH];
+    double start;
+    double connect;             /* summed connect durations           */
+    double last_event;          /* last send, reply or connect        */
+    double last_sent;
+    double ttfb;                /* -1 until the first reply           */
+    double data_start;
+    double data_end;
+    double disk;
+    uint64_t bytes;
+} op_timing_t;
+
+/* Totals over every operation of the run. */
+typedef struct
+{
+    unsigned long ops;
+    unsigned long failed;
+    uint64_t bytes;
+    double connect;
+    double ttfb;
+    double transfer;
+    double disk;
+    double total;
+} run_timing_t;
+
+static pthread_mutex_t timing_mutex = PTHREAD_MUTEX_INITIALIZER;
+static op_timing_t cur;
+static int active = 0;
+static run_timing_t run;
+
+/**
+ * @brief Monotonic clock in seconds.
+ */
+double timing_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/** @brief MB/s over @p sec seconds, or 0 when nothing was timed. */
+static double mbps(uint64_t bytes, double sec)
+{
+    return sec > 0 ? (double)bytes / sec / 1e6 : 0.0;
+}
+
+/**
+ * @brief Print the TOTAL line if the run had more than one operation.
+ */
+static void print_total(void)
+{
+    if (run.ops < 2)
+        return;
+    fprintf(stderr,
+            "STATS op=TOTAL ops=%lu failed=%lu bytes=%llu connect_ms=%.3f "
+            "ttfb_ms=%.3f transfer_ms=%.3f disk_ms=%.3f total_ms=%.3f mbps=%.2f\n",
+            run.ops, run.failed, (unsigned long long)run.bytes,
+            run.connect * 1e3, run.ttfb * 1e3, run.transfer * 1e3,
+            run.disk * 1e3, run.total * 1e3, mbps(run.bytes, run.transfer));
+}
+
+/**
+ * @brief Turn on --stats (the TOTAL line is printed at exit).
+ */
+void timing_enable(void)
+{
+    timing_on = 1;
+    atexit(print_total);
+}
+
+/**
+ * @brief Start timing an operation.
+ */
+void timing_begin(const char *op, const char *path)
+{
+    if (!timing_on)
+        return;
+    pthread_mutex_lock(&timing_mutex);
+    memset(&cur, 0, sizeof(cur));
+    snprintf(cur.op, sizeof(cur.op), "%s", op);
+    snprintf(cur.path, sizeof(cur.path), "%s", path[0] ? path : "/");
+    cur.start = timing_now();
+    cur.last_event = cur.start;
+    cur.ttfb = -1;
+    active = 1;
+    pthread_mutex_unlock(&timing_mutex);
+}
+
+/**
+ * @brief End the current operation and print its STATS line.
+ */
+void timing_end(int status)
+{
+    if (!timing_on)
+        return;
+    pthread_mutex_lock(&timing_mutex);
+    if (!active)
+    {
+        pthread_mutex_unlock(&timing_mutex);
+        return;
+    }
+    active = 0;
+
+    double total = timing_now() - cur.start;
+    double transfer = cur.data_end > cur.data_start ? cur.data_end - cur.data_start : 0;
+    double ttfb = cur.ttfb < 0 ? 0 : cur.ttfb;
+    fprintf(stderr,
+            "STATS op=%s path=%s status=%d bytes=%llu connect_ms=%.3f "
+            "ttfb_ms=%.3f transfer_ms=%.3f disk_ms=%.3f total_ms=%.3f mbps=%.2f\n",
+            cur.op, cur.path, status, (unsigned long long)cur.bytes,
+            cur.connect * 1e3, ttfb * 1e3, transfer * 1e3, cur.disk * 1e3,
+            total * 1e3, mbps(cur.bytes, transfer));
+
+    run.ops++;
+    run.failed += status != 0;
+    run.bytes += cur.bytes;
+    run.connect += cur.connect;
+    run.ttfb += ttfb;
+    run.transfer += transfer;
+    run.disk += cur.disk;
+    run.total += total;
+    pthread_mutex_unlock(&timing_mutex);
+}
+
+/**
+ * @brief A session finished connecting.
+ */
+void timing_connected(double start)
+{
+    if (!timing_on)
+        return;
+    double now = timing_now();
+    pthread_mutex_lock(&timing_mutex);
+    cur.connect += now - start;
+    cur.last_event = now;
+    pthread_mutex_unlock(&timing_mutex);
+}
+
+/**
+ * @brief The last byte of a request (header or payload) was sent.
+ */
+void timing_sent(void)
+{
+    if (!timing_on)
+        return;
+    double now = timing_now();
+    pthread_mutex_lock(&timing_mutex);
+    cur.last_sent = now;
+    cur.last_event = now;
+    pthread_mutex_unlock(&timing_mutex);
+}
+
+/**
+ * @brief A reply header arrived.
+ */
+void timing_reply(void)
+{
+    if (!timing_on)
+        return;
+    double now = timing_now();
+    pthread_mutex_lock(&timing_mutex);
+    if (cur.ttfb < 0 && cur.last_sent > 0)
+        cur.ttfb = now - cur.last_sent;
+    cur.last_event = now;
+    pthread_mutex_unlock(&timing_mutex);
+}
+
+/**
+ * @brief File data moved over the connection.
+ *
+ * The transfer starts at the event just before the first data: the
+ * request header of an upload, or the reply header of a download.
+ */
+void timing_data(uint64_t bytes, double disk_sec)
+{
+    if (!timing_on)
+        return;
+    double now = timing_now();
+    pthread_mutex_lock(&timing_mutex);
+    if (cur.data_start == 0)
+        cur.data_start = cur.last_event;
+    cur.data_end = now;
+    cur.bytes += bytes;
+    cur.disk += disk_sec;
+    pthread_mutex_unlock(&timing_mutex);
+}
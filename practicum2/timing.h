@@ -0,0 +1,78 @@
+/*
+ * timing.h -- per-operation timing for the rfs client (--stats)
+ *
+ * With --stats, every transfer prints one line to stderr when it ends:
+ *
+ *   STATS op=GET path=a/b.txt status=0 bytes=1048576 connect_ms=0.412
+ *         ttfb_ms=0.198 transfer_ms=3.104 disk_ms=1.207 total_ms=4.020
+ *         mbps=337.82
+ *
+ *   connect_ms   TCP (or Unix socket) connect plus the HELLO handshake
+ *   ttfb_ms      from the last request byte sent to the first reply
+ *                byte: the server's think time plus one round trip.
+ *                For an upload this is the wait after the last data
+ *                byte, i.e. the server's commit.
+ *   transfer_ms  first to last byte of file data, either direction
+ *   disk_ms      part of the transfer spent in local reads or writes
+ *   bytes        file data moved (payload only, no headers)
+ *   mbps         bytes / transfer time, in MB/s (10^6 bytes)
+ *
+ * A run that performs more than one operation (DIFF -g) ends with
+ * "STATS op=TOTAL ops=N failed=F" and the summed fields. Every line is
+ * space-separated key=value pairs, so it can be split without a parser.
+ *
+ * Only the main thread begins and ends operations; data and connect
+ * events may come from multipart upload threads.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+/* Non-zero once timing_enable() was called; checked before each hook. */
+extern int timing_on;
+
+/**
+ * @brief Turn on --stats (the TOTAL line is printed at exit).
+ */
+void timing_enable(void);
+
+/**
+ * @brief Start timing an operation.
+ *
+ * @param op Operation name (WRITE, GET, SYNC, APPEND, PATCH, DIFF).
+ * @param path Remote path it acts on.
+ */
+void timing_begin(const char *op, const char *path);
+
+/**
+ * @brief End the current operation and print its STATS line.
+ *
+ * @param status The operation's exit status (0 = success).
+ */
+void timing_end(int status);
+
+/** @brief A session finished connecting; @p start is when it began. */
+void timing_connected(double start);
+
+/** @brief The last byte of a request (header or payload) was sent. */
+void timing_sent(void);
+
+/** @brief A reply header arrived. */
+void timing_reply(void);
+
+/**
+ * @brief File data moved over the connection.
+ *
+ * @param bytes Payload bytes sent or received.
+ * @param disk_sec Seconds of that spent in local reads or writes.
+ */
+void timing_data(uint64_t bytes, double disk_sec);
+
+/** @brief Monotonic clock in seconds. */
+double timing_now(void);
+
+#endif /* TIMING_H */
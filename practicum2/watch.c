@@ -0,0 +1,352 @@
+/*
+ * watch.c -- WATCH subscriptions: notifier thread and event queue
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "watch.h"
+#include "protocol.h"
+
+typedef struct
+{
+    int sock;
+    char *prefix;
+    size_t prefix_len;
+} watcher_t;
+
+typedef struct event
+{
+    struct event *next;
+    uint32_t type;
+    uint32_t version;
+    uint64_t size;
+    char path[];
+} event_t;
+
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* pending events (FIFO) */
+static event_t *ev_head = NULL;
+static event_t *ev_tail = NULL;
+static size_t ev_count = 0;
+static uint64_t ev_seq = 0;
+
+/* watchers waiting to be adopted by the notifier */
+static watcher_t *incoming = NULL;
+static size_t incoming_count = 0;
+static size_t incoming_cap = 0;
+
+/* self-pipe used to wake the notifier out of poll() */
+static int wake_pipe[2] = { -1, -1 };
+
+/**
+ * @brief Wake the notifier thread.
+ */
+static void wake_notifier(void)
+{
+    char b = 1;
+    ssize_t n = write(wake_pipe[1], &b, 1);
+    (void)n;    /* pipe full means a wakeup is already pending */
+}
+
+/**
+ * @brief Send one event to one watcher.
+ *
+ * @param w Watcher to send to.
+ * @param ev Event to encode.
+ * @param seq Event sequence number.
+ *
+ * @return 0 on success, or -1 if the watcher should be dropped.
+ */
+static int send_event(const watcher_t *w, const event_t *ev, uint64_t seq)
+{
+    size_t path_len = strlen(ev->path);
+    uint8_t fixed[16];
+    uint32_t v;
+
+    v = htonl(ev->type);
+    memcpy(fixed, &v, 4);
+    v = htonl(ev->version);
+    memcpy(fixed + 4, &v, 4);
+    rfs_put_u64(fixed + 8, ev->size);
+
+    rfs_resp_t resp;
+    resp.status      = RFS_OK;
+    resp.flags       = RFS_F_EVENT;
+    resp.payload_len = sizeof(fixed) + path_len;
+    resp.arg         = seq;
+
+    if (rfs_send_response(w->sock, &resp) < 0 ||
+        send_all(w->sock, fixed, sizeof(fixed)) < 0 ||
+        send_all(w->sock, ev->path, path_len) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Close and forget watcher @p i of @p list (swap-remove).
+ */
+static void drop_watcher(watcher_t *list, size_t *count, size_t i)
+{
+    close(list[i].sock);
+    free(list[i].prefix);
+    list[i] = list[*count - 1];
+    (*count)--;
+}
+
+/**
+ * @brief Notifier thread: owns all watcher sockets.
+ *
+ * Waits in poll() on the wake pipe and every watcher. Queued events
+ * are delivered to each watcher whose prefix matches; a watcher that
+ * hangs up, sends data, or cannot take an event within
+ * WATCH_SEND_TIMEOUT_MS is dropped. New watchers get their RFS_OK
+ * reply from here, so it can never interleave with an event.
+ *
+ * @param arg Unused.
+ *
+ * @return Never returns.
+ */
+static void *notifier_main(void *arg)
+{
+    (void)arg;
+
+    watcher_t *watchers = NULL;
+    size_t count = 0, cap = 0;
+    struct pollfd *pfds = NULL;
+    size_t pfd_cap = 0;
+
+    while (1)
+    {
+        if (pfd_cap < count + 1)
+        {
+            pfd_cap = (count + 1) * 2;
+            struct pollfd *p = (struct pollfd *)realloc(pfds, pfd_cap * sizeof(*p));
+            if (!p)
+            {
+                perror("realloc");
+                sleep(1);
+                continue;
+            }
+            pfds = p;
+        }
+
+        pfds[0].fd = wake_pipe[0];
+        pfds[0].events = POLLIN;
+        for (size_t i = 0; i < count; i++)
+        {
+            pfds[i + 1].fd = watchers[i].sock;
+            pfds[i + 1].events = POLLIN;
+            pfds[i + 1].revents = 0;
+        }
+
+        if (poll(pfds, count + 1, -1) < 0)
+        {
+            if (errno != EINTR)
+                perror("poll");
+            continue;
+        }
+
+        /* watchers only listen; any input or hangup ends them */
+        for (size_t i = count; i > 0; i--)
+        {
+            if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                drop_watcher(watchers, &count, i - 1);
+        }
+
+        if (!(pfds[0].revents & POLLIN))
+            continue;
+
+        char drain[64];
+        while (read(wake_pipe[0], drain, sizeof(drain)) > 0)
+            ;
+
+        pthread_mutex_lock(&watch_lock);
+        event_t *events = ev_head;
+        uint64_t first_seq = ev_seq - ev_count + 1;
+        ev_head = ev_tail = NULL;
+        ev_count = 0;
+
+        if (count + incoming_count > cap)
+        {
+            size_t ncap = (count + incoming_count) * 2;
+            watcher_t *w = (watcher_t *)realloc(watchers, ncap * sizeof(*w));
+            if (w)
+            {
+                watchers = w;
+                cap = ncap;
+            }
+        }
+        size_t adopted = count;
+        for (size_t i = 0; i < incoming_count; i++)
+        {
+            if (count < cap)
+                watchers[count++] = incoming[i];
+            else
+            {
+                close(incoming[i].sock);
+                free(incoming[i].prefix);
+            }
+        }
+        incoming_count = 0;
+        pthread_mutex_unlock(&watch_lock);
+
+        /* acknowledge new watchers before their first event */
+        rfs_resp_t ack = { RFS_OK, 0, 0, 0 };
+        for (size_t i = count; i > adopted; i--)
+        {
+            if (rfs_send_response(watchers[i - 1].sock, &ack) < 0)
+                drop_watcher(watchers, &count, i - 1);
+        }
+
+        uint64_t seq = first_seq;
+        while (events)
+        {
+            event_t *ev = events;
+            events = ev->next;
+
+            for (size_t i = count; i > 0; i--)
+            {
+                watcher_t *w = &watchers[i - 1];
+                if (strncmp(ev->path, w->prefix, w->prefix_len) == 0 &&
+                    send_event(w, ev, seq) < 0)
+                    drop_watcher(watchers, &count, i - 1);
+            }
+            seq++;
+            free(ev);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start the notifier thread.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int watch_init(void)
+{
+    if (pipe(wake_pipe) < 0)
+    {
+        perror("pipe");
+        return -1;
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, notifier_main, NULL) != 0)
+    {
+        perror("pthread_create");
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+/**
+ * @brief Hand a client connection over to the notifier.
+ *
+ * @param sock Connected v2 client socket.
+ * @param prefix Remote path prefix to match.
+ *
+ * @return 0 on success, or -1 on error (caller keeps @p sock).
+ */
+int watch_add(int sock, const char *prefix)
+{
+    if (wake_pipe[1] < 0)
+        return -1;
+
+    struct timeval tv;
+    tv.tv_sec  = WATCH_SEND_TIMEOUT_MS / 1000;
+    tv.tv_usec = (WATCH_SEND_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    char *copy = strdup(prefix);
+    if (!copy)
+        return -1;
+
+    pthread_mutex_lock(&watch_lock);
+    if (incoming_count == incoming_cap)
+    {
+        size_t ncap = incoming_cap ? incoming_cap * 2 : 8;
+        watcher_t *w = (watcher_t *)realloc(incoming, ncap * sizeof(*w));
+        if (!w)
+        {
+            pthread_mutex_unlock(&watch_lock);
+            free(copy);
+            return -1;
+        }
+        incoming = w;
+        incoming_cap = ncap;
+    }
+    incoming[incoming_count].sock = sock;
+    incoming[incoming_count].prefix = copy;
+    incoming[incoming_count].prefix_len = strlen(copy);
+    incoming_count++;
+    pthread_mutex_unlock(&watch_lock);
+
+    wake_notifier();
+    return 0;
+}
+
+/**
+ * @brief Queue a change event for all matching watchers.
+ *
+ * If WATCH_MAX_QUEUED events are already pending the oldest is
+ * dropped, so a stalled notifier cannot exhaust memory.
+ *
+ * @param event RFS_EV_WRITE or RFS_EV_RM.
+ * @param path Remote path that changed.
+ * @param version Version number now current (0 after RM).
+ * @param size Size of that version in bytes.
+ */
+void watch_notify(uint32_t event, const char *path,
+                  uint32_t version, uint64_t size)
+{
+    if (wake_pipe[1] < 0)
+        return;
+
+    size_t len = strlen(path);
+    event_t *ev = (event_t *)malloc(sizeof(*ev) + len + 1);
+    if (!ev)
+        return;
+    ev->next    = NULL;
+    ev->type    = event;
+    ev->version = version;
+    ev->size    = size;
+    memcpy(ev->path, path, len + 1);
+
+    pthread_mutex_lock(&watch_lock);
+    if (ev_tail)
+        ev_tail->next = ev;
+    else
+        ev_head = ev;
+    ev_tail = ev;
+    ev_count++;
+    ev_seq++;
+
+    if (ev_count > WATCH_MAX_QUEUED)
+    {
+        event_t *old = ev_head;
+        ev_head = old->next;
+        ev_count--;
+        free(old);
+    }
+    pthread_mutex_unlock(&watch_lock);
+
+    wake_notifier();
+}
@@ -0,0 +1,66 @@
+/*
+ * watch.h -- WATCH subscriptions: push change events to clients
+ *
+ * A client sends WATCH with a path prefix and keeps the connection
+ * open. From then on, every committed WRITE or RM whose remote path
+ * starts with that prefix produces one event frame on the connection:
+ * a v2 response header (status RFS_OK, flags RFS_F_EVENT, arg = event
+ * sequence number) followed by the payload
+ *
+ *   uint32 event    RFS_EV_WRITE or RFS_EV_RM (protocol.h)
+ *   uint32 version  version number now current (0 after RM)
+ *   uint64 size     size of that version in bytes (0 after RM)
+ *   path            remote path (payload_len - 16 bytes, no NUL)
+ *
+ * Watched sockets are owned by a single notifier thread, so an idle
+ * watcher costs no worker thread. Committing threads only queue the
+ * event; the notifier does the sending.
+ *
+ * Sooji Kim | CS5600 | Northeastern University
+ * Fall 2025 | Dec 6 2025
+ */
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+
+#define WATCH_MAX_QUEUED  65536   /* events buffered before dropping */
+#define WATCH_SEND_TIMEOUT_MS 1000 /* a watcher this slow is dropped */
+
+/**
+ * @brief Start the notifier thread.
+ *
+ * @return 0 on success, or -1 on error.
+ */
+int watch_init(void);
+
+/**
+ * @brief Hand a client connection over to the notifier.
+ *
+ * On success the notifier owns @p sock: it sends the RFS_OK reply to
+ * the WATCH request, then events, and closes the socket when the
+ * client disconnects or falls behind. Every event queued after this
+ * returns is delivered.
+ *
+ * @param sock Connected v2 client socket (WATCH not yet answered).
+ * @param prefix Remote path prefix to match ("" matches everything).
+ *
+ * @return 0 on success, or -1 on error (the caller still owns @p sock).
+ */
+int watch_add(int sock, const char *prefix);
+
+/**
+ * @brief Queue a change event for all matching watchers.
+ *
+ * Cheap and non-blocking: callers may hold the commit lock, which
+ * keeps events in commit order.
+ *
+ * @param event RFS_EV_WRITE or RFS_EV_RM.
+ * @param path Remote path that changed.
+ * @param version Version number now current (0 after RM).
+ * @param size Size of that version in bytes.
+ */
+void watch_notify(uint32_t event, const char *path,
+                  uint32_t version, uint64_t size);
+
+#endif /* WATCH_H */